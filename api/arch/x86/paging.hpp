@@ -194,6 +194,9 @@ inline std::ostream& operator<<(std::ostream& out, const Summary& sum){
   return out;
 }
 
+/** Invalidate page (e.g. flush TLB entry) **/
+void invalidate(void *pageaddr);
+
 /**
  * Multi-level page directories / page tables
  * (x86) Backend for os::mem::map / os::mem::protect
@@ -785,6 +788,44 @@ public:
   }
 
 
+  /**
+   * Recursively replace page directories fully covered by the identity
+   * mapping req.lin -> req.lin + req.size with single pages of the largest
+   * size allowed by req.page_sizes, setting req.flags on them.
+   * Each entry is replaced with a single write, so the range stays mapped
+   * throughout. The replaced directories are only deleted if free_dirs is
+   * set, since other CPUs might still have them cached.
+   * @returns the number of page directories replaced
+   **/
+  int collapse_r(Map req, bool free_dirs)
+  {
+    Expects(req.phys == req.lin);
+    int count = 0;
+    const uintptr_t end = req.lin + req.size;
+    uintptr_t addr = std::max(req.lin, start_addr()) & ~(page_size - 1);
+
+    for (; addr < end and within_range(addr); addr += page_size)
+    {
+      auto* ent = entry(addr);
+      if (not is_page_dir(*ent)) continue;
+
+      auto* pdir = page_dir(ent);
+      const bool covered = addr >= req.lin and addr + page_size <= end;
+      if (covered and (req.page_sizes & page_size)
+          and (allowed_flags & Pflag::huge) != Pflag::none)
+      {
+        *ent = addr | ((req.flags | Pflag::present | Pflag::huge) & allowed_flags);
+        invalidate((void*) addr);
+        if (free_dirs) delete pdir;
+        count++;
+      }
+      else {
+        count += pdir->collapse_r(req, free_dirs);
+      }
+    }
+    return count;
+  }
+
   /** Recursively get protection flags for a page enclosing addr **/
   Pflag flags_r(uintptr_t addr)
   {
@@ -894,6 +935,11 @@ inline  x86::paging::Summary Pml1::summary(bool, int){
 }
 
 
+template <>
+inline int Pml1::collapse_r(Map, bool)
+{ return 0; }
+
+
 template <>
 inline Map Pml1::map_r(Map req)
 {
@@ -917,9 +963,6 @@ inline Map Pml1::map_r(Map req)
 }
 
 
-/** Invalidate page (e.g. flush TLB entry) **/
-void invalidate(void *pageaddr);
-
 template <>
 inline void Pml1::traverse(delegate<void(void*, size_t)>) {}
 
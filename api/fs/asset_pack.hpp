@@ -0,0 +1,169 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef FS_ASSET_PACK_HPP
+#define FS_ASSET_PACK_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace fs {
+
+  /**
+   * A read-only image of files, made to be used in place.
+   *
+   * The image is built on the host by tools/memdisk/assetpack.py (see
+   * os_add_asset_pack) and is usually the memdisk. Nothing is parsed or
+   * copied at runtime: paths are found through a perfect hash, file data
+   * starts on a page boundary, and files are handed out as views into
+   * the image. Files can carry gzip and brotli variants next to the
+   * original, so precompressed content can be sent as is.
+   *
+   * Layout: header, entries sorted by path, hash table, path strings,
+   * then the file data.
+   **/
+  class Asset_pack {
+  public:
+    static constexpr char     magic[8] = {'I','O','S','P','A','C','K','1'};
+    static constexpr uint32_t version  = 1;
+
+    enum class Encoding : uint8_t {
+      identity = 0,
+      gzip     = 1,
+      brotli   = 2
+    };
+    static constexpr int encodings = 3;
+
+    struct Header {
+      char     magic[8];
+      uint32_t version;
+      uint32_t count;       // number of files
+      uint32_t page_size;   // file data alignment
+      uint32_t flags;
+      uint64_t entries;     // Entry[count], sorted by path
+      uint64_t table;       // int32_t seed[count], uint32_t slot[count]
+      uint64_t strings;     // paths, not terminated
+      uint64_t strings_size;
+      uint64_t image_size;
+    } __attribute__((packed));
+    static_assert(sizeof(Header) == 64);
+
+    struct Blob {
+      uint64_t offset;      // from the start of the image
+      uint64_t size;        // 0 when there is no such variant
+    } __attribute__((packed));
+
+    struct Entry {
+      uint32_t path;        // offset into the strings
+      uint16_t path_len;
+      uint16_t flags;
+      uint32_t hash;        // hash(0, path)
+      uint32_t reserved;
+      Blob     data[encodings];
+    } __attribute__((packed));
+    static_assert(sizeof(Entry) == 64);
+
+    /** One file in the pack */
+    class Asset {
+    public:
+      Asset() = default;
+
+      bool is_valid() const noexcept
+      { return entry_ != nullptr; }
+      explicit operator bool() const noexcept
+      { return is_valid(); }
+
+      /** Path relative to the root, without the leading slash */
+      std::string_view path() const noexcept;
+
+      /** The file contents in enc, empty if there is no such variant */
+      std::string_view data(Encoding enc = Encoding::identity) const noexcept;
+
+      size_t size(Encoding enc = Encoding::identity) const noexcept
+      { return entry_ ? entry_->data[(int) enc].size : 0; }
+
+      bool has(Encoding enc) const noexcept
+      { return enc == Encoding::identity or size(enc) != 0; }
+
+      /**
+       * The smallest variant a client accepts, given the value of its
+       * Accept-Encoding header
+       **/
+      Encoding best(std::string_view accept_encoding) const noexcept;
+
+    private:
+      friend class Asset_pack;
+      Asset(const Asset_pack* pack, const Entry* entry) noexcept
+        : pack_{pack}, entry_{entry} {}
+
+      const Asset_pack* pack_  = nullptr;
+      const Entry*      entry_ = nullptr;
+    };
+
+    /** An empty pack */
+    Asset_pack() = default;
+
+    /**
+     * Use the image in place, it has to outlive the pack.
+     * A malformed image gives an empty pack, see is_valid().
+     **/
+    explicit Asset_pack(std::string_view image) noexcept;
+
+    bool is_valid() const noexcept
+    { return header_ != nullptr; }
+
+    /** Number of files */
+    size_t size() const noexcept
+    { return header_ ? header_->count : 0; }
+
+    bool empty() const noexcept
+    { return size() == 0; }
+
+    /** Find a file by path, with or without the leading slash */
+    Asset find(std::string_view path) const noexcept;
+
+    /** The file at index, files are sorted by path */
+    Asset at(size_t index) const noexcept;
+
+    /** Files whose path starts with prefix, in path order */
+    std::vector<Asset> list(std::string_view prefix = {}) const;
+
+    /** FNV-1a with seed as offset basis (the default basis when 0) */
+    static constexpr uint32_t hash(uint32_t seed, std::string_view str) noexcept
+    {
+      uint32_t h = seed ? seed : 0x811C9DC5;
+      for (const char c : str)
+        h = (h ^ (uint8_t) c) * 0x01000193;
+      return h;
+    }
+
+  private:
+    std::string_view path_of(const Entry&) const noexcept;
+    bool check() const noexcept;
+
+    std::string_view image_;
+    const Header*    header_  = nullptr;
+    const Entry*     entries_ = nullptr;
+    const int32_t*   seeds_   = nullptr;
+    const uint32_t*  slots_   = nullptr;
+  };
+
+} //< namespace fs
+
+#endif //< FS_ASSET_PACK_HPP
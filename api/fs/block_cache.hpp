@@ -0,0 +1,129 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+#ifndef FS_BLOCK_CACHE_HPP
+#define FS_BLOCK_CACHE_HPP
+
+#include <hw/block_device.hpp>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace fs {
+
+  /**
+   * A read cache of device sectors, for filesystems that keep going back
+   * to the same sectors (boot sector, directories, allocation tables).
+   *
+   * Sectors are kept in one slab in least-recently-used order. A read that
+   * misses fetches the whole missing range in a single device read, and
+   * when reads run sequentially the fetch is extended with read-ahead.
+   * Reads larger than the bypass limit go straight to the device, so that
+   * streaming a big file doesn't evict the metadata.
+   *
+   * Every read returns a fresh buffer, callers may modify it.
+   * The cache doesn't see writes, so it's only meant for read-only mounts.
+   **/
+  class Block_cache {
+  public:
+    using block_t      = hw::Block_device::block_t;
+    using buffer_t     = hw::Block_device::buffer_t;
+    using on_read_func = hw::Block_device::on_read_func;
+
+    static constexpr size_t default_capacity   = 1024; // sectors
+    static constexpr size_t default_read_ahead = 32;   // sectors
+    static constexpr size_t default_bypass     = 64;   // sectors
+
+    Block_cache(hw::Block_device& dev,
+                size_t capacity   = default_capacity,
+                size_t read_ahead = default_read_ahead,
+                size_t bypass     = default_bypass);
+
+    void read(block_t blk, size_t count, on_read_func reader);
+
+    void read(block_t blk, on_read_func reader)
+    { read(blk, 1, std::move(reader)); }
+
+    buffer_t read_sync(block_t blk, size_t count = 1);
+
+    /** Forget every cached sector */
+    void invalidate();
+
+    hw::Block_device& device() noexcept
+    { return dev_; }
+
+    size_t capacity() const noexcept
+    { return capacity_; }
+
+    /** Number of sectors currently cached */
+    size_t size() const noexcept
+    { return index_.size(); }
+
+    bool contains(block_t blk) const
+    { return index_.count(blk) != 0; }
+
+    struct Stats {
+      uint64_t& hits;       // sectors served from the cache
+      uint64_t& misses;     // sectors read from the device on demand
+      uint64_t& read_ahead; // sectors read from the device ahead of time
+    };
+    const Stats& stats() const noexcept
+    { return stats_; }
+
+  private:
+    // [first, last) sectors of a read that have to come from the device
+    struct Range {
+      block_t first;
+      block_t last;
+    };
+    Range plan(block_t blk, size_t count);
+    void  copy_cached(block_t blk, size_t count, uint8_t* dest, Range skip);
+    void  insert(block_t first, const uint8_t* data, size_t count);
+    void  touch(uint32_t slot);
+    void  link_front(uint32_t slot);
+    void  unlink(uint32_t slot);
+
+    hw::Block_device& dev_;
+    const size_t   capacity_;
+    const size_t   read_ahead_;
+    const size_t   bypass_;
+    const size_t   sector_size_;
+    // where the next read starts if the access is sequential
+    block_t        next_seq_ = ~block_t(0);
+
+    // capacity sectors, allocated on first use
+    std::unique_ptr<uint8_t[]> slab_;
+    struct Slot {
+      block_t  blk;
+      uint32_t prev;
+      uint32_t next;
+    };
+    std::vector<Slot> slots_;
+    std::unordered_map<block_t, uint32_t> index_;
+    // most recently used slot, its prev is the least recently used
+    uint32_t head_ = none;
+    static constexpr uint32_t none = UINT32_MAX;
+
+    Stats stats_;
+  };
+
+} //< namespace fs
+
+#endif //< FS_BLOCK_CACHE_HPP
@@ -21,11 +21,13 @@
 
 #include <fs/filesystem.hpp>
 #include <fs/dirent.hpp>
+#include <fs/block_cache.hpp>
 #include <hw/block_device.hpp>
 #include <functional>
 #include <cstdint>
 #include <memory>
 #include <map>
+#include <vector>
 
 namespace fs
 {
@@ -124,8 +126,54 @@ namespace fs
     error_t traverse(Path path, dirvector&, const Dirent* const = nullptr) const;
     error_t int_ls(uint32_t sector, dirvector&) const;
 
+    // a run of clusters that follow each other on disk
+    struct Extent {
+      uint32_t file_cluster; // where the run starts in the file
+      uint32_t cluster;      // where the run starts on disk
+      uint32_t count;
+    };
+    typedef std::vector<Extent> Extent_list;
+    typedef std::shared_ptr<const Extent_list> Extents_ptr;
+    // a run of sectors that can be read in one go
+    struct Run {
+      uint64_t sector;
+      uint32_t count;
+    };
+    // following a cluster chain through the FAT
+    struct Chain_walk {
+      Chain_walk(uint32_t first, uint32_t needed_)
+        : list{{0, first, 1}}, cluster{first}, needed{needed_} {}
+      void add(uint32_t next);
+
+      Extent_list list;
+      uint32_t cluster; // the last cluster found
+      uint32_t covered = 1;
+      uint32_t needed;  // clusters the file takes up
+    };
+
+    // the extents of a file, taking up needed clusters from cluster
+    // returns nullptr when the FAT could not be read
+    Extents_ptr extents(uint32_t cluster, uint32_t needed) const;
+    typedef delegate<void(Extents_ptr)> on_extents_func;
+    void extents(uint32_t cluster, uint32_t needed, on_extents_func) const;
+    Extents_ptr cached_extents(uint32_t cluster) const;
+    Extents_ptr cache_extents(uint32_t cluster, Chain_walk&) const;
+    // follow the chain through the FAT sectors in data, starting at
+    // fat_sector, and return the FAT sector needed to go on (if not done)
+    uint32_t walk_chain(Chain_walk&, uint32_t fat_sector,
+                        const uint8_t* data, size_t len, bool& done) const;
+    // device sectors holding nsect sectors of a file from sector
+    std::vector<Run> file_runs(const Extent_list&, uint32_t sector, uint32_t nsect) const;
+    uint32_t clusters_needed(uint64_t size) const noexcept;
+    uint32_t fat_offset(uint32_t cl) const noexcept;
+    uint32_t fat_entry(const uint8_t* entry, uint32_t cl) const noexcept;
+    void read_runs(std::vector<Run>, hw::Block_device::on_read_func) const;
+    buffer_t read_runs(const std::vector<Run>&) const;
+
     // device we can read and write sectors to
     hw::Block_device& device;
+    // sectors are read through this
+    mutable Block_cache cache;
 
     /// private members ///
     // the location of this partition
@@ -150,6 +198,18 @@ namespace fs
 
     // simplistic cache for stat results
     std::map<std::string, Dirent> stat_cache;
+    // extents of recently read files, by first cluster, evicting the
+    // least recently used. FAT is read-only, anything writing to a file
+    // has to drop its entry.
+    struct Cached_extents {
+      Extents_ptr list;
+      uint64_t    used;
+    };
+    mutable std::map<uint32_t, Cached_extents> extent_cache;
+    mutable uint64_t          extent_clock = 0;
+    static constexpr size_t   extent_cache_max = 64;
+    // FAT sectors to read at a time when walking a chain
+    static constexpr uint32_t fat_window = 8;
   };
 
 } // fs
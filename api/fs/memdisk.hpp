@@ -20,6 +20,7 @@
 #define FS_MEMDISK_HPP
 
 #include <cstdint>
+#include <string_view>
 #include <hw/block_device.hpp>
 
 namespace fs {
@@ -52,6 +53,10 @@ namespace fs {
 
     buffer_t read_sync(block_t blk, size_t cnt) override;
 
+    /** The whole image, for formats that are used in place */
+    std::string_view image() const noexcept
+    { return {image_start_, size_t(image_end_ - image_start_)}; }
+
     explicit MemDisk() noexcept;
     explicit MemDisk(const char* start, const char* end) noexcept;
 
@@ -20,7 +20,9 @@
 #define FS_PATH_HPP
 
 #include <deque>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include <expects>
 
@@ -126,6 +128,94 @@ namespace fs {
     std::deque<std::string> stk;
   }; //< class Path
 
+  /**
+   * The components of a path, found while iterating over it, without
+   * copying the path or allocating. Parses like Path: "." is skipped,
+   * and the path ends at the first "//".
+   **/
+  class Path_view {
+  public:
+    class iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type        = std::string_view;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const std::string_view*;
+      using reference         = std::string_view;
+
+      iterator() = default;
+
+      std::string_view operator * () const noexcept
+      { return path_.substr(pos_, len_); }
+
+      iterator& operator ++ () noexcept
+      { next(pos_ + len_); return *this; }
+
+      iterator operator ++ (int) noexcept
+      { auto it = *this; ++(*this); return it; }
+
+      bool operator == (const iterator& other) const noexcept
+      { return pos_ == other.pos_; }
+
+      bool operator != (const iterator& other) const noexcept
+      { return pos_ != other.pos_; }
+
+      /** Where the current component starts in the path */
+      size_t offset() const noexcept
+      { return pos_; }
+
+    private:
+      friend class Path_view;
+      iterator(std::string_view path, size_t from) noexcept
+        : path_{path}
+      { next(from); }
+
+      void next(size_t from) noexcept
+      {
+        while (true) {
+          if (from < path_.size() and path_[from] == '/') {
+            // two separators in a row end the path
+            if (++from < path_.size() and path_[from] == '/') break;
+          }
+          if (from >= path_.size()) break;
+          auto end = path_.find('/', from);
+          if (end == std::string_view::npos) end = path_.size();
+          if (end - from == 1 and path_[from] == '.') {
+            from = end;
+            continue;
+          }
+          pos_ = from;
+          len_ = end - from;
+          return;
+        }
+        pos_ = std::string_view::npos;
+        len_ = 0;
+      }
+
+      std::string_view path_;
+      size_t pos_ = std::string_view::npos;
+      size_t len_ = 0;
+    };
+
+    constexpr Path_view(std::string_view path) noexcept
+      : path_{path} {}
+
+    iterator begin() const noexcept
+    { return {path_, 0}; }
+
+    iterator end() const noexcept
+    { return {}; }
+
+    bool empty() const noexcept
+    { return begin() == end(); }
+
+    std::string_view str() const noexcept
+    { return path_; }
+
+  private:
+    std::string_view path_;
+  }; //< class Path_view
+
 } //< namespace fs
 
 #endif //< FS_PATH_HPP
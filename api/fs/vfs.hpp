@@ -25,7 +25,10 @@
 #include <map>
 #include <memory>
 #include <stdexcept>
+#include <string_view>
+#include <type_traits>
 #include <typeinfo>
+#include <unordered_map>
 #include <info>
 #include <fs/fd_compatible.hpp>
 
@@ -230,6 +233,35 @@ namespace fs {
       return next_node;
     }
 
+    /**
+     * Walk a given path in the VFS tree, without copying it.
+     *
+     * @return pointer to found node, nullptr if none found
+     * @param rest : if given, walk as far as possible like a partial walk,
+     *               and set rest to the part of path left for the dirent
+     **/
+    Obs_ptr find(std::string_view path, std::string_view* rest = nullptr)
+    {
+      Obs_ptr current_node = this;
+      const Path_view view{path};
+
+      for (auto it = view.begin(); it != view.end(); ++it)
+      {
+        auto next_node = current_node->get_child(*it);
+        if (not next_node) {
+          if (rest and current_node->type() == typeid(Dirent)) {
+            *rest = path.substr(it.offset());
+            return current_node;
+          }
+          return nullptr;
+        }
+        current_node = next_node;
+      }
+
+      if (rest) *rest = path.substr(path.size());
+      return current_node;
+    }
+
     template<bool Throw, typename Exception>
     typename std::enable_if<Throw>::type
     throw_if(std::string msg) {
@@ -278,21 +310,26 @@ namespace fs {
       parent->template insert<T>(token, obj, desc);
     }
 
-    Obs_ptr get_child(const std::string& name) const {
-      for (auto&& child : children_)
-        if (child.get()->name() == name) return child.get();
-      return nullptr;
+    Obs_ptr get_child(std::string_view name) const {
+      auto it = child_index_.find(name);
+      return it != child_index_.end() ? it->second : nullptr;
     };
 
     Obs_ptr insert_parent(const std::string& token){
       children_.emplace_back(std::make_unique<VFS_entry>(token, "Directory"));
-      return children_.back().get();
+      return index(children_.back().get());
     }
 
     template <typename T>
     VFS_entry& insert(const std::string& token, T& obj, const std::string& desc) {
       children_.emplace_back(std::make_unique<VFS_entry>(obj, token, desc));
-      return *children_.back();
+      return *index(children_.back().get());
+    }
+
+    Obs_ptr index(Obs_ptr child) {
+      // entries never move, so the key can point into the child's name
+      child_index_.emplace(child->name_, child);
+      return child;
     }
 
     const std::type_info& type_;
@@ -301,6 +338,7 @@ namespace fs {
     std::string name_;
     std::string desc_;
     std::vector<Own_ptr> children_;
+    std::unordered_map<std::string_view, Obs_ptr> child_index_;
     bool is_fd_compatible = false;
 
   }; // End VFS_entry
@@ -322,6 +360,7 @@ namespace fs {
     template<bool create_path = true, typename T>
     static void mount(Path path, T& obj, std::string desc) {
       INFO("VFS", "Mounting %s on %s", type_name(typeid(obj)).c_str(), path.to_string().c_str());;
+      lookup_cache().clear();
       mutable_root().mount<create_path, T>(path, obj, desc);
     }
 
@@ -358,13 +397,24 @@ namespace fs {
     template <typename P = Path>
     static VFS_entry& get_entry(P path){
 
-      Path p{path};
-      auto item = VFS::mutable_root().walk(p);
+      if constexpr (is_path_string<P>) {
+        std::string_view rest;
+        VFS_entry* item = lookup(path, rest);
+
+        if (not item or not rest.empty())
+          throw Err_not_found(std::string("Path ") + std::string(std::string_view(path)) + " does not exist");
 
-      if (not item)
-        throw Err_not_found(std::string("Path ") + p.to_string() + " does not exist");
+        return *item;
+      }
+      else {
+        Path p{path};
+        auto item = VFS::mutable_root().walk(p);
 
-      return *item;
+        if (not item)
+          throw Err_not_found(std::string("Path ") + p.to_string() + " does not exist");
+
+        return *item;
+      }
     }
 
     template <typename T, typename P = Path>
@@ -376,29 +426,51 @@ namespace fs {
     template<typename P = Path>
     static void stat(P path, on_stat_func fn) {
 
-      Path p{path};
-      auto item = VFS::mutable_root().walk(p, true);
+      if constexpr (is_path_string<P>) {
+        std::string_view rest;
+        VFS_entry* item = lookup(path, rest);
+
+        if (not item)
+          throw Err_not_found(std::string("Path ") + std::string(std::string_view(path)) + " does not exist");
 
-      if (not item)
-        throw Err_not_found(std::string("Path ") + p.to_string() + " does not exist");
+        item->obj<Dirent>().stat(Path{std::string(rest)}, fn);
+      }
+      else {
+        Path p{path};
+        auto item = VFS::mutable_root().walk(p, true);
+
+        if (not item)
+          throw Err_not_found(std::string("Path ") + p.to_string() + " does not exist");
 
-      auto&& obj = item->obj<Dirent>();
+        auto&& obj = item->obj<Dirent>();
 
-      obj.stat(p, fn);
+        obj.stat(p, fn);
+      }
     }
 
     template<typename P = Path>
     static Dirent stat_sync(P path) {
 
-      Path p{path};
-      auto item = VFS::mutable_root().walk(p, true);
+      if constexpr (is_path_string<P>) {
+        std::string_view rest;
+        VFS_entry* item = lookup(path, rest);
 
-      if (not item)
-        throw Err_not_found(std::string("Path ") + p.to_string() + " does not exist (stat sync)");
+        if (not item)
+          throw Err_not_found(std::string("Path ") + std::string(std::string_view(path)) + " does not exist (stat sync)");
 
-      auto&& obj = item->obj<Dirent>();
+        return item->obj<Dirent>().stat_sync(Path{std::string(rest)});
+      }
+      else {
+        Path p{path};
+        auto item = VFS::mutable_root().walk(p, true);
+
+        if (not item)
+          throw Err_not_found(std::string("Path ") + p.to_string() + " does not exist (stat sync)");
 
-      return obj.stat_sync(p);
+        auto&& obj = item->obj<Dirent>();
+
+        return obj.stat_sync(p);
+      }
     }
 
 
@@ -448,8 +520,59 @@ namespace fs {
       );
     }
 
+    /** Number of paths in the lookup cache **/
+    static size_t lookup_cache_size() {
+      return lookup_cache().size();
+    }
+
+    /** Paths remembered before the cache starts over **/
+    static constexpr size_t lookup_cache_max = 1024;
+
   private:
 
+    // plain strings take the lookup fast path, without building a Path
+    template <typename P>
+    static constexpr bool is_path_string = std::is_convertible_v<const P&, std::string_view>;
+
+    // a full path, and where the part left for the dirent starts
+    struct Lookup {
+      VFS_entry* entry;
+      size_t     rest;
+    };
+
+    struct Path_hash : std::hash<std::string_view> {
+      using is_transparent = void;
+    };
+
+    using Lookup_cache = std::unordered_map<std::string, Lookup, Path_hash, std::equal_to<>>;
+
+    /**
+     * Walk path as far as possible, through the cache of earlier walks.
+     * Only successful walks are cached, and every mount clears the cache.
+     **/
+    static VFS_entry* lookup(std::string_view path, std::string_view& rest)
+    {
+      auto& cache = lookup_cache();
+      auto it = cache.find(path);
+      if (it != cache.end()) {
+        rest = path.substr(it->second.rest);
+        return it->second.entry;
+      }
+
+      auto item = mutable_root().find(path, &rest);
+      if (item) {
+        if (cache.size() >= lookup_cache_max)
+          cache.clear();
+        cache.emplace(path, Lookup{item, static_cast<size_t>(rest.data() - path.data())});
+      }
+      return item;
+    }
+
+    static Lookup_cache& lookup_cache() {
+      static Lookup_cache cache_;
+      return cache_;
+    }
+
     static Dirent& invalid_dirent() {
       static Dirent dir{nullptr};
       return dir;
@@ -507,15 +630,13 @@ namespace fs {
   /** fs::stat_sync **/
   template <typename P = Path>
   inline Dirent stat_sync(P path) {
-    Path p{path};
-    return VFS::stat_sync(p);
+    return VFS::stat_sync(path);
   }
 
   /** fs::stat async **/
   template <typename P = Path>
   inline void stat(P path, on_stat_func func) {
-    Path p{path};
-    VFS::stat(p, func);
+    VFS::stat(path, func);
   }
 
   /** fs::print_tree **/
@@ -138,6 +138,36 @@ public:
    */
   virtual buffer_t read_sync(block_t blk, size_t count=1) = 0;
 
+  /**
+   * One operation of a batch, see submit()
+   */
+  struct Io_request {
+    enum class Op : uint8_t { READ, WRITE, FLUSH };
+    Op       op    = Op::READ;
+    bool     fua   = false; // WRITE: complete only once the data is durable
+    bool     error = false; // set on completion
+    block_t  blk   = 0;
+    size_t   count = 0;     // READ: number of blocks
+    buffer_t buffer;        // READ: the data read, WRITE: the data to write
+  };
+  using Io_batch      = std::vector<Io_request>;
+  using on_batch_func = delegate<void(Io_batch)>;
+
+  /**
+   * Submit a batch of operations at once
+   *
+   * @param batch
+   *   The operations, which may complete in any order
+   *
+   * @param done
+   *   Called with the batch and the results, once all operations completed
+   *
+   * @note Drivers can ship a whole batch with one notification to the
+   *       device. By default the operations run one by one, and writes
+   *       and flushes fail unless the device is writable.
+   */
+  virtual void submit(Io_batch batch, on_batch_func done);
+
   /**
    * Method to deactivate the block device
    */
@@ -0,0 +1,92 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef HW_NAPI_HPP
+#define HW_NAPI_HPP
+
+#include <cstdint>
+#include <delegate>
+
+namespace hw {
+
+  /**
+   * Switches a receive queue between interrupts and polling, like NAPI.
+   *
+   * The first interrupt masks the queue interrupt and polls the queue for
+   * at most budget packets. As long as a poll uses its whole budget, the
+   * queue keeps being polled from the event loop, with the interrupt still
+   * masked. Once the queue runs dry, the interrupt is unmasked again (and
+   * the queue checked once more, for packets that arrived in between).
+   *
+   * Under load this takes one interrupt per busy period instead of one per
+   * packet, while other events still get their turn between polls.
+   **/
+  class Napi {
+  public:
+    /** Handle up to budget packets, returns the number handled */
+    using poll_func    = delegate<int(int budget)>;
+    /** Whether the queue has packets waiting */
+    using pending_func = delegate<bool()>;
+    /** Mask (false) or unmask (true) the queue interrupt */
+    using irq_func     = delegate<void(bool enable)>;
+
+    static constexpr int default_budget = 128;
+
+    Napi(poll_func poll, pending_func pending, irq_func irq,
+         int budget = default_budget);
+
+    /** Call from the queue interrupt handler */
+    void interrupt();
+
+    /** True while the queue is polled instead of interrupting */
+    bool is_polling() const noexcept
+    { return polling_; }
+
+    int budget() const noexcept
+    { return budget_; }
+
+    void set_budget(int budget) noexcept
+    { budget_ = budget; }
+
+    /** Poll from the current CPU from now on, see Nic::move_to_this_cpu */
+    void move_to_this_cpu();
+
+    struct Stats {
+      uint64_t interrupts = 0;
+      uint64_t polls      = 0;
+      uint64_t packets    = 0;
+      uint64_t exhausted  = 0; // polls that used the whole budget
+    };
+    const Stats& stats() const noexcept
+    { return stats_; }
+
+  private:
+    void poll();
+
+    poll_func    poll_;
+    pending_func pending_;
+    irq_func     irq_;
+    int          budget_;
+    int          event_ = -1;
+    bool         polling_ = false;
+    Stats        stats_;
+  };
+
+}
+
+#endif
@@ -31,7 +31,23 @@ namespace hw
     **/
     virtual void write(block_t blk, buffer_t, on_write_func) = 0;
     virtual bool write_sync(block_t blk, buffer_t) = 0;
-    
+
+    /**
+     * Write blocks, and only complete once they are durable (Force Unit
+     * Access). Defaults to a write followed by a flush.
+    **/
+    virtual void write_fua(block_t blk, buffer_t, on_write_func);
+
+    /**
+     * Make all completed writes durable. Devices without a volatile
+     * write cache complete right away.
+    **/
+    virtual void flush(on_write_func callback) {
+      callback(false);
+    }
+
+    void submit(Io_batch batch, on_batch_func done) override;
+
     virtual ~Writable_Block_device() noexcept = default;
   };
 }
@@ -0,0 +1,105 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef KERNEL_ASYNC_LOG_HPP
+#define KERNEL_ASYNC_LOG_HPP
+
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <delegate>
+#include <util/log_ring.hpp>
+
+/**
+ * Logging off the request path.
+ *
+ * Every CPU queues log records in its own lock-free ring, formatted in
+ * place, without allocating or waiting. A flusher hands the records to
+ * the sink of their channel in batches, from a timer on one CPU, so the
+ * slow part (disks, sockets) happens there and not in the code logging.
+ *
+ * When a ring is full new records are dropped and counted, and the next
+ * flush tells every sink how many were lost. Records less severe than
+ * LOG_WARNING may only fill part of a ring, leaving the rest for errors.
+ **/
+namespace os::async_log {
+
+  /** Bytes each CPU can have queued */
+  static constexpr size_t ring_size = 16384;
+  using Ring = Log_ring<ring_size>;
+
+  /** Longer records are cut to this length, and counted as truncated */
+  static constexpr size_t max_record = Ring::max_record;
+
+  /** Channels there can be */
+  static constexpr int max_channels = 8;
+
+  /** Records of one channel handed to a sink at once, at most */
+  static constexpr size_t batch_size = 64;
+
+  struct Record {
+    int channel;
+    int severity;          // LOG_EMERG to LOG_DEBUG, see <syslog.h>
+    std::string_view text; // valid until the sink returns
+  };
+
+  /** Take count records of one channel, in the order one CPU wrote them */
+  using Sink = delegate<void(const Record* records, size_t count)>;
+
+  /** Add a destination for records, returns the channel writing to it */
+  int add_channel(Sink sink);
+
+  /**
+   * Queue a record from this CPU, without blocking or allocating.
+   *
+   * @return false if the record was dropped
+   **/
+  bool write(int channel, int severity, const char* data, size_t len);
+
+  /** Queue a record formatted straight into the ring */
+  __attribute__((format(printf, 3, 4)))
+  bool printf(int channel, int severity, const char* format, ...);
+  bool vprintf(int channel, int severity, const char* format, va_list args);
+
+  /**
+   * Hand every queued record to its sink, from the current CPU. Returns
+   * right away if another CPU is flushing.
+   **/
+  void flush();
+
+  /** Flush every interval from the current CPU, from now on */
+  void start(std::chrono::milliseconds interval = std::chrono::milliseconds(50));
+  void stop();
+
+  /** True while a flusher is running, and records should be queued */
+  bool is_running() noexcept;
+
+  struct Stats {
+    uint64_t written = 0; // records queued by this CPU
+    uint64_t bytes   = 0; // bytes queued by this CPU
+    uint64_t dropped = 0; // records dropped because the ring was full
+    uint64_t truncated = 0; // records cut to max_record
+    uint64_t flushed = 0; // records handed to a sink
+  };
+  Stats stats(int cpu);
+
+}
+
+#endif
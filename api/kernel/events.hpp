@@ -19,6 +19,7 @@
 #define KERNEL_EVENTS_HPP
 
 #include <delegate>
+#include <expects>
 #include <array>
 #include <deque>
 #include <smp>
@@ -53,6 +54,18 @@ public:
   /** process all pending events */
   void process_events();
 
+  /**
+   * Call back at the start of every process_events(), typically right
+   * after the CPU woke up. Used to retry work that waits for any event.
+   * There is one hook per CPU, which the task scheduler takes, so it can
+   * only be set when unset, or be cleared.
+   */
+  void on_process(event_callback cb)
+  {
+    Expects(not cb or not process_hook);
+    process_hook = std::move(cb);
+  }
+
   /** array of received events */
   auto& get_received_array() const noexcept
   { return received_array; }
@@ -79,6 +92,7 @@ private:
   // using deque because vector resize causes invalidation of ranged for
   // when something subscribes during processing of events
   std::deque<uint8_t> sublist;
+  event_callback process_hook = nullptr;
 };
 
 inline void Events::trigger_event(const uint8_t evt)
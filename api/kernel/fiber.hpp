@@ -154,13 +154,19 @@ public:
   /** Switch into fiber stack and start the function */
   void start();
 
-  /** Yield into the parent fiber. */
+  /**
+   * Yield into the parent fiber, or back to the plain stack that started
+   * or resumed this fiber if there is no parent fiber.
+   */
   static void yield();
 
-  /** Resume a suspended / yielded fiber */
+  /** Resume a suspended / yielded fiber, from a fiber or a plain stack */
   void resume();
 
-  /** TODO: restart a fiber */
+  /**
+   * Make a finished (or never started) fiber ready to start again,
+   * reusing its stack.
+   */
   void restart();
 
   Fiber* parent()
@@ -0,0 +1,82 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef KERNEL_FUTEX_HPP
+#define KERNEL_FUTEX_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Futex wait queues, the kernel side of FUTEX_WAIT and FUTEX_WAKE.
+ *
+ * Waiters are kept in hashed buckets, keyed by the futex address, so
+ * any CPU can wake them. A waiter running in a fiber yields to the parent
+ * fiber while it waits; otherwise it blocks in the event loop of its CPU,
+ * halting until the next interrupt. Waking a waiter on another CPU sends
+ * it an IPI.
+ **/
+namespace os::futex {
+
+  using Timeout = std::chrono::nanoseconds;
+
+  /** Match any waiter when waking */
+  static constexpr uint32_t bitset_any = 0xffffffff;
+
+  /**
+   * Wait for a wake on addr, as long as *addr == val
+   *
+   * @param addr    the futex word
+   * @param val     the expected value of the futex word
+   * @param timeout relative timeout, Timeout::max() waits forever
+   * @param bitset  only wakes with an overlapping bitset wake this waiter
+   *
+   * @return 0 when woken, -EAGAIN if *addr != val, -ETIMEDOUT on timeout
+   **/
+  int wait(int* addr, int val, Timeout timeout = Timeout::max(),
+           uint32_t bitset = bitset_any);
+
+  /**
+   * Wake up to count waiters on addr, oldest waiter first
+   *
+   * @return the number of waiters woken
+   **/
+  int wake(int* addr, int count, uint32_t bitset = bitset_any);
+
+  /**
+   * Wake up to count waiters on addr, then move up to requeue waiters
+   * that are left over to wait on addr2 instead.
+   *
+   * @return the number of waiters woken and requeued
+   **/
+  int requeue(int* addr, int count, int* addr2, int requeue);
+
+  /**
+   * Like requeue, as long as *addr == val
+   *
+   * @return the number of waiters woken and requeued, or -EAGAIN
+   **/
+  int cmp_requeue(int* addr, int count, int* addr2, int requeue, int val);
+
+  /** Number of waiters on addr */
+  size_t waiters(const int* addr);
+
+}
+
+#endif
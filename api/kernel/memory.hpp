@@ -22,6 +22,7 @@
 #include <util/bitops.hpp>
 #include <util/units.hpp>
 #include <util/alloc_buddy.hpp>
+#include <util/alloc_slab.hpp>
 #include <util/allocator.hpp>
 #include <sstream>
 #include <expects>
@@ -42,6 +43,12 @@ namespace os::mem {
   /** Get default allocator for untyped allocations */
   Raw_allocator& raw_allocator();
 
+  /** Per-CPU small object allocator in front of the raw allocator */
+  using Slab_allocator = slab::Alloc<Raw_allocator>;
+
+  /** Get the allocator behind kalloc and the default PMR resource */
+  Slab_allocator& slab_allocator();
+
   template <typename T>
   using Typed_allocator = Allocator<T, Raw_allocator>;
 
@@ -49,6 +56,32 @@ namespace os::mem {
   template <typename T>
   Typed_allocator<T> system_allocator() { return Typed_allocator<T>(raw_allocator()); }
 
+  /** The page size of huge page regions, or 0 if not supported */
+  size_t huge_psize();
+
+  /**
+   * Allocate a region backed by huge pages, for large working sets
+   * that would otherwise take TLB misses (e.g. packet buffer pools).
+   * The size is rounded up to a multiple of huge_psize(), the region is
+   * aligned to it and mapped with pages of at least that size.
+   *
+   * @return The region, or nullptr if no aligned region was available.
+   *         Regions are only guaranteed to be available when the heap is
+   *         set up for huge pages (see os_huge_page_heap).
+   */
+  void* alloc_huge(size_t size);
+
+  /** Free a region allocated with alloc_huge */
+  void free_huge(void* addr, size_t size);
+
+  /**
+   * Map the identity mapped range addr -> addr + size with the largest
+   * page sizes the alignment allows, replacing any smaller pages.
+   * Everything in the range gets read / write access.
+   * @return The number of page tables replaced by huge pages
+   */
+  int map_huge(uintptr_t addr, size_t size);
+
   /** Get bitfield with bit set for each supported page size */
   uintptr_t supported_page_sizes();
 
@@ -29,6 +29,9 @@ public:
   using timestamp_t = uint64_t;
 
   /// a 64-bit nanosecond timestamp of the current time
+  /// lock-free, and cheap enough to call per packet: on x86 PC the clock
+  /// source with the fewest cycles per read is picked at boot, which is
+  /// ~25-40 cycles for an invariant TSC and ~50-100 for kvmclock
   static timestamp_t nanos_now() {
     return __arch_system_time();
   }
@@ -0,0 +1,101 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef KERNEL_SCHEDULER_HPP
+#define KERNEL_SCHEDULER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <delegate>
+
+/**
+ * Tasks: many stackful fibers multiplexed onto the CPUs.
+ *
+ * Every CPU has a run queue of ready tasks, which it runs in batches from
+ * its event loop. A CPU that runs out of tasks steals half of the queue of
+ * a busy CPU. Tasks that wait - in os::block(), a futex or sleep() - are
+ * parked instead of halting the CPU, letting other tasks run, and are made
+ * ready again by the event that wakes them.
+ *
+ * Finished tasks keep their fiber stacks in a per-CPU pool, so spawning a
+ * task normally allocates nothing.
+ **/
+class Scheduler {
+public:
+  struct Task;
+  using task_func = delegate<void()>;
+
+  /** Tasks run per round, before other events get their turn */
+  static constexpr int batch_size = 64;
+
+  /** Finished tasks (with their stacks) kept per CPU for reuse */
+  static constexpr int pool_size = 64;
+
+  /**
+   * Run func as a new task
+   *
+   * @param func  the task body
+   * @param cpu   the CPU to queue it on, -1 for the current CPU.
+   *              Idle CPUs may steal it from there.
+   **/
+  static void spawn(task_func func, int cpu = -1);
+
+  /** The running task, or nullptr when not running in a task */
+  static Task* current() noexcept;
+
+  /** Let the other ready tasks run, then continue */
+  static void yield();
+
+  /**
+   * Suspend the running task until unpark(). May return early, so wait
+   * for a condition in a loop, and unpark after making it true.
+   **/
+  static void park();
+
+  /** Make a parked task ready, from any CPU. The task must not have finished. */
+  static void unpark(Task*) noexcept;
+
+  /** Park the running task for at least the duration */
+  static void sleep(std::chrono::nanoseconds);
+
+  /**
+   * Keep the running task on its CPU until unpin(), so it is not stolen
+   * while it holds per-CPU state like a timer. Calls nest.
+   **/
+  static void pin() noexcept;
+  static void unpin() noexcept;
+
+  /**
+   * Park the running task until the next round of events on its CPU.
+   * This is what os::block() does in a task.
+   **/
+  static void block();
+
+  struct Stats {
+    uint64_t spawned  = 0;
+    uint64_t finished = 0;
+    uint64_t switches = 0; // tasks started or resumed
+    uint64_t steals   = 0; // tasks taken from other CPUs
+    uint32_t ready    = 0;
+    uint32_t blocked  = 0;
+    uint32_t pooled   = 0;
+  };
+  static Stats stats(int cpu);
+};
+
+#endif
@@ -0,0 +1,123 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef KERNEL_SMP_WORK_HPP
+#define KERNEL_SMP_WORK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <delegate>
+
+/**
+ * Posting work to CPUs.
+ *
+ * Every CPU has a lock-free ring of work items, which any CPU can post to.
+ * A CPU is only interrupted when its ring goes from idle to busy: posting
+ * marks the target, and flush() sends one IPI to each marked CPU, however
+ * many items were posted. The target runs its items from the IPI handler,
+ * and work posted to the current CPU runs from its event loop.
+ **/
+namespace os::smp {
+
+  using Work = delegate<void()>;
+
+  /** Work items each CPU can have queued */
+  static constexpr size_t ring_size = 256;
+
+  /**
+   * Queue work on cpu, without notifying it yet.
+   *
+   * @return false if the ring of cpu is full
+   **/
+  bool post(int cpu, Work work);
+
+  /** Notify the CPUs that got work posted from this CPU */
+  void flush();
+
+  /**
+   * Run work on cpu, then done back on this CPU. Both are queued right away.
+   *
+   * @return false if the ring of cpu is full
+   **/
+  bool run_on(int cpu, Work work, Work done = nullptr);
+
+  /** Run the work queued for this CPU. Called from the IPI handlers. */
+  void drain();
+
+  /**
+   * Call body(begin, end) for chunks of at least grain indices covering
+   * [begin, end), spread over all CPUs. CPUs claim chunks as they go, so
+   * faster CPUs take more. The calling CPU takes part, and returns when
+   * every chunk is done.
+   **/
+  void parallel_for(size_t begin, size_t end,
+                    delegate<void(size_t, size_t)> body, size_t grain = 1);
+
+  /**
+   * Map chunks of [begin, end) to values on all CPUs, and fold them
+   * together in order, starting with init.
+   **/
+  template <typename T, typename Map, typename Reduce>
+  T parallel_reduce(size_t begin, size_t end, T init,
+                    Map map, Reduce reduce, size_t grain = 1);
+
+  struct Stats {
+    uint64_t posted   = 0; // items posted by this CPU
+    uint64_t executed = 0; // items run on this CPU
+    uint64_t ipis     = 0; // notifications sent by this CPU
+    uint64_t full     = 0; // posts refused because the target was full
+  };
+  Stats stats(int cpu);
+
+  namespace detail {
+    // chunks of at least grain, a few per CPU
+    size_t chunk_count(size_t total, size_t grain) noexcept;
+    // call fn(chunk) for every chunk in [0, chunks) on all CPUs
+    void for_each_chunk(size_t chunks, delegate<void(size_t)> fn);
+  }
+
+  template <typename T, typename Map, typename Reduce>
+  T parallel_reduce(size_t begin, size_t end, T init,
+                    Map map, Reduce reduce, size_t grain)
+  {
+    if (end <= begin) return init;
+    const size_t total  = end - begin;
+    const size_t chunks = detail::chunk_count(total, grain);
+    std::vector<T> partial(chunks, init);
+    struct Job {
+      std::vector<T>& partial;
+      Map&   map;
+      size_t begin, total, chunks;
+    } job {partial, map, begin, total, chunks};
+
+    detail::for_each_chunk(chunks, [&job] (size_t i) {
+      const size_t first = job.begin + job.total * i / job.chunks;
+      const size_t last  = job.begin + job.total * (i + 1) / job.chunks;
+      job.partial[i] = job.map(first, last);
+    });
+
+    T result = std::move(init);
+    for (auto& value : partial)
+      result = reduce(std::move(result), std::move(value));
+    return result;
+  }
+
+}
+
+#endif
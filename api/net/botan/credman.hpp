@@ -25,6 +25,7 @@
 #include <botan/x509cert.h>
 #include <botan/x509_ca.h>
 #include <botan/x509self.h>
+#include <net/tls/ticket_keys.hpp>
 #include <memory>
 
 namespace net
@@ -84,6 +85,21 @@ public:
     return m_server_key.get();
   }
 
+  // Botan derives the session ticket encryption key from this psk.
+  // Botan only knows one key, so tickets issued before a rotation
+  // fall back to a full handshake (or the session cache).
+  Botan::SymmetricKey psk(const std::string& type,
+                          const std::string& context,
+                          const std::string& identity) override
+  {
+    if (type == "tls-server" && context == "session-ticket")
+    {
+      const auto key = net::tls::Ticket_keys::get().current();
+      return Botan::SymmetricKey(key.hmac_key.data(), key.hmac_key.size());
+    }
+    return Botan::Credentials_Manager::psk(type, context, identity);
+  }
+
   static Credman* create(
         const std::string& name,
         Botan::RandomNumberGenerator&  rng,
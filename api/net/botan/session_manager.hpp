@@ -0,0 +1,94 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#pragma once
+#ifndef NET_BOTAN_SESSION_MANAGER_HPP
+#define NET_BOTAN_SESSION_MANAGER_HPP
+
+#include <botan/tls_session_manager.h>
+#include <net/tls/session_cache.hpp>
+
+namespace net
+{
+namespace botan
+{
+/**
+ * @brief      A Botan session manager backed by the shared TLS session cache.
+ *
+ *             Botan only asks a server session manager for sessions by id,
+ *             server info lookups are for clients and are not supported.
+ */
+class Session_manager : public Botan::TLS::Session_Manager
+{
+public:
+  explicit Session_manager(net::tls::Session_cache& cache = net::tls::Session_cache::get())
+    : m_cache{cache} {}
+
+  bool load_from_session_id(const std::vector<uint8_t>& session_id,
+                            Botan::TLS::Session& session) override
+  {
+    std::vector<uint8_t> buffer;
+    if (not m_cache.lookup(to_id(session_id), buffer)) return false;
+    try {
+      session = Botan::TLS::Session(buffer.data(), buffer.size());
+      return true;
+    }
+    catch (const std::exception&) {
+      m_cache.erase(to_id(session_id));
+      return false;
+    }
+  }
+
+  bool load_from_server_info(const Botan::TLS::Server_Information&,
+                             Botan::TLS::Session&) override
+  {
+    return false;
+  }
+
+  void remove_entry(const std::vector<uint8_t>& session_id) override
+  {
+    m_cache.erase(to_id(session_id));
+  }
+
+  size_t remove_all() override
+  {
+    return m_cache.clear();
+  }
+
+  void save(const Botan::TLS::Session& session) override
+  {
+    const auto der = session.DER_encode();
+    m_cache.insert(to_id(session.session_id()), der.data(), der.size());
+  }
+
+  std::chrono::seconds session_lifetime() const override
+  {
+    return m_cache.lifetime();
+  }
+
+private:
+  net::tls::Session_cache& m_cache;
+
+  static std::string_view to_id(const std::vector<uint8_t>& id) noexcept
+  { return {(const char*) id.data(), id.size()}; }
+};
+
+} // botan
+} // net
+
+#endif
@@ -35,10 +35,11 @@ class Server : public Botan::TLS::Callbacks, public net::Stream
 public:
   Server(net::Stream_ptr remote,
          Botan::RandomNumberGenerator& rng,
-         Botan::Credentials_Manager& credman)
+         Botan::Credentials_Manager& credman,
+         Botan::TLS::Session_Manager* sessions = nullptr)
   : m_creds{credman},
     m_session_manager{},
-    m_tls{*this, m_session_manager, m_creds, m_policy, rng},
+    m_tls{*this, sessions ? *sessions : m_session_manager, m_creds, m_policy, rng},
     m_transport{std::move(remote)}
   {
     assert(m_transport->is_connected());
@@ -217,6 +218,7 @@ private:
 
   Botan::Credentials_Manager&   m_creds;
   Botan::TLS::Strict_Policy     m_policy;
+  // used when no (shared) session manager is given
   Botan::TLS::Session_Manager_Noop m_session_manager;
 
   Botan::TLS::Server m_tls;
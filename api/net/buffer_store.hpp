@@ -77,6 +77,7 @@ namespace net
   private:
     uint32_t pool_buffers() const noexcept { return poolsize_ / bufsize_; }
     void create_new_pool();
+    void add_pool(uint8_t* pool, bool is_huge);
     bool growth_enabled() const;
 
     uint32_t              poolsize_;
@@ -84,6 +85,7 @@ namespace net
     int                   index = -1;
     std::vector<uint8_t*> available_;
     std::vector<uint8_t*> pools_;
+    std::vector<bool>     huge_pools_;
 #ifdef INCLUDEOS_SMP_ENABLE
     Spinlock              plock;
 #endif
@@ -0,0 +1,217 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_CORO_HPP
+#define NET_CORO_HPP
+
+#include <util/coro.hpp>
+#include <net/inet.hpp>
+#include <net/tcp/connection.hpp>
+#include <net/udp/socket.hpp>
+#include <deque>
+#include <string>
+
+/**
+ * Awaitables for the network stack, see util/coro.hpp
+ *
+ * @example
+ *   os::coro::Task<> echo(net::tcp::Connection_ptr conn) {
+ *     os::coro::Tcp_stream stream {conn};
+ *     while (auto buf = co_await stream.read())
+ *       stream.write(buf);
+ *   }
+ **/
+namespace os::coro {
+
+  /**
+   * Reads a TCP connection from a coroutine. Data arriving while nobody
+   * awaits read() is queued. The stream owns the read, close and disconnect
+   * callbacks of the connection while it exists.
+   **/
+  class Tcp_stream {
+  public:
+    using buffer_t = net::tcp::buffer_t;
+
+    explicit Tcp_stream(net::tcp::Connection_ptr conn, size_t bufsz = 16384)
+      : conn_{std::move(conn)}
+    {
+      conn_->on_read(bufsz, [this] (buffer_t buf) {
+        queue_.push_back(std::move(buf));
+        wake();
+      });
+      conn_->on_disconnect([this] (net::tcp::Connection_ptr self, net::tcp::Connection::Disconnect) {
+        closed_ = true;
+        if (not self->is_closing()) self->close();
+        wake();
+      });
+      conn_->on_close([this] {
+        closed_ = true;
+        wake();
+      });
+    }
+
+    ~Tcp_stream() {
+      conn_->set_on_read_callback(nullptr);
+      conn_->on_close(nullptr);
+      conn_->on_disconnect([] (net::tcp::Connection_ptr self, net::tcp::Connection::Disconnect) {
+        if (not self->is_closing()) self->close();
+      });
+    }
+
+    Tcp_stream(const Tcp_stream&) = delete;
+    Tcp_stream& operator=(const Tcp_stream&) = delete;
+
+    /** Await the next data, nullptr once the connection is closed */
+    auto read() noexcept {
+      struct Awaiter {
+        Tcp_stream& stream;
+        bool await_ready() const noexcept
+        { return not stream.queue_.empty() or stream.closed_; }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        { stream.reader_ = h; }
+        buffer_t await_resume() noexcept {
+          if (stream.queue_.empty()) return nullptr;
+          auto buf = std::move(stream.queue_.front());
+          stream.queue_.pop_front();
+          return buf;
+        }
+      };
+      Expects(reader_ == nullptr);
+      return Awaiter{*this};
+    }
+
+    void write(buffer_t buf)
+    { conn_->write(std::move(buf)); }
+
+    void write(const std::string& str)
+    { conn_->write(str); }
+
+    void close()
+    { conn_->close(); }
+
+    bool is_closed() const noexcept
+    { return closed_; }
+
+    net::tcp::Connection& connection() noexcept
+    { return *conn_; }
+
+  private:
+    void wake() {
+      if (reader_) std::exchange(reader_, nullptr).resume();
+    }
+
+    net::tcp::Connection_ptr conn_;
+    std::deque<buffer_t>     queue_;
+    std::coroutine_handle<>  reader_ = nullptr;
+    bool closed_ = false;
+  };
+
+  /**
+   * Receives datagrams on a UDP socket from a coroutine. At most max_queued
+   * datagrams wait to be read, the oldest are dropped after that.
+   **/
+  class Udp_reader {
+  public:
+    struct Datagram {
+      net::udp::addr_t addr;
+      net::udp::port_t port;
+      std::string      data;
+    };
+
+    explicit Udp_reader(net::udp::Socket& sock, size_t max_queued = 256)
+      : sock_{sock}, max_queued_{max_queued}
+    {
+      sock_.on_read(
+      [this] (net::udp::addr_t addr, net::udp::port_t port, const char* data, size_t len) {
+        if (queue_.size() >= max_queued_) {
+          queue_.pop_front();
+          dropped_++;
+        }
+        queue_.push_back({addr, port, std::string(data, len)});
+        if (reader_) std::exchange(reader_, nullptr).resume();
+      });
+    }
+
+    ~Udp_reader() {
+      sock_.on_read([] (net::udp::addr_t, net::udp::port_t, const char*, size_t) {});
+    }
+
+    Udp_reader(const Udp_reader&) = delete;
+    Udp_reader& operator=(const Udp_reader&) = delete;
+
+    /** Await the next datagram */
+    auto read() noexcept {
+      struct Awaiter {
+        Udp_reader& reader;
+        bool await_ready() const noexcept
+        { return not reader.queue_.empty(); }
+        void await_suspend(std::coroutine_handle<> h) noexcept
+        { reader.reader_ = h; }
+        Datagram await_resume() noexcept {
+          auto dgram = std::move(reader.queue_.front());
+          reader.queue_.pop_front();
+          return dgram;
+        }
+      };
+      Expects(reader_ == nullptr);
+      return Awaiter{*this};
+    }
+
+    /** Datagrams dropped because nobody read them in time */
+    uint64_t dropped() const noexcept
+    { return dropped_; }
+
+  private:
+    net::udp::Socket&       sock_;
+    const size_t            max_queued_;
+    std::deque<Datagram>    queue_;
+    std::coroutine_handle<> reader_ = nullptr;
+    uint64_t                dropped_ = 0;
+  };
+
+  struct Resolved {
+    net::dns::Response_ptr response;
+    net::Error             error;
+  };
+
+  /** Resolve a hostname with the DNS client of a stack */
+  class Resolve : public Callback_awaiter<Resolved> {
+  public:
+    Resolve(net::Inet& stack, std::string hostname, bool force)
+      : stack_{stack}, hostname_{std::move(hostname)}, force_{force} {}
+
+    bool await_suspend(std::coroutine_handle<> h) {
+      stack_.resolve(hostname_,
+        [this] (net::dns::Response_ptr res, const net::Error& err) {
+          complete({std::move(res), err});
+        }, force_);
+      return suspend(h);
+    }
+
+  private:
+    net::Inet&  stack_;
+    std::string hostname_;
+    bool        force_;
+  };
+
+  inline Resolve resolve(net::Inet& stack, std::string hostname, bool force = false)
+  { return {stack, std::move(hostname), force}; }
+
+}
+
+#endif
@@ -0,0 +1,161 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2015-2018 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_DNS_CACHE_HPP
+#define NET_DNS_CACHE_HPP
+
+#include <net/dns/response.hpp>
+#include <kernel/rtc.hpp>
+#include <chrono>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace net::dns {
+
+  /**
+   * @brief      A DNS response cache, bounded by memory use and evicting
+   *             the least recently used entry.
+   *
+   *             Positive answers are cached for the lowest TTL among the
+   *             answer records. Negative answers (NXDOMAIN and NODATA) are
+   *             cached as described in RFC 2308, using the SOA record
+   *             from the authority section, and are never cached without it.
+   *             TTLs are capped by the max_ttl given on insert.
+   */
+  class Cache
+  {
+  public:
+    using timestamp_t = RTC::timestamp_t;
+
+    static constexpr size_t DEFAULT_MAX_BYTES = 256 * 1024;
+
+    struct Stats
+    {
+      uint64_t hits          = 0;
+      uint64_t negative_hits = 0;
+      uint64_t misses        = 0;
+      uint64_t inserts       = 0;
+      uint64_t evictions     = 0;
+      uint64_t expired       = 0;
+    };
+
+    explicit Cache(size_t max_bytes = DEFAULT_MAX_BYTES)
+      : max_bytes_{max_bytes}
+    {}
+
+    /**
+     * @brief      Look up a cached response. The record TTLs in the returned
+     *             response are the remaining TTLs.
+     *
+     * @param[in]  name  The hostname
+     * @param[in]  type  The record type
+     * @param[in]  now   The current timestamp in seconds
+     *
+     * @return     A copy of the cached response, or nullptr if not cached
+     *             (or expired).
+     */
+    Response_ptr lookup(const std::string& name, Record_type type, timestamp_t now);
+
+    /**
+     * @brief      Cache a response, if cacheable.
+     *
+     * @param[in]  name     The hostname asked for
+     * @param[in]  type     The record type asked for
+     * @param[in]  res      The response
+     * @param[in]  now      The current timestamp in seconds
+     * @param[in]  max_ttl  The maximum time an entry may be cached
+     *
+     * @return     Whether the response was cached.
+     */
+    bool insert(const std::string& name, Record_type type, const Response& res,
+                timestamp_t now, std::chrono::seconds max_ttl);
+
+    /**
+     * @brief      Removes all expired entries.
+     *
+     * @return     The number of entries removed
+     */
+    size_t flush_expired(timestamp_t now);
+
+    void clear();
+
+    bool empty() const noexcept
+    { return lru_.empty(); }
+
+    size_t size() const noexcept
+    { return lru_.size(); }
+
+    // estimated memory used by the cached entries
+    size_t bytes() const noexcept
+    { return bytes_; }
+
+    size_t max_bytes() const noexcept
+    { return max_bytes_; }
+
+    void set_max_bytes(size_t max_bytes);
+
+    const Stats& stats() const noexcept
+    { return stats_; }
+
+    /**
+     * @brief      How long a response may be cached
+     *
+     * @param[in]  res   The response
+     *
+     * @return     The TTL in seconds, or -1 if the response can not be cached
+     */
+    static int64_t ttl_of(const Response& res);
+
+  private:
+    struct Key
+    {
+      std::string name;
+      Record_type type;
+
+      bool operator==(const Key& other) const noexcept
+      { return type == other.type and name == other.name; }
+    };
+    struct Key_hash
+    {
+      size_t operator()(const Key& key) const noexcept
+      { return std::hash<std::string>{}(key.name) ^ static_cast<size_t>(key.type); }
+    };
+    struct Entry
+    {
+      Key         key;
+      Response    response;
+      timestamp_t expires;
+      size_t      bytes;
+    };
+    using Entry_list = std::list<Entry>;
+
+    Entry_list lru_; // most recently used first
+    std::unordered_map<Key, Entry_list::iterator, Key_hash> map_;
+    size_t bytes_ = 0;
+    size_t max_bytes_;
+    Stats  stats_;
+
+    static Key make_key(const std::string& name, Record_type type);
+    void erase(Entry_list::iterator it);
+    void evict();
+  };
+
+}
+
+#endif
@@ -19,6 +19,7 @@
 #define NET_DNS_CLIENT_HPP
 
 #include <net/dns/dns.hpp>
+#include <net/dns/cache.hpp>
 #include <net/ip4/ip4.hpp>
 #include <net/udp/socket.hpp>
 #include <util/timer.hpp>
@@ -36,8 +37,13 @@ namespace net::dns {
    * @brief      A simple DNS client which is able to resolve hostnames
    *             and locally cache them.
    *
-   * @note       A entry can stay longer than TTL due to flush timer granularity.
-   *             Max_TTL = TTL + FLUSH_INTERVAL (90s default)
+   *             Responses are cached for the TTL of their records, capped by
+   *             the cache TTL. Negative responses are cached too (RFC 2308).
+   *             Concurrent lookups for the same name are coalesced into
+   *             a single query.
+   *
+   * @note       A entry can stay in memory longer than its TTL due to flush
+   *             timer granularity, but is never returned after it expires.
    */
   class Client
   {
@@ -47,24 +53,11 @@ namespace net::dns {
     using Address         = net::Addr;
     using Hostname        = std::string;
     using timestamp_t     = RTC::timestamp_t;
-    /**
-     * @brief      A simple cache entry containing the resolved IP address
-     *             and a timestamp when it expires (based on uptime)
-     */
-    struct Cache_entry
-    {
-      Address     address;
-      timestamp_t expires;
-
-      Cache_entry(Address addr, const timestamp_t exp) noexcept
-        : address{std::move(addr)}, expires{exp}
-      {}
-    };
-    using Cache           = std::unordered_map<Hostname, Cache_entry>;
+    using Cache           = dns::Cache;
 
     static Timer::duration_t DEFAULT_RESOLVE_TIMEOUT; // 5s, client.cpp
-    static Timer::duration_t DEFAULT_FLUSH_INTERVAL; // 60s, client.cpp
-    static std::chrono::seconds DEFAULT_CACHE_TTL; // 60s, client.cpp
+    static Timer::duration_t DEFAULT_FLUSH_INTERVAL; // 30s, client.cpp
+    static std::chrono::seconds DEFAULT_CACHE_TTL; // 1h, client.cpp
 
     /**
      * @brief      Construct a DNS client on a given interface (stack),
@@ -81,6 +74,8 @@ namespace net::dns {
      *             The address can be 0 (INADDR_ANY) which means that
      *             1) either the hostname was not found or
      *             2) the request timed out.
+     *             If a request for the same hostname is already in flight,
+     *             the handler is invoked when that request finishes.
      *
      * @param[in]  dns_server  The dns server where to send the request
      * @param[in]  hostname    The hostname to resolve
@@ -119,7 +114,7 @@ namespace net::dns {
     { return cache_; }
 
     /**
-     * @brief      Returns the time to live value of an entry in the cache.
+     * @brief      Returns the maximum time to live of an entry in the cache.
      *
      * @return     Time to live in seconds
      */
@@ -127,7 +122,9 @@ namespace net::dns {
     { return cache_ttl_; }
 
     /**
-     * @brief      Sets the time to live for a cache entry
+     * @brief      Sets the maximum time to live for a cache entry.
+     *             Entries are cached for the TTL of the response records,
+     *             but never longer than this.
      *             A value of zero means caching is disabled.
      *
      * @param[in]  ttl   The ttl in seconds
@@ -135,6 +132,15 @@ namespace net::dns {
     void set_cache_ttl(std::chrono::seconds ttl)
     { cache_ttl_ = ttl; }
 
+    /**
+     * @brief      Sets the maximum memory used by the cache. The least
+     *             recently used entries are evicted to stay below it.
+     *
+     * @param[in]  bytes  The limit in bytes
+     */
+    void set_cache_limit(size_t bytes)
+    { cache_.set_max_bytes(bytes); }
+
     /**
      * @brief      Disables caching
      */
@@ -144,7 +150,7 @@ namespace net::dns {
     /**
      * @brief      Enables caching
      *
-     * @param[in]  ttl   The ttl for a cache entry (optional)
+     * @param[in]  ttl   The maximum ttl for a cache entry (optional)
      */
     void enable_cache(std::chrono::seconds ttl = DEFAULT_CACHE_TTL)
     { set_cache_ttl(ttl); }
@@ -170,13 +176,12 @@ namespace net::dns {
     void receive_response(Address, udp::port_t, const char* data, size_t);
 
     /**
-     * @brief      Adds a cache entry.
+     * @brief      Adds a response to the cache, if it can be cached.
      *
-     * @param[in]  hostname  The hostname
-     * @param[in]  addr      The address
-     * @param[in]  ttl       The ttl
+     * @param[in]  query  The query which was answered
+     * @param[in]  res    The response
      */
-    void add_cache_entry(const Hostname& hostname, Address addr, std::chrono::seconds ttl);
+    void add_cache_entry(const dns::Query& query, const dns::Response& res);
 
     /**
      * @brief      Flush all expired cache entries.
@@ -208,6 +213,8 @@ namespace net::dns {
       udp::Socket&    socket;
 
       Resolve_handler callback;
+      // coalesced lookups for the same hostname
+      std::vector<Resolve_handler> waiters;
       Timer           timer;
 
       Request(Client& cli, udp::Socket& sock, dns::Query q, Resolve_handler cb);
@@ -235,6 +242,8 @@ namespace net::dns {
     using Requests = std::unordered_map<dns::id_t, Request>;
     /** Pending requests (not yet resolved) */
     Requests requests_;
+    /** Pending request for a hostname and record type */
+    std::map<std::pair<Hostname, Record_type>, dns::id_t> pending_;
   };
 }
 
@@ -42,6 +42,9 @@ namespace net::dns {
     ip6::Addr get_ipv6() const;
     net::Addr get_addr() const;
 
+    // the MINIMUM field of a SOA record, used as negative caching TTL
+    uint32_t get_soa_minimum() const;
+
     bool is_addr() const
     { return rtype == Record_type::A or rtype == Record_type::AAAA; }
   };
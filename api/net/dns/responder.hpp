@@ -0,0 +1,214 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2015-2018 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_DNS_RESPONDER_HPP
+#define NET_DNS_RESPONDER_HPP
+
+#include <net/dns/dns.hpp>
+#include <net/addr.hpp>
+#include <string>
+#include <vector>
+
+namespace net::dns {
+
+  // helpers for reading wire format messages
+  namespace wire
+  {
+    static constexpr size_t MAX_NAME_LEN = 255;
+
+    /**
+     * @brief      Skip past a (possibly compressed) name.
+     *
+     * @return     The position after the name, or 0 if malformed
+     */
+    size_t skip_name(const uint8_t* msg, size_t len, size_t pos) noexcept;
+
+    /**
+     * @brief      Encode a dotted name as uncompressed labels.
+     *
+     * @return     The encoded name, empty if the name is invalid
+     */
+    std::vector<uint8_t> encode_name(const std::string& name);
+
+    inline uint16_t read16(const uint8_t* p) noexcept
+    { return (p[0] << 8) | p[1]; }
+
+    inline uint32_t read32(const uint8_t* p) noexcept
+    { return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+    inline void write16(uint8_t* p, uint16_t v) noexcept
+    { p[0] = v >> 8; p[1] = v; }
+
+    inline void write32(uint8_t* p, uint32_t v) noexcept
+    { p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v; }
+  }
+
+  /**
+   * @brief      The question of a query, pointing into the query.
+   */
+  struct Question_view
+  {
+    const uint8_t* name = nullptr;  // uncompressed wire format name
+    uint16_t name_len   = 0;        // including the root label
+    uint16_t qtype      = 0;
+    uint16_t qclass     = 0;
+    uint16_t end        = 0;        // offset of the end of the question
+
+    /**
+     * @brief      Parse the (single) question of a query.
+     *
+     * @return     Whether the query has a valid question
+     */
+    bool parse(const uint8_t* msg, size_t len) noexcept;
+  };
+
+  /**
+   * @brief      An authoritative DNS responder for in-memory zones.
+   *
+   *             Names are stored in a tree of labels, from the root and down.
+   *             The answer section for each name and type is compiled to wire
+   *             format when records are added, with the owner name compressed
+   *             to point at the question. Answering a query is then a walk down
+   *             the tree and a few copies into the output buffer,
+   *             without any allocation.
+   *
+   *             The responder does not know about sockets, see dns::Server.
+   */
+  class Responder
+  {
+  public:
+    static constexpr size_t MAX_UDP_SIZE = 512;
+
+    enum class Result
+    {
+      ANSWERED,          // response written, authoritative or error
+      NOT_AUTHORITATIVE, // name is in none of our zones, REFUSED written
+      DROP               // not a query, nothing written
+    };
+
+    struct Soa
+    {
+      std::string mname;
+      std::string rname;
+      uint32_t serial  = 1;
+      uint32_t refresh = 7200;
+      uint32_t retry   = 900;
+      uint32_t expire  = 1209600;
+      uint32_t minimum = 300;  // negative caching TTL
+      uint32_t ttl     = 3600;
+    };
+
+    struct Stats
+    {
+      uint64_t queries   = 0;
+      uint64_t answered  = 0;
+      uint64_t nxdomain  = 0;
+      uint64_t nodata    = 0;
+      uint64_t refused   = 0;
+      uint64_t malformed = 0;
+      uint64_t truncated = 0;
+    };
+
+    Responder();
+
+    /**
+     * @brief      Add a zone we are authoritative for.
+     *
+     * @param[in]  apex  The name of the zone, e.g. "example.com"
+     * @param[in]  soa   The SOA record of the zone
+     */
+    void add_zone(const std::string& apex, const Soa& soa);
+
+    /**
+     * @brief      Add a record to the zone it belongs to.
+     *             Throws std::invalid_argument if the name is invalid
+     *             or not within one of our zones.
+     *
+     * @param[in]  name   The owner name
+     * @param[in]  type   The record type
+     * @param[in]  ttl    The ttl
+     * @param[in]  rdata  The record data in wire format
+     * @param[in]  len    The length of the record data
+     */
+    void add_record(const std::string& name, uint16_t type, uint32_t ttl,
+                    const void* rdata, size_t len);
+
+    void add(const std::string& name, ip4::Addr addr, uint32_t ttl)
+    { add_record(name, DNS_TYPE_A, ttl, &addr, sizeof(addr)); }
+
+    void add(const std::string& name, const ip6::Addr& addr, uint32_t ttl)
+    { add_record(name, DNS_TYPE_AAAA, ttl, &addr, sizeof(addr)); }
+
+    void add_cname(const std::string& name, const std::string& target, uint32_t ttl);
+
+    /**
+     * @brief      Answer a query.
+     *
+     * @param[in]  query  The query
+     * @param[in]  len    The length of the query
+     * @param      out    The output buffer, at least MAX_UDP_SIZE bytes
+     * @param[out] out_len  The length of the response
+     *
+     * @return     The result
+     */
+    Result answer(const uint8_t* query, size_t len, uint8_t* out, size_t& out_len);
+
+    /**
+     * @brief      Write a response without answers.
+     *
+     * @return     The length of the response
+     */
+    static size_t write_error(const uint8_t* query, const Question_view* question,
+                              Response_code rcode, uint8_t* out) noexcept;
+
+    const Stats& stats() const noexcept
+    { return stats_; }
+
+  private:
+    struct Answer
+    {
+      uint16_t type;
+      uint16_t count;
+      std::vector<uint8_t> wire; // RRs with the owner compressed to the question
+    };
+    struct Node
+    {
+      std::string label; // lower case
+      std::vector<uint32_t> children; // sorted by label
+      std::vector<Answer> answers;
+      int32_t zone = -1;
+    };
+    struct Zone
+    {
+      uint32_t node;
+      // SOA RR without owner name, with ttl = min(ttl, minimum)
+      std::vector<uint8_t> soa;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<Zone> zones_;
+    Stats stats_;
+
+    uint32_t find_or_create(const std::vector<uint8_t>& name);
+    int32_t  find_child(const Node&, const uint8_t* label, uint8_t len) const noexcept;
+    static const Answer* find_answer(const Node&, uint16_t type) noexcept;
+  };
+
+}
+
+#endif
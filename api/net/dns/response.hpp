@@ -30,6 +30,7 @@ namespace net::dns {
       parse(buffer, len);
     }
 
+    Response_code       rcode = Response_code::NO_ERROR;
     std::vector<Record> answers;
     std::vector<Record> auth;
     std::vector<Record> addit;
@@ -40,6 +41,10 @@ namespace net::dns {
 
     bool has_addr() const;
 
+    // the name does not exist (NXDOMAIN)
+    bool is_name_error() const noexcept
+    { return rcode == Response_code::NAME_ERROR; }
+
     int parse(const char* buffer, size_t len);
   };
 
@@ -0,0 +1,160 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2015-2018 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_DNS_SERVER_HPP
+#define NET_DNS_SERVER_HPP
+
+#include <net/dns/responder.hpp>
+#include <net/udp/socket.hpp>
+#include <util/timer.hpp>
+#include <kernel/rtc.hpp>
+#include <array>
+#include <list>
+#include <string_view>
+#include <unordered_map>
+
+namespace net
+{
+  class Inet;
+}
+namespace net::dns {
+
+  /**
+   * @brief      A UDP DNS server answering from a Responder, optionally
+   *             forwarding queries outside of its zones to an upstream
+   *             server and caching the answers for their TTL.
+   *
+   *             Each reply is copied into a packet from the buffer pool
+   *             and transmitted on its own; UDP has no batched send path.
+   *
+   *             Neither the server nor the responder are thread safe,
+   *             use one of each per core.
+   */
+  class Server
+  {
+  public:
+    using Stack = Inet;
+
+    static constexpr size_t DEFAULT_CACHE_LIMIT = 1024 * 1024;
+    static constexpr size_t MAX_PENDING         = 4096;
+    static constexpr size_t MAX_MESSAGE         = 4096;
+    static Timer::duration_t FORWARD_TIMEOUT; // 2s, server.cpp
+
+    struct Stats
+    {
+      uint64_t forwarded  = 0;
+      uint64_t cache_hits = 0;
+      uint64_t timeouts   = 0;
+      uint64_t overloaded = 0;
+    };
+
+    /**
+     * @brief      Construct a DNS server, binding to the given port
+     *
+     * @param      stack      The stack
+     * @param      responder  The responder for our zones
+     * @param[in]  port       The port
+     */
+    Server(Stack& stack, Responder& responder, udp::port_t port = SERVICE_PORT);
+
+    ~Server();
+
+    /**
+     * @brief      Forward queries outside of our zones to a recursive
+     *             server, instead of refusing them.
+     *
+     * @param[in]  upstream  The upstream server
+     * @param[in]  port      The upstream port
+     */
+    void forward_to(net::Addr upstream, udp::port_t port = SERVICE_PORT);
+
+    // maximum memory used for cached upstream answers
+    void set_cache_limit(size_t bytes)
+    { cache_limit_ = bytes; evict(); }
+
+    size_t cache_size() const noexcept
+    { return lru_.size(); }
+
+    const Stats& stats() const noexcept
+    { return stats_; }
+
+    Responder& responder() noexcept
+    { return responder_; }
+
+    /**
+     * @brief      Subtract elapsed time from the TTLs of a message.
+     */
+    static void age_ttls(uint8_t* msg, size_t len, uint32_t elapsed) noexcept;
+
+    /**
+     * @brief      How long a response may be cached
+     *
+     * @return     TTL in seconds, or -1 if not cacheable
+     */
+    static int64_t cacheable_ttl(const uint8_t* msg, size_t len) noexcept;
+
+  private:
+    struct Pending
+    {
+      net::Addr   client;
+      udp::port_t port;
+      uint16_t    id;
+      std::string key;
+      RTC::timestamp_t sent;
+    };
+    struct Cached
+    {
+      std::string key;
+      std::vector<uint8_t> msg;
+      RTC::timestamp_t stored;
+      RTC::timestamp_t expires;
+    };
+    using Cache_list = std::list<Cached>;
+
+    Stack&       stack_;
+    Responder&   responder_;
+    udp::Socket& socket_;
+    udp::Socket* upstream_socket_ = nullptr;
+    net::Addr    upstream_;
+    udp::port_t  upstream_port_ = SERVICE_PORT;
+
+    std::unordered_map<uint16_t, Pending> pending_;
+    Cache_list lru_; // most recently used first
+    std::unordered_map<std::string_view, Cache_list::iterator> cache_;
+    size_t cache_bytes_ = 0;
+    size_t cache_limit_ = DEFAULT_CACHE_LIMIT;
+
+    Timer  timeout_timer_;
+    Stats  stats_;
+    alignas(8) std::array<uint8_t, MAX_MESSAGE> buffer_;
+    std::array<char, wire::MAX_NAME_LEN + 2> key_buffer_;
+
+    void receive(net::Addr, udp::port_t, const char* data, size_t len);
+    void receive_upstream(net::Addr, udp::port_t, const char* data, size_t len);
+    void forward(net::Addr, udp::port_t, const uint8_t* query, size_t len, const Question_view&);
+    bool answer_cached(net::Addr, udp::port_t, const uint8_t* query, std::string_view key);
+    void cache_insert(std::string_view key, const uint8_t* msg, size_t len, int64_t ttl);
+    void cache_erase(Cache_list::iterator);
+    void evict();
+    void expire_pending();
+    std::string_view make_key(const Question_view&) noexcept;
+  };
+
+}
+
+#endif
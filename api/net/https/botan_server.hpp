@@ -22,6 +22,7 @@
 #include <net/http/server.hpp>
 #include <fs/dirent.hpp>
 #include <net/botan/tls_server.hpp>
+#include <net/botan/session_manager.hpp>
 
 namespace http {
 
@@ -86,6 +87,7 @@ public:
 private:
   Botan::RandomNumberGenerator& rng;
   std::unique_ptr<Botan::Credentials_Manager> credman;
+  net::botan::Session_manager sessions;
 
   /**
    * @brief      Binds TCP to pass all new connections to this on_connect.
@@ -40,8 +40,11 @@ public:
 
 private:
   void* m_config = nullptr;
+  // creation time of the last ticket key added to the config
+  uint64_t m_ticket_key = 0;
 
   void initialize(const std::string&, const std::string&);
+  void update_ticket_key();
   void bind(const uint16_t port) override;
   void on_connect(TCP_conn conn) override;
 };
@@ -0,0 +1,144 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_MEMCACHED_CACHE_HPP
+#define NET_MEMCACHED_CACHE_HPP
+
+#include <net/memcached/store.hpp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <smp>
+#include <smp_utils>
+
+namespace liu {
+  struct Storage; struct Restore;
+}
+
+namespace net::memcached {
+
+  /**
+   * @brief      A key/value cache shared by all cores, made of one Store
+   *             per core.
+   *
+   *             Keys are spread over the shards by hash, and each shard
+   *             has its own lock, held only while an item is looked up
+   *             and copied. The memory is split evenly between the shards
+   *             through a Pmr_pool.
+   */
+  class Cache {
+  public:
+    static constexpr size_t DEFAULT_MEMORY = 64 * 1024 * 1024;
+
+    using Item = Store::Item;
+
+    /**
+     * @brief      Construct a cache
+     *
+     * @param[in]  memory  The memory for items, over all shards
+     * @param[in]  shards  The number of shards, 0 for one per CPU
+     * @param[in]  growth  The slab class growth factor
+     */
+    explicit Cache(size_t memory = DEFAULT_MEMORY, size_t shards = 0,
+                   double growth = 1.25);
+
+    /**
+     * @brief      Call fn(item) with the shard locked, if key is found
+     *
+     * @param[in]  exptime  If given, also the new expiry time, like gat
+     */
+    template <typename Fn>
+    bool get(std::string_view key, uint32_t now, Fn&& fn,
+             const uint32_t* exptime = nullptr);
+
+    Result store(Mode mode, std::string_view key, uint32_t flags,
+                 uint32_t exptime, std::string_view value, uint32_t now,
+                 uint64_t cas = 0);
+
+    Result remove(std::string_view key, uint32_t now);
+
+    Result touch(std::string_view key, uint32_t exptime, uint32_t now);
+
+    Result arith(std::string_view key, bool incr, uint64_t delta,
+                 uint64_t& value, uint32_t now);
+
+    void flush_all(uint32_t when, uint32_t now);
+
+    // accumulated stats for all shards
+    Store::Stats stats() const;
+
+    size_t shards() const noexcept
+    { return shards_.size(); }
+
+    size_t capacity() const noexcept
+    { return memory_; }
+
+    /**
+     * @brief      Store every live item, so the cache stays warm across a
+     *             LiveUpdate. Use from a storage function registered with
+     *             LiveUpdate::register_partition.
+     *
+     * @param[in]  id     The id used for the entries
+     * @param      store  The storage
+     */
+    void store(uint16_t id, liu::Storage& store) const;
+
+    /**
+     * @brief      Restore items stored by store(), with their cas values and
+     *             LRU segments. Consumes all entries up to and including
+     *             the terminating marker.
+     *
+     * @param      store  The restore object, positioned at the first entry
+     */
+    void restore(liu::Restore& store);
+
+  private:
+    struct alignas(SMP_ALIGN) Shard {
+      mutable Spinlock lock;
+      std::unique_ptr<Store> store;
+    };
+
+    static size_t hash(std::string_view key) noexcept
+    { return std::hash<std::string_view>{}(key); }
+
+    Shard& shard_for(size_t hash) noexcept
+    { return shards_[hash % shards_.size()]; }
+
+    os::mem::Pmr_pool  pool_;
+    std::vector<Shard> shards_;
+    size_t memory_;
+  };
+
+  template <typename Fn>
+  bool Cache::get(std::string_view key, uint32_t now, Fn&& fn, const uint32_t* exptime)
+  {
+    const size_t h = hash(key);
+    auto& shard = shard_for(h);
+    std::lock_guard<Spinlock> lock(shard.lock);
+    if (exptime and shard.store->touch(key, h, *exptime, now) != Result::TOUCHED)
+      return false;
+    const Item* item = shard.store->get(key, h, now);
+    if (item == nullptr) return false;
+    fn(*item);
+    return true;
+  }
+
+}
+
+#endif
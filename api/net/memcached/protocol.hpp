@@ -0,0 +1,82 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_MEMCACHED_PROTOCOL_HPP
+#define NET_MEMCACHED_PROTOCOL_HPP
+
+#include <net/memcached/cache.hpp>
+#include <delegate>
+#include <string>
+#include <string_view>
+
+namespace net::memcached {
+
+  /**
+   * @brief      One client of the memcached text protocol.
+   *
+   *             Input is fed as it arrives, in pieces of any size, and the
+   *             replies to every complete command are appended to out.
+   *             Storage commands wait for their whole data block.
+   */
+  class Connection {
+  public:
+    // the longest command line accepted
+    static constexpr size_t max_line = 2048;
+
+    explicit Connection(Cache& cache)
+      : cache_{cache} {}
+
+    /**
+     * @brief      Handle incoming data
+     *
+     * @param[in]  data  The data
+     * @param[in]  len   The length
+     * @param      out   Replies are appended here
+     *
+     * @return     false if the connection should be closed
+     */
+    bool feed(const char* data, size_t len, std::string& out);
+
+    // The clock used for expiry, in unix seconds. Defaults to RTC::now().
+    void set_clock(delegate<uint32_t()> clock)
+    { clock_ = std::move(clock); }
+
+  private:
+    // Returns the bytes consumed from data, 0 if more is needed
+    size_t process(std::string_view data, std::string& out);
+    size_t process_line(std::string_view line, size_t consumed,
+                        std::string_view rest, std::string& out);
+
+    void retrieve(std::string_view args, bool cas, bool touch, std::string& out);
+    void storage(Mode, std::string_view args, std::string_view value,
+                 std::string& out);
+    void stats(std::string& out);
+    uint32_t now() const;
+
+    Cache& cache_;
+    delegate<uint32_t()> clock_ = nullptr;
+    // unprocessed input
+    std::string buffer_;
+    // a data block too large to store, skipped as it arrives
+    size_t      swallow_ = 0;
+    bool        closed_  = false;
+  };
+
+}
+
+#endif
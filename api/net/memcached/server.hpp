@@ -0,0 +1,91 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_MEMCACHED_SERVER_HPP
+#define NET_MEMCACHED_SERVER_HPP
+
+#include <net/memcached/protocol.hpp>
+#include <net/tcp/connection.hpp>
+#include <net/tcp/listener.hpp>
+#include <memory>
+#include <unordered_map>
+
+namespace net
+{
+  class Inet;
+}
+namespace net::memcached {
+
+  /**
+   * @brief      A memcached server speaking the text protocol over TCP,
+   *             serving items from a Cache.
+   *
+   *             The cache can be shared by servers on several cores, each
+   *             server belongs to the core of its stack.
+   */
+  class Server
+  {
+  public:
+    using Stack = Inet;
+
+    static constexpr uint16_t SERVICE_PORT = 11211;
+    static constexpr size_t   READ_SIZE    = 16 * 1024;
+
+    struct Stats
+    {
+      uint64_t accepted = 0;
+      uint64_t closed   = 0; // by quit, or protocol error
+    };
+
+    /**
+     * @brief      Construct a memcached server, listening on the given port
+     *
+     * @param      stack  The stack
+     * @param      cache  The cache
+     * @param[in]  port   The port
+     */
+    Server(Stack& stack, Cache& cache, uint16_t port = SERVICE_PORT);
+
+    ~Server();
+
+    size_t connections() const noexcept
+    { return clients_.size(); }
+
+    const Stats& stats() const noexcept
+    { return stats_; }
+
+  private:
+    struct Client {
+      tcp::Connection_ptr conn;
+      Connection          protocol;
+      std::string         out;
+    };
+
+    void accept(tcp::Connection_ptr conn);
+    void receive(Client&, tcp::buffer_t buf);
+
+    Stack& stack_;
+    Cache& cache_;
+    tcp::Listener& listener_;
+    std::unordered_map<tcp::Connection*, std::unique_ptr<Client>> clients_;
+    Stats stats_;
+  };
+
+}
+
+#endif
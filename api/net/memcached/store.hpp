@@ -0,0 +1,260 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_MEMCACHED_STORE_HPP
+#define NET_MEMCACHED_STORE_HPP
+
+#include <util/alloc_pmr.hpp>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace net::memcached {
+
+  enum class Result {
+    STORED,
+    NOT_STORED,
+    EXISTS,
+    NOT_FOUND,
+    DELETED,
+    TOUCHED,
+    NON_NUMERIC,
+    TOO_LARGE,
+    NO_MEMORY
+  };
+
+  enum class Mode { SET, ADD, REPLACE, APPEND, PREPEND, CAS };
+
+  /**
+   * @brief      One shard of a key/value cache, in the style of memcached.
+   *
+   *             Items live in chunks carved out of 1 MB pages, with one
+   *             slab class per chunk size, so the memory never fragments.
+   *             Pages come from a Pmr_resource, which caps the memory of
+   *             the shard. When a class needs room and there are no pages
+   *             left, it evicts its own least recently used items, or if
+   *             it has none, takes a page from the class with the most.
+   *
+   *             Every slab class has a segmented LRU: new items start out
+   *             HOT, and are moved to COLD as newer ones push them out,
+   *             unless they were used meanwhile, in which case they go to
+   *             WARM instead. Items are evicted from the tail of COLD, so a
+   *             scan over many keys only churns HOT and COLD, while the
+   *             items in use stay WARM. Hits in HOT and WARM only mark the
+   *             item active, and do not touch the lists.
+   *
+   *             Times are in seconds since the epoch. Not thread safe.
+   */
+  class Store {
+  public:
+    static constexpr size_t   page_size   = 1024 * 1024;
+    static constexpr size_t   min_chunk   = 96;
+    static constexpr size_t   max_key     = 250;
+    static constexpr int      max_classes = 64;
+    // relative expiry times are up to 30 days, larger ones are absolute
+    static constexpr int64_t  max_relative_exptime = 60 * 60 * 24 * 30;
+
+    enum Segment : uint8_t { HOT, WARM, COLD, SEGMENTS };
+
+    struct Item {
+      Item*    h_next;  // hash chain, or free list
+      Item*    prev;
+      Item*    next;
+      uint64_t cas;
+      uint32_t hash;
+      uint32_t exptime; // 0 if it never expires
+      uint32_t time;    // when it was stored
+      uint32_t flags;
+      uint32_t nbytes;
+      uint8_t  nkey;
+      uint8_t  cls;
+      uint8_t  segment;
+      uint8_t  active;
+
+      // the key, then the value, follow the header
+      char* data() noexcept { return (char*) (this + 1); }
+      const char* data() const noexcept { return (const char*) (this + 1); }
+
+      std::string_view key() const noexcept
+      { return {data(), nkey}; }
+
+      std::string_view value() const noexcept
+      { return {data() + nkey, nbytes}; }
+    };
+
+    // the largest value there is room for with a key
+    static constexpr size_t max_value = page_size - sizeof(Item) - max_key;
+
+    struct Stats {
+      uint64_t get_hits    = 0;
+      uint64_t get_misses  = 0;
+      uint64_t sets        = 0;
+      uint64_t evictions   = 0;
+      uint64_t expired     = 0;
+      uint64_t items       = 0;
+      uint64_t bytes       = 0; // keys and values
+      uint64_t pages       = 0;
+      uint64_t reassigned  = 0; // pages moved to another slab class
+    };
+
+    using Memory = os::mem::Pmr_pool::Resource_ptr;
+
+    /**
+     * @brief      Construct a store taking its pages from memory
+     *
+     * @param[in]  memory  The resource, its capacity caps the store
+     * @param[in]  growth  How much larger each slab class is than the last
+     */
+    explicit Store(Memory memory, double growth = 1.25);
+    ~Store();
+
+    Store(const Store&) = delete;
+    Store& operator=(const Store&) = delete;
+
+    /**
+     * @brief      Look up an item which has not expired, and mark it used
+     *
+     * @return     The item, valid until the store is changed, or nullptr
+     */
+    const Item* get(std::string_view key, size_t hash, uint32_t now);
+
+    /**
+     * @brief      Store a value, following the rules of the memcached
+     *             storage commands for mode.
+     *
+     * @param[in]  cas     The cas unique for Mode::CAS
+     */
+    Result store(Mode mode, std::string_view key, size_t hash,
+                 uint32_t flags, uint32_t exptime, std::string_view value,
+                 uint32_t now, uint64_t cas = 0);
+
+    // Remove a key
+    Result remove(std::string_view key, size_t hash, uint32_t now);
+
+    // Change the expiry time of a key
+    Result touch(std::string_view key, size_t hash, uint32_t exptime, uint32_t now);
+
+    /**
+     * @brief      Add to or subtract from a decimal value, like incr/decr.
+     *             Decrementing stops at 0 and incrementing wraps at 64 bits.
+     *
+     * @param      value  Receives the new value
+     */
+    Result arith(std::string_view key, size_t hash, bool incr, uint64_t delta,
+                 uint64_t& value, uint32_t now);
+
+    /**
+     * @brief      Invalidate every item stored up until when. Items are
+     *             freed right away if when is now or earlier.
+     */
+    void flush_all(uint32_t when, uint32_t now);
+
+    // Call fn(item) for every live item, coldest first in each class
+    template <typename Fn>
+    void for_each(Fn&& fn, uint32_t now) const;
+
+    /**
+     * @brief      Insert an item as it was, with its cas and segment, for
+     *             restoring a store. Goes in at the head of the segment.
+     */
+    bool restore(std::string_view key, size_t hash, uint32_t flags,
+                 uint32_t exptime, uint32_t time, uint64_t cas,
+                 uint8_t segment, std::string_view value, uint32_t now);
+
+    // The absolute expiry time of a protocol exptime
+    static uint32_t expiry(int64_t exptime, uint32_t now) noexcept;
+
+    const Stats& stats() const noexcept
+    { return stats_; }
+
+    size_t capacity() const noexcept
+    { return memory_->capacity(); }
+
+    int classes() const noexcept
+    { return classes_; }
+
+    // the chunk size of a slab class
+    size_t chunk_size(int cls) const noexcept
+    { return slabs_.at(cls).size; }
+
+    // the number of pages of a slab class
+    size_t pages(int cls) const noexcept
+    { return slabs_.at(cls).pages.size(); }
+
+    // the number of items in a segment of a slab class
+    size_t segment_size(int cls, Segment seg) const noexcept
+    { return slabs_.at(cls).count[seg]; }
+
+  private:
+    struct Slab_class {
+      uint32_t size     = 0; // chunk size
+      uint32_t per_page = 0;
+      Item*    free     = nullptr;
+      uint32_t items    = 0;
+      std::array<Item*, SEGMENTS>   head {};
+      std::array<Item*, SEGMENTS>   tail {};
+      std::array<uint32_t, SEGMENTS> count {};
+      std::vector<void*> pages;
+    };
+
+    Memory memory_;
+    std::array<Slab_class, max_classes> slabs_;
+    int classes_ = 0;
+    std::vector<Item*> buckets_;
+    size_t   hashed_ = 0;
+    uint64_t cas_ = 0;
+    uint32_t flushed_at_ = 0;
+    uint32_t now_ = 0; // as of the last lookup
+    Item*    pinned_ = nullptr; // not to be evicted while replaced
+    Stats    stats_;
+
+    static uint32_t bucket_hash(size_t hash) noexcept
+    { return uint32_t(hash >> 8) ^ uint32_t(uint64_t(hash) >> 32); }
+
+    bool   is_live(const Item&, uint32_t now) const noexcept;
+    Item*  find(std::string_view key, uint32_t hash, uint32_t now);
+    Item*  alloc(std::string_view key, uint32_t hash, size_t nbytes);
+    int    class_for(size_t size) const noexcept;
+    bool   grow(Slab_class&, int cls);
+    bool   reassign(Slab_class&, int cls);
+    void   carve(Slab_class&, int cls, void* page);
+    Item*  evict(Slab_class&);
+    void   link(Item*, uint8_t segment);
+    void   replace(Item* old, Item* item);
+    void   unlink(Item*);
+    void   free(Item*);
+    void   lru_push(Item*, uint8_t segment);
+    void   lru_remove(Item*);
+    void   bump(Item*);
+    void   balance(Slab_class&);
+    void   rehash();
+  };
+
+  template <typename Fn>
+  void Store::for_each(Fn&& fn, uint32_t now) const
+  {
+    for (int cls = 0; cls < classes_; cls++)
+      for (int seg = COLD; seg >= HOT; seg--)
+        for (const Item* item = slabs_[cls].tail[seg]; item; item = item->prev)
+          if (is_live(*item, now)) fn(*item);
+  }
+
+}
+
+#endif
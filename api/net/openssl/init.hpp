@@ -2,6 +2,11 @@
 #include <openssl/ossl_typ.h>
 #include <fs/common.hpp>
 
+namespace net::tls {
+  class Session_cache;
+  class Ticket_keys;
+}
+
 namespace openssl
 {
   extern void setup_rng();
@@ -9,6 +14,8 @@ namespace openssl
   extern void init();
 
   extern SSL_CTX* create_server(const std::string& cert, const std::string& key);
+  // resume sessions through a shared session cache and session tickets
+  extern void enable_resumption(SSL_CTX*, net::tls::Session_cache&, net::tls::Ticket_keys&);
 
   extern SSL_CTX* create_client(fs::List, bool verify_peer = false);
   // enable peer certificate verification
@@ -3,6 +3,7 @@
 #include <openssl/pem.h>
 #include <openssl/ssl.h>
 #include <net/stream_buffer.hpp>
+#include <deque>
 
 //#define VERBOSE_OPENSSL 1
 #ifdef VERBOSE_OPENSSL
@@ -17,8 +18,12 @@ namespace openssl
   {
     using Stream_ptr = net::Stream_ptr;
 
+    // maximum plaintext in a single TLS record
+    static constexpr size_t RECORD_SIZE = SSL3_RT_MAX_PLAIN_LENGTH;
+
     TLS_stream(SSL_CTX* ctx, Stream_ptr, bool outgoing = false);
-    TLS_stream(Stream_ptr, SSL* ctx, BIO*, BIO*);
+    // takes ownership of an already configured SSL object
+    TLS_stream(Stream_ptr, SSL* ssl);
     virtual ~TLS_stream();
 
     void write(buffer_t buffer) override;
@@ -26,6 +31,18 @@ namespace openssl
     void write(const void* buf, size_t n) override;
     void close() override;
 
+    /**
+     * @brief      Coalesce small writes into full TLS records. Batched data
+     *             is sent when a full record is ready, after @delay, or on
+     *             flush(). A zero delay disables batching (the default).
+     *
+     * @param[in]  delay  The maximum time data is held back
+     */
+    void set_write_batching(Timer::duration_t delay);
+
+    // encrypt and send any batched writes now
+    void flush();
+
     net::Socket local() const override {
       return m_transport->local();
     }
@@ -65,11 +82,14 @@ namespace openssl
 
   private:
     void handle_data();
-    int  decrypt(const void *data,int size);
     int  send_decrypted();
     bool tls_read(buffer_t);
+    bool tls_write(const uint8_t*, size_t);
+    bool ssl_write(const uint8_t*, size_t);
+    bool write_unsent();
     int  tls_perform_stream_write();
     int  tls_perform_handshake();
+    void attach_bio();
     bool handshake_completed() const noexcept;
     void close_callback_once();
 
@@ -79,10 +99,27 @@ namespace openssl
       STATUS_FAIL
     };
     status_t status(int n) const noexcept;
+
+    // BIO backed directly by the transport buffers
+    static BIO_METHOD* bio_method();
+    static int  bio_write(BIO*, const char*, int);
+    static int  bio_read(BIO*, char*, int);
+    static long bio_ctrl(BIO*, int, long, void*);
+
     Stream_ptr m_transport = nullptr;
     SSL*   m_ssl    = nullptr;
-    BIO*   m_bio_rd = nullptr;
-    BIO*   m_bio_wr = nullptr;
+    // received ciphertext, not yet consumed by OpenSSL
+    std::deque<buffer_t> m_rx_chain;
+    size_t m_rx_offset  = 0;
+    size_t m_rx_pending = 0;
+    // encrypted records waiting to be handed to the transport
+    buffer_t m_tx = nullptr;
+    // batched plaintext waiting to be encrypted
+    buffer_t m_plain = nullptr;
+    // plaintext SSL_write could not take yet
+    buffer_t m_unsent = nullptr;
+    Timer  m_flush_timer{{this, &TLS_stream::flush}};
+    Timer::duration_t m_batch_delay{0};
     int8_t m_busy = 0;
     bool   m_deferred_close = false;
   };
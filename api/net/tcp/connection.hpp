@@ -624,6 +624,8 @@ public:
   // ???
   void deserialize_from(void*);
   int  serialize_to(void*) const;
+  // bytes serialize_to will write
+  int  serialized_size() const;
   static const int VERSION = 2;
 
   /**
@@ -212,7 +212,9 @@ namespace net::tcp
 
     int get_cpuid() const noexcept override;
 
-    size_t serialize_to(void* p, const size_t) const override {
+    size_t serialize_to(void* p, const size_t len) const override {
+      if (m_tcp->serialized_size() > (int64_t) len)
+        throw std::runtime_error("TCP stream does not fit in serialization area");
       return m_tcp->serialize_to(p);
     }
     uint16_t serialization_subid() const override {
@@ -0,0 +1,159 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_TLS_SESSION_CACHE_HPP
+#define NET_TLS_SESSION_CACHE_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <smp>
+#include <smp_utils>
+
+namespace liu {
+  struct Storage; struct Restore;
+}
+
+namespace net::tls {
+
+/**
+ * @brief      A bounded, sharded LRU cache of serialized TLS sessions,
+ *             keyed by session id.
+ *
+ *             A returning client may be accepted on any core, so the cache
+ *             is shared by all of them. The shard is chosen by a hash of
+ *             the session id and each shard has its own lock, keeping
+ *             contention low during a reconnect storm.
+ *             The cache does not know about the TLS library, sessions are
+ *             stored in whatever serialized form the library produces.
+ */
+class Session_cache {
+public:
+  static constexpr size_t SHARDS = SMP_MAX_CORES;
+
+  struct Stats {
+    uint64_t hits      = 0;
+    uint64_t misses    = 0;
+    uint64_t inserts   = 0;
+    uint64_t evictions = 0;
+    uint64_t expired   = 0;
+    size_t   entries   = 0;
+  };
+
+  // the cache shared by all TLS servers in this instance
+  static Session_cache& get();
+
+  /**
+   * @brief      Construct a session cache
+   *
+   * @param[in]  max_entries  The maximum number of sessions (over all shards)
+   * @param[in]  lifetime     How long a session may be resumed
+   */
+  explicit Session_cache(size_t max_entries = 8192,
+                         std::chrono::seconds lifetime = std::chrono::hours(2));
+
+  /**
+   * @brief      Insert (or replace) a session, evicting the least recently
+   *             used session in the shard if it is full.
+   *
+   * @param[in]  id    The session id
+   * @param[in]  data  The serialized session
+   * @param[in]  len   The length of the serialized session
+   */
+  void insert(std::string_view id, const void* data, size_t len);
+
+  /**
+   * @brief      Look up a session which has not expired.
+   *
+   * @param[in]  id    The session id
+   * @param      out   Receives the serialized session
+   *
+   * @return     Whether the session was found.
+   */
+  bool lookup(std::string_view id, std::vector<uint8_t>& out);
+
+  // remove a single session, returns whether it existed
+  bool erase(std::string_view id);
+
+  // remove all sessions, returns the number removed
+  size_t clear();
+
+  void set_lifetime(std::chrono::seconds lifetime) noexcept
+  { m_lifetime = lifetime; }
+
+  std::chrono::seconds lifetime() const noexcept
+  { return m_lifetime; }
+
+  size_t capacity() const noexcept
+  { return m_max_per_shard * SHARDS; }
+
+  // accumulated stats for all shards
+  Stats stats() const;
+
+  /**
+   * @brief      Store all sessions which have not expired, so that clients
+   *             may resume across a LiveUpdate. Use from a storage function
+   *             registered with LiveUpdate::register_partition.
+   *
+   * @param[in]  id     The id used for the entries
+   * @param      store  The storage
+   */
+  void store(uint16_t id, liu::Storage& store) const;
+
+  /**
+   * @brief      Restore sessions stored by store(). Consumes all entries
+   *             up to and including the terminating marker.
+   *
+   * @param      store  The restore object, positioned at the first entry
+   */
+  void restore(liu::Restore& store);
+
+private:
+  struct Entry {
+    std::string          id;
+    std::vector<uint8_t> data;
+    uint64_t             expires;
+  };
+  using Entry_list = std::list<Entry>;
+
+  struct alignas(SMP_ALIGN) Shard {
+    mutable Spinlock lock;
+    Entry_list lru; // most recently used first
+    std::unordered_map<std::string_view, Entry_list::iterator> map;
+    Stats stats;
+  };
+
+  Shard& shard_for(std::string_view id) noexcept
+  { return m_shards[std::hash<std::string_view>{}(id) % SHARDS]; }
+
+  void insert(std::string_view id, const void* data, size_t len, uint64_t expires);
+  void erase_locked(Shard&, Entry_list::iterator);
+
+  std::array<Shard, SHARDS> m_shards;
+  size_t m_max_per_shard;
+  std::chrono::seconds m_lifetime;
+};
+
+} // < namespace net::tls
+
+#endif
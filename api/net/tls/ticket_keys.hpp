@@ -0,0 +1,119 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_TLS_TICKET_KEYS_HPP
+#define NET_TLS_TICKET_KEYS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <smp_utils>
+
+namespace liu {
+  struct Storage; struct Restore;
+}
+
+namespace net::tls {
+
+/**
+ * @brief      A session ticket key (RFC 5077 recommended layout).
+ */
+struct Ticket_key
+{
+  static constexpr size_t NAME_LEN = 16;
+  static constexpr size_t KEY_LEN  = 32;
+
+  std::array<uint8_t, NAME_LEN> name;
+  std::array<uint8_t, KEY_LEN>  aes_key;
+  std::array<uint8_t, KEY_LEN>  hmac_key;
+  // unix timestamp of when the key was generated
+  uint64_t created = 0;
+};
+
+/**
+ * @brief      Rotating session ticket keys, shared by all cores.
+ *
+ *             New tickets are always encrypted with the current key.
+ *             The previous key is kept for one more rotation interval, so
+ *             that tickets issued just before a rotation can still be
+ *             decrypted (and are then renewed). Keys are generated lazily
+ *             from the system RNG on first use.
+ *
+ *             Store the keys in a LiveUpdate partition to let clients keep
+ *             resuming with their tickets after an update.
+ */
+class Ticket_keys {
+public:
+  // the keys shared by all TLS servers in this instance
+  static Ticket_keys& get();
+
+  explicit Ticket_keys(std::chrono::seconds interval = std::chrono::hours(12))
+    : m_interval{interval} {}
+
+  /**
+   * @brief      The key to encrypt new tickets with. Rotates the keys if
+   *             the current key is older than the rotation interval.
+   *
+   * @return     A copy of the current key
+   */
+  Ticket_key current();
+
+  /**
+   * @brief      Find the key a ticket was encrypted with. Rotates the
+   *             keys first if the current key is older than the rotation
+   *             interval, like current().
+   *
+   * @param[in]  name        The key name from the ticket (NAME_LEN bytes)
+   * @param[out] is_current  Whether the key is the current key. If not,
+   *                         the ticket should be renewed.
+   *
+   * @return     A copy of the key, or nullopt if unknown or expired
+   */
+  std::optional<Ticket_key> find(const uint8_t* name, bool& is_current);
+
+  // generate a new current key, demoting the current to previous
+  void rotate();
+
+  void set_rotation_interval(std::chrono::seconds interval) noexcept
+  { m_interval = interval; }
+
+  std::chrono::seconds rotation_interval() const noexcept
+  { return m_interval; }
+
+  // store the current and previous key
+  void store(uint16_t id, liu::Storage& store) const;
+  // restore keys stored by store(), replacing any existing keys
+  void restore(liu::Restore& store);
+
+private:
+  void rotate_locked(uint64_t now);
+  bool previous_valid(uint64_t now) const noexcept
+  { return m_has_previous && now < m_previous.created + 2 * m_interval.count(); }
+
+  mutable Spinlock m_lock;
+  Ticket_key m_current;
+  Ticket_key m_previous;
+  bool m_has_current  = false;
+  bool m_has_previous = false;
+  std::chrono::seconds m_interval;
+};
+
+} // < namespace net::tls
+
+#endif
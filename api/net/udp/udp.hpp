@@ -113,6 +113,11 @@ namespace net {
 
     /** Send UDP datagram to network handler */
     void transmit(udp::Packet_view_ptr udp);
+    void transmit(udp::Packet_view& udp);
+
+    /** Build and send a single datagram, without allocating a packet view */
+    void transmit(const net::Socket& src, const net::Socket& dst,
+                  const uint8_t* data, size_t length);
 
     //! @param port local port
     udp::Socket& bind(port_t port);
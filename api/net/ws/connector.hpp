@@ -52,10 +52,13 @@ public:
    *
    * @param[in]  on_connect  On connect callback
    * @param[in]  on_accept   On accept (optional)
+   * @param[in]  deflate     The permessage-deflate config (optional)
    */
-  WS_server_connector(ConnectCallback on_connect, AcceptCallback on_accept = nullptr)
+  WS_server_connector(ConnectCallback on_connect, AcceptCallback on_accept = nullptr,
+                      WS_deflate_options deflate = {})
     : WS_connector(std::move(on_connect)),
-      on_accept_(std::move(on_accept))
+      on_accept_(std::move(on_accept)),
+      deflate_(std::move(deflate))
   {
   }
 
@@ -90,7 +93,7 @@ public:
         return;
       }
     }
-    auto ws = WebSocket::upgrade(*req, *writer);
+    auto ws = WebSocket::upgrade(*req, *writer, deflate_);
     if (ws == nullptr) return;
 
     assert(ws->get_cpuid() == SMP::cpu_id());
@@ -99,6 +102,7 @@ public:
 
 private:
   AcceptCallback  on_accept_;
+  WS_deflate_options deflate_;
 
 }; // < WS_server_connector
 
@@ -127,18 +131,21 @@ public:
    *             with restricted lifetime to the response handler itself.
    *
    * @param[in]  cb    A connect callback
-   * @param[in]  key   The WS key
+   * @param[in]  key      The WS key
+   * @param[in]  deflate  The permessage-deflate offer sent (optional)
    *
    * @return     Returns a Response handler with a captured client connector.
    */
-  static Response_handler create_response_handler(ConnectCallback cb, std::string key)
+  static Response_handler create_response_handler(ConnectCallback cb, std::string key,
+                                                  WS_deflate_options deflate = {})
   {
     // @todo Try replace with unique_ptr
     // create a new instance of a client connector
     //auto ptr = std::unique_ptr<WS_client_connector>{
     //  new WS_client_connector(std::move(cb), std::move(key))
     //};
-    auto ptr = std::make_shared<WS_client_connector>(std::move(cb), std::move(key));
+    auto ptr = std::make_shared<WS_client_connector>(std::move(cb), std::move(key),
+                                                     std::move(deflate));
 
     return [ ptr{std::move(ptr)} ]
            (auto err, auto res, auto& conn)
@@ -170,7 +177,7 @@ public:
    */
   void on_response(http::Error err, http::Response_ptr res, http::Connection& conn)
   {
-    auto ws = WebSocket::upgrade(err, *res, conn, key_);
+    auto ws = WebSocket::upgrade(err, *res, conn, key_, deflate_);
 
     if(ws == nullptr) {
     } // not ok
@@ -185,10 +192,13 @@ public:
    *
    * @param[in]  on_connect  On connect callback
    * @param[in]  key         The WS key
+   * @param[in]  deflate     The permessage-deflate offer sent (optional)
    */
-  WS_client_connector(ConnectCallback on_connect, std::string key)
+  WS_client_connector(ConnectCallback on_connect, std::string key,
+                      WS_deflate_options deflate = {})
     : WS_connector(std::move(on_connect)),
-      key_(std::move(key))
+      key_(std::move(key)),
+      deflate_(std::move(deflate))
   {
   }
 
@@ -205,6 +215,7 @@ public:
 
 private:
   std::string key_;
+  WS_deflate_options deflate_;
 
 }; // < WS_client_connector
 
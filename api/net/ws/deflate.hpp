@@ -0,0 +1,206 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef NET_WS_DEFLATE_HPP
+#define NET_WS_DEFLATE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace net {
+
+/**
+ * @brief      permessage-deflate (RFC 7692) extension parameters.
+ *
+ *             Used both as the local configuration passed to upgrade/connect,
+ *             and as the result of a successful negotiation.
+ */
+struct WS_deflate_options
+{
+  static constexpr uint8_t MIN_WINDOW_BITS = 8;
+  static constexpr uint8_t MAX_WINDOW_BITS = 15;
+
+  bool    enabled = false;
+  bool    server_no_context_takeover = false;
+  bool    client_no_context_takeover = false;
+  uint8_t server_max_window_bits = MAX_WINDOW_BITS;
+  uint8_t client_max_window_bits = MAX_WINDOW_BITS;
+  // the client offer contained client_max_window_bits (with or without value)
+  bool    client_max_window_bits_offered = false;
+
+  // local only (not negotiated): zlib memLevel used when compressing
+  uint8_t  mem_level = 8;
+  // local only (not negotiated): messages smaller than this are sent as-is
+  uint16_t min_size  = 64;
+
+  // enabled, without context takeover: connections only hold zlib
+  // state while a message is being (de)compressed
+  static WS_deflate_options defaults() noexcept
+  {
+    WS_deflate_options opts;
+    opts.enabled = true;
+    opts.server_no_context_takeover = true;
+    opts.client_no_context_takeover = true;
+    return opts;
+  }
+
+  /**
+   * @brief      Parse a Sec-WebSocket-Extensions value, returning the first
+   *             valid permessage-deflate element.
+   *
+   * @param[in]  header  The header value
+   *
+   * @return     The parameters, or nullopt if none/invalid.
+   */
+  static std::optional<WS_deflate_options> parse(std::string_view header);
+
+  /**
+   * @brief      Server side: accept a client offer against this
+   *             (local) configuration.
+   *
+   * @param[in]  offer  The parsed client offer
+   *
+   * @return     The negotiated parameters to be used and sent back.
+   */
+  WS_deflate_options accept(const WS_deflate_options& offer) const noexcept;
+
+  /**
+   * @brief      Client side: validate a server response against this offer.
+   *
+   * @param[in]  response  The parsed server response
+   *
+   * @return     The negotiated parameters, or nullopt if the response
+   *             is not acceptable.
+   */
+  std::optional<WS_deflate_options>
+  confirm(const WS_deflate_options& response) const noexcept;
+
+  // Sec-WebSocket-Extensions value for a client offer
+  std::string offer_string() const;
+  // Sec-WebSocket-Extensions value for a server response
+  std::string response_string() const;
+};
+
+/**
+ * @brief      A per-CPU pool of zlib (de)compression contexts.
+ *
+ *             A deflate context is several hundred KB with default settings.
+ *             Connections only hold a context for the duration of a single
+ *             message, unless context takeover is negotiated for that
+ *             direction, in which case the context is kept until the
+ *             connection is closed.
+ */
+class WS_deflate_pool {
+public:
+  struct Context;
+  struct Context_deleter {
+    void operator() (Context*) const;
+  };
+  using Context_ptr = std::unique_ptr<Context, Context_deleter>;
+
+  struct Stats {
+    uint32_t created  = 0;
+    uint32_t in_use   = 0;
+    uint32_t idle     = 0;
+  };
+
+  // returns the pool for the current CPU
+  static WS_deflate_pool& get();
+
+  Context_ptr deflater(int window_bits, int mem_level);
+  Context_ptr inflater(int window_bits);
+
+  // maximum number of idle contexts kept around
+  void set_max_idle(size_t n) noexcept
+  { max_idle = n; }
+
+  const Stats& stats() const noexcept
+  { return m_stats; }
+
+  // scratch buffer for compressed output, reused by all connections
+  std::vector<uint8_t>& scratch() noexcept
+  { return m_scratch; }
+
+  ~WS_deflate_pool();
+
+private:
+  void release(Context*);
+  Context_ptr acquire(bool deflate, int window_bits, int mem_level);
+
+  std::vector<Context*> m_idle;
+  std::vector<uint8_t>  m_scratch;
+  size_t max_idle = 16;
+  Stats  m_stats;
+};
+
+/**
+ * @brief      Per-connection permessage-deflate state.
+ */
+class WS_deflate {
+public:
+  WS_deflate(const WS_deflate_options& negotiated, bool client);
+
+  const WS_deflate_options& options() const noexcept
+  { return m_opts; }
+
+  /**
+   * @brief      Compress a message payload.
+   *
+   * @param[in]  data  The data
+   * @param[in]  len   The length
+   *
+   * @return     The compressed payload (owned by the pool, valid until the
+   *             next call), or an empty view if compression failed.
+   */
+  std::string_view compress(const char* data, size_t len);
+
+  /**
+   * @brief      Decompress a message payload.
+   *
+   * @param[in]  data      The compressed data
+   * @param[in]  len       The length
+   * @param      out       The output vector
+   * @param[in]  max_size  Maximum decompressed size, 0 is unlimited
+   *
+   * @return     Whether the payload was valid and within limits.
+   */
+  bool decompress(const uint8_t* data, size_t len,
+                  std::vector<uint8_t>& out, size_t max_size);
+
+  // whether a message of this size should be compressed
+  bool should_compress(size_t len) const noexcept
+  { return len >= m_opts.min_size; }
+
+private:
+  WS_deflate_options m_opts;
+  // contexts only stay here between messages with context takeover
+  WS_deflate_pool::Context_ptr m_deflater;
+  WS_deflate_pool::Context_ptr m_inflater;
+  int  m_deflate_bits;
+  int  m_inflate_bits;
+  bool m_keep_deflater;
+  bool m_keep_inflater;
+};
+
+} // < namespace net
+
+#endif
@@ -45,6 +45,13 @@ namespace net {
       bits |= 0x80;
       assert(is_final() == true);
     }
+    // RSV1 marks a compressed message (permessage-deflate)
+    bool is_compressed() const noexcept {
+      return (bits >> 6) & 1;
+    }
+    void set_compressed() noexcept {
+      bits |= 0x40;
+    }
     uint16_t payload() const noexcept {
       return (bits >> 8) & 0x7f;
     }
@@ -20,6 +20,7 @@
 #define NET_WS_WEBSOCKET_HPP
 
 #include "header.hpp"
+#include "deflate.hpp"
 
 #include <net/http/server.hpp>
 #include <net/http/basic_client.hpp>
@@ -107,6 +108,13 @@ public:
           writable_header().masking_algorithm(this->data());
     }
 
+    bool is_compressed() const noexcept
+    { return header().is_compressed(); }
+
+    // replace the payload, eg. after decompression
+    void set_data(Data data) noexcept
+    { data_ = std::move(data); }
+
   private:
     Data data_;
     std::array<uint8_t, 15> header_;
@@ -144,25 +152,29 @@ public:
   /**
    * @brief      Upgrade a HTTP Request to a WebSocket connection.
    *
-   * @param      req     The HTTP request
-   * @param      writer  The HTTP response writer
+   * @param      req      The HTTP request
+   * @param      writer   The HTTP response writer
+   * @param[in]  deflate  The permessage-deflate config (disabled by default)
    *
    * @return     A WebSocket_ptr, or nullptr if upgrade fails.
    */
-  static WebSocket_ptr upgrade(http::Request& req, http::Response_writer& writer);
+  static WebSocket_ptr upgrade(http::Request& req, http::Response_writer& writer,
+                               const WS_deflate_options& deflate = {});
 
   /**
    * @brief      Upgrade a HTTP Response to a WebSocket connection.
    *
    * @param[in]  err   The HTTP error
    * @param      res   The HTTP response
-   * @param      conn  The HTTP connection
-   * @param      key   The WS key sent in the HTTP request
+   * @param      conn     The HTTP connection
+   * @param      key      The WS key sent in the HTTP request
+   * @param[in]  deflate  The permessage-deflate offer sent in the HTTP request
    *
    * @return     A WebSocket_ptr, or nullptr if upgrade fails.
    */
   static WebSocket_ptr upgrade(http::Error err, http::Response& res,
-                               http::Connection& conn, const std::string& key);
+                               http::Connection& conn, const std::string& key,
+                               const WS_deflate_options& deflate = {});
 
   /**
    * @brief      Generate a random WebSocket key
@@ -177,33 +189,39 @@ public:
    * @param      client    The HTTP client
    * @param[in]  dest      The destination
    * @param[in]  callback  The connect callback
+   * @param[in]  deflate   The permessage-deflate offer (disabled by default)
    */
   static void connect(http::Basic_client&   client,
                       uri::URI        dest,
-                      Connect_handler callback);
+                      Connect_handler callback,
+                      const WS_deflate_options& deflate = {});
 
   /**
    * @brief      Creates a request handler on heap.
    *
    * @param[in]  on_connect  On connect handler
    * @param[in]  on_accept   On accept (optional)
+   * @param[in]  deflate     The permessage-deflate config (optional)
    *
    * @return     A Request handler for a http::Server
    */
   static http::Server::Request_handler
   create_request_handler(Connect_handler on_connect,
-                         Accept_handler  on_accept = nullptr);
+                         Accept_handler  on_accept = nullptr,
+                         WS_deflate_options deflate = {});
 
   /**
    * @brief      Creates a response handler on heap.
    *
    * @param[in]  on_connect  On connect handler
    * @param[in]  key         The WebSocket key sent in outgoing HTTP header
+   * @param[in]  deflate     The permessage-deflate offer sent in outgoing HTTP header
    *
    * @return     A Response handler for a http::Client
    */
   static http::Basic_client::Response_handler
-  create_response_handler(Connect_handler on_connect, std::string key);
+  create_response_handler(Connect_handler on_connect, std::string key,
+                          WS_deflate_options deflate = {});
 
   void write(const char* buffer, size_t len, op_code = op_code::TEXT);
   void write(Stream::buffer_t, op_code = op_code::TEXT);
@@ -270,11 +288,20 @@ public:
     max_msg_size = sz;
   }
 
+  // whether permessage-deflate was negotiated
+  bool is_compressed() const noexcept {
+    return this->m_deflate != nullptr;
+  }
+  // the negotiated permessage-deflate parameters
+  const WS_deflate_options* deflate_options() const noexcept {
+    return m_deflate ? &m_deflate->options() : nullptr;
+  }
+
   size_t serialize_to(void* p) const /*override*/;
   /* Create connection from binary data */
   static std::pair<WebSocket_ptr, size_t> deserialize_from(const void*);
 
-  WebSocket(net::Stream_ptr, bool);
+  WebSocket(net::Stream_ptr, bool, const WS_deflate_options& = {});
   ~WebSocket() {
     assert(m_busy == false && "Cannot delete stream while in its call stack");
   }
@@ -283,6 +310,7 @@ private:
   net::Stream_ptr stream;
   Timer ping_timer{{this, &WebSocket::pong_timeout}};
   Message_ptr message;
+  std::unique_ptr<WS_deflate> m_deflate;
   uint32_t max_msg_size;
   bool     clientside;
   bool     m_busy = false;
@@ -294,6 +322,8 @@ private:
   WebSocket& operator= (WebSocket&&) = delete;
   void read_data(Stream::buffer_t);
   bool write_opcode(op_code code, const char*, size_t);
+  void write_compressed(const char*, size_t, op_code);
+  bool inflate_message();
   void failure(const std::string&);
   void close_callback_once();
   size_t create_message(const uint8_t*, size_t len);
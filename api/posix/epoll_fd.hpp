@@ -0,0 +1,91 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef INCLUDE_EPOLL_FD_HPP
+#define INCLUDE_EPOLL_FD_HPP
+
+#include "fd.hpp"
+#include <sys/epoll.h>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+
+/**
+ * @brief An epoll instance
+ * @details Watches the readiness of other descriptors. Descriptors tell
+ *          the instance when their readiness may have changed, which puts
+ *          them on a ready list. epoll_wait only looks at the ready list,
+ *          so it does work proportional to the number of ready descriptors,
+ *          not the number of watched ones.
+ *
+ *          Level-triggered descriptors stay on the ready list as long as
+ *          they are ready, edge-triggered (EPOLLET) descriptors are removed
+ *          once reported, and EPOLLONESHOT disables the descriptor until it
+ *          is rearmed with EPOLL_CTL_MOD.
+ */
+class Epoll_FD : public FD, public FD_watcher {
+public:
+  using Timeout = std::chrono::nanoseconds;
+
+  explicit Epoll_FD(const int id)
+    : FD(id)
+  {}
+
+  ~Epoll_FD();
+
+  int  close() override;
+
+  // readable while there are ready descriptors
+  int  poll_events() override;
+
+  /** epoll_ctl(2) on the descriptor fd */
+  long ctl(int op, int fd, struct epoll_event* event);
+
+  /**
+   * @brief epoll_wait(2). Blocks until a watched descriptor is ready,
+   *        or the timeout expires. Timeout::max() waits forever.
+   *
+   * @return The number of events, or a negative error
+   */
+  long wait(struct epoll_event* events, int maxevents, Timeout timeout);
+
+  size_t watched() const noexcept
+  { return interest_.size(); }
+
+  void fd_ready(FD&) override;
+  void fd_closed(FD&) override;
+
+private:
+  struct Interest {
+    FD*          fd;
+    uint32_t     events;
+    epoll_data_t data;
+    bool         queued   = false;
+    bool         disabled = false; // after EPOLLONESHOT
+  };
+
+  void enqueue(Interest&);
+  void unqueue(Interest&);
+  void forget_all();
+
+  std::unordered_map<FD*, Interest> interest_;
+  std::deque<Interest*> ready_;
+  // futex word, incremented whenever something is queued
+  int seq_ = 0;
+};
+
+#endif
@@ -22,10 +22,26 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <chrono>
 #include <cstdarg>
 #include <errno.h>
+#include <vector>
 
 #define DEFAULT_ERR EPERM
+
+class FD;
+
+/**
+ * @brief Told whenever the readiness of a watched FD may have changed
+ */
+struct FD_watcher {
+  virtual void fd_ready(FD&) = 0;
+  // the FD is going away, and must be forgotten
+  virtual void fd_closed(FD&) = 0;
+  virtual ~FD_watcher() = default;
+};
+
 /**
  * @brief File descriptor
  * @details
@@ -77,6 +93,36 @@ public:
   // linux specific
   virtual long getdents(struct dirent*, unsigned int) { return -1; }
 
+  /** READINESS **/
+
+  /**
+   * @brief Current (level-triggered) readiness of the descriptor, as
+   *        poll(2) events. Descriptors without a notion of readiness,
+   *        like regular files, are always ready.
+   */
+  virtual int poll_events() { return POLLIN | POLLOUT; }
+
+  /**
+   * @brief Tell watchers and pollers that the readiness may have changed.
+   *        Called on every edge, e.g. when data arrives or the send
+   *        queue drains.
+   */
+  void notify_ready();
+
+  void add_watcher(FD_watcher* w) { watchers_.push_back(w); }
+  void remove_watcher(FD_watcher* w);
+
+  /** Incremented on every notify_ready(), on any descriptor */
+  static int ready_sequence() noexcept;
+
+  /**
+   * @brief Wait until any descriptor notifies, unless one already has
+   *        since ready_sequence() returned seq
+   *
+   * @return false on timeout
+   */
+  static bool wait_ready(int seq, std::chrono::nanoseconds timeout);
+
   id_t get_id() const noexcept { return id_; }
 
   virtual bool is_file() { return false; }
@@ -86,20 +132,21 @@ public:
   bool operator!=(const FD& fd) const noexcept { return !(*this == fd); }
 
   bool is_blocking() const noexcept {
-    return this->non_blocking == 0;
+    return (this->fflags & O_NONBLOCK) == 0;
+  }
+
+  void set_blocking(bool blocking) noexcept {
+    if (blocking) this->fflags &= ~O_NONBLOCK;
+    else this->fflags |= O_NONBLOCK;
   }
 
-  virtual ~FD() {}
+  virtual ~FD();
 
 private:
   const id_t id_;
+  std::vector<FD_watcher*> watchers_;
   int dflags;
-  union {
-    struct {
-      int   non_blocking : 1;
-    };
-    int fflags;
-  };
+  int fflags;
 };
 
 #endif
@@ -20,10 +20,11 @@
 #define INCLUDE_FD_MAP_HPP
 
 #include "fd.hpp"
-#include <map>
 #include <memory>
+#include <pmr>
 #include <stdexcept>
 #include <string>
+#include <vector>
 #include <cassert>
 #include <likely>
 
@@ -41,11 +42,21 @@ public:
 /**
  * @brief File descriptor map
  * @details Singleton class that manages all the file descriptors
+ *
+ *          Descriptors live in a flat table indexed by their id, so a
+ *          lookup is a bounds check and a load. New descriptors get the
+ *          lowest free id, as POSIX requires, found through a bitmap of
+ *          free ids. The descriptor objects are allocated from a pool.
  */
 class FD_map {
 public:
   using id_t = FD::id_t;
-  using FD_ptr = std::unique_ptr<FD>;
+
+  /** The lowest id handed out. Lower ids are stdin, stdout, stderr etc. */
+  static constexpr id_t first_id = 5;
+
+  /** The highest number of open descriptors */
+  static constexpr id_t max_ids = 65536;
 
   static FD_map& instance()
   {
@@ -68,21 +79,28 @@ public:
   static void close(id_t id)
   { instance().internal_close(id); }
 
+  ~FD_map();
+
 private:
-  std::map<id_t, std::unique_ptr<FD>> map_;
-  id_t counter_ = 5;
+  struct Slot {
+    FD*      fd    = nullptr;
+    uint32_t size  = 0;
+    uint32_t align = 0;
+  };
+  static constexpr int bits = 64;
+
+  std::vector<Slot> table_;
+  // one bit per id in the table, set when the id is free
+  std::vector<uint64_t> free_;
+  // no free ids in the words before this one
+  size_t lowest_ = 0;
+  std::pmr::unsynchronized_pool_resource pool_;
 
   FD_map() = default;
 
-  auto& counter() noexcept
-  { return counter_; }
-
-  void internal_close(const id_t id)
-  {
-    [[ maybe_unused ]]
-    auto erased = map_.erase(id);
-    assert(erased > 0);
-  }
+  id_t alloc_id();
+  void free_id(id_t id) noexcept;
+  void internal_close(const id_t id);
 };
 
 template <typename T, typename... Args>
@@ -91,27 +109,76 @@ T& FD_map::open(Args&&... args)
   static_assert(std::is_base_of<FD, T>::value,
     "Template argument is not a File Descriptor (FD)");
 
+  const auto id = alloc_id();
 
-  const auto id = counter()++;
+  void* mem = pool_.allocate(sizeof(T), alignof(T));
+  T* fd;
+  try {
+    fd = new (mem) T(id, std::forward<Args>(args)...);
+  }
+  catch (...) {
+    pool_.deallocate(mem, sizeof(T), alignof(T));
+    free_id(id);
+    throw;
+  }
+  table_[id] = {fd, sizeof(T), alignof(T)};
+  return *fd;
+}
 
-  auto* fd = new T(id, std::forward<Args>(args)...);
+inline FD* FD_map::get(const id_t id) const noexcept
+{
+  if (LIKELY((size_t) id < table_.size()))
+    return table_[id].fd;
 
-  auto res = map_.emplace(std::piecewise_construct,
-                          std::forward_as_tuple(id),
-                          std::forward_as_tuple(fd));
+  return nullptr;
+}
 
-  if(UNLIKELY(res.second == false))
-    throw FD_map_error{"Unable to open FD (map emplace failed)"};
+inline FD_map::id_t FD_map::alloc_id()
+{
+  for (size_t w = lowest_; w < free_.size(); w++)
+  {
+    if (free_[w] != 0) {
+      lowest_ = w;
+      const int bit = __builtin_ctzll(free_[w]);
+      free_[w] &= ~(1ull << bit);
+      return w * bits + bit;
+    }
+  }
+  // grow the table by a word of ids
+  if (UNLIKELY(table_.size() + bits > (size_t) max_ids))
+    throw FD_map_error{"Unable to open FD (too many open descriptors)"};
+  const size_t base = table_.size();
+  table_.resize(base + bits);
+  uint64_t word = ~0ull;
+  // the ids below first_id are never handed out
+  if (base < (size_t) first_id)
+    word <<= (first_id - base);
+  free_.push_back(word);
+  lowest_ = free_.size() - 1;
+  return alloc_id();
+}
 
-  return *fd;
+inline void FD_map::free_id(const id_t id) noexcept
+{
+  free_[id / bits] |= 1ull << (id % bits);
+  if ((size_t) id / bits < lowest_)
+    lowest_ = id / bits;
 }
 
-inline FD* FD_map::get(const id_t id) const noexcept
+inline void FD_map::internal_close(const id_t id)
 {
-  if(auto it = map_.find(id); it != map_.end())
-    return it->second.get();
+  assert((size_t) id < table_.size() && table_[id].fd != nullptr);
+  const auto slot = table_[id];
+  table_[id] = {};
+  free_id(id);
+  slot.fd->~FD();
+  pool_.deallocate(slot.fd, slot.size, slot.align);
+}
 
-  return nullptr;
+inline FD_map::~FD_map()
+{
+  for (size_t id = 0; id < table_.size(); id++)
+    if (table_[id].fd != nullptr) internal_close(id);
 }
 
 #endif
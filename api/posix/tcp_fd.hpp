@@ -50,6 +50,8 @@ public:
 
   int     shutdown(int) override;
 
+  int     poll_events() override;
+
   bool is_listener() const noexcept {
     return ld != nullptr;
   }
@@ -60,10 +62,17 @@ public:
   inline net::tcp::Listener& get_listener() noexcept;
   inline bool has_connq();
 
-  ~TCP_FD() {}
+  ~TCP_FD();
 private:
   std::unique_ptr<TCP_FD_Conn> cd = nullptr;
   TCP_FD_Listen* ld = nullptr;
+  // state of a non-blocking connect
+  net::tcp::Connection_ptr pending = nullptr;
+  bool connecting = false;
+  bool connect_failed = false;
+
+  void attach(std::unique_ptr<TCP_FD_Conn>);
+  void cancel_connect();
 
   friend struct TCP_FD_Listen;
 };
@@ -71,9 +80,14 @@ private:
 struct TCP_FD_Conn
 {
   TCP_FD_Conn(net::tcp::Connection_ptr c);
+  ~TCP_FD_Conn();
 
   void retrieve_buffer();
   void set_default_read();
+  void set_default_write();
+  // tell the owning FD that the readiness may have changed
+  void notify();
+  int  poll_events() const;
 
   ssize_t send(const void *, size_t, int fl);
   ssize_t recv(void*, size_t, int fl);
@@ -86,12 +100,14 @@ struct TCP_FD_Conn
   net::tcp::buffer_t buffer;
   size_t buf_offset;
   bool recv_disc = false;
+  // null while queued on a listener
+  FD* owner = nullptr;
 };
 
 struct TCP_FD_Listen
 {
-  TCP_FD_Listen(net::tcp::Listener& l)
-    : listener(l)
+  TCP_FD_Listen(net::tcp::Listener& l, TCP_FD& fd)
+    : listener(l), owner(fd)
   {}
 
   int close();
@@ -102,6 +118,7 @@ struct TCP_FD_Listen
   std::string to_string() const { return listener.to_string(); }
 
   net::tcp::Listener& listener;
+  TCP_FD& owner;
   std::deque<std::unique_ptr<TCP_FD_Conn>> connq;
 };
 
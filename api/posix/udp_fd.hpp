@@ -54,6 +54,10 @@ public:
 
   int     shutdown(int) override { return 0; }
 
+  // datagrams can always be sent
+  int     poll_events() override
+  { return buffer_.empty() ? POLLOUT : (POLLIN | POLLOUT); }
+
   int     getsockopt(int, int, void *__restrict__, socklen_t *__restrict__) override;
   int     setsockopt(int, int, const void *, socklen_t) override;
 
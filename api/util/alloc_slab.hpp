@@ -0,0 +1,355 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef UTIL_ALLOC_SLAB_HPP
+#define UTIL_ALLOC_SLAB_HPP
+
+#include <array>
+#include <atomic>
+#include <pmr>
+#include <sstream>
+#include <expects>
+#include <likely>
+#include <smp>
+
+#include <util/units.hpp>
+
+namespace os::mem::slab {
+
+  using Size_t = size_t;
+
+  /** Size of a slab, and the smallest allocation of the backend */
+  static constexpr Size_t slab_size = 4096;
+
+  /** Alignment of every object handed out from a slab */
+  static constexpr Size_t min_align = 16;
+
+  /**
+   * Object sizes served from slabs. Each class fills a slab (minus the
+   * header) with little waste. Anything larger is a page allocation.
+   **/
+  static constexpr std::array<uint16_t, 17> size_classes {
+    16, 32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 448, 576, 672, 1008, 1344, 2016
+  };
+
+  static constexpr Size_t max_size = size_classes.back();
+
+  /** Size class index for a size, which must be <= max_size */
+  constexpr int class_of(Size_t size) noexcept {
+    int i = 0;
+    while (size_classes[i] < size) i++;
+    return i;
+  }
+
+  /** A slab header, at the start of every slab page */
+  struct alignas(64) Slab {
+    static constexpr uint32_t magic_value = 0x51ab51ab;
+
+    void*    free = nullptr; // free objects, owner only
+    Slab*    next = nullptr; // partial slabs of the owner, for this class
+    Slab*    prev = nullptr;
+    char*    bump;           // start of never allocated objects
+    uint32_t magic = magic_value;
+    uint16_t cls;
+    uint16_t owner;
+    uint16_t in_use = 0;
+    uint16_t capacity;
+    bool     listed = false;
+
+    Slab(int cls_, int owner_) noexcept
+      : bump{(char*) this + sizeof(Slab)}, cls(cls_), owner(owner_),
+        capacity((slab_size - sizeof(Slab)) / size_classes[cls_])
+    {}
+
+    char* end() noexcept
+    { return (char*) this + sizeof(Slab) + capacity * size_classes[cls]; }
+
+    void* pop() noexcept {
+      if (free != nullptr) {
+        void* obj = free;
+        free = *(void**) obj;
+        in_use++;
+        return obj;
+      }
+      if (bump < end()) {
+        void* obj = bump;
+        bump += size_classes[cls];
+        in_use++;
+        return obj;
+      }
+      return nullptr;
+    }
+
+    void push(void* obj) noexcept {
+      *(void**) obj = free;
+      free = obj;
+      in_use--;
+    }
+
+    bool full() const noexcept  { return in_use == capacity; }
+    bool empty() const noexcept { return in_use == 0; }
+  };
+  static_assert(sizeof(Slab) == 64, "Objects must stay 16 byte aligned");
+
+  /** Slab header of an object allocated from a slab */
+  inline Slab* slab_of(void* ptr) noexcept {
+    return (Slab*) ((uintptr_t) ptr & ~(slab_size - 1));
+  }
+
+  /**
+   * Slab objects are never page aligned, since the slab header is at the
+   * start of the page. Page aligned pointers belong to the backend.
+   **/
+  inline bool is_slab_object(void* ptr) noexcept {
+    return ((uintptr_t) ptr & (slab_size - 1)) != 0;
+  }
+
+  /** Per size class statistics */
+  struct Class_stats {
+    Size_t   size         = 0;
+    uint64_t allocs       = 0;
+    uint64_t frees        = 0;
+    uint64_t remote_frees = 0; // freed on a different CPU than the owner
+    Size_t   slabs        = 0;
+    Size_t   in_use       = 0;
+  };
+
+  /**
+   * A per-CPU slab allocator for small objects, in front of a page
+   * allocator (e.g. the buddy allocator).
+   *
+   * Each CPU owns its slabs, so allocations and frees on the owning CPU
+   * take no locks. Objects freed on another CPU are pushed onto a lock-free
+   * remote free queue of the owner, which is drained by the owner on its
+   * next allocation. Empty slabs are returned to the backend, keeping one
+   * partial slab per class and CPU.
+   *
+   * Only page sized (and larger) allocations reach the backend, which must
+   * hand out slab_size aligned memory with allocate(size) and take it back
+   * with deallocate(ptr, size).
+   **/
+  template <typename Backend, int Cpus = SMP_MAX_CORES>
+  class Alloc : public std::pmr::memory_resource {
+  public:
+    static constexpr int classes = size_classes.size();
+
+    explicit Alloc(Backend& backend) noexcept
+      : backend_{backend} {}
+
+    ~Alloc() {
+      for (int cpu = 0; cpu < Cpus; cpu++)
+        release(cpu);
+    }
+
+    void* allocate(Size_t size) noexcept {
+      return allocate_on(SMP::cpu_id(), size);
+    }
+
+    void deallocate(void* ptr, Size_t size) noexcept {
+      deallocate_on(SMP::cpu_id(), ptr, size);
+    }
+
+    /** Allocate as if running on cpu. Must be called on that CPU. */
+    void* allocate_on(int cpu, Size_t size) noexcept {
+      if (UNLIKELY(size > max_size))
+        return backend_.allocate(size);
+
+      Expects(cpu >= 0 and cpu < Cpus);
+      auto& cache = caches_[cpu];
+      if (UNLIKELY(cache.remote.load(std::memory_order_relaxed) != nullptr))
+        drain(cpu);
+
+      auto& cls = cache.cls[class_of(size ? size : 1)];
+      Slab* slab = cls.partial;
+      if (UNLIKELY(slab == nullptr)) {
+        slab = new_slab(cpu, &cls - cache.cls.data());
+        if (slab == nullptr) return nullptr;
+      }
+      void* obj = slab->pop();
+      if (slab->full()) unlink(cls, slab);
+      cls.stats.allocs++;
+      return obj;
+    }
+
+    /** Free as if running on cpu. Must be called on that CPU. */
+    void deallocate_on(int cpu, void* ptr, Size_t size) noexcept {
+      if (ptr == nullptr) return;
+      if (not is_slab_object(ptr)) {
+        backend_.deallocate(ptr, size);
+        return;
+      }
+      Slab* slab = slab_of(ptr);
+      Expects(slab->magic == Slab::magic_value);
+
+      if (LIKELY(slab->owner == cpu)) {
+        free_local(cpu, slab, ptr);
+        return;
+      }
+      // queue the object for its owner
+      auto& cache = caches_[slab->owner];
+      void* head = cache.remote.load(std::memory_order_relaxed);
+      do {
+        *(void**) ptr = head;
+      } while (not cache.remote.compare_exchange_weak(head, ptr,
+                   std::memory_order_release, std::memory_order_relaxed));
+      caches_[cpu].cls[slab->cls].stats.remote_frees++;
+    }
+
+    /** Free objects other CPUs have freed for cpu. Must be called on that CPU. */
+    void drain(int cpu) noexcept {
+      void* obj = caches_[cpu].remote.exchange(nullptr, std::memory_order_acquire);
+      while (obj != nullptr) {
+        void* next = *(void**) obj;
+        free_local(cpu, slab_of(obj), obj);
+        obj = next;
+      }
+    }
+
+    /** Accumulated statistics for a size class over all CPUs */
+    Class_stats stats(int cls) const noexcept {
+      Class_stats total;
+      total.size = size_classes.at(cls);
+      for (const auto& cache : caches_) {
+        const auto& st = cache.cls[cls].stats;
+        total.allocs       += st.allocs;
+        total.frees        += st.frees;
+        total.remote_frees += st.remote_frees;
+        total.slabs        += st.slabs;
+      }
+      total.in_use = total.allocs - total.frees;
+      return total;
+    }
+
+    /** Bytes of backend memory held in slabs */
+    Size_t bytes_reserved() const noexcept {
+      Size_t slabs = 0;
+      for (int i = 0; i < classes; i++)
+        slabs += stats(i).slabs;
+      return slabs * slab_size;
+    }
+
+    Backend& backend() noexcept { return backend_; }
+
+    std::string summary() const {
+      std::stringstream out;
+      out << "Slab size classes, " << util::Byte_r(bytes_reserved()) << " reserved\n";
+      for (int i = 0; i < classes; i++) {
+        auto st = stats(i);
+        if (st.allocs == 0) continue;
+        out << "  " << st.size << "B: in use " << st.in_use
+            << " slabs " << st.slabs << " allocs " << st.allocs
+            << " remote frees " << st.remote_frees << "\n";
+      }
+      return out.str();
+    }
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+      if (alignment > min_align)
+        return backend_.do_allocate(bytes, alignment);
+      return allocate(bytes);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+      if (alignment > min_align) {
+        backend_.do_deallocate(p, bytes, alignment);
+        return;
+      }
+      deallocate(p, bytes);
+    }
+
+    bool do_is_equal(const memory_resource& other) const noexcept override {
+      return &other == this;
+    }
+
+  private:
+    struct Class_cache {
+      Slab*       partial = nullptr; // slabs with free objects
+      Class_stats stats;
+    };
+
+    struct alignas(SMP_ALIGN) Cpu_cache {
+      std::array<Class_cache, classes> cls;
+      std::atomic<void*> remote {nullptr};
+    };
+
+    Slab* new_slab(int cpu, int cls_idx) noexcept {
+      void* page = backend_.allocate(slab_size);
+      if (UNLIKELY(page == nullptr)) return nullptr;
+      Expects(((uintptr_t) page & (slab_size - 1)) == 0);
+      auto& cls = caches_[cpu].cls[cls_idx];
+      auto* slab = new (page) Slab(cls_idx, cpu);
+      link(cls, slab);
+      cls.stats.slabs++;
+      return slab;
+    }
+
+    void free_local(int cpu, Slab* slab, void* ptr) noexcept {
+      auto& cls = caches_[cpu].cls[slab->cls];
+      slab->push(ptr);
+      cls.stats.frees++;
+      if (not slab->listed) {
+        link(cls, slab);
+      }
+      // keep one slab around, to not bounce pages on alloc/free cycles
+      else if (slab->empty() and (slab->next != nullptr or slab->prev != nullptr)) {
+        unlink(cls, slab);
+        cls.stats.slabs--;
+        slab->magic = 0;
+        backend_.deallocate(slab, slab_size);
+      }
+    }
+
+    static void link(Class_cache& cls, Slab* slab) noexcept {
+      slab->prev = nullptr;
+      slab->next = cls.partial;
+      if (cls.partial) cls.partial->prev = slab;
+      cls.partial = slab;
+      slab->listed = true;
+    }
+
+    static void unlink(Class_cache& cls, Slab* slab) noexcept {
+      if (slab->prev) slab->prev->next = slab->next;
+      else cls.partial = slab->next;
+      if (slab->next) slab->next->prev = slab->prev;
+      slab->next = slab->prev = nullptr;
+      slab->listed = false;
+    }
+
+    // return the empty slabs of a CPU to the backend
+    void release(int cpu) noexcept {
+      drain(cpu);
+      for (auto& cls : caches_[cpu].cls) {
+        Slab* slab = cls.partial;
+        while (slab != nullptr) {
+          Slab* next = slab->next;
+          if (slab->empty()) {
+            unlink(cls, slab);
+            cls.stats.slabs--;
+            slab->magic = 0;
+            backend_.deallocate(slab, slab_size);
+          }
+          slab = next;
+        }
+      }
+    }
+
+    Backend& backend_;
+    std::array<Cpu_cache, Cpus> caches_;
+  };
+
+}
+
+#endif
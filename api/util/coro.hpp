@@ -0,0 +1,284 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef UTIL_CORO_HPP
+#define UTIL_CORO_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <expects>
+#include <hw/block_device.hpp>
+#include <kernel/events.hpp>
+#include <kernel/timers.hpp>
+
+/**
+ * C++20 coroutines on the event loop.
+ *
+ * Task<T> is a lazy coroutine returning T. Awaiting a task starts it, and
+ * the awaiting coroutine continues when it finishes. spawn() runs a task on
+ * its own. The awaitables below wrap the callback based APIs; a suspended
+ * coroutine is resumed from the event loop by the callback.
+ *
+ * Coroutine frames come from Frame_pool, per-CPU free lists of a few size
+ * classes, so creating a coroutine does not go to the heap once the pool
+ * has warmed up.
+ *
+ * @example
+ *   os::coro::Task<size_t> count(hw::Block_device& dev) {
+ *     auto buf = co_await os::coro::read(dev, 0, 8);
+ *     co_await os::coro::sleep(10ms);
+ *     co_return buf ? buf->size() : 0;
+ *   }
+ **/
+namespace os::coro {
+
+  /** Allocator for coroutine frames */
+  struct Frame_pool {
+    static constexpr size_t min_size   = 64;
+    static constexpr size_t max_size   = 4096;
+    static constexpr size_t chunk_size = 65536;
+    static constexpr int    classes    = 7; // 64 to 4096 bytes
+
+    /**
+     * A frame of at least size bytes. Free frames are carved from chunks,
+     * which are kept for the lifetime of the system. Frames above max_size
+     * go directly to the heap.
+     **/
+    static void* allocate(size_t size);
+    static void  deallocate(void* frame, size_t size) noexcept;
+
+    struct Stats {
+      uint64_t allocs    = 0;
+      uint64_t frees     = 0;
+      uint64_t chunks    = 0; // chunks taken from the heap
+      uint64_t oversized = 0; // frames too large for the pool
+    };
+    static Stats stats(int cpu);
+  };
+
+  template <typename T = void> class Task;
+
+  namespace detail {
+    struct Pooled_frame {
+      static void* operator new(size_t size)
+      { return Frame_pool::allocate(size); }
+      static void operator delete(void* frame, size_t size) noexcept
+      { Frame_pool::deallocate(frame, size); }
+    };
+
+    struct Promise_base : Pooled_frame {
+      // continue the awaiting coroutine, if any, when finished
+      struct Final_awaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+          auto next = h.promise().continuation;
+          if (next) return next;
+          return std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+      };
+
+      std::suspend_always initial_suspend() const noexcept { return {}; }
+      Final_awaiter final_suspend() const noexcept { return {}; }
+      void unhandled_exception() noexcept { error = std::current_exception(); }
+
+      void rethrow() {
+        if (error) std::rethrow_exception(error);
+      }
+
+      std::coroutine_handle<> continuation = nullptr;
+      std::exception_ptr      error = nullptr;
+    };
+
+    template <typename T>
+    struct Promise : Promise_base {
+      Task<T> get_return_object() noexcept;
+
+      template <typename U>
+      void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+      T result() {
+        rethrow();
+        return std::move(*value);
+      }
+
+      std::optional<T> value;
+    };
+
+    template <>
+    struct Promise<void> : Promise_base {
+      Task<void> get_return_object() noexcept;
+      void return_void() const noexcept {}
+      void result() { rethrow(); }
+    };
+  }
+
+  /**
+   * A lazily started coroutine returning T. Exceptions thrown in the task
+   * are rethrown in the coroutine awaiting it.
+   **/
+  template <typename T>
+  class Task {
+  public:
+    using promise_type = detail::Promise<T>;
+    using handle_type  = std::coroutine_handle<promise_type>;
+
+    explicit Task(handle_type h) noexcept : coro_{h} {}
+    Task(Task&& other) noexcept : coro_{std::exchange(other.coro_, nullptr)} {}
+    Task& operator=(Task&& other) noexcept {
+      if (this != &other) {
+        reset();
+        coro_ = std::exchange(other.coro_, nullptr);
+      }
+      return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { reset(); }
+
+    bool done() const noexcept
+    { return not coro_ or coro_.done(); }
+
+    /** Start the task, and continue when it has finished */
+    auto operator co_await() noexcept {
+      struct Awaiter {
+        handle_type coro;
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+          coro.promise().continuation = awaiting;
+          return coro;
+        }
+        T await_resume() { return coro.promise().result(); }
+      };
+      Expects(coro_ and not coro_.done());
+      return Awaiter{coro_};
+    }
+
+  private:
+    void reset() noexcept {
+      if (coro_) coro_.destroy();
+      coro_ = nullptr;
+    }
+    handle_type coro_;
+  };
+
+  namespace detail {
+    template <typename T>
+    Task<T> Promise<T>::get_return_object() noexcept
+    { return Task<T>{Task<T>::handle_type::from_promise(*this)}; }
+
+    inline Task<void> Promise<void>::get_return_object() noexcept
+    { return Task<void>{Task<void>::handle_type::from_promise(*this)}; }
+  }
+
+  /**
+   * Start a task that nobody awaits. It runs until it first waits, and then
+   * continues from the event loop. Its frame is freed when it finishes;
+   * an exception ending it is printed.
+   *
+   * @note The frame of a coroutine lambda refers to the lambda's captures,
+   *       so the lambda object must outlive the task.
+   **/
+  void spawn(Task<void> task);
+
+  /**
+   * Awaits a callback based operation, which calls complete() with the
+   * result when done - possibly right away, in which case the coroutine
+   * continues without suspending.
+   **/
+  template <typename R>
+  class Callback_awaiter {
+  public:
+    bool await_ready() const noexcept { return result_.has_value(); }
+    R await_resume() { return std::move(*result_); }
+
+    void complete(R result) {
+      result_.emplace(std::move(result));
+      if (handle_) std::exchange(handle_, nullptr).resume();
+    }
+
+  protected:
+    // call at the end of await_suspend, after starting the operation
+    bool suspend(std::coroutine_handle<> h) noexcept {
+      if (result_.has_value()) return false;
+      handle_ = h;
+      return true;
+    }
+
+  private:
+    std::optional<R>        result_;
+    std::coroutine_handle<> handle_ = nullptr;
+  };
+
+  /** Continue after the events that are already pending */
+  inline auto yield() noexcept
+  {
+    struct Awaiter {
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> h) {
+        Events::get().defer([h] { h.resume(); });
+      }
+      void await_resume() const noexcept {}
+    };
+    return Awaiter{};
+  }
+
+  /** Continue after (at least) the duration */
+  inline auto sleep(Timers::duration_t duration) noexcept
+  {
+    struct Awaiter {
+      Timers::duration_t duration;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> h) {
+        Timers::oneshot(duration, [h] (Timers::id_t) { h.resume(); });
+      }
+      void await_resume() const noexcept {}
+    };
+    return Awaiter{duration};
+  }
+
+  /** Read count blocks from blk, the result is nullptr on error */
+  class Read_blocks : public Callback_awaiter<hw::Block_device::buffer_t> {
+  public:
+    Read_blocks(hw::Block_device& dev, hw::Block_device::block_t blk, size_t count)
+      : dev_{dev}, blk_{blk}, count_{count} {}
+
+    bool await_suspend(std::coroutine_handle<> h) {
+      dev_.read(blk_, count_,
+        [this] (hw::Block_device::buffer_t buf) { complete(std::move(buf)); });
+      return suspend(h);
+    }
+
+  private:
+    hw::Block_device&         dev_;
+    hw::Block_device::block_t blk_;
+    size_t                    count_;
+  };
+
+  inline Read_blocks read(hw::Block_device& dev,
+                          hw::Block_device::block_t blk, size_t count = 1)
+  { return {dev, blk, count}; }
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef UTIL_LOG_RING_HPP
+#define UTIL_LOG_RING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/**
+ * A bounded lock-free ring of variable length records, with a single
+ * producer and a single consumer.
+ *
+ * The producer reserves room for a record, writes the record in place
+ * and commits it, so records are formatted straight into the ring. A
+ * record never wraps: when it does not fit before the end of the ring,
+ * the rest is skipped with a padding record. The consumer reads records
+ * in place and releases them in batches.
+ *
+ * When the ring is full the new record is dropped, never an old one.
+ **/
+template <size_t N>
+class Log_ring {
+public:
+  static_assert(N >= 64 and (N & (N - 1)) == 0, "Capacity must be a power of two");
+
+  struct Header {
+    uint32_t len;
+    uint32_t tag;
+  };
+  static constexpr uint32_t PADDING = UINT32_MAX;
+
+  /** Largest record there is always room for in an empty ring */
+  static constexpr size_t max_record = N / 4 - sizeof(Header);
+
+  Log_ring() = default;
+  Log_ring(const Log_ring&) = delete;
+  Log_ring& operator=(const Log_ring&) = delete;
+
+  /**
+   * Reserve room for a record of at most len bytes, as long as the ring
+   * stays within limit bytes. Returns where to write it, or nullptr.
+   **/
+  char* reserve(size_t len, size_t limit = N) noexcept
+  {
+    if (len > max_record) return nullptr;
+    const size_t need = aligned(sizeof(Header) + len);
+    const size_t head = head_.load(std::memory_order_acquire);
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    const size_t to_end = N - (pos & (N - 1));
+    const size_t skip = need > to_end ? to_end : 0;
+    if (pos + skip + need - head > limit)
+      return nullptr;
+    if (skip) {
+      header(pos) = {uint32_t(skip - sizeof(Header)), PADDING};
+      pos += skip;
+    }
+    reserved_ = pos;
+    return &data_[(pos & (N - 1)) + sizeof(Header)];
+  }
+
+  /** Publish the reserved record, with the len bytes actually written */
+  void commit(size_t len, uint32_t tag) noexcept
+  {
+    header(reserved_) = {uint32_t(len), tag};
+    tail_.store(reserved_ + aligned(sizeof(Header) + len), std::memory_order_release);
+  }
+
+  /** Reserve, copy and commit a record. Returns false if it was dropped. */
+  bool write(std::string_view text, uint32_t tag, size_t limit = N) noexcept
+  {
+    char* dst = reserve(text.size(), limit);
+    if (dst == nullptr) return false;
+    std::memcpy(dst, text.data(), text.size());
+    commit(text.size(), tag);
+    return true;
+  }
+
+  /**
+   * Call fn(tag, text) for up to max of the records not read yet. The
+   * text stays valid until release(). Returns the number of records read.
+   **/
+  template <typename Fn>
+  size_t read(Fn&& fn, size_t max = SIZE_MAX)
+  {
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    size_t count = 0;
+    while (read_ != tail and count < max)
+    {
+      const Header& hdr = header(read_);
+      read_ += aligned(sizeof(Header) + hdr.len);
+      if (hdr.tag == PADDING) continue;
+      fn(hdr.tag, std::string_view(reinterpret_cast<const char*>(&hdr + 1), hdr.len));
+      count++;
+    }
+    return count;
+  }
+
+  /** Give the room of every record read so far back to the producer */
+  void release() noexcept
+  { head_.store(read_, std::memory_order_release); }
+
+  /** Bytes in use, including records read but not released */
+  size_t used() const noexcept
+  { return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed); }
+
+  /** Whether every record has been read, consumer only */
+  bool empty() const noexcept
+  { return tail_.load(std::memory_order_relaxed) == read_; }
+
+  static constexpr size_t capacity() noexcept
+  { return N; }
+
+private:
+  // records start at multiples of the header size, so a padding header
+  // always fits before the end of the ring
+  static constexpr size_t aligned(size_t len) noexcept
+  { return (len + sizeof(Header) - 1) & ~(sizeof(Header) - 1); }
+
+  Header& header(size_t pos) noexcept
+  { return *reinterpret_cast<Header*>(&data_[pos & (N - 1)]); }
+
+  alignas(64) std::array<char, N> data_;
+  // producer side
+  alignas(64) std::atomic<size_t> tail_ {0};
+  size_t reserved_ = 0;
+  // consumer side
+  alignas(64) std::atomic<size_t> head_ {0};
+  size_t read_ = 0;
+};
+
+#endif
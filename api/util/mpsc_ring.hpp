@@ -0,0 +1,112 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef UTIL_MPSC_RING_HPP
+#define UTIL_MPSC_RING_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/**
+ * A bounded lock-free ring with many producers and a single consumer.
+ *
+ * Every slot has a sequence number telling whose turn it is: producers
+ * claim a position with a CAS on the tail, fill the slot and publish it
+ * by bumping its sequence. The consumer owns the head, so popping takes
+ * no atomic read-modify-write at all.
+ **/
+template <typename T, size_t N>
+class Mpsc_ring {
+public:
+  static_assert(N >= 2 and (N & (N - 1)) == 0, "Capacity must be a power of two");
+
+  Mpsc_ring() noexcept {
+    for (size_t i = 0; i < N; i++)
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  Mpsc_ring(const Mpsc_ring&) = delete;
+  Mpsc_ring& operator=(const Mpsc_ring&) = delete;
+
+  /** Add an item from any CPU. Returns false when the ring is full. */
+  template <typename U>
+  bool push(U&& item)
+  {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[pos & (N - 1)];
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0) {
+        return false;
+      }
+      else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->item = std::forward<U>(item);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Take the oldest item. Only the consumer may call this. */
+  bool pop(T& out)
+  {
+    Slot& slot = slots_[head_ & (N - 1)];
+    const size_t seq = slot.seq.load(std::memory_order_acquire);
+    if ((intptr_t) seq - (intptr_t) (head_ + 1) < 0)
+      return false;
+    out = std::move(slot.item);
+    slot.item = T{};
+    slot.seq.store(head_ + N, std::memory_order_release);
+    head_++;
+    return true;
+  }
+
+  /** Approximate number of queued items */
+  size_t size() const noexcept {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    return tail > head_ ? tail - head_ : 0;
+  }
+
+  bool empty() const noexcept
+  { return size() == 0; }
+
+  static constexpr size_t capacity() noexcept
+  { return N; }
+
+private:
+  struct Slot {
+    std::atomic<size_t> seq;
+    T item {};
+  };
+
+  std::array<Slot, N> slots_;
+  alignas(64) std::atomic<size_t> tail_ {0};
+  alignas(64) size_t head_ = 0;
+};
+
+#endif
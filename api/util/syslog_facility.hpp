@@ -51,8 +51,14 @@ public:
   virtual void open_socket() = 0;
   virtual void close_socket() = 0;
   virtual std::string build_message_prefix(const std::string&) = 0;
+  // Same as build_message_prefix, written into buf without allocating.
+  // Returns the length, cut to fit size.
+  virtual size_t format_message_prefix(char* buf, size_t size, const char* binary_name) = 0;
   virtual ~Syslog_facility() {}
 
+  // Room for any prefix
+  static constexpr size_t prefix_max = 256;
+
   Syslog_facility() {}
   Syslog_facility(const char* ident, int facility) : ident_{ident}, facility_{facility} {}
 
@@ -169,6 +175,8 @@ public:
 
   std::string build_message_prefix(const std::string& binary_name);
 
+  size_t format_message_prefix(char* buf, size_t size, const char* binary_name);
+
   Syslog_udp() : Syslog_facility() {}
   Syslog_udp(const char* ident, int facility) : Syslog_facility(ident, facility) {}
 
@@ -193,6 +201,7 @@ public:
   void close_socket() override {}
 
   std::string build_message_prefix(const std::string& binary_name) override;
+  size_t format_message_prefix(char* buf, size_t size, const char* binary_name) override;
 
   Syslog_print() : Syslog_facility() {}
   Syslog_print(const char* ident, int facility) : Syslog_facility(ident, facility) {}
@@ -54,6 +54,16 @@ public:
 
   static void closelog();
 
+  /**
+   * Queue messages in the async log and send them from its flusher,
+   * instead of sending each one from the caller. See os::async_log.
+   */
+  static void set_async(bool async);
+
+  static bool is_async() noexcept {
+    return async_;
+  }
+
   static bool valid_priority(int priority) noexcept {
     return not ((priority < LOG_EMERG) or (priority > LOG_DEBUG));
   }
@@ -69,6 +79,8 @@ public:
 
 private:
   static std::unique_ptr<Syslog_facility> fac_;
+  static bool async_;
+  static int  channel_;
 
 }; // < Syslog
 
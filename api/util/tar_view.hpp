@@ -0,0 +1,253 @@
+// -*-C++-*-
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#ifndef UTIL_TAR_VIEW_HPP
+#define UTIL_TAR_VIEW_HPP
+
+#include <util/tar.hpp>
+#include <hw/block_device.hpp>
+#include <delegate>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+
+namespace tar {
+
+// ---------------------------- Header_view ----------------------------
+
+/** A tar header read in place, nothing is copied */
+class Header_view {
+public:
+  Header_view() = default;
+  explicit Header_view(const Tar_header* header) noexcept
+    : header_{header} {}
+
+  const Tar_header* raw() const noexcept { return header_; }
+
+  std::string_view name() const noexcept     { return field(header_->name, LENGTH_NAME); }
+  std::string_view prefix() const noexcept   { return field(header_->prefix, LENGTH_PREFIX); }
+  std::string_view linkname() const noexcept { return field(header_->linkname, LENGTH_LINKNAME); }
+  std::string_view uname() const noexcept    { return field(header_->uname, LENGTH_UNAME); }
+  std::string_view gname() const noexcept    { return field(header_->gname, LENGTH_GNAME); }
+
+  uint64_t size() const noexcept     { return number(header_->size, LENGTH_SIZE); }
+  uint32_t mode() const noexcept     { return number(header_->mode, LENGTH_MODE); }
+  uint64_t mod_time() const noexcept { return number(header_->mod_time, LENGTH_MTIME); }
+  char typeflag() const noexcept     { return header_->typeflag; }
+
+  bool is_dir() const noexcept  { return typeflag() == DIRTYPE; }
+  bool is_file() const noexcept { return typeflag() == REGTYPE or typeflag() == AREGTYPE; }
+  bool is_ustar() const noexcept
+  { return strncmp(header_->magic, TMAGIC, TMAGLEN - 1) == 0; }
+
+  /** Whether the checksum matches the header */
+  bool checksum_ok() const noexcept;
+
+  /** Bytes taken up by the content, padded to whole blocks */
+  uint64_t padded_size() const noexcept
+  { return (size() + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE; }
+
+  /** A field up to its terminator, if there is one */
+  static std::string_view field(const char* str, size_t len) noexcept
+  { return {str, strnlen(str, len)}; }
+
+  /** An octal number field, or a base-256 one (GNU) for large values */
+  static uint64_t number(const char* str, size_t len) noexcept;
+
+private:
+  const Tar_header* header_ = nullptr;
+};
+
+/** An archive member: its header and its content, both in place */
+struct Entry_view {
+  Header_view      header;
+  std::string_view content;
+
+  std::string_view name() const noexcept { return header.name(); }
+  bool is_valid() const noexcept { return header.raw() != nullptr; }
+};
+
+// -------------------------------- View --------------------------------
+
+/**
+ * A tar archive in memory (the memdisk, a linked-in blob), used in place.
+ *
+ * Unlike Reader::read() nothing is collected up front: headers are
+ * parsed as the iteration gets to them, and names and contents are
+ * views into the archive. A corrupt header throws a Tar_exception.
+ **/
+class View {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = Entry_view;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const Entry_view*;
+    using reference         = const Entry_view&;
+
+    iterator() = default;
+    reference operator*() const noexcept { return entry_; }
+    pointer operator->() const noexcept  { return &entry_; }
+    iterator& operator++();
+    iterator operator++(int) { auto it = *this; ++(*this); return it; }
+    bool operator==(const iterator& other) const noexcept
+    { return pos_ == other.pos_; }
+    bool operator!=(const iterator& other) const noexcept
+    { return pos_ != other.pos_; }
+
+  private:
+    friend class View;
+    iterator(std::string_view data, size_t pos);
+    void load();
+
+    std::string_view data_;
+    size_t           pos_ = std::string_view::npos;
+    Entry_view       entry_;
+  };
+
+  View() = default;
+  explicit View(std::string_view archive) noexcept
+    : data_{archive} {}
+  View(const uint8_t* data, size_t size) noexcept
+    : data_{(const char*) data, size} {}
+
+  /** The tarball linked into the service (see Reader::read_tar) */
+  static View linked() noexcept
+  { return {&_binary_input_bin_start, (size_t) &_binary_input_bin_size}; }
+
+  iterator begin() const { return {data_, 0}; }
+  iterator end() const noexcept { return {}; }
+
+  /**
+   * Find a member by name. Goes through the headers in order,
+   * or looks it up when the index has been built.
+   * Returns an invalid entry when there is no such member.
+   **/
+  Entry_view find(std::string_view name) const;
+
+  /** Hash the names of all members, so find() takes constant time */
+  void build_index();
+
+  bool has_index() const noexcept { return indexed_; }
+
+private:
+  std::string_view data_;
+  // name -> offset of its header
+  std::unordered_map<std::string_view, size_t> index_;
+  bool indexed_ = false;
+};
+
+// ------------------------------- Stream -------------------------------
+
+/**
+ * A tar reader for archives that arrive in pieces, like blocks from a
+ * device or the output of a decompressor. Only one header is kept, so
+ * memory use doesn't depend on the size of the archive.
+ **/
+class Stream {
+public:
+  /** A new member begins */
+  using on_entry_func = delegate<void(const Header_view&)>;
+  /** The next piece of content of the current member */
+  using on_data_func  = delegate<void(const Header_view&, std::string_view)>;
+
+  Stream(on_entry_func on_entry, on_data_func on_data = nullptr)
+    : on_entry_{std::move(on_entry)}, on_data_{std::move(on_data)} {}
+
+  /**
+   * Feed the next bytes of the archive, in pieces of any size.
+   * Returns false once the end of the archive has been seen.
+   * Throws Tar_exception on a corrupt header.
+   **/
+  bool feed(std::string_view data);
+
+  /** Reading from a device is over, error is set if it failed */
+  using on_done_func  = delegate<void(bool error)>;
+
+  /**
+   * Read the archive stored from block first of dev, chunk blocks at a time,
+   * with the asynchronous read of the driver. done is called once the end
+   * of the archive or the device is reached, or a read fails or a header is
+   * corrupt. The stream and the device must live until then.
+   **/
+  void feed(hw::Block_device& dev, on_done_func done,
+            hw::Block_device::block_t first = 0, size_t chunk = 64);
+
+  /** Read a .tar.gz in memory, decompressing a window at a time */
+  void feed_gz(std::string_view gz);
+
+  bool done() const noexcept { return state_ == DONE; }
+
+private:
+  enum State : uint8_t { HEADER, DATA, PADDING, DONE };
+  enum Result : uint8_t { READING, FINISHED, FAILED };
+
+  void read_blocks();
+  void blocks_read(hw::Block_device::buffer_t buffer);
+  void finish();
+
+  on_entry_func on_entry_;
+  on_data_func  on_data_;
+  Tar_header    header_;
+  size_t        have_ = 0;      // bytes of header_ filled in
+  uint64_t      remaining_ = 0; // content or padding left
+  uint64_t      padding_ = 0;
+  State         state_ = HEADER;
+  // reading from a device
+  hw::Block_device* dev_ = nullptr;
+  hw::Block_device::block_t next_ = 0;
+  size_t        chunk_ = 0;
+  on_done_func  on_done_ = nullptr;
+  Result        result_ = READING;
+  bool          reading_ = false; // inside dev_->read()
+  bool          again_ = false;   // the read completed before it returned
+};
+
+// ------------------------------- Gunzip -------------------------------
+
+/**
+ * Decompresses gzip data in memory a piece at a time. Only the 32 KB
+ * window of DEFLATE is kept, not the whole output.
+ **/
+class Gunzip {
+public:
+  static constexpr size_t window = 32768;
+
+  /** Throws Tar_exception when gz has no valid gzip header */
+  explicit Gunzip(std::string_view gz);
+
+  /**
+   * Decompress up to len bytes into out.
+   * Returns the number of bytes written, 0 at the end of the data.
+   * Throws Tar_exception on corrupt data.
+   **/
+  size_t read(uint8_t* out, size_t len);
+
+  bool done() const noexcept { return done_; }
+
+private:
+  std::unique_ptr<uint8_t[]> dict_;
+  TINF_DATA d_;
+  bool done_ = false;
+};
+
+} // namespace tar
+
+#endif
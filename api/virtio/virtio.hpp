@@ -350,6 +350,10 @@ public:
 
   void move_to_this_cpu();
 
+  /** Deliver the MSI-X vector of queue index to irq on this CPU,
+      for devices with a queue per CPU */
+  void move_queue_to_this_cpu(uint16_t index, uint8_t irq);
+
   /** Virtio device constructor.
 
       Should conform to Virtio std. §3.1.1, steps 1-6
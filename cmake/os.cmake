@@ -170,11 +170,18 @@ function(os_add_executable TARGET NAME)
     set(LIBGCC libclang_rt.builtins-${ARCH}.a)
   endif()
 
+  # libos uses zlib for websocket compression
+  find_library(ZLIB_LIBRARY NAMES libz.a)
+  if (NOT ZLIB_LIBRARY)
+    message(FATAL_ERROR "zlib (libz.a) not found")
+  endif()
+
   set(LIBRARIES
     ${INCLUDEOS_PACKAGE}/lib/libos.a
     ${INCLUDEOS_PACKAGE}/platform/${LIBPLATFORM}
     ${INCLUDEOS_PACKAGE}/lib/libarch.a
     ${INCLUDEOS_PACKAGE}/lib/libos.a
+    ${ZLIB_LIBRARY}
     ${INCLUDEOS_PACKAGE}/libcxx/lib/libc++.a
     ${INCLUDEOS_PACKAGE}/libc/lib/libc.a
     ${INCLUDEOS_PACKAGE}/lib/libmusl_syscalls.a
@@ -359,6 +366,22 @@ function(os_diskbuilder TARGET FOLD)
   os_build_memdisk(${TARGET} ${FOLD})
 endfunction()
 
+# build a packed asset image (fs::Asset_pack) from folder and use it as memdisk
+# extra arguments go to assetpack.py, e.g. --gzip --brotli
+function(os_add_asset_pack TARGET FOLD)
+  get_filename_component(REL_PATH "${FOLD}" REALPATH BASE_DIR "${CMAKE_CURRENT_SOURCE_DIR}")
+  file(GLOB_RECURSE PACK_FILES ${REL_PATH}/*)
+  add_custom_command(
+      OUTPUT  memdisk.pack
+      COMMAND ${PYTHON3_EXECUTABLE} ${INCLUDEOS_PACKAGE}/tools/memdisk/assetpack.py -o memdisk.pack ${ARGN} ${REL_PATH}
+      COMMENT "Creating asset pack"
+      DEPENDS ${PACK_FILES}
+  )
+  add_custom_target(${TARGET}_assetpack DEPENDS memdisk.pack)
+  os_add_dependencies(${TARGET} ${TARGET}_assetpack)
+  os_add_memdisk(${TARGET} "${CMAKE_CURRENT_BINARY_DIR}/memdisk.pack")
+endfunction()
+
 # Add both standard certificate bundle and any specific certs provided as parameters
 function(os_add_ssl_certificates TARGET)
   set(CERTS_DIR ${CMAKE_CURRENT_BINARY_DIR}/certs)
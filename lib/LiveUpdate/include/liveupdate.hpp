@@ -36,6 +36,15 @@ struct Storage;
 struct Restore;
 typedef std::vector<char> buffer_t;
 
+// Memory kept in place across an update, see LiveUpdate::reserve_region
+struct Region
+{
+  void*     data   = nullptr;
+  size_t    length = 0;
+  // how far the region moved, for pointers not in its fixup table
+  ptrdiff_t moved  = 0;
+};
+
 /**
  * The beginning and the end of the LiveUpdate process is the exec() and resume() functions.
  * exec() is called with a provided fixed memory location for where to store all serialized data,
@@ -94,6 +103,19 @@ struct LiveUpdate
   // Never returns zero
   static size_t stored_data_length(const void* storage_area = nullptr);
 
+  // Reserve memory that is kept in place across updates, for large state
+  // like a cache arena. Regions are taken from the top of the storage area,
+  // and are never copied: store them with Storage::add_region, and the new
+  // kernel gets them back where they were with Restore::as_region.
+  // Regions stored before an update stay reserved in the new kernel.
+  // When @storage_area is nullptr (default) the area is retrieved from OS,
+  // otherwise @area_size is the size of the area.
+  // Throws std::bad_alloc when there is no room left in the storage area
+  static void* reserve_region(size_t size, void* storage_area = nullptr,
+                              size_t area_size = 0);
+  // Returns the number of bytes reserved for regions in the storage area
+  static size_t reserved_bytes(const void* storage_area = nullptr) noexcept;
+
   // Set location of known good blob to rollback to if something happens
   static void set_rollback_blob(const void*, size_t) noexcept;
   // Returns true if a backup rollback blob has been set
@@ -150,6 +172,11 @@ struct Storage
   // store a Stream, but not its underlying transport
   // NOTE: UID is taken and used to determine its underlying type
   void add_stream(net::Stream&);
+  // store a region from LiveUpdate::reserve_region in place, without copying
+  // its contents. @pointers are the offsets of pointers in the region that
+  // point into the region, and are adjusted if the region is mapped elsewhere
+  void add_region(uid, const void* region, size_t length,
+                  const std::vector<size_t>& pointers = {});
 
   // markers are used to delineate the end of variable-length structures
   void put_marker(uid);
@@ -184,6 +211,7 @@ struct Restore
   bool  is_vector() const noexcept; // not for string-vector
   bool  is_string_vector() const noexcept; // for string-vector
   bool  is_stream() const noexcept;
+  bool  is_region() const noexcept;
 
   int             as_int()    const;
   std::string     as_string() const;
@@ -194,6 +222,8 @@ struct Restore
   // 2. select whether or not its an outgoing or incoming connection
   // 3. provide the underlying transport stream, for example a TCP stream
   net::Stream_ptr as_tls_stream(void* ctx, bool outgoing, net::Stream_ptr tr);
+  // the region where it is now, with the pointers in its table fixed up
+  Region          as_region() const;
 
   template <typename S>
   inline const S& as_type() const;
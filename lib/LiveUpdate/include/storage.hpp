@@ -21,6 +21,7 @@
 #pragma once
 #include <cstdint>
 #include <array>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <delegate>
@@ -35,6 +36,7 @@ enum storage_type
   TYPE_BUFFER  = 11,
   TYPE_VECTOR  = 12,
   TYPE_STR_VECTOR = 13,
+  TYPE_REGION  = 14,
 
   TYPE_TCP    = 100,
   TYPE_TCP6   = 101,
@@ -60,6 +62,18 @@ struct varseg_entry
   char   vla[0];
 };
 
+struct region_entry
+{
+  // relative to the storage entry, so the whole area can move
+  int64_t    offset; // the region
+  int64_t    area;   // the storage header
+  int64_t    end;    // the end of the storage area
+  uint64_t   length;
+  uint64_t   base;   // address of the region when stored
+  uint64_t   count;
+  uint64_t   vla[0]; // offsets of pointers into the region
+};
+
 struct storage_entry
 {
   storage_entry(int16_t type, uint16_t id, int length);
@@ -125,9 +139,12 @@ struct storage_header
   void add_string(uint16_t id, const std::string& data);
   void add_buffer(uint16_t id, const char*, int);
   storage_entry& add_struct(int16_t type, uint16_t id, int length);
-  storage_entry& add_struct(int16_t type, uint16_t id, construct_func);
+  // @max_length bounds what the function writes
+  storage_entry& add_struct(int16_t type, uint16_t id, int max_length, construct_func);
   void add_vector(uint16_t, const void*, size_t cnt, size_t esize);
   void add_string_vector(uint16_t id, const std::vector<std::string>& vec);
+  void add_region(uint16_t id, const void* region, size_t length,
+                  const size_t* pointers, size_t count);
   void add_end();
 
   storage_entry* begin(int p);
@@ -137,7 +154,10 @@ struct storage_header
   storage_entry& create_entry(Args&&... args);
 
   inline storage_entry&
-  var_entry(int16_t type, uint16_t id, construct_func func);
+  var_entry(int16_t type, uint16_t id, int max_length, construct_func func);
+
+  // bytes left for one more entry, before any reserved regions
+  inline size_t room() const noexcept;
 
   void append_eof() noexcept {
     ((storage_entry*) &vla[length])->type = TYPE_END;
@@ -146,6 +166,8 @@ struct storage_header
   bool validate() const noexcept;
   // zero out everything if all partitions consumed
   void try_zero() noexcept;
+  // the lowest region stored in a partition not yet resumed, or nullptr
+  const char* lowest_region() const noexcept;
 
 private:
   uint32_t generate_checksum() const noexcept;
@@ -161,13 +183,29 @@ private:
   char     vla[0];
 };
 
+// the bottom of the regions reserved in a storage area, or nullptr
+const char* region_floor(const void* area) noexcept;
+
+inline size_t storage_header::room() const noexcept
+{
+  const char* floor = region_floor(this);
+  if (floor == nullptr) return SIZE_MAX;
+  // the next entry is always followed by an end entry
+  const char* next = &vla[length] + sizeof(storage_entry);
+  return (next < floor) ? floor - next : 0;
+}
+
 template <typename... Args>
 inline storage_entry&
 storage_header::create_entry(Args&&... args)
 {
+  // nothing may be written into the reserved regions
+  const storage_entry header(args...);
+  if ((size_t) header.size() > room())
+    throw std::runtime_error("LiveUpdate storage would overlap reserved regions");
   // create entry
   auto* entry = (storage_entry*) &vla[length];
-  new (entry) storage_entry(args...);
+  new (entry) storage_entry(header);
   // next storage_entry will be this much further out:
   this->length += entry->size();
   this->entries++;
@@ -177,13 +215,17 @@ storage_header::create_entry(Args&&... args)
 }
 
 inline storage_entry&
-storage_header::var_entry(int16_t type, uint16_t id, construct_func func)
+storage_header::var_entry(int16_t type, uint16_t id, int max_length, construct_func func)
 {
+  if (sizeof(storage_entry) + max_length > room())
+    throw std::runtime_error("LiveUpdate storage would overlap reserved regions");
   // create entry
   auto* entry = (storage_entry*) &vla[length];
   new (entry) storage_entry(type, id, 0);
   // determine and set size of entry
   entry->len = func(entry->vla);
+  if (entry->len > max_length)
+    throw std::runtime_error("LiveUpdate entry larger than its maximum length");
   // next storage_entry will be this much further out:
   this->length += entry->size();
   this->entries++;
@@ -0,0 +1,145 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "liveupdate.hpp"
+#include "storage.hpp"
+#include <kernel.hpp>
+#include <cstring>
+#include <stdexcept>
+
+// regions are page aligned
+static const uintptr_t REGION_ALIGN = 4096;
+// room left for the stored data at the bottom of the area
+static const size_t    STORAGE_ROOM = 1024 * 1024;
+
+// the regions of one storage area grow down from its end
+static struct {
+  const char* area  = nullptr;
+  const char* end   = nullptr;
+  const char* floor = nullptr;
+} arena;
+// the lowest region restored so far, kept from reservations made later
+static const char* adopted = nullptr;
+
+static void arena_init(void* area, size_t size)
+{
+  arena.area  = (const char*) area;
+  arena.end   = (const char*) (((uintptr_t) area + size) & ~(REGION_ALIGN-1));
+  arena.floor = arena.end;
+  // keep the regions stored before an update
+  auto* storage = (const storage_header*) area;
+  if (storage->validate()) {
+    const char* lowest = storage->lowest_region();
+    if (lowest && lowest >= arena.area && lowest < arena.floor) arena.floor = lowest;
+  }
+  if (adopted && adopted >= arena.area && adopted < arena.floor) arena.floor = adopted;
+}
+
+const char* region_floor(const void* area) noexcept
+{
+  return (area == arena.area) ? arena.floor : nullptr;
+}
+static bool is_reserved_region(const void* area, const void* region, size_t length) noexcept
+{
+  const char* begin = (const char*) region;
+  return area == arena.area && begin >= arena.floor
+      && length <= (size_t) (arena.end - begin);
+}
+
+void storage_header::add_region(uint16_t id, const void* region, size_t length,
+                                const size_t* pointers, size_t count)
+{
+  if (!is_reserved_region(this, region, length))
+      throw std::runtime_error("LiveUpdate: region was not reserved in this storage area");
+  for (size_t i = 0; i < count; i++)
+    if (pointers[i] + sizeof(uintptr_t) > length)
+        throw std::out_of_range("LiveUpdate: region pointer offset outside region");
+
+  auto& entry = create_entry(TYPE_REGION, id, sizeof(region_entry) + count * sizeof(uint64_t));
+  auto& reg = *(region_entry*) entry.vla;
+  const char* base = (const char*) &entry;
+  reg.offset = (const char*) region - base;
+  reg.area   = (const char*) this - base;
+  reg.end    = arena.end - base;
+  reg.length = length;
+  reg.base   = (uintptr_t) region;
+  reg.count  = count;
+  for (size_t i = 0; i < count; i++)
+    reg.vla[i] = pointers[i];
+}
+
+namespace liu
+{
+void* LiveUpdate::reserve_region(size_t size, void* area, size_t area_size)
+{
+  if (area == nullptr) {
+    area      = kernel::liveupdate_storage_area();
+    area_size = kernel::state().liveupdate_size;
+  }
+  if (area != arena.area) arena_init(area, area_size);
+
+  size = (size + REGION_ALIGN-1) & ~(REGION_ALIGN-1);
+  const char* lowest = arena.area + sizeof(storage_header) + STORAGE_ROOM;
+  if (arena.floor < lowest || size > (size_t) (arena.floor - lowest))
+      throw std::bad_alloc();
+  arena.floor -= size;
+  return (void*) arena.floor;
+}
+size_t LiveUpdate::reserved_bytes(const void* area) noexcept
+{
+  if (area == nullptr) area = kernel::liveupdate_storage_area();
+  return (area == arena.area) ? arena.end - arena.floor : 0;
+}
+
+void Storage::add_region(uid id, const void* region, size_t length,
+                         const std::vector<size_t>& pointers)
+{
+  hdr.add_region(id, region, length, pointers.data(), pointers.size());
+}
+
+bool Restore::is_region() const noexcept
+{
+  return get_type() == TYPE_REGION;
+}
+Region Restore::as_region() const
+{
+  if (ent->type != TYPE_REGION)
+      throw std::runtime_error("LiveUpdate: Restore::as_region() encountered incorrect type " + std::to_string(ent->type));
+  auto& reg = *(region_entry*) ent->vla;
+  char* data = (char*) ent + reg.offset;
+  const ptrdiff_t moved = (uintptr_t) data - reg.base;
+  if (moved != 0)
+  {
+    for (uint64_t i = 0; i < reg.count; i++)
+    {
+      uintptr_t ptr;
+      std::memcpy(&ptr, data + reg.vla[i], sizeof(ptr));
+      // null pointers stay null
+      if (ptr == 0) continue;
+      ptr += moved;
+      std::memcpy(data + reg.vla[i], &ptr, sizeof(ptr));
+    }
+    // the pointers must not be moved twice
+    reg.base = (uintptr_t) data;
+  }
+  // the region now belongs to this kernel, and can be stored again
+  char* area = (char*) ent + reg.area;
+  if (area != arena.area) arena_init(area, reg.end - reg.area);
+  if (adopted == nullptr || data < adopted) adopted = data;
+  if (data >= arena.area && data < arena.floor) arena.floor = data;
+  return {data, (size_t) reg.length, moved};
+}
+
+} // liu
@@ -284,6 +284,15 @@ int Connection::serialize_to(void* addr) const
   return sizeof(serialized_tcp) + writeq_len + readq_len;
 }
 
+int Connection::serialized_size() const
+{
+  int writeq_len = sizeof(serialized_writeq)
+                 + writeq.size() * sizeof(write_buffer) + writeq.bytes_total();
+  int readq_len  = sizeof(read_buffer)
+                 + ((read_request) ? read_request->front().size() : 0);
+  return sizeof(serialized_tcp) + writeq_len + readq_len;
+}
+
 void serialized_tcp::wakeup_ip_networks()
 {
   // start all the send queues for the slumbering IP stacks
@@ -297,7 +306,7 @@ namespace liu
 {
   void Storage::add_connection(uid id, Connection_ptr conn)
   {
-    hdr.add_struct(TYPE_TCP, id,
+    hdr.add_struct(TYPE_TCP, id, conn->serialized_size(),
     [&conn] (char* location) -> int {
       // return size of all the serialized data
       return conn->serialize_to(location);
@@ -73,9 +73,10 @@ storage_entry& storage_header::add_struct(int16_t type, uint16_t id, int length)
 {
   return create_entry(type, id, length);
 }
-storage_entry& storage_header::add_struct(int16_t type, uint16_t id, construct_func func)
+storage_entry& storage_header::add_struct(int16_t type, uint16_t id, int max_length,
+                                          construct_func func)
 {
-  return var_entry(type, id, func);
+  return var_entry(type, id, max_length, func);
 }
 void storage_header::add_vector(uint16_t id, const void* buf, size_t cnt, size_t esize)
 {
@@ -88,7 +89,10 @@ void storage_header::add_vector(uint16_t id, const void* buf, size_t cnt, size_t
 }
 void storage_header::add_string_vector(uint16_t id, const std::vector<std::string>& vec)
 {
-  var_entry(TYPE_STR_VECTOR, id,
+  int max_length = sizeof(varseg_begin);
+  for (auto& str : vec) max_length += sizeof(varseg_entry) + str.size();
+
+  var_entry(TYPE_STR_VECTOR, id, max_length,
   [&vec] (char* dest) -> int
   {
     int total_len = sizeof(varseg_begin);
@@ -185,6 +189,25 @@ void storage_header::zero()
   this->magic = 0;
 }
 
+const char* storage_header::lowest_region() const noexcept
+{
+  const char* lowest = nullptr;
+  for (uint32_t p = 0; p < partitions; p++)
+  {
+    auto& part = ptable.at(p);
+    if (part.length == 0) continue;
+    auto* ent = (const storage_entry*) &vla[part.offset];
+    for (; ent->type != TYPE_END; ent = ent->next())
+    {
+      if (ent->type != TYPE_REGION) continue;
+      auto& reg = *(const region_entry*) ent->vla;
+      const char* region = (const char*) ent + reg.offset;
+      if (lowest == nullptr || region < lowest) lowest = region;
+    }
+  }
+  return lowest;
+}
+
 storage_entry* storage_header::begin(int p)
 {
   return (storage_entry*) &vla[ptable.at(p).offset];
@@ -20,7 +20,9 @@
 **/
 #include "liveupdate.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cstdint>
 #include <stdexcept>
 #include <string>
@@ -366,10 +368,13 @@ void Storage::add_stream(net::Stream& stream)
   // calling the wrong deserialization function on the stream
   const uint16_t subid = stream_ptr->serialization_subid();
   assert(subid != 0 && "Stream should not return 0 for subid");
-  // serialize the stream
-  hdr.add_struct(TYPE_STREAM, subid,
-  [stream_ptr] (char* location) -> int {
+  // serialize the stream into whatever room is left
+  const size_t left = hdr.room();
+  const int room = std::min<size_t>(left > sizeof(storage_entry) ? left - sizeof(storage_entry) : 0,
+                                    INT32_MAX);
+  hdr.add_struct(TYPE_STREAM, subid, room,
+  [stream_ptr, room] (char* location) -> int {
     // returns size of all the serialized data
-    return stream_ptr->serialize_to(location, 0xFFFFFFFF);
+    return stream_ptr->serialize_to(location, room);
   });
 }
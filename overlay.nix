@@ -62,6 +62,7 @@ final: prev: {
 
     # Deps
     uzlib = self.callPackage ./deps/uzlib/default.nix { };
+    zlib = prev.pkgsStatic.zlib;
     botan2 = self.callPackage ./deps/botan/default.nix { };
     s2n-tls = self.callPackage ./deps/s2n/default.nix { };
     http-parser = self.callPackage ./deps/http-parser/default.nix { };
@@ -130,11 +131,17 @@ final: prev: {
         self.http-parser
         prev.pkgsStatic.openssl
         prev.pkgsStatic.rapidjson
+        self.zlib
         #self.s2n-tls          👈 This is postponed until we can fix the s2n build.
         self.uzlib
         self.vmbuild
       ];
 
+      # libos uses zlib (websocket compression), services link it too
+      propagatedBuildInputs = [
+        self.zlib
+      ];
+
       postInstall = ''
         echo Copying vmbuild binaries to tools/vmbuild
         mkdir -p "$out/tools/vmbuild"
@@ -172,6 +179,7 @@ final: prev: {
 
       passthru = {
         inherit (self) uzlib;
+        inherit (self) zlib;
         inherit (self) http-parser;
         inherit (self) botan2;
         #inherit (self) s2n-tls;
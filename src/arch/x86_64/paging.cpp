@@ -18,6 +18,7 @@
 #include <arch/x86/paging.hpp>
 #include <arch/x86/paging_utils.hpp>
 #include <kernel/cpuid.hpp>
+#include <smp>
 #include <kprint>
 
 // #define DEBUG_X86_PAGING
@@ -220,6 +221,11 @@ uintptr_t mem::max_psize()
   return bits::keeplast(supported_page_sizes());
 }
 
+size_t mem::huge_psize()
+{
+  return bits::keepfirst(supported_page_sizes() & ~min_psize());
+}
+
 bool mem::supported_page_size(uintptr_t size)
 {
   return bits::is_pow2(size) and (size & supported_page_sizes()) != 0;
@@ -368,6 +374,19 @@ Map mem::unmap(uintptr_t lin){
   return to_mmap(m);
 }
 
+int mem::map_huge(uintptr_t addr, size_t size)
+{
+  using namespace x86::paging;
+  const auto psizes = supported_page_sizes() & ~min_psize();
+  Map_x86 req {addr, addr, Flags::present | Flags::writable | Flags::no_exec, size, psizes};
+
+  // Once the APs are running they might still cache the replaced tables
+  const bool free_dirs = SMP::cpu_count() <= 1;
+  const int count = __pml4->collapse_r(req, free_dirs);
+  MEM_PRINT("::map_huge 0x%lx size %zu replaced %d tables\n", addr, size, count);
+  return count;
+}
+
 uintptr_t mem::active_page_size(uintptr_t addr){
   return __pml4->active_page_size(addr);
 }
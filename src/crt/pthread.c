@@ -16,21 +16,20 @@
 // limitations under the License.
 
 #include <stdio.h>
-#define UNLOCKED 0
-#define LOCKED   1
+#define UNLOCKED  0
+#define LOCKED    1
+#define CONTENDED 2
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
 
 extern void panic(const char* why);
+extern int syscall_SYS_futex(volatile int* uaddr, int op, int val,
+                             const void* timeout, int* uaddr2, int val3);
 typedef int spinlock_t;
 
-void yield()
+static int compare_and_swap(volatile spinlock_t* addr, int expected, int newval)
 {
-  printf("yield() called, but not implemented yet!");
-}
-
-static int compare_and_swap(volatile spinlock_t* addr)
-{
-  const int expected = UNLOCKED;
-  const int newval   = LOCKED;
   return __sync_val_compare_and_swap(addr, expected, newval);
 }
 
@@ -48,13 +47,23 @@ int pthread_mutex_destroy(volatile spinlock_t* lock)
 
 int pthread_mutex_lock(volatile spinlock_t* lock)
 {
-  while (!compare_and_swap(lock))
-      yield();
+  int state = compare_and_swap(lock, UNLOCKED, LOCKED);
+  if (state == UNLOCKED) return 0;
+  // mark the lock as contended, and sleep until the owner wakes us
+  if (state != CONTENDED)
+      state = __sync_lock_test_and_set(lock, CONTENDED);
+  while (state != UNLOCKED) {
+      syscall_SYS_futex(lock, FUTEX_WAIT, CONTENDED, NULL, NULL, 0);
+      state = __sync_lock_test_and_set(lock, CONTENDED);
+  }
   return 0;
 }
 
 int pthread_mutex_unlock(volatile spinlock_t* lock)
 {
-  *lock = UNLOCKED;
+  if (__sync_fetch_and_sub(lock, 1) != LOCKED) {
+      *lock = UNLOCKED;
+      syscall_SYS_futex(lock, FUTEX_WAKE, 1, NULL, NULL, 0);
+  }
   return 0;
 }
@@ -3,6 +3,8 @@
 #include <kernel/events.hpp>
 #include <fs/common.hpp>
 #include <hw/pci.hpp>
+#include <smp>
+#include <algorithm>
 #include <cassert>
 #include <stdlib.h>
 #include <info>
@@ -16,6 +18,7 @@
 #define VIRTIO_BLK_F_BLK_SIZE  6
 #define VIRTIO_BLK_F_SCSI      7
 #define VIRTIO_BLK_F_FLUSH     9
+#define VIRTIO_BLK_F_MQ       12
 
 #define VIRTIO_BLK_T_IN         0
 #define VIRTIO_BLK_T_OUT        1
@@ -29,13 +32,25 @@
 
 #define FEAT(x)  (1 << x)
 
-// a deleter that does nothing
-void null_deleter(uint8_t*) {};
+// data per request when the device sets no limit
+static const uint32_t DEFAULT_MAX_REQUEST = 1024 * 1024;
 
 #include <statman>
 
+VirtioBlk::queue_t::queue_t(const std::string& name, int size, int index, uint32_t iobase)
+  : vq(name, size, index, iobase)
+{
+  // every request takes at least 3 tokens
+  const size_t pool_size = size / 3;
+  pool.reset(new request_t[pool_size]);
+  free_reqs.reserve(pool_size);
+  for (size_t i = 0; i < pool_size; i++)
+    free_reqs.push_back(&pool[i]);
+  tokens.reserve(size);
+}
+
 VirtioBlk::VirtioBlk(hw::PCI_Device& d)
-  : Virtio(d), hw::Block_device(), req(device_name() + ".req0", queue_size(0), 0, iobase()), inflight(0)
+  : Virtio(d), hw::Writable_Block_device()
 {
   INFO("VirtioBlk", "Initializing");
   {
@@ -52,7 +67,13 @@ VirtioBlk::VirtioBlk(hw::PCI_Device& d)
 
   uint32_t needed_features =
     FEAT(VIRTIO_BLK_F_BLK_SIZE);
-  negotiate_features(needed_features);
+  uint32_t wanted_features = needed_features
+    | FEAT(VIRTIO_BLK_F_SIZE_MAX)
+    | FEAT(VIRTIO_BLK_F_SEG_MAX)
+    | FEAT(VIRTIO_BLK_F_RO)
+    | FEAT(VIRTIO_BLK_F_FLUSH)
+    | FEAT(VIRTIO_BLK_F_MQ);
+  negotiate_features(wanted_features);
 
   CHECK(features() & FEAT(VIRTIO_BLK_F_BARRIER),
         "Barrier is enabled");
@@ -70,23 +91,55 @@ VirtioBlk::VirtioBlk(hw::PCI_Device& d)
         "SCSI is enabled :(");
   CHECK(features() & FEAT(VIRTIO_BLK_F_FLUSH),
         "Flush enabled");
+  CHECK(features() & FEAT(VIRTIO_BLK_F_MQ),
+        "Multiple queues");
 
   CHECK ((features() & needed_features) == needed_features,
          "Negotiated needed features");
 
-  // Step 1 - Initialize REQ queue
-  auto success = assign_queue(0, req.queue_desc());
-  CHECK(success, "Request queue assigned (%p) to device",
-        req.queue_desc());
-
-  // Step 3 - Fill receive queue with buffers
-  // DEBUG: Disable
-  INFO("VirtioBlk", "Queue size: %i\tRequest size: %zu\n",
-       req.size(), sizeof(request_t));
+  read_only_ = features() & FEAT(VIRTIO_BLK_F_RO);
+  // without a write cache, completed writes are already durable
+  has_flush_ = features() & FEAT(VIRTIO_BLK_F_FLUSH);
 
   // Get device configuration
   get_config();
 
+  // One queue per CPU, when each CPU can have its own queue and vector
+  size_t num_queues = 1;
+  const size_t cpus = SMP::cpu_count();
+  if ((features() & FEAT(VIRTIO_BLK_F_MQ)) && cpus > 1
+      && config.num_queues >= cpus
+      && has_msix() && get_msix_vectors() >= cpus)
+  {
+    num_queues = cpus;
+  }
+
+  // Step 1 - Initialize request queues
+  for (size_t i = 0; i < num_queues; i++)
+  {
+    queues.push_back(std::make_unique<queue_t>(
+        device_name() + ".req" + std::to_string(i), queue_size(i), i, iobase()));
+    auto success = assign_queue(i, queues.back()->vq.queue_desc());
+    CHECK(success, "Request queue %zu assigned (%p) to device",
+          i, queues.back()->vq.queue_desc());
+  }
+  auto& req = queues.front()->vq;
+
+  // Requests go straight to and from the caller buffer, split in segments
+  // of at most SIZE_MAX, and at most SEG_MAX segments per request
+  seg_size_ = DEFAULT_MAX_REQUEST;
+  if ((features() & FEAT(VIRTIO_BLK_F_SIZE_MAX)) && config.size_max >= SECTOR_SIZE)
+    seg_size_ = std::min<uint32_t>(seg_size_, config.size_max & ~(SECTOR_SIZE-1));
+  uint32_t max_segs = req.size() - 2;
+  if ((features() & FEAT(VIRTIO_BLK_F_SEG_MAX)) && config.seg_max > 0)
+    max_segs = std::min(max_segs, config.seg_max);
+  max_request_ = std::max<uint32_t>(SECTOR_SIZE,
+      std::min<uint64_t>(DEFAULT_MAX_REQUEST, (uint64_t) seg_size_ * max_segs));
+
+  INFO("VirtioBlk", "%zu queue(s) of size %i, max %u bytes per request%s%s",
+       num_queues, req.size(), max_request_,
+       has_flush_ ? ", write cache" : "", read_only_ ? ", read-only" : "");
+
   // Signal setup complete.
   setup_complete((features() & needed_features) == needed_features);
   CHECK((features() & needed_features) == needed_features, "Signalled driver OK");
@@ -98,13 +151,16 @@ VirtioBlk::VirtioBlk(hw::PCI_Device& d)
     auto& irqs = this->get_irqs();
     // update IRQ subscriptions
     Events::get().subscribe(irqs[0], {this, &VirtioBlk::service_RX});
-    Events::get().subscribe(irqs[1], {this, &VirtioBlk::msix_conf_handler});
+    // the other queues move to their CPU on first use
+    if (num_queues == 1)
+      Events::get().subscribe(irqs[1], {this, &VirtioBlk::msix_conf_handler});
   }
   else
   {
     auto& irqs = this->get_irqs();
     Events::get().subscribe(irqs[0], {this, &VirtioBlk::irq_handler});
   }
+  queues.front()->irq_ready = true;
 
   // Done
   INFO("VirtioBlk", "Block device with %zu sectors capacity", config.capacity);
@@ -112,7 +168,8 @@ VirtioBlk::VirtioBlk(hw::PCI_Device& d)
 
 void VirtioBlk::get_config()
 {
-  Virtio::get_config(&config, sizeof(virtio_blk_config_t));
+  Virtio::get_config(&config,
+      offsetof(virtio_blk_config_t, num_queues) + sizeof(config.num_queues));
 }
 
 void VirtioBlk::msix_conf_handler()
@@ -139,152 +196,291 @@ void VirtioBlk::irq_handler() {
   // Step 2. B)
   if (isr & 2) {
     debug("\t <VirtioBlk> Configuration change:\n");
-
-    // Getting the MAC + status
-    //debug("\t             Old status: 0x%x\n", config.status);
     get_config();
-    //debug("\t             New status: 0x%x \n", config.status);
   }
 }
 
-void VirtioBlk::handle(request_t* hdr)
+VirtioBlk::queue_t& VirtioBlk::local_queue()
 {
-  // check request response
-  blk_resp_t& resp = hdr->resp;
-  // only call handler with data when the request was fullfilled
-  //printf("response: status %u blk %llu  func %p  buff %p\n",
-  //      resp.status, hdr->hdr.sector, resp.handler.get_ptr(), hdr->io.sector);
-
-  if (resp.status == 0) {
-    // packaged as buffer, but deleted as request
-    resp.handler(hdr->io.sector);
+  if (queues.size() == 1) return *queues.front();
+  const int cpu = SMP::cpu_id();
+  auto& q = *queues.at(cpu);
+  if (UNLIKELY(!q.irq_ready)) {
+    // completions for this queue are handled here, on its own CPU
+    auto irq = Events::get().subscribe({this, &VirtioBlk::service_RX});
+    move_queue_to_this_cpu(cpu, irq);
+    q.irq_ready = true;
+  }
+  return q;
+}
+
+void VirtioBlk::finish(job_t* job)
+{
+  if (job->failed) (*this->errors)++;
+
+  if (job->batch != nullptr) {
+    auto* batch = job->batch;
+    auto& op = batch->ops[job->index];
+    op.error = job->failed;
+    if (op.op == Io_request::Op::READ && !job->failed)
+      op.buffer = std::move(job->buffer);
+    delete job;
+    if (--batch->pending == 0) {
+      batch->done(std::move(batch->ops));
+      delete batch;
+    }
+    return;
+  }
+  if (job->on_read) {
+    // callback with no data on failure
+    job->on_read(job->failed ? nullptr : std::move(job->buffer));
   }
   else {
-    // return empty shared ptr
-    resp.handler(nullptr);
+    job->on_write(job->failed);
   }
+  delete job;
+}
 
-  // delete request
-  delete hdr;
+void VirtioBlk::handle(queue_t& q, request_t* vbr)
+{
+  job_t* job = vbr->job;
+  if (vbr->status != VIRTIO_BLK_S_OK) job->failed = true;
+  // return the request before the callback, which may ship more
+  q.free_reqs.push_back(vbr);
+
+  if (--job->pending > 0) return;
+  if (job->fua && !job->failed && has_flush_) {
+    // the write is done, now make it durable
+    job->fua = false;
+    if (enqueue(q, job, VIRTIO_BLK_T_FLUSH, 0)) q.vq.kick();
+    return;
+  }
+  finish(job);
 }
 
 void VirtioBlk::service_RX()
 {
-  req.disable_interrupts();
-  while (req.new_incoming())
+  service_queue(local_queue());
+}
+
+void VirtioBlk::service_queue(queue_t& q)
+{
+  q.vq.disable_interrupts();
+  while (q.vq.new_incoming())
   {
-    auto tok = req.dequeue();
+    auto tok = q.vq.dequeue();
     if (!tok.size()) break;
 
     // only handle the main header of each request
     auto* hdr = (request_t*) tok.data();
-    received.emplace_back(hdr);
+    q.received.emplace_back(hdr);
   };
+  q.vq.enable_interrupts();
+
+  // callbacks may service the queue again, so take the list
+  std::vector<request_t*> received;
+  received.swap(q.received);
+  for (request_t* hdr : received) {
+    q.inflight--;
+    handle(q, hdr);
+  }
+  // keep the allocation
+  received.clear();
+  if (q.received.empty()) q.received.swap(received);
 
   // if we have free space and jobs, start shipping
   bool shipped = false;
-  while (free_space() && !jobs.empty()) {
-    shipit(jobs.front());
-    jobs.pop_front();
+  while (!q.jobs.empty() && free_space(q, q.jobs.front())) {
+    shipit(q, q.jobs.front());
+    q.jobs.pop_front();
     shipped = true;
   }
-  if (shipped) req.kick();
-  req.enable_interrupts();
+  if (shipped) q.vq.kick();
+}
 
-  // TODO: -Wunused-but-set-variable
-  // int handled = 0;
-  for (request_t* hdr : received) {
-    handle(hdr);
-    inflight--; //handled++;
+void VirtioBlk::shipit(queue_t& q, const range_t& range)
+{
+  request_t* vbr = q.free_reqs.back();
+  q.free_reqs.pop_back();
+  vbr->hdr.type   = range.type;
+  vbr->hdr.ioprio = 0; // reserved
+  vbr->hdr.sector = range.sector;
+  vbr->status = VIRTIO_BLK_S_IOERR;
+  vbr->job    = range.job;
+
+  // the device reads from, or writes straight into, the job buffer
+  const auto dir = (range.type == VIRTIO_BLK_T_OUT) ? Token::OUT : Token::IN;
+  auto& tokens = q.tokens;
+  tokens.clear();
+  tokens.emplace_back(Token::span{ (uint8_t*) &vbr->hdr, sizeof(scsi_header_t) }, Token::OUT);
+  for (uint32_t off = 0; off < range.len; off += seg_size_)
+  {
+    const uint32_t len = std::min(seg_size_, range.len - off);
+    tokens.emplace_back(Token::span{ range.data + off, len }, dir);
   }
-  received.clear();
+  tokens.emplace_back(Token::span{ &vbr->status, 1 }, Token::IN); // 1 status byte
 
-  //printf("inflight: %d  handled: %d  shipped: %d  num_free: %u\n",
-  //    inflight, handled, scnt, req.num_free());
+  q.vq.enqueue(tokens);
+  q.inflight++;
+  (*this->requests)++;
+}
+
+bool VirtioBlk::enqueue(queue_t& q, const range_t& range)
+{
+  // keep the order of waiting jobs
+  if (q.jobs.empty() && free_space(q, range)) {
+    shipit(q, range);
+    return true;
+  }
+  q.jobs.push_back(range);
+  return false;
 }
 
-void VirtioBlk::shipit(request_t* vbr) {
+bool VirtioBlk::enqueue(queue_t& q, job_t* job, uint32_t type, block_t blk)
+{
+  if (type == VIRTIO_BLK_T_FLUSH) {
+    job->pending = 1;
+    return enqueue(q, {job, type, 0, nullptr, 0});
+  }
+  // one request per contiguous range that fits in a request
+  const size_t total = job->buffer->size();
+  job->pending = (total + max_request_ - 1) / max_request_;
 
-  Token token1 { { (uint8_t*) &vbr->hdr, sizeof(scsi_header_t) }, Token::OUT };
-  Token token2 { { (uint8_t*) &vbr->io, sizeof(blk_io_t) }, Token::IN };
-  Token token3 { { (uint8_t*) &vbr->resp, 1 }, Token::IN }; // 1 status byte
+  bool shipped = false;
+  for (size_t off = 0; off < total; off += max_request_)
+  {
+    const range_t range {
+      job, type, blk + off / SECTOR_SIZE, job->buffer->data() + off,
+      (uint32_t) std::min<size_t>(max_request_, total - off)
+    };
+    shipped |= enqueue(q, range);
+  }
+  return shipped;
+}
 
-  //printf("shipping job: sect %llu  func %p  buff %p\n",
-  //      vbr->hdr.sector, vbr->resp.handler.get_ptr(), vbr->io.sector);
-  std::array<Token, 3> tokens {{ token1, token2, token3 }};
-  req.enqueue(tokens);
-  inflight++;
-  (*this->requests)++;
+bool VirtioBlk::start(job_t* job, uint32_t type)
+{
+  if (type == VIRTIO_BLK_T_OUT && (read_only_ || job->buffer == nullptr
+                               || job->buffer->size() % SECTOR_SIZE != 0)) {
+    job->failed = true;
+    finish(job);
+    return false;
+  }
+  // without a write cache there is nothing to flush
+  if ((type == VIRTIO_BLK_T_FLUSH && !has_flush_)
+   || (type != VIRTIO_BLK_T_FLUSH && job->buffer->empty())) {
+    finish(job);
+    return false;
+  }
+  return true;
+}
+
+void VirtioBlk::start(job_t* job, uint32_t type, block_t blk)
+{
+  if (!start(job, type)) return;
+  auto& q = local_queue();
+  // kick when we have enqueued stuff
+  if (enqueue(q, job, type, blk)) q.vq.kick();
 }
 
 void VirtioBlk::read (block_t blk, size_t cnt, on_read_func func)
 {
-  // create big buffer for collecting all the disk data
-  auto bigbuf = fs::construct_buffer(block_size() * cnt);
-  // number of reads left
-  auto results = std::make_shared<size_t> (cnt);
-  bool shipped = false;
-  //printf("virtioblk: Enqueue blk %llu cnt %u\n", blk, cnt);
+  auto* job = new job_t;
+  job->buffer  = fs::construct_buffer(block_size() * cnt);
+  job->on_read = std::move(func);
+  start(job, VIRTIO_BLK_T_IN, blk);
+}
 
-  //for (int i = cnt-1; i >= 0; i--)
-  for (size_t i = 0; i < cnt; i++)
-  {
-    // create a special request where we collect all the data
-    auto* vbr = new request_t(
-      blk + i,
-      request_handler_t::make_packed(
-      [this, i, func, results, bigbuf] (uint8_t* data) {
-        // if the job was already completed, return early
-        if (*results == 0) {
-          printf("[virtioblk] Job cancelled? results == 0,  blk=%zu\n", i);
-          return;
-        }
-        // validate partial result
-        if (data != nullptr) {
-          *results -= 1;
-          // copy partial block
-          memcpy(bigbuf->data() + i * block_size(), data, block_size());
-          // check if we have all blocks
-          if (*results == 0) {
-            // finally, call user-provided callback
-            func(bigbuf);
-          }
-        }
-        else {
-          (*this->errors)++;
-          // if the partial result failed, cancel all
-          *results = 0;
-          // callback with no data
-          func(nullptr);
-        }
-      })
-    );
-    //printf("virtioblk: Enqueue blk %llu\n", blk + i);
-    //
-    if (free_space()) {
-      shipit(vbr);
-      shipped = true;
-    }
-    else
-      jobs.push_back(vbr);
+void VirtioBlk::write(block_t blk, buffer_t buffer, on_write_func func)
+{
+  auto* job = new job_t;
+  job->buffer   = std::move(buffer);
+  job->on_write = std::move(func);
+  start(job, VIRTIO_BLK_T_OUT, blk);
+}
+
+void VirtioBlk::write_fua(block_t blk, buffer_t buffer, on_write_func func)
+{
+  auto* job = new job_t;
+  job->buffer   = std::move(buffer);
+  job->on_write = std::move(func);
+  job->fua      = true;
+  start(job, VIRTIO_BLK_T_OUT, blk);
+}
+
+void VirtioBlk::flush(on_write_func func)
+{
+  auto* job = new job_t;
+  job->on_write = std::move(func);
+  start(job, VIRTIO_BLK_T_FLUSH, 0);
+}
+
+bool VirtioBlk::write_sync(block_t blk, buffer_t buffer)
+{
+  bool done  = false;
+  bool error = true;
+  write(blk, std::move(buffer), [&done, &error] (bool err) {
+    error = err;
+    done  = true;
+  });
+  // completions are taken off the queue here, instead of by the IRQ
+  auto& q = local_queue();
+  while (!done) {
+    if (q.vq.new_incoming()) service_queue(q);
+    else os::Arch::cpu_relax();
   }
-  // kick when we have enqueued stuff
-  if (shipped) req.kick();
+  return error;
 }
 
-VirtioBlk::request_t::request_t(uint64_t blk, request_handler_t cb)
+void VirtioBlk::submit(Io_batch ops, on_batch_func done)
 {
-  hdr.type   = VIRTIO_BLK_T_IN;
-  hdr.ioprio = 0; // reserved
-  hdr.sector = blk;
-  resp.status  = VIRTIO_BLK_S_IOERR;
-  resp.handler = cb;
+  if (ops.empty()) {
+    done(std::move(ops));
+    return;
+  }
+  auto* batch = new batch_t{std::move(ops), std::move(done), 0};
+  // hold the batch open until every operation is started
+  batch->pending = batch->ops.size() + 1;
+
+  auto& q = local_queue();
+  bool shipped = false;
+  for (size_t i = 0; i < batch->ops.size(); i++)
+  {
+    auto& op = batch->ops[i];
+    auto* job = new job_t;
+    job->batch = batch;
+    job->index = i;
+    uint32_t type = VIRTIO_BLK_T_IN;
+    switch (op.op) {
+    case Io_request::Op::READ:
+      job->buffer = fs::construct_buffer(block_size() * op.count);
+      break;
+    case Io_request::Op::WRITE:
+      job->buffer = op.buffer;
+      job->fua    = op.fua;
+      type = VIRTIO_BLK_T_OUT;
+      break;
+    case Io_request::Op::FLUSH:
+      type = VIRTIO_BLK_T_FLUSH;
+      break;
+    }
+    if (start(job, type))
+      shipped |= enqueue(q, job, type, op.blk);
+  }
+  // one notification for the whole batch
+  if (shipped) q.vq.kick();
+
+  if (--batch->pending == 0) {
+    batch->done(std::move(batch->ops));
+    delete batch;
+  }
 }
 
 void VirtioBlk::deactivate()
 {
   /// disable interrupts on virtio queues
-  req.disable_interrupts();
+  for (auto& q : queues)
+    q->vq.disable_interrupts();
 
   /// reset device
   this->Virtio::reset();
@@ -19,13 +19,13 @@
 #ifndef VIRTIO_BLOCK_HPP
 #define VIRTIO_BLOCK_HPP
 
-#include <hw/block_device.hpp>
+#include <hw/writable_blkdev.hpp>
 #include <hw/pci_device.hpp>
 #include <virtio/virtio.hpp>
 #include <deque>
 
-/** Virtio-net device driver.  */
-class VirtioBlk : public Virtio, public hw::Block_device
+/** Virtio-blk device driver.  */
+class VirtioBlk : public Virtio, public hw::Writable_Block_device
 {
 public:
 
@@ -60,6 +60,25 @@ public:
     return buffer_t();
   }
 
+  // write whole sectors from buffer to disk, starting at @blk
+  void write(block_t blk, buffer_t, on_write_func) override;
+  // write, then wait for the device by polling the queue
+  bool write_sync(block_t blk, buffer_t) override;
+  // write, then flush once the write completed
+  void write_fua(block_t blk, buffer_t, on_write_func) override;
+  // flush the device write cache, if it has one
+  void flush(on_write_func) override;
+
+  // ship the whole batch, with one notification to the device
+  void submit(Io_batch batch, on_batch_func done) override;
+
+  bool read_only() const noexcept
+  { return read_only_; }
+
+  // number of request queues, one per CPU with multi-queue
+  size_t queue_count() const noexcept
+  { return queues.size(); }
+
   void deactivate() override;
 
   /** Constructor. @param pcidev an initialized PCI device. */
@@ -84,6 +103,9 @@ private:
     uint8_t alignment_offset;    // Alignment offset in logical blocks
     uint16_t min_io_size;        // Minimum I/O size without performance penalty in logical blocks
     uint32_t opt_io_size;        // Optimal sustained I/O size in logical blocks
+    uint8_t writeback;           // Write cache mode, if VIRTIO_BLK_F_CONFIG_WCE
+    uint8_t unused0;
+    uint16_t num_queues;         // Only valid if VIRTIO_BLK_F_MQ
   };
 
   struct scsi_header_t
@@ -92,37 +114,74 @@ private:
     uint32_t ioprio;
     uint64_t sector;
   };
-  struct blk_io_t
+
+  struct batch_t
   {
-    uint8_t      sector[512];
+    Io_batch      ops;
+    on_batch_func done;
+    size_t        pending;
   };
-  typedef delegate<void(uint8_t*)> request_handler_t;
-  struct blk_resp_t
+
+  // one read, write or flush, completed when all its requests are
+  struct job_t
   {
-    uint8_t           status;
-    request_handler_t handler;
+    buffer_t      buffer;
+    on_read_func  on_read;
+    on_write_func on_write;
+    // set when the job is part of a batch
+    batch_t*      batch = nullptr;
+    size_t        index = 0;
+    uint32_t      pending = 0;
+    bool          failed  = false;
+    // flush once the write completed
+    bool          fua     = false;
   };
 
+  // a contiguous range of sectors, from or to the job buffer
+  struct range_t
+  {
+    job_t*   job;
+    uint32_t type;
+    uint64_t sector;
+    uint8_t* data;
+    uint32_t len;
+  };
+
+  // one virtio request, taken from the request pool
   struct request_t
   {
+    // must stay first, the queue hands back the address of the header
     scsi_header_t hdr;
-    blk_io_t      io;
-    blk_resp_t    resp;
+    uint8_t       status;
+    job_t*        job;
+  };
 
-    request_t(uint64_t blk, request_handler_t cb);
+  // a request queue and everything needed to feed it, owned by one CPU
+  struct queue_t
+  {
+    Virtio::Queue vq;
+    // preallocated requests, enough for a full queue
+    std::unique_ptr<request_t[]> pool;
+    std::vector<request_t*> free_reqs;
+    // tokens of the request being shipped
+    std::vector<Token> tokens;
+    // queue waiting for space in vring
+    std::deque<range_t> jobs;
+    // stack of dequeued requests to be processed
+    std::vector<request_t*> received;
+    size_t inflight = 0;
+    // the queue interrupt goes to the owning CPU
+    bool   irq_ready = false;
+
+    queue_t(const std::string& name, int size, int index, uint32_t iobase);
   };
 
   /** Get virtio PCI config. @see Virtio::get_config.*/
   void get_config();
 
-  /** Service the RX Queue.
-      Push incoming data up to linklayer, dequeue RX buffers. */
+  /** Service the request queue of this CPU */
   void service_RX();
-
-  /** Service the TX Queue
-      Dequeue used TX buffers. @note: This function does not take any
-      responsibility for memory management. */
-  void service_TX();
+  void service_queue(queue_t&);
 
   /** Handle device IRQ.
 
@@ -131,30 +190,44 @@ private:
 
   void msix_conf_handler();
 
-  // need at least 3 tokens free to ship a request
-  inline bool free_space() const noexcept
-  { return req.num_free() >= 3; }
+  // the request queue of this CPU
+  queue_t& local_queue();
+
+  // segments needed to ship a range
+  inline size_t segments(const range_t& r) const noexcept
+  { return (r.len + seg_size_ - 1) / seg_size_; }
+
+  // need a free request, and a token per segment plus header and status
+  inline bool free_space(const queue_t& q, const range_t& r) const noexcept
+  { return !q.free_reqs.empty() && q.vq.num_free() >= segments(r) + 2; }
+
+  // split a job in ranges, and ship or queue them, without kicking
+  bool enqueue(queue_t&, job_t*, uint32_t type, block_t blk);
+  bool enqueue(queue_t&, const range_t&);
 
-  // need many free tokens free to efficiently ship requests
-  inline bool lots_free_space() const noexcept
-  { return req.num_free() >= 32; }
+  // add one request to queue, without kicking
+  void shipit(queue_t&, const range_t&);
 
-  // add one request to queue and kick
-  void shipit(request_t*);
+  void handle(queue_t&, request_t*);
+  void finish(job_t*);
 
-  void handle(request_t*);
+  // complete jobs the device needn't or can't do, false if completed
+  bool start(job_t*, uint32_t type);
+  // start a job and kick
+  void start(job_t*, uint32_t type, block_t blk);
 
-  Virtio::Queue req;
+  std::vector<std::unique_ptr<queue_t>> queues;
 
   // configuration as read from paravirtual PCI device
   virtio_blk_config_t config;
 
-  // queue waiting for space in vring
-  std::deque<request_t*> jobs;
-  size_t    inflight;
+  // largest data segment, and data per request, in bytes
+  uint32_t seg_size_;
+  uint32_t max_request_;
 
-  // stack of dequeued requests to be processed
-  std::vector<request_t*> received;
+  // flushes are needed to make writes durable
+  bool has_flush_ = false;
+  bool read_only_ = false;
 
   // stat counters
   uint32_t* errors;
@@ -82,7 +82,9 @@ VirtioNet::VirtioNet(hw::PCI_Device& d, const uint16_t /*mtu*/)
     stat_packets_rx_total_{Statman::get().create(Stat::UINT64,
                 device_name() + ".stat_rx_total_packets").get_uint64()},
     stat_packets_tx_total_{Statman::get().create(Stat::UINT64,
-                device_name() + ".stat_tx_total_packets").get_uint64()}
+                device_name() + ".stat_tx_total_packets").get_uint64()},
+    rx_napi_{{this, &VirtioNet::rx_poll}, {this, &VirtioNet::rx_pending},
+             {this, &VirtioNet::rx_irq}}
 
 {
   INFO("VirtioNet", "Driver initializing");
@@ -231,15 +233,18 @@ void VirtioNet::msix_conf_handler()
 }
 void VirtioNet::msix_recv_handler()
 {
-  auto rx = stat_packets_rx_total_;
-  rx_q.disable_interrupts();
+  rx_napi_.interrupt();
+}
+int VirtioNet::rx_poll(const int budget)
+{
   // handle incoming packets as long as bufstore has available buffers
-  int max = 128;
-  while (rx_q.new_incoming() && max-- > 0)
+  int received = 0;
+  while (received < budget && rx_q.new_incoming())
   {
     auto res = rx_q.dequeue();
     VDBG_RX("[virtionet] Recv %u bytes\n", (uint32_t) res.size());
     auto pckt = recv_packet(res.data(), res.size());
+    received++;
 
     // Stat increase packets received
     stat_packets_rx_total_++;
@@ -255,8 +260,18 @@ void VirtioNet::msix_recv_handler()
     }
     add_receive_buffer(bufstore().get_buffer());
   }
-  rx_q.enable_interrupts();
-  if (rx != stat_packets_rx_total_) rx_q.kick();
+  if (received > 0) rx_q.kick();
+  return received;
+}
+bool VirtioNet::rx_pending()
+{
+  return rx_q.new_incoming()
+      && Nic::buffers_still_available(bufstore().buffers_in_use());
+}
+void VirtioNet::rx_irq(const bool enable)
+{
+  if (enable) rx_q.enable_interrupts();
+  else        rx_q.disable_interrupts();
 }
 void VirtioNet::msix_xmit_handler()
 {
@@ -293,7 +308,7 @@ void VirtioNet::msix_xmit_handler()
 
 void VirtioNet::legacy_handler()
 {
-  msix_recv_handler();
+  rx_napi_.interrupt();
   msix_xmit_handler();
 }
 
@@ -425,7 +440,7 @@ void VirtioNet::handle_deferred_devices()
 
 void VirtioNet::poll()
 {
-  msix_recv_handler();
+  rx_poll(rx_napi_.budget());
   msix_xmit_handler();
   // flush transmit_q immediately
   if (this->deferred_kick)
@@ -460,6 +475,8 @@ void VirtioNet::move_to_this_cpu()
   Events::get().subscribe(irqs[0], {this, &VirtioNet::msix_recv_handler});
   Events::get().subscribe(irqs[1], {this, &VirtioNet::msix_xmit_handler});
   Events::get().subscribe(irqs[2], {this, &VirtioNet::msix_conf_handler});
+  // keep polling on this CPU
+  rx_napi_.move_to_this_cpu();
 #ifndef NO_DEFERRED_KICK
   // update deferred kick IRQ
   auto defirq = Events::get().subscribe(handle_deferred_devices);
@@ -35,6 +35,7 @@
 
 #include <expects>
 #include <hw/pci_device.hpp>
+#include <hw/napi.hpp>
 #include <virtio/virtio.hpp>
 #include <net/packet.hpp>
 #include <net/buffer_store.hpp>
@@ -221,6 +222,11 @@ private:
   void msix_xmit_handler();
   void msix_conf_handler();
 
+  /** RX polling, driven by rx_napi_ */
+  int  rx_poll(int budget);
+  bool rx_pending();
+  void rx_irq(bool enable);
+
   /** Legacy IRQ handler */
   void legacy_handler();
 
@@ -247,6 +253,9 @@ private:
 
   std::deque<net::Packet_ptr> sendq{};
 
+  /** Switches RX between interrupts and polling under load */
+  hw::Napi rx_napi_;
+
 };
 
 #endif
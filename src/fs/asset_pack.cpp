@@ -0,0 +1,155 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fs/asset_pack.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace fs {
+
+  Asset_pack::Asset_pack(std::string_view image) noexcept
+    : image_{image}
+  {
+    if (image_.size() < sizeof(Header)) return;
+    header_  = (const Header*) image_.data();
+    entries_ = (const Entry*) (image_.data() + header_->entries);
+    seeds_   = (const int32_t*) (image_.data() + header_->table);
+    slots_   = (const uint32_t*) (seeds_ + header_->count);
+    if (not check()) {
+      header_  = nullptr;
+      entries_ = nullptr;
+      seeds_   = nullptr;
+      slots_   = nullptr;
+    }
+  }
+
+  bool Asset_pack::check() const noexcept
+  {
+    const auto& hdr = *header_;
+    const uint64_t size = image_.size();
+    if (memcmp(hdr.magic, magic, sizeof(magic)) != 0
+        or hdr.version != version or hdr.image_size > size)
+      return false;
+    const uint64_t count = hdr.count;
+    if (hdr.entries > size or count * sizeof(Entry) > size - hdr.entries
+        or hdr.table > size or count * 8 > size - hdr.table
+        or hdr.strings > size or hdr.strings_size > size - hdr.strings)
+      return false;
+    // everything below is read without further checks
+    for (uint64_t i = 0; i < count; i++)
+    {
+      const auto& ent = entries_[i];
+      if (ent.path + (uint64_t) ent.path_len > hdr.strings_size
+          or slots_[i] >= count)
+        return false;
+      for (const auto& blob : ent.data)
+        if (blob.offset > size or blob.size > size - blob.offset)
+          return false;
+    }
+    return true;
+  }
+
+  std::string_view Asset_pack::path_of(const Entry& ent) const noexcept
+  {
+    return image_.substr(header_->strings + ent.path, ent.path_len);
+  }
+
+  Asset_pack::Asset Asset_pack::find(std::string_view path) const noexcept
+  {
+    if (empty()) return {};
+    if (not path.empty() and path.front() == '/')
+      path.remove_prefix(1);
+    const uint32_t count = header_->count;
+    const uint32_t h = hash(0, path);
+    // singletons are placed directly, other buckets through a seed
+    const int32_t seed = seeds_[h % count];
+    const uint32_t slot = (seed < 0) ? -seed - 1 : hash(seed, path) % count;
+    if (slot >= count) return {};
+    const auto& ent = entries_[slots_[slot]];
+    if (ent.hash != h or path_of(ent) != path)
+      return {};
+    return {this, &ent};
+  }
+
+  Asset_pack::Asset Asset_pack::at(size_t index) const noexcept
+  {
+    if (index >= size()) return {};
+    return {this, &entries_[index]};
+  }
+
+  std::vector<Asset_pack::Asset> Asset_pack::list(std::string_view prefix) const
+  {
+    std::vector<Asset> result;
+    if (empty()) return result;
+    if (not prefix.empty() and prefix.front() == '/')
+      prefix.remove_prefix(1);
+    const Entry* end = entries_ + header_->count;
+    const Entry* it = std::lower_bound(entries_, end, prefix,
+        [this] (const Entry& ent, std::string_view prefix) {
+          return path_of(ent) < prefix;
+        });
+    for (; it != end and path_of(*it).substr(0, prefix.size()) == prefix; ++it)
+      result.push_back({this, it});
+    return result;
+  }
+
+  std::string_view Asset_pack::Asset::path() const noexcept
+  {
+    if (entry_ == nullptr) return {};
+    return pack_->path_of(*entry_);
+  }
+
+  std::string_view Asset_pack::Asset::data(Encoding enc) const noexcept
+  {
+    if (entry_ == nullptr) return {};
+    const auto& blob = entry_->data[(int) enc];
+    if (blob.size == 0) return {};
+    return pack_->image_.substr(blob.offset, blob.size);
+  }
+
+  Asset_pack::Encoding
+  Asset_pack::Asset::best(std::string_view accept) const noexcept
+  {
+    Encoding best = Encoding::identity;
+    while (not accept.empty())
+    {
+      auto end = accept.find(',');
+      auto token = accept.substr(0, end);
+      accept = (end == accept.npos) ? std::string_view{} : accept.substr(end + 1);
+
+      auto params = token.find(';');
+      auto name = token.substr(0, params);
+      while (not name.empty() and name.front() == ' ') name.remove_prefix(1);
+      while (not name.empty() and name.back() == ' ') name.remove_suffix(1);
+      // q=0 means not acceptable
+      if (params != token.npos) {
+        auto q = token.substr(params + 1);
+        while (not q.empty() and q.front() == ' ') q.remove_prefix(1);
+        if (q.substr(0, 2) == "q=" and q.find_first_not_of("0.", 2) == q.npos)
+          continue;
+      }
+
+      Encoding enc;
+      if (name == "gzip")    enc = Encoding::gzip;
+      else if (name == "br") enc = Encoding::brotli;
+      else continue;
+      if (has(enc) and size(enc) < size(best))
+        best = enc;
+    }
+    return best;
+  }
+
+} //< namespace fs
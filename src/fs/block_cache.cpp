@@ -0,0 +1,220 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <fs/block_cache.hpp>
+#include <fs/common.hpp>
+#include <statman>
+#include <algorithm>
+#include <cstring>
+#include <expects>
+#include <likely>
+
+namespace fs {
+
+  static uint64_t& create_stat(const hw::Block_device& dev, const char* what)
+  {
+    return Statman::get().create(Stat::UINT64,
+              dev.device_name() + ".cache." + what).get_uint64();
+  }
+
+  Block_cache::Block_cache(hw::Block_device& dev, size_t capacity,
+                           size_t read_ahead, size_t bypass)
+    : dev_{dev}, capacity_{capacity}, read_ahead_{read_ahead},
+      bypass_{std::min(bypass, capacity)}, sector_size_{dev.block_size()},
+      stats_{create_stat(dev, "hits"), create_stat(dev, "misses"),
+             create_stat(dev, "read_ahead")}
+  {
+    Expects(capacity_ > 0 and capacity_ < none);
+  }
+
+  Block_cache::Range Block_cache::plan(block_t blk, size_t count)
+  {
+    Range miss {blk + count, blk + count};
+    for (block_t b = blk; b < blk + count; b++)
+    {
+      if (index_.count(b)) continue;
+      if (miss.first == miss.last) miss.first = b;
+      miss.last = b + 1;
+    }
+    if (miss.first == miss.last) miss.first = miss.last = blk;
+    return miss;
+  }
+
+  void Block_cache::copy_cached(block_t blk, size_t count,
+                                uint8_t* dest, Range skip)
+  {
+    for (block_t b = blk; b < blk + count; b++)
+    {
+      if (b >= skip.first and b < skip.last) continue;
+      const uint32_t slot = index_.at(b);
+      std::memcpy(dest + (b - blk) * sector_size_,
+                  &slab_[slot * sector_size_], sector_size_);
+      touch(slot);
+      stats_.hits++;
+    }
+  }
+
+  void Block_cache::unlink(uint32_t slot)
+  {
+    auto& s = slots_[slot];
+    if (s.next == slot) {
+      head_ = none;
+      return;
+    }
+    slots_[s.prev].next = s.next;
+    slots_[s.next].prev = s.prev;
+    if (head_ == slot) head_ = s.next;
+  }
+
+  void Block_cache::link_front(uint32_t slot)
+  {
+    auto& s = slots_[slot];
+    if (head_ == none) {
+      s.prev = s.next = slot;
+    }
+    else {
+      auto& first = slots_[head_];
+      s.next = head_;
+      s.prev = first.prev;
+      slots_[first.prev].next = slot;
+      first.prev = slot;
+    }
+    head_ = slot;
+  }
+
+  void Block_cache::touch(uint32_t slot)
+  {
+    if (head_ == slot) return;
+    unlink(slot);
+    link_front(slot);
+  }
+
+  void Block_cache::insert(block_t first, const uint8_t* data, size_t count)
+  {
+    if (UNLIKELY(slab_ == nullptr)) {
+      slab_.reset(new uint8_t[capacity_ * sector_size_]);
+      slots_.reserve(capacity_);
+      index_.reserve(capacity_);
+    }
+    // more than fits would only evict itself
+    if (count > capacity_) {
+      data  += (count - capacity_) * sector_size_;
+      first += count - capacity_;
+      count  = capacity_;
+    }
+    for (block_t b = first; b < first + count; b++, data += sector_size_)
+    {
+      uint32_t slot;
+      auto it = index_.find(b);
+      if (it != index_.end()) {
+        slot = it->second;
+      }
+      else if (slots_.size() < capacity_) {
+        slot = slots_.size();
+        slots_.push_back({b, slot, slot});
+        index_.emplace(b, slot);
+        link_front(slot);
+      }
+      else {
+        // reuse the least recently used sector
+        slot = slots_[head_].prev;
+        index_.erase(slots_[slot].blk);
+        slots_[slot].blk = b;
+        index_.emplace(b, slot);
+      }
+      std::memcpy(&slab_[slot * sector_size_], data, sector_size_);
+      touch(slot);
+    }
+  }
+
+  void Block_cache::invalidate()
+  {
+    index_.clear();
+    slots_.clear();
+    head_ = none;
+    next_seq_ = ~block_t(0);
+  }
+
+  Block_cache::buffer_t Block_cache::read_sync(block_t blk, size_t count)
+  {
+    const bool sequential = (blk == next_seq_);
+    next_seq_ = blk + count;
+    if (count == 0 or count > bypass_)
+      return dev_.read_sync(blk, count);
+
+    const Range miss = plan(blk, count);
+    auto buffer = construct_buffer(count * sector_size_);
+    // the cached sectors first, fetching may evict them
+    copy_cached(blk, count, buffer->data(), miss);
+    if (miss.first == miss.last)
+      return buffer;
+
+    block_t end = miss.last;
+    if (sequential and end == blk + count)
+      end = std::max(end, std::min(end + read_ahead_, dev_.size()));
+
+    auto data = dev_.read_sync(miss.first, end - miss.first);
+    if (UNLIKELY(data == nullptr))
+      return nullptr;
+    std::memcpy(buffer->data() + (miss.first - blk) * sector_size_,
+                data->data(), (miss.last - miss.first) * sector_size_);
+    insert(miss.first, data->data(), end - miss.first);
+    stats_.misses     += miss.last - miss.first;
+    stats_.read_ahead += end - miss.last;
+    return buffer;
+  }
+
+  void Block_cache::read(block_t blk, size_t count, on_read_func reader)
+  {
+    const bool sequential = (blk == next_seq_);
+    next_seq_ = blk + count;
+    if (count == 0 or count > bypass_) {
+      dev_.read(blk, count, std::move(reader));
+      return;
+    }
+
+    const Range miss = plan(blk, count);
+    auto buffer = construct_buffer(count * sector_size_);
+    copy_cached(blk, count, buffer->data(), miss);
+    if (miss.first == miss.last) {
+      reader(std::move(buffer));
+      return;
+    }
+
+    block_t end = miss.last;
+    if (sequential and end == blk + count)
+      end = std::max(end, std::min(end + read_ahead_, dev_.size()));
+
+    dev_.read(miss.first, end - miss.first,
+      on_read_func::make_packed(
+      [this, blk, miss, end, buffer, reader] (buffer_t data)
+      {
+        if (UNLIKELY(data == nullptr)) {
+          reader(nullptr);
+          return;
+        }
+        std::memcpy(buffer->data() + (miss.first - blk) * sector_size_,
+                    data->data(), (miss.last - miss.first) * sector_size_);
+        insert(miss.first, data->data(), end - miss.first);
+        stats_.misses     += miss.last - miss.first;
+        stats_.read_ahead += end - miss.last;
+        reader(buffer);
+      })
+    );
+  }
+
+} //< namespace fs
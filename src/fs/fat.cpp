@@ -21,6 +21,7 @@
 #include <fs/mbr.hpp>
 #include <cassert>
 #include <cstring>
+#include <algorithm>
 #include <locale>
 #include <os.hpp> // for panic()
 #include <info>
@@ -39,7 +40,7 @@ inline std::string trim_right_copy(
 namespace fs
 {
   FAT::FAT(hw::Block_device& dev)
-    : device(dev) {
+    : device(dev), cache(dev) {
     //
   }
 
@@ -144,7 +145,7 @@ namespace fs
     this->lba_size = size;
 
     // read Partition block
-    device.read(
+    cache.read(
       base,
       hw::Block_device::on_read_func::make_packed(
       [this, on_init] (buffer_t data)
@@ -287,4 +288,114 @@ namespace fs
     return found_last;
   }
 
+
+  uint32_t FAT::clusters_needed(uint64_t size) const noexcept
+  {
+    const uint64_t cluster_size = sectors_per_cluster * sector_size;
+    return std::max<uint64_t>(1, (size + cluster_size - 1) / cluster_size);
+  }
+
+  uint32_t FAT::fat_offset(uint32_t cl) const noexcept
+  {
+    if (fat_type == T_FAT12)
+      return cl + cl / 2;
+    else if (fat_type == T_FAT16)
+      return cl * 2;
+    else
+      return cl * 4;
+  }
+
+  uint32_t FAT::fat_entry(const uint8_t* entry, uint32_t cl) const noexcept
+  {
+    const uint32_t word = entry[0] | (entry[1] << 8);
+    if (fat_type == T_FAT12)
+      return (cl & 1) ? word >> 4 : word & 0xFFF;
+    else if (fat_type == T_FAT16)
+      return word;
+    else
+      return (word | (entry[2] << 16) | (entry[3] << 24)) & 0x0FFFFFFF;
+  }
+
+  void FAT::Chain_walk::add(uint32_t next)
+  {
+    auto& last = list.back();
+    if (next == last.cluster + last.count)
+      last.count++;
+    else
+      list.push_back({last.file_cluster + last.count, next, 1});
+    cluster = next;
+    covered++;
+  }
+
+  uint32_t FAT::walk_chain(Chain_walk& walk, uint32_t fat_sector,
+                           const uint8_t* data, size_t len, bool& done) const
+  {
+    const uint32_t entry_len = (fat_type == T_FAT32) ? 4 : 2;
+    const uint64_t start = fat_sector * sector_size;
+    done = false;
+    while (walk.covered < walk.needed)
+    {
+      const uint32_t ofs = fat_offset(walk.cluster);
+      if (ofs < start or ofs + entry_len > start + len) {
+        const uint32_t sector = ofs / sector_size;
+        // past the FAT, or straddling its end
+        if (sector >= sectors_per_fat or sector == fat_sector) break;
+        return sector;
+      }
+      const uint32_t next = fat_entry(data + (ofs - start), walk.cluster);
+      // end of chain, or a free or bad cluster
+      if (next < 2 or next > clusters + 1) break;
+      walk.add(next);
+    }
+    done = true;
+    return 0;
+  }
+
+  FAT::Extents_ptr FAT::cached_extents(uint32_t cluster) const
+  {
+    auto it = extent_cache.find(cluster);
+    if (it == extent_cache.end()) return nullptr;
+    it->second.used = ++extent_clock;
+    return it->second.list;
+  }
+
+  FAT::Extents_ptr FAT::cache_extents(uint32_t cluster, Chain_walk& walk) const
+  {
+    if (extent_cache.size() >= extent_cache_max)
+    {
+      auto lru = std::min_element(extent_cache.begin(), extent_cache.end(),
+          [] (const auto& a, const auto& b) {
+            return a.second.used < b.second.used;
+          });
+      extent_cache.erase(lru);
+    }
+    auto list = std::make_shared<const Extent_list> (std::move(walk.list));
+    extent_cache[cluster] = {list, ++extent_clock};
+    return list;
+  }
+
+  std::vector<FAT::Run> FAT::file_runs(const Extent_list& list,
+                                       uint32_t sector, uint32_t nsect) const
+  {
+    std::vector<Run> runs;
+    const uint32_t spc = sectors_per_cluster;
+    while (nsect > 0)
+    {
+      const uint32_t fc = sector / spc;
+      // the last extent starting at or before fc
+      auto it = std::upper_bound(list.begin(), list.end(), fc,
+          [] (uint32_t fc, const Extent& ext) { return fc < ext.file_cluster; });
+      --it;
+      // a chain ending before the file does (like on images without
+      // an allocation table) is taken to go on contiguously
+      const uint64_t end = (it + 1 == list.end())
+          ? UINT64_MAX : uint64_t(it->file_cluster + it->count) * spc;
+      const uint32_t count = std::min<uint64_t>(nsect, end - sector);
+      runs.push_back({cl_to_sector(it->cluster) + uint64_t(sector - it->file_cluster * spc), count});
+      sector += count;
+      nsect  -= count;
+    }
+    return runs;
+  }
+
 }
@@ -47,7 +47,7 @@ namespace fs
     {
       FS_PRINT("int_ls: sec=%u\n", sector);
       auto next = weak_next.lock();
-      device.read(
+      cache.read(
         sector,
         hw::Block_device::on_read_func::make_packed(
         [this, sector, callback, dirents, next] (buffer_t data)
@@ -192,12 +192,13 @@ namespace fs
     uint32_t sector = stapos / this->sector_size;
     uint32_t nsect = roundup(endpos, sector_size) / sector_size - sector;
     uint32_t internal_ofs = stapos % device.block_size();
+    // nothing left to read at or past the end of the file
+    if (nsect == 0) {
+      callback(no_error, construct_buffer());
+      return;
+    }
 
-    // cluster -> sector + position
-    device.read(
-      this->cl_to_sector(ent.block()) + sector,
-      nsect,
-      hw::Block_device::on_read_func::make_packed(
+    auto done = hw::Block_device::on_read_func::make_packed(
       [n, callback, internal_ofs] (buffer_t data)
       {
         if (!data) {
@@ -218,10 +219,114 @@ namespace fs
         }
 
         callback(no_error, data);
+      });
+
+    if (ent.block() < 2) {
+      // cluster -> sector + position
+      read_runs({{this->cl_to_sector(ent.block()) + sector, nsect}}, std::move(done));
+      return;
+    }
+    // find the clusters through the FAT, then read each run in one go
+    extents(ent.block(), clusters_needed(ent.size()),
+      on_extents_func::make_packed(
+      [this, sector, nsect, done] (Extents_ptr list)
+      {
+        if (list == nullptr) {
+          done(nullptr);
+          return;
+        }
+        read_runs(file_runs(*list, sector, nsect), done);
       })
     );
   }
 
+  void FAT::read_runs(std::vector<Run> runs, hw::Block_device::on_read_func callback) const
+  {
+    if (runs.empty()) {
+      callback(construct_buffer());
+      return;
+    }
+    if (runs.size() == 1) {
+      cache.read(runs[0].sector, runs[0].count, std::move(callback));
+      return;
+    }
+    // all runs are read at once, and copied into place as they arrive
+    struct Job {
+      buffer_t data;
+      size_t   pending;
+      bool     failed = false;
+      hw::Block_device::on_read_func callback;
+    };
+    size_t total = 0;
+    for (auto& run : runs) total += run.count;
+    auto job = std::make_shared<Job> (Job{construct_buffer(total * sector_size),
+                                          runs.size(), false, std::move(callback)});
+    size_t offset = 0;
+    for (auto& run : runs)
+    {
+      cache.read(run.sector, run.count,
+        hw::Block_device::on_read_func::make_packed(
+        [job, offset] (buffer_t data)
+        {
+          if (data == nullptr)
+            job->failed = true;
+          else
+            std::memcpy(job->data->data() + offset, data->data(), data->size());
+          if (--job->pending == 0)
+            job->callback(job->failed ? nullptr : job->data);
+        })
+      );
+      offset += run.count * sector_size;
+    }
+  }
+
+  void FAT::extents(uint32_t cluster, uint32_t needed, on_extents_func callback) const
+  {
+    if (auto list = cached_extents(cluster)) {
+      callback(list);
+      return;
+    }
+    auto walk = std::make_shared<Chain_walk> (cluster, needed);
+    const uint32_t first = fat_offset(cluster) / sector_size;
+    if (needed <= 1 or first >= sectors_per_fat) {
+      callback(cache_extents(cluster, *walk));
+      return;
+    }
+
+    // read the FAT a window at a time, for as long as the chain goes
+    typedef delegate<void(uint32_t)> next_func_t;
+
+    auto next = std::make_shared<next_func_t> ();
+    auto weak_next = std::weak_ptr<next_func_t>(next);
+    *next = next_func_t::make_packed(
+    [this, cluster, callback, walk, weak_next] (uint32_t fat_sector)
+    {
+      auto next = weak_next.lock();
+      cache.read(
+        lba_base + reserved + fat_sector,
+        std::min(fat_window, sectors_per_fat - fat_sector),
+        hw::Block_device::on_read_func::make_packed(
+        [this, cluster, fat_sector, callback, walk, next] (buffer_t data)
+        {
+          if (data == nullptr) {
+            callback(nullptr);
+            return;
+          }
+          bool done;
+          const uint32_t sector =
+              walk_chain(*walk, fat_sector, data->data(), data->size(), done);
+          if (done)
+            callback(cache_extents(cluster, *walk));
+          else
+            (*next)(sector);
+        })
+      );
+    });
+
+    // start at the FAT sector of the first cluster
+    (*next)(first);
+  }
+
   void FAT::stat(Path_ptr path, on_stat_func func, const Dirent* const start) const
   {
     // manual lookup
@@ -45,7 +45,18 @@ namespace fs
     auto nsect = roundup(endpos, sector_size) / sector_size - sector;
 
     // read @nsect sectors ahead
-    buffer_t data = device.read_sync(this->cl_to_sector(ent.block()) + sector, nsect);
+    buffer_t data;
+    if (ent.block() < 2 or nsect == 0) {
+      data = cache.read_sync(this->cl_to_sector(ent.block()) + sector, nsect);
+    }
+    else {
+      // find the clusters through the FAT, then read each run in one go
+      auto list = extents(ent.block(), clusters_needed(ent.size()));
+      if (list != nullptr)
+        data = read_runs(file_runs(*list, sector, nsect));
+    }
+    if (UNLIKELY(!data))
+      return Buffer({ error_t::E_IO, "Unable to read file" }, nullptr);
     // where to start copying from the device result
     auto internal_ofs = stapos % device.block_size();
     // when the offset is non-zero we aren't on a sector boundary
@@ -60,12 +71,50 @@ namespace fs
     return Buffer(no_error, std::move(data));
   }
 
+  buffer_t FAT::read_runs(const std::vector<Run>& runs) const
+  {
+    if (runs.size() == 1)
+      return cache.read_sync(runs[0].sector, runs[0].count);
+
+    size_t total = 0;
+    for (auto& run : runs) total += run.count;
+    auto data = construct_buffer(total * sector_size);
+    auto* dest = data->data();
+    for (auto& run : runs)
+    {
+      auto part = cache.read_sync(run.sector, run.count);
+      if (UNLIKELY(!part)) return nullptr;
+      std::memcpy(dest, part->data(), part->size());
+      dest += part->size();
+    }
+    return data;
+  }
+
+  FAT::Extents_ptr FAT::extents(uint32_t cluster, uint32_t needed) const
+  {
+    if (auto list = cached_extents(cluster))
+      return list;
+
+    Chain_walk walk {cluster, needed};
+    uint32_t sector = fat_offset(cluster) / sector_size;
+    bool done = (needed <= 1 or sector >= sectors_per_fat);
+    // read the FAT a window at a time, for as long as the chain goes
+    while (not done)
+    {
+      auto data = cache.read_sync(lba_base + reserved + sector,
+                                  std::min(fat_window, sectors_per_fat - sector));
+      if (UNLIKELY(!data)) return nullptr;
+      sector = walk_chain(walk, sector, data->data(), data->size(), done);
+    }
+    return cache_extents(cluster, walk);
+  }
+
   error_t FAT::int_ls(uint32_t sector, dirvector& ents) const
   {
     bool done = false;
     do {
       // read sector sync
-      buffer_t data = device.read_sync(sector);
+      buffer_t data = cache.read_sync(sector);
       if (UNLIKELY(!data))
           return { error_t::E_IO, "Unable to read directory" };
       // parse directory into @ents
@@ -0,0 +1,98 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <hw/block_device.hpp>
+#include <hw/writable_blkdev.hpp>
+
+namespace hw {
+
+  struct Batch_state {
+    Block_device::Io_batch      batch;
+    Block_device::on_batch_func done;
+    size_t pending;
+  };
+
+  static void complete_one(Batch_state* state)
+  {
+    if (--state->pending > 0) return;
+    state->done(std::move(state->batch));
+    delete state;
+  }
+
+  // run each operation on its own, writes only on a writable device
+  static void run_batch(Block_device& dev, Writable_Block_device* wdev,
+                        Block_device::Io_batch batch,
+                        Block_device::on_batch_func done)
+  {
+    using Op = Block_device::Io_request::Op;
+    if (batch.empty()) {
+      done(std::move(batch));
+      return;
+    }
+    auto* state = new Batch_state{std::move(batch), std::move(done), 0};
+    // hold the batch open until every operation is started
+    state->pending = state->batch.size() + 1;
+
+    for (size_t i = 0; i < state->batch.size(); i++)
+    {
+      auto& req = state->batch[i];
+      auto on_write = [state, i] (bool error) {
+        state->batch[i].error = error;
+        complete_one(state);
+      };
+      switch (req.op) {
+      case Op::READ:
+        dev.read(req.blk, req.count, [state, i] (Block_device::buffer_t buf) {
+          state->batch[i].error  = (buf == nullptr);
+          state->batch[i].buffer = std::move(buf);
+          complete_one(state);
+        });
+        break;
+      case Op::WRITE:
+        if (wdev == nullptr) on_write(true);
+        else if (req.fua) wdev->write_fua(req.blk, req.buffer, on_write);
+        else wdev->write(req.blk, req.buffer, on_write);
+        break;
+      case Op::FLUSH:
+        if (wdev == nullptr) on_write(true);
+        else wdev->flush(on_write);
+        break;
+      }
+    }
+    complete_one(state);
+  }
+
+  void Block_device::submit(Io_batch batch, on_batch_func done)
+  {
+    run_batch(*this, nullptr, std::move(batch), std::move(done));
+  }
+
+  void Writable_Block_device::submit(Io_batch batch, on_batch_func done)
+  {
+    run_batch(*this, this, std::move(batch), std::move(done));
+  }
+
+  void Writable_Block_device::write_fua(block_t blk, buffer_t buffer,
+                                        on_write_func callback)
+  {
+    write(blk, std::move(buffer), on_write_func::make_packed(
+      [this, callback] (bool error) {
+        if (error) callback(true);
+        else flush(callback);
+      }));
+  }
+
+}
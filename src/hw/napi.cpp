@@ -0,0 +1,69 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <hw/napi.hpp>
+#include <kernel/events.hpp>
+#include <expects>
+#include <likely>
+
+namespace hw {
+
+  Napi::Napi(poll_func poll, pending_func pending, irq_func irq, int budget)
+    : poll_{std::move(poll)}, pending_{std::move(pending)},
+      irq_{std::move(irq)}, budget_{budget}
+  {
+    Expects(budget_ > 0);
+  }
+
+  void Napi::move_to_this_cpu()
+  {
+    event_ = Events::get().subscribe({this, &Napi::poll});
+  }
+
+  void Napi::interrupt()
+  {
+    stats_.interrupts++;
+    // already polling, the next poll picks the packets up
+    if (polling_) return;
+    if (UNLIKELY(event_ < 0)) move_to_this_cpu();
+    irq_(false);
+    polling_ = true;
+    poll();
+  }
+
+  void Napi::poll()
+  {
+    const int done = poll_(budget_);
+    stats_.polls++;
+    stats_.packets += done;
+
+    if (done >= budget_) {
+      // more work is likely waiting, come back after the other events
+      stats_.exhausted++;
+      Events::get().trigger_event(event_);
+      return;
+    }
+    irq_(true);
+    // packets arriving before the unmask raised no interrupt
+    if (pending_()) {
+      irq_(false);
+      Events::get().trigger_event(event_);
+      return;
+    }
+    polling_ = false;
+  }
+
+}
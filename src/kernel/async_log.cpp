@@ -0,0 +1,212 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <kernel/async_log.hpp>
+#include <kernel/timers.hpp>
+#include <expects>
+#include <likely>
+#include <smp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <syslog.h>
+
+namespace os::async_log {
+
+  // less severe records may only fill this much of a ring
+  static constexpr size_t low_severity_limit = ring_size * 3 / 4;
+  // formatted records start out with this much room
+  static constexpr size_t printf_guess = 256;
+
+  struct alignas(SMP_ALIGN) Cpu_log {
+    Ring  ring;
+    // set while this CPU writes, so a nested write is dropped
+    bool  writing = false;
+    Stats stats;
+    // drops already reported, flusher only
+    uint64_t reported = 0;
+  };
+  static SMP::Array<Cpu_log> cpus;
+
+  // channels are added from constructors, before ours may have run
+  static std::array<Sink, max_channels>& sinks()
+  {
+    static std::array<Sink, max_channels> sinks_;
+    return sinks_;
+  }
+  static std::atomic<int> channels {0};
+  static std::atomic<bool> flushing {false};
+  static Timers::id_t flush_timer = Timers::UNUSED_ID;
+
+  static uint32_t tag(int channel, int severity) noexcept
+  { return (uint32_t(channel) << 8) | (severity & 0xff); }
+
+  static size_t limit(int severity) noexcept
+  { return severity <= LOG_WARNING ? ring_size : low_severity_limit; }
+
+  int add_channel(Sink sink)
+  {
+    const int channel = channels.fetch_add(1);
+    Expects(channel < max_channels);
+    sinks()[channel] = std::move(sink);
+    return channel;
+  }
+
+  bool write(int channel, int severity, const char* data, size_t len)
+  {
+    auto& log = PER_CPU(cpus);
+    if (UNLIKELY(log.writing)) {
+      log.stats.dropped++;
+      return false;
+    }
+    log.writing = true;
+    if (UNLIKELY(len > max_record)) {
+      len = max_record;
+      log.stats.truncated++;
+    }
+    const bool queued = log.ring.write({data, len}, tag(channel, severity), limit(severity));
+    if (LIKELY(queued)) {
+      log.stats.written++;
+      log.stats.bytes += len;
+    }
+    else log.stats.dropped++;
+    log.writing = false;
+    return queued;
+  }
+
+  bool printf(int channel, int severity, const char* format, ...)
+  {
+    va_list args;
+    va_start(args, format);
+    const bool queued = vprintf(channel, severity, format, args);
+    va_end(args);
+    return queued;
+  }
+
+  bool vprintf(int channel, int severity, const char* format, va_list args)
+  {
+    auto& log = PER_CPU(cpus);
+    if (UNLIKELY(log.writing)) {
+      log.stats.dropped++;
+      return false;
+    }
+    log.writing = true;
+    // most records fit the guess, the rest are formatted again with room
+    va_list again;
+    va_copy(again, args);
+    size_t room = printf_guess;
+    char* dst = log.ring.reserve(room, limit(severity));
+    int len = dst ? vsnprintf(dst, room, format, args) : -1;
+    if (len >= (int) room) {
+      room = std::min<size_t>(len + 1, max_record);
+      dst = log.ring.reserve(room, limit(severity));
+      len = dst ? vsnprintf(dst, room, format, again) : -1;
+    }
+    va_end(again);
+
+    const bool queued = len >= 0;
+    if (LIKELY(queued)) {
+      // vsnprintf needs room for a zero, which is not part of the record
+      const size_t used = std::min<size_t>(len, room - 1);
+      if (UNLIKELY(used < (size_t) len)) log.stats.truncated++;
+      log.ring.commit(used, tag(channel, severity));
+      log.stats.written++;
+      log.stats.bytes += used;
+    }
+    else log.stats.dropped++;
+    log.writing = false;
+    return queued;
+  }
+
+  static void deliver(const Record* batch, size_t count, Stats& stats)
+  {
+    if (count == 0) return;
+    auto& sink = sinks()[batch[0].channel];
+    if (sink) sink(batch, count);
+    stats.flushed += count;
+  }
+
+  static void drain(Cpu_log& log)
+  {
+    std::array<Record, batch_size> batch;
+    size_t count = 0;
+    log.ring.read([&] (uint32_t tag, std::string_view text) {
+      const Record rec {int(tag >> 8), int(tag & 0xff), text};
+      if (count == batch_size or (count and batch[0].channel != rec.channel)) {
+        deliver(batch.data(), count, log.stats);
+        count = 0;
+      }
+      if (rec.channel < max_channels) batch[count++] = rec;
+    });
+    deliver(batch.data(), count, log.stats);
+    log.ring.release();
+  }
+
+  static void report_drops(int cpu, Cpu_log& log)
+  {
+    const uint64_t dropped = log.stats.dropped;
+    if (LIKELY(dropped == log.reported)) return;
+    char text[96];
+    const int len = snprintf(text, sizeof(text),
+        "async_log: %llu records dropped on CPU %d\n",
+        (unsigned long long) (dropped - log.reported), cpu);
+    log.reported = dropped;
+    for (int channel = 0; channel < channels.load() and channel < max_channels; channel++)
+    {
+      const Record rec {channel, LOG_WARNING, {text, (size_t) len}};
+      if (sinks()[channel]) sinks()[channel](&rec, 1);
+    }
+  }
+
+  void flush()
+  {
+    if (flushing.exchange(true, std::memory_order_acquire)) return;
+    for (int cpu = 0; cpu < SMP::cpu_count(); cpu++)
+    {
+      auto& log = cpus[cpu];
+      if (not log.ring.empty()) drain(log);
+      report_drops(cpu, log);
+    }
+    flushing.store(false, std::memory_order_release);
+  }
+
+  void start(std::chrono::milliseconds interval)
+  {
+    if (flush_timer != Timers::UNUSED_ID) Timers::stop(flush_timer);
+    flush_timer = Timers::periodic(interval, [] (Timers::id_t) { flush(); });
+  }
+
+  void stop()
+  {
+    if (flush_timer == Timers::UNUSED_ID) return;
+    Timers::stop(flush_timer);
+    flush_timer = Timers::UNUSED_ID;
+    // nothing flushes the rings after this
+    flush();
+  }
+
+  bool is_running() noexcept
+  {
+    return flush_timer != Timers::UNUSED_ID;
+  }
+
+  Stats stats(int cpu)
+  {
+    return cpus.at(cpu).stats;
+  }
+
+}
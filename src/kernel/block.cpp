@@ -18,6 +18,7 @@
 #include <os>
 #include <statman>
 #include <kernel/events.hpp>
+#include <kernel/scheduler.hpp>
 
 // Keep track of blocking levels
 static uint32_t* blocking_level = nullptr;
@@ -37,6 +38,12 @@ extern "C" uint32_t os_get_highest_blocking_level() {
  **/
 void os::block() noexcept
 {
+  // a task waits in the scheduler instead, letting the other tasks run
+  if (Scheduler::current() != nullptr) {
+    Scheduler::block();
+    return;
+  }
+
   // Initialize stats
   if (not blocking_level) {
     blocking_level = &Statman::get()
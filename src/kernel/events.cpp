@@ -117,6 +117,8 @@ void Events::defer(event_callback callback)
 
 void Events::process_events()
 {
+  if (process_hook) process_hook();
+
   bool handled_any;
   do {
     handled_any = false;
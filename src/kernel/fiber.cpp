@@ -45,6 +45,7 @@ extern "C" {
 
     // Last stackframe before switching back. Done.
     PER_CPU(Fiber::current_) = f->parent_ ? f->parent_ : nullptr;
+    f->running_ = false;
     f->done_ = true;
   }
 }
@@ -87,12 +88,14 @@ void Fiber::yield() {
 
   auto* from = PER_CPU(current_);
   Expects(from);
+  // without a parent fiber we return to the stack that resumed us
   auto* into = PER_CPU(current_)->parent_;
-  Expects(into);
-  Expects(into->suspended());
-  Expects(into->stack_loc_);
+  if (into) {
+    Expects(into->suspended());
+    Expects(into->stack_loc_);
+    Expects(not into->done_);
+  }
   Expects(from->stack_loc_);
-  Expects(not into->done_);
 
   from->suspended_ = true;
   from->running_ = false;
@@ -109,15 +112,18 @@ void Fiber::resume()
   if (not suspended_ or done_ or func_ == nullptr)
     return;
 
-  Expects(PER_CPU(current_));
-
-  make_parent(PER_CPU(current_));
+  if (PER_CPU(current_)) {
+    make_parent(PER_CPU(current_));
+    parent_->suspended_ = true;
+    parent_->running_ = false;
+  }
+  else {
+    parent_ = nullptr;
+  }
 
   PER_CPU(current_) = this;
   suspended_ = false;
   running_ = true;
-  parent_->suspended_ = true;
-  parent_->running_ = false;
 
   Expects(stack_loc_ > stack_.get() and stack_loc_ < stack_.get() + stack_size_);
   Expects(not done_);
@@ -127,3 +133,15 @@ void Fiber::resume()
   // Returns here after yield
 
 }
+
+void Fiber::restart()
+{
+  Expects(not running_ and (done_ or not started_));
+
+  stack_loc_ = (void*)(uintptr_t(stack_.get() + stack_size_) & ~ (uintptr_t)0xf);
+  parent_    = nullptr;
+  ret_       = nullptr;
+  suspended_ = false;
+  started_   = false;
+  done_      = false;
+}
@@ -0,0 +1,277 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <kernel/futex.hpp>
+#include <kernel/fiber.hpp>
+#include <kernel/scheduler.hpp>
+#include <kernel/timers.hpp>
+#include <os.hpp>
+#include <smp>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <mutex>
+
+namespace os::futex {
+
+  enum State : int {
+    QUEUED,
+    WOKEN,
+    TIMED_OUT
+  };
+
+  // lives on the stack of the waiter, and is linked into a bucket
+  struct Waiter {
+    Waiter(int* addr_, uint32_t bitset_)
+      : addr{addr_}, bitset{bitset_}, cpu{SMP::cpu_id()},
+        task{Scheduler::current()} {}
+
+    std::atomic<int*> addr;
+    const uint32_t    bitset;
+    const int         cpu;
+    Scheduler::Task* const task;
+    std::atomic<int>  state {QUEUED};
+    Timers::id_t      timer = Timers::UNUSED_ID;
+    Waiter* next = nullptr;
+    Waiter* prev = nullptr;
+  };
+
+  struct alignas(SMP_ALIGN) Bucket {
+    Spinlock lock;
+    Waiter*  head = nullptr;
+    Waiter*  tail = nullptr;
+
+    void push_back(Waiter* w) noexcept {
+      w->next = nullptr;
+      w->prev = tail;
+      if (tail) tail->next = w;
+      else head = w;
+      tail = w;
+    }
+
+    void unlink(Waiter* w) noexcept {
+      if (w->prev) w->prev->next = w->next;
+      else head = w->next;
+      if (w->next) w->next->prev = w->prev;
+      else tail = w->prev;
+      w->next = w->prev = nullptr;
+    }
+  };
+
+  static constexpr int bucket_bits = 6;
+  static std::array<Bucket, 1 << bucket_bits> buckets;
+
+  static Bucket& bucket_of(const int* addr) noexcept
+  {
+    // fibonacci hashing, futex words are at least 4 byte aligned
+    const uint64_t key = (uint64_t) (uintptr_t) addr >> 2;
+    return buckets[(key * 0x9E3779B97F4A7C15ull) >> (64 - bucket_bits)];
+  }
+
+  // lock the bucket a waiter is queued in, which changes on requeue
+  static Bucket& lock_bucket_of(Waiter& w) noexcept
+  {
+    while (true) {
+      auto& bucket = bucket_of(w.addr.load(std::memory_order_acquire));
+      bucket.lock.lock();
+      if (&bucket == &bucket_of(w.addr.load(std::memory_order_relaxed)))
+        return bucket;
+      bucket.lock.unlock();
+    }
+  }
+
+  // a halted CPU only notices that its waiter was woken on an interrupt
+  static void notify(int cpu) noexcept
+  {
+#ifdef INCLUDEOS_SMP_ENABLE
+    if (cpu == SMP::cpu_id()) return;
+    if (cpu == 0) SMP::signal_bsp();
+    else SMP::signal(cpu);
+#else
+    (void) cpu;
+#endif
+  }
+
+  // wake an unlinked waiter, remembering its CPU for notify().
+  // Called with the bucket locked, which the waiter takes before returning.
+  static void wake_unlinked(Waiter* w, std::array<int, SMP_MAX_CORES>& cpus) noexcept
+  {
+    w->state.store(WOKEN, std::memory_order_release);
+    if (w->task != nullptr)
+      Scheduler::unpark(w->task);
+    else
+      cpus[w->cpu]++;
+  }
+
+  static void park() noexcept
+  {
+    // tasks let other tasks run
+    if (Scheduler::current() != nullptr) {
+      Scheduler::park();
+      return;
+    }
+    // let the parent fiber run, it resumes us again later
+    auto* fiber = Fiber::current();
+    if (fiber != nullptr and fiber->parent() != nullptr)
+      Fiber::yield();
+    else
+      os::block();
+  }
+
+  int wait(int* addr, int val, Timeout timeout, uint32_t bitset)
+  {
+    if (bitset == 0) return -EINVAL;
+
+    Waiter w {addr, bitset};
+    {
+      auto& bucket = bucket_of(addr);
+      std::lock_guard<Spinlock> lock(bucket.lock);
+      if (__atomic_load_n(addr, __ATOMIC_SEQ_CST) != val)
+        return -EAGAIN;
+      if (timeout <= Timeout::zero())
+        return -ETIMEDOUT;
+      bucket.push_back(&w);
+    }
+
+    // timers run on this CPU, from the event loop we block in, so a task
+    // stays on this CPU until its timer is stopped
+    const bool timed = timeout != Timeout::max();
+    if (timed) {
+      Scheduler::pin();
+      auto timer = Timers::oneshot(timeout,
+      [&w] (Timers::id_t) {
+        auto& bucket = lock_bucket_of(w);
+        w.timer = Timers::UNUSED_ID;
+        if (w.state.load(std::memory_order_relaxed) == QUEUED) {
+          bucket.unlink(&w);
+          w.state.store(TIMED_OUT, std::memory_order_relaxed);
+          if (w.task != nullptr) Scheduler::unpark(w.task);
+        }
+        bucket.lock.unlock();
+      });
+      // the timer can't fire before we park, but clears w.timer locked
+      auto& bucket = lock_bucket_of(w);
+      w.timer = timer;
+      bucket.lock.unlock();
+    }
+
+    while (w.state.load(std::memory_order_acquire) == QUEUED)
+      park();
+
+    // wait for the waker to let go of w
+    auto& bucket = lock_bucket_of(w);
+    const auto timer = w.timer;
+    bucket.lock.unlock();
+    if (timer != Timers::UNUSED_ID)
+      Timers::stop(timer);
+    if (timed) Scheduler::unpin();
+
+    return (w.state == WOKEN) ? 0 : -ETIMEDOUT;
+  }
+
+  int wake(int* addr, int count, uint32_t bitset)
+  {
+    if (bitset == 0) return -EINVAL;
+
+    std::array<int, SMP_MAX_CORES> cpus {};
+    int woken = 0;
+    {
+      auto& bucket = bucket_of(addr);
+      std::lock_guard<Spinlock> lock(bucket.lock);
+      Waiter* w = bucket.head;
+      while (w != nullptr && woken < count)
+      {
+        Waiter* next = w->next;
+        if (w->addr.load(std::memory_order_relaxed) == addr && (w->bitset & bitset))
+        {
+          bucket.unlink(w);
+          wake_unlinked(w, cpus);
+          woken++;
+        }
+        w = next;
+      }
+    }
+    for (int cpu = 0; cpu < SMP_MAX_CORES; cpu++)
+      if (cpus[cpu]) notify(cpu);
+    return woken;
+  }
+
+  static int do_requeue(int* addr, int count, int* addr2, int requeue,
+                        const int* expected)
+  {
+    if (count < 0 || requeue < 0) return -EINVAL;
+
+    auto& from = bucket_of(addr);
+    auto& to   = bucket_of(addr2);
+    // lock in a fixed order, and only once when the buckets are the same
+    auto& first  = (&from < &to) ? from : to;
+    auto& second = (&from < &to) ? to : from;
+    std::array<int, SMP_MAX_CORES> cpus {};
+    int woken = 0, moved = 0;
+    {
+      std::lock_guard<Spinlock> lock1(first.lock);
+      std::unique_lock<Spinlock> lock2(second.lock, std::defer_lock);
+      if (&first != &second) lock2.lock();
+
+      if (expected && __atomic_load_n(addr, __ATOMIC_SEQ_CST) != *expected)
+        return -EAGAIN;
+
+      Waiter* w = from.head;
+      while (w != nullptr && (woken < count || moved < requeue))
+      {
+        Waiter* next = w->next;
+        if (w->addr.load(std::memory_order_relaxed) == addr)
+        {
+          from.unlink(w);
+          if (woken < count) {
+            wake_unlinked(w, cpus);
+            woken++;
+          }
+          else {
+            w->addr.store(addr2, std::memory_order_release);
+            to.push_back(w);
+            moved++;
+          }
+        }
+        w = next;
+      }
+    }
+    for (int cpu = 0; cpu < SMP_MAX_CORES; cpu++)
+      if (cpus[cpu]) notify(cpu);
+    return woken + moved;
+  }
+
+  int requeue(int* addr, int count, int* addr2, int requeue)
+  {
+    return do_requeue(addr, count, addr2, requeue, nullptr);
+  }
+
+  int cmp_requeue(int* addr, int count, int* addr2, int requeue, int val)
+  {
+    return do_requeue(addr, count, addr2, requeue, &val);
+  }
+
+  size_t waiters(const int* addr)
+  {
+    auto& bucket = bucket_of(addr);
+    std::lock_guard<Spinlock> lock(bucket.lock);
+    size_t count = 0;
+    for (Waiter* w = bucket.head; w != nullptr; w = w->next)
+      if (w->addr.load(std::memory_order_relaxed) == addr) count++;
+    return count;
+  }
+
+}
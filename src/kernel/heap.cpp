@@ -49,6 +49,8 @@ size_t os::total_memuse() noexcept {
 
 constexpr size_t heap_alignment = 4096;
 __attribute__((weak)) ssize_t __brk_max = 0x100000;
+// Align the mmap heap to, and map it with, huge pages. Costs up to one huge page.
+__attribute__((weak)) bool os_huge_page_heap = false;
 
 static bool __heap_ready = false;
 
@@ -72,7 +74,7 @@ void kernel::init_heap(uintptr_t free_mem_begin, uintptr_t memory_end) noexcept
   __init_mmap(brk_end, memory_end);
 
   // Also set the PMR default allocator to use the same allocator as mmap
-  auto& alloc = os::mem::raw_allocator();
+  auto& alloc = os::mem::slab_allocator();
   std::pmr::set_default_resource(&alloc);
 
   __heap_ready = true;
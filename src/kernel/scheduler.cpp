@@ -0,0 +1,375 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <kernel/scheduler.hpp>
+#include <kernel/events.hpp>
+#include <kernel/fiber.hpp>
+#include <kernel/timers.hpp>
+#include <expects>
+#include <smp>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+enum Task_state : int {
+  READY,
+  RUNNING,
+  YIELDING,
+  PARKING,
+  PARKED,
+  BLOCKING,
+  DONE
+};
+
+struct Scheduler::Task {
+  Task() : fiber{&Task::main, this} {}
+
+  static void main(Task* task)
+  {
+    try {
+      task->func();
+    }
+    catch (const std::exception& e) {
+      fprintf(stderr, "Scheduler: task exited on exception: %s\n", e.what());
+    }
+    task->func = nullptr;
+  }
+
+  Fiber fiber;
+  task_func func = nullptr;
+  std::atomic<int>  state {READY};
+  // set by unpark(), consumed by park()
+  std::atomic<bool> permit {false};
+  // the CPU it last ran on, where it is queued when made ready
+  std::atomic<int>  cpu {0};
+  // not stolen while non-zero, only changed by the task itself
+  std::atomic<int>  pinned {0};
+};
+using Task = Scheduler::Task;
+
+struct alignas(SMP_ALIGN) Cpu_sched {
+  Spinlock lock;
+  std::deque<Task*> ready;    // guarded by lock, thieves take from the back
+  std::vector<Task*> blocked; // owner only
+  std::vector<Task*> pool;    // owner only
+  std::vector<Task*> stolen;  // owner only, reused by every steal
+  Task* current = nullptr;
+  int   run_evt = -1;
+  std::atomic<bool> idle {false};
+  Scheduler::Stats stats;
+};
+static SMP::Array<Cpu_sched> cpus;
+
+static void run_ready();
+static void retry_blocked();
+
+static Cpu_sched& local()
+{
+  auto& sched = PER_CPU(cpus);
+  if (UNLIKELY(sched.run_evt < 0)) {
+    auto& events = Events::get();
+    sched.run_evt = events.subscribe(run_ready);
+    events.on_process(retry_blocked);
+  }
+  return sched;
+}
+
+// let the CPU run its queue from its event loop
+static void wake(int cpu)
+{
+  if (cpu == SMP::cpu_id()) {
+    Events::get().trigger_event(local().run_evt);
+    return;
+  }
+#ifdef INCLUDEOS_SMP_ENABLE
+  auto kick = [] { Events::get().trigger_event(local().run_evt); };
+  if (cpu == 0) {
+    SMP::add_bsp_task(kick);
+    SMP::signal_bsp();
+  }
+  else {
+    SMP::add_task(kick, cpu);
+    SMP::signal(cpu);
+  }
+#endif
+}
+
+static void make_ready(Task* task)
+{
+  const int cpu = task->cpu.load(std::memory_order_relaxed);
+  {
+    auto& sched = cpus[cpu];
+    std::lock_guard<Spinlock> lock(sched.lock);
+    sched.ready.push_back(task);
+  }
+  wake(cpu);
+}
+
+// an idle CPU steals when there is more than one task waiting here
+static void share_work()
+{
+  const int me = SMP::cpu_id();
+  for (int cpu = 0; cpu < SMP::cpu_count(); cpu++) {
+    if (cpu == me) continue;
+    if (cpus[cpu].idle.exchange(false)) {
+      wake(cpu);
+      return;
+    }
+  }
+}
+
+static Task* pop_local(Cpu_sched& self)
+{
+  std::lock_guard<Spinlock> lock(self.lock);
+  if (self.ready.empty()) return nullptr;
+  Task* task = self.ready.front();
+  self.ready.pop_front();
+  return task;
+}
+
+// take half of the ready tasks of the first busy CPU, except pinned ones
+static Task* steal(Cpu_sched& self)
+{
+  const int me = SMP::cpu_id();
+  const int count = SMP::cpu_count();
+  auto& stolen = self.stolen;
+  stolen.clear();
+  for (int i = 1; i < count and stolen.empty(); i++)
+  {
+    auto& victim = cpus[(me + i) % count];
+    std::lock_guard<Spinlock> lock(victim.lock);
+    size_t take = (victim.ready.size() + 1) / 2;
+    for (auto it = victim.ready.end(); take > 0 and it != victim.ready.begin();)
+    {
+      --it;
+      if ((*it)->pinned.load(std::memory_order_relaxed)) continue;
+      stolen.push_back(*it);
+      it = victim.ready.erase(it);
+      take--;
+    }
+  }
+  if (stolen.empty()) return nullptr;
+
+  self.stats.steals += stolen.size();
+  for (auto* task : stolen)
+    task->cpu.store(me, std::memory_order_relaxed);
+  // never hold two queue locks, thieves lock them in any order
+  if (stolen.size() > 1) {
+    std::lock_guard<Spinlock> lock(self.lock);
+    self.ready.insert(self.ready.end(), stolen.begin() + 1, stolen.end());
+  }
+  return stolen.front();
+}
+
+static void finish(Cpu_sched& self, Task* task)
+{
+  task->state.store(DONE, std::memory_order_relaxed);
+  self.stats.finished++;
+  if (self.pool.size() < Scheduler::pool_size) {
+    task->fiber.restart();
+    self.pool.push_back(task);
+  }
+  else {
+    delete task;
+  }
+}
+
+static void run(Cpu_sched& self, Task* task)
+{
+  task->state.store(RUNNING, std::memory_order_relaxed);
+  self.current = task;
+  self.stats.switches++;
+  if (task->fiber.started())
+    task->fiber.resume();
+  else
+    task->fiber.start();
+  // back when the task finished, or yielded for one of the reasons below
+  self.current = nullptr;
+
+  if (task->fiber.done()) {
+    finish(self, task);
+    return;
+  }
+  switch (task->state.load(std::memory_order_relaxed)) {
+  case YIELDING:
+    task->state.store(READY, std::memory_order_relaxed);
+    {
+      std::lock_guard<Spinlock> lock(self.lock);
+      self.ready.push_back(task);
+    }
+    break;
+  case BLOCKING:
+    self.blocked.push_back(task);
+    break;
+  case PARKING:
+    // unpark() either sees PARKED, or we see its permit
+    task->state.store(PARKED);
+    if (task->permit.load()) {
+      int expected = PARKED;
+      if (task->state.compare_exchange_strong(expected, READY))
+        make_ready(task);
+    }
+    break;
+  default:
+    Expects(0 && "Task yielded outside the scheduler");
+  }
+}
+
+static void run_ready()
+{
+  auto& self = local();
+  // tasks never run nested, even if one processes events itself
+  if (self.current != nullptr) return;
+
+  self.idle.store(false, std::memory_order_relaxed);
+  for (int i = 0; i < Scheduler::batch_size; i++)
+  {
+    Task* task = pop_local(self);
+    if (task == nullptr) task = steal(self);
+    if (task == nullptr) {
+      self.idle.store(true, std::memory_order_relaxed);
+      return;
+    }
+    run(self, task);
+  }
+  // let other events in before the next batch
+  std::lock_guard<Spinlock> lock(self.lock);
+  if (not self.ready.empty())
+    Events::get().trigger_event(self.run_evt);
+}
+
+static void retry_blocked()
+{
+  auto& self = PER_CPU(cpus);
+  if (self.blocked.empty()) return;
+  {
+    std::lock_guard<Spinlock> lock(self.lock);
+    for (auto* task : self.blocked) {
+      task->state.store(READY, std::memory_order_relaxed);
+      self.ready.push_back(task);
+    }
+  }
+  self.blocked.clear();
+  Events::get().trigger_event(self.run_evt);
+}
+
+void Scheduler::spawn(task_func func, int cpu)
+{
+  Expects(func);
+  Expects(cpu < SMP::cpu_count());
+  auto& self = local();
+  Task* task;
+  if (not self.pool.empty()) {
+    task = self.pool.back();
+    self.pool.pop_back();
+  }
+  else {
+    task = new Task();
+  }
+  task->func = std::move(func);
+  task->state.store(READY, std::memory_order_relaxed);
+  task->permit.store(false, std::memory_order_relaxed);
+  task->pinned.store(0, std::memory_order_relaxed);
+  task->cpu.store(cpu < 0 ? SMP::cpu_id() : cpu, std::memory_order_relaxed);
+  self.stats.spawned++;
+  make_ready(task);
+
+  if (SMP::cpu_count() > 1) {
+    std::unique_lock<Spinlock> lock(self.lock);
+    const bool busy = self.ready.size() > 1;
+    lock.unlock();
+    if (busy) share_work();
+  }
+}
+
+Task* Scheduler::current() noexcept
+{
+  return PER_CPU(cpus).current;
+}
+
+void Scheduler::yield()
+{
+  Task* task = current();
+  if (task == nullptr) return;
+  task->state.store(YIELDING, std::memory_order_relaxed);
+  Fiber::yield();
+}
+
+void Scheduler::park()
+{
+  Task* task = current();
+  Expects(task != nullptr);
+  if (task->permit.exchange(false)) return;
+  task->state.store(PARKING, std::memory_order_relaxed);
+  Fiber::yield();
+  task->permit.store(false);
+}
+
+void Scheduler::unpark(Task* task) noexcept
+{
+  task->permit.store(true);
+  int expected = PARKED;
+  if (task->state.compare_exchange_strong(expected, READY))
+    make_ready(task);
+}
+
+void Scheduler::sleep(std::chrono::nanoseconds duration)
+{
+  Task* task = current();
+  Expects(task != nullptr);
+  // the timer fires on this CPU, while the task is parked
+  bool expired = false;
+  Timers::oneshot(duration,
+  [task, &expired] (Timers::id_t) {
+    expired = true;
+    unpark(task);
+  });
+  while (not expired) park();
+}
+
+void Scheduler::pin() noexcept
+{
+  Task* task = current();
+  if (task != nullptr) task->pinned.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Scheduler::unpin() noexcept
+{
+  Task* task = current();
+  if (task != nullptr) task->pinned.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void Scheduler::block()
+{
+  Task* task = current();
+  Expects(task != nullptr);
+  task->state.store(BLOCKING, std::memory_order_relaxed);
+  Fiber::yield();
+}
+
+Scheduler::Stats Scheduler::stats(int cpu)
+{
+  auto& sched = cpus.at(cpu);
+  Stats st = sched.stats;
+  st.blocked = sched.blocked.size();
+  st.pooled  = sched.pool.size();
+  std::lock_guard<Spinlock> lock(sched.lock);
+  st.ready = sched.ready.size();
+  return st;
+}
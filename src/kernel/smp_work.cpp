@@ -0,0 +1,198 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <kernel/smp_work.hpp>
+#include <kernel/events.hpp>
+#include <util/mpsc_ring.hpp>
+#include <expects>
+#include <smp>
+#include <smp_utils>
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+
+namespace os::smp {
+
+  struct alignas(SMP_ALIGN) Cpu_work {
+    Mpsc_ring<Work, ring_size> ring;
+    // set by the first post after a drain, so one notification is enough
+    std::atomic<bool> notified {false};
+    // CPUs this CPU has posted to since its last flush, owner only
+    std::bitset<SMP_MAX_CORES> to_notify;
+    int   local_evt = -1;
+    Stats stats;
+  };
+  static SMP::Array<Cpu_work> cpus;
+
+  static Cpu_work& local()
+  {
+    auto& self = PER_CPU(cpus);
+    if (UNLIKELY(self.local_evt < 0))
+      self.local_evt = Events::get().subscribe(drain);
+    return self;
+  }
+
+  bool post(int cpu, Work work)
+  {
+    Expects(cpu >= 0 and cpu < SMP::cpu_count());
+    auto& self = local();
+    auto& target = cpus[cpu];
+    if (UNLIKELY(not target.ring.push(std::move(work)))) {
+      self.stats.full++;
+      return false;
+    }
+    self.stats.posted++;
+    if (not target.notified.exchange(true))
+      self.to_notify.set(cpu);
+    return true;
+  }
+
+  void flush()
+  {
+    auto& self = local();
+    if (self.to_notify.none()) return;
+    const int me = SMP::cpu_id();
+    for (int cpu = 0; cpu < SMP_MAX_CORES; cpu++)
+    {
+      if (not self.to_notify.test(cpu)) continue;
+      if (cpu == me) {
+        Events::get().trigger_event(self.local_evt);
+        continue;
+      }
+      self.stats.ipis++;
+#ifdef INCLUDEOS_SMP_ENABLE
+      if (cpu == 0) SMP::signal_bsp();
+      else SMP::signal(cpu);
+#endif
+    }
+    self.to_notify.reset();
+  }
+
+  // a done callback that has to go back to where the work came from
+  struct Round_trip {
+    Work work;
+    Work done;
+    int  origin;
+  };
+
+  bool run_on(int cpu, Work work, Work done)
+  {
+    bool posted;
+    if (done == nullptr) {
+      posted = post(cpu, std::move(work));
+    }
+    else {
+      auto* trip = new Round_trip{std::move(work), std::move(done), SMP::cpu_id()};
+      posted = post(cpu, [trip] {
+        trip->work();
+        // the origin drains its ring while we wait for room
+        while (not post(trip->origin, std::move(trip->done))) {
+          flush();
+          os::Arch::cpu_relax();
+        }
+        delete trip;
+      });
+      if (not posted) delete trip;
+    }
+    flush();
+    return posted;
+  }
+
+  void drain()
+  {
+    auto& self = local();
+    // anything posted from here on notifies us again
+    self.notified.store(false);
+    Work work;
+    while (self.ring.pop(work)) {
+      self.stats.executed++;
+      work();
+    }
+    // notify the CPUs the work posted to
+    flush();
+  }
+
+  namespace detail {
+
+    size_t chunk_count(size_t total, size_t grain) noexcept
+    {
+      if (grain == 0) grain = 1;
+      const size_t most = 8 * (size_t) SMP::cpu_count();
+      return std::clamp<size_t>((total + grain - 1) / grain, 1, most);
+    }
+
+    struct Chunk_job {
+      delegate<void(size_t)> fn;
+      const size_t        chunks;
+      std::atomic<size_t> next {0};
+      // helpers still holding on to the job
+      std::atomic<int>    helpers {0};
+
+      void run() {
+        size_t i;
+        while ((i = next.fetch_add(1, std::memory_order_relaxed)) < chunks)
+          fn(i);
+      }
+    };
+
+    void for_each_chunk(size_t chunks, delegate<void(size_t)> fn)
+    {
+      Chunk_job job {std::move(fn), chunks};
+      const int me = SMP::cpu_id();
+      const int wanted = std::min<size_t>(SMP::cpu_count(), chunks) - 1;
+      for (int cpu = 0; cpu < SMP::cpu_count() and job.helpers < wanted; cpu++)
+      {
+        if (cpu == me) continue;
+        job.helpers++;
+        const bool posted = post(cpu, [&job] {
+          job.run();
+          job.helpers.fetch_sub(1, std::memory_order_release);
+        });
+        if (not posted) job.helpers--;
+      }
+      flush();
+      job.run();
+      // helpers may not have started yet, keep our own ring moving meanwhile
+      while (job.helpers.load(std::memory_order_acquire) > 0) {
+        drain();
+        os::Arch::cpu_relax();
+      }
+    }
+
+  }
+
+  void parallel_for(size_t begin, size_t end,
+                    delegate<void(size_t, size_t)> body, size_t grain)
+  {
+    if (end <= begin) return;
+    struct Job {
+      delegate<void(size_t, size_t)>& body;
+      size_t begin, total, chunks;
+    } job {body, begin, end - begin, detail::chunk_count(end - begin, grain)};
+
+    detail::for_each_chunk(job.chunks, [&job] (size_t i) {
+      const size_t first = job.begin + job.total * i / job.chunks;
+      const size_t last  = job.begin + job.total * (i + 1) / job.chunks;
+      job.body(first, last);
+    });
+  }
+
+  Stats stats(int cpu)
+  {
+    return cpus.at(cpu).stats;
+  }
+
+}
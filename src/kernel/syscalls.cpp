@@ -18,6 +18,7 @@
 #include <os.hpp>
 #include <kernel.hpp>
 #include <os.hpp>
+#include <kernel/async_log.hpp>
 #include <kernel/elf.hpp>
 #include <system_log>
 #include <statman>
@@ -129,6 +130,9 @@ void os::panic(const char* why) noexcept
   SMP::global_lock();
 #endif
 
+  // Get the queued log records out before the panic output
+  os::async_log::flush();
+
   // Tell the System log that we have paniced
   if (SystemLog::is_initialized()) {
     SystemLog::set_flags(SystemLog::PANIC);
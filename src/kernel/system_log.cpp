@@ -1,9 +1,12 @@
 #include <system_log>
 #include <kernel.hpp>
 #include <os.hpp>
+#include <kernel/async_log.hpp>
 #include <kernel/memory.hpp>
 #include <ringbuffer>
+#include <algorithm>
 #include <kprint>
+#include <syslog.h>
 
 struct Log_buffer {
   uint64_t magic;
@@ -132,8 +135,34 @@ void SystemLog::initialize()
   SystemLog::write(temp_mrb.sequentialize(), temp_mrb.size());
 }
 
+static int log_channel = -1;
+
+static void system_log_flush(const os::async_log::Record* records, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+    SystemLog::write(records[i].text.data(), records[i].text.size());
+}
+
+static void system_log_print(const char* data, size_t len)
+{
+  // while panicking there may be no more flushes
+  if (not os::async_log::is_running() or kernel::is_panicking()) {
+    SystemLog::write(data, len);
+    return;
+  }
+  // long writes take several records, rather than being cut
+  while (len > 0)
+  {
+    const size_t part = std::min(len, os::async_log::max_record);
+    os::async_log::write(log_channel, LOG_INFO, data, part);
+    data += part;
+    len  -= part;
+  }
+}
+
 __attribute__((constructor))
 static void system_log_gconstr()
 {
-  os::add_stdout(SystemLog::write);
+  log_channel = os::async_log::add_channel(system_log_flush);
+  os::add_stdout(system_log_print);
 }
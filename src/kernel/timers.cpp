@@ -185,10 +185,22 @@ void Timers::stop(Timers::id_t id)
   for (; it != system.scheduled.end(); ++it) {
     // found dead timer
     if (id == it->second) {
+      const bool was_front = (it == system.scheduled.begin());
       // erase from schedule
       system.scheduled.erase(it);
       // free from system
       system.free_timer(id);
+      // the hardware timer is armed for this timer, so re-arm it for the
+      // next deadline, or stop it, instead of waking up for nothing
+      if (was_front && system.is_running) {
+        if (system.scheduled.empty()) {
+          system.is_running = false;
+          system.arch_stop_func();
+        }
+        else {
+          Events::get().trigger_event(system.interrupt);
+        }
+      }
       break;
     }
   }
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+#
+# Build a packed asset image (fs::Asset_pack) from the files in a folder.
+#
+# Layout, all little endian:
+#   header (64 bytes), entries (64 bytes each, sorted by path),
+#   hash table (int32 seed[count], uint32 slot[count]), path strings,
+#   then the file data, every file starting on a page boundary.
+#
+# Paths are found with a hash-and-displace perfect hash: a path goes in
+# bucket hash(0, path) % count. Buckets with one path store -(slot + 1)
+# directly, larger ones store the seed that spreads their paths over free
+# slots with hash(seed, path) % count.
+
+from __future__ import print_function
+import argparse
+import gzip
+import io
+import os
+import struct
+import sys
+
+MAGIC     = b'IOSPACK1'
+VERSION   = 1
+HEADER    = struct.Struct('<8sIIIIQQQQQ')
+ENTRY     = struct.Struct('<IHHII' + 'QQ' * 3)
+IDENTITY, GZIP, BROTLI = range(3)
+SUFFIXES  = {'.gz': GZIP, '.br': BROTLI}
+
+def fnv1a(seed, data):
+  h = seed if seed else 0x811C9DC5
+  for c in data:
+    h = ((h ^ c) * 0x01000193) & 0xFFFFFFFF
+  return h
+
+def perfect_hash(keys):
+  n = len(keys)
+  buckets = [[] for _ in range(n)]
+  for i, key in enumerate(keys):
+    buckets[fnv1a(0, key) % n].append(i)
+  buckets.sort(key=len, reverse=True)
+
+  seeds = [0] * n
+  slots = [None] * n
+  singles = []
+  for bucket in buckets:
+    if len(bucket) == 0:
+      break
+    if len(bucket) == 1:
+      singles.append(bucket[0])
+      continue
+    seed = 1
+    while True:
+      taken = [fnv1a(seed, keys[i]) % n for i in bucket]
+      if len(set(taken)) == len(taken) and all(slots[s] is None for s in taken):
+        break
+      seed += 1
+      if seed >= 0x7FFFFFFF:
+        sys.exit("assetpack: no perfect hash found")
+    seeds[fnv1a(0, keys[bucket[0]]) % n] = seed
+    for i, s in zip(bucket, taken):
+      slots[s] = i
+
+  free = [s for s in range(n) if slots[s] is None]
+  for i in singles:
+    s = free.pop()
+    seeds[fnv1a(0, keys[i]) % n] = -s - 1
+    slots[s] = i
+  return seeds, slots
+
+def compress_gzip(data):
+  out = io.BytesIO()
+  # mtime=0 keeps the image reproducible
+  with gzip.GzipFile(fileobj=out, mode='wb', compresslevel=9, mtime=0) as f:
+    f.write(data)
+  return out.getvalue()
+
+def collect(folder, want_gzip, want_brotli):
+  brotli = None
+  if want_brotli:
+    try:
+      import brotli
+    except ImportError:
+      print("assetpack: brotli module not found, skipping brotli", file=sys.stderr)
+
+  files = {}
+  precompressed = []
+  for root, dirs, names in os.walk(folder):
+    dirs.sort()
+    for name in sorted(names):
+      full = os.path.join(root, name)
+      path = os.path.relpath(full, folder).replace(os.sep, '/')
+      with open(full, 'rb') as f:
+        data = f.read()
+      base, ext = os.path.splitext(path)
+      if ext in SUFFIXES:
+        precompressed.append((base, SUFFIXES[ext], path, data))
+      files[path] = [data, None, None]
+
+  # foo.js.gz next to foo.js is the gzip variant of foo.js
+  for base, enc, path, data in precompressed:
+    if base in files:
+      files[base][enc] = data
+      del files[path]
+
+  for path, variants in files.items():
+    data = variants[IDENTITY]
+    if want_gzip and variants[GZIP] is None:
+      packed = compress_gzip(data)
+      if len(packed) < len(data):
+        variants[GZIP] = packed
+    if brotli and variants[BROTLI] is None:
+      packed = brotli.compress(data)
+      if len(packed) < len(data):
+        variants[BROTLI] = packed
+  return files
+
+def align(n, page):
+  return (n + page - 1) // page * page
+
+def build(files, page):
+  paths = sorted(files.keys(), key=lambda p: p.encode('utf-8'))
+  keys = [p.encode('utf-8') for p in paths]
+  count = len(keys)
+  seeds, slots = perfect_hash(keys) if count else ([], [])
+
+  entries_ofs = HEADER.size
+  table_ofs   = entries_ofs + ENTRY.size * count
+  strings_ofs = table_ofs + 8 * count
+  strings     = b''.join(keys)
+  data_ofs    = align(strings_ofs + len(strings), page)
+
+  entries = b''
+  blobs = []
+  pos = data_ofs
+  str_pos = 0
+  for path, key in zip(paths, keys):
+    fields = []
+    for data in files[path]:
+      if data is None:
+        fields += [0, 0]
+        continue
+      fields += [pos, len(data)]
+      blobs.append((pos, data))
+      pos = align(pos + len(data), page)
+    entries += ENTRY.pack(str_pos, len(key), 0, fnv1a(0, key), 0, *fields)
+    str_pos += len(key)
+
+  image = bytearray(pos)
+  HEADER.pack_into(image, 0, MAGIC, VERSION, count, page, 0,
+                   entries_ofs, table_ofs, strings_ofs, len(strings), pos)
+  image[entries_ofs:table_ofs] = entries
+  table = struct.pack('<%di%dI' % (count, count), *(seeds + slots))
+  image[table_ofs:strings_ofs] = table
+  image[strings_ofs:strings_ofs + len(strings)] = strings
+  for ofs, data in blobs:
+    image[ofs:ofs + len(data)] = data
+  return bytes(image)
+
+def main():
+  parser = argparse.ArgumentParser(description='Create a packed asset image')
+  parser.add_argument('folder', help='a folder with files')
+  parser.add_argument('-o', '--output', default='memdisk.pack', help='the image to write')
+  parser.add_argument('--gzip', action='store_true', help='add gzip variants')
+  parser.add_argument('--brotli', action='store_true', help='add brotli variants')
+  parser.add_argument('--page-size', type=int, default=4096, help='file data alignment')
+  args = parser.parse_args()
+
+  files = collect(args.folder, args.gzip, args.brotli)
+  image = build(files, args.page_size)
+  with open(args.output, 'wb') as f:
+    f.write(image)
+  print("assetpack: %d files, %d bytes => %s" % (len(files), len(image), args.output))
+
+if __name__ == '__main__':
+  main()
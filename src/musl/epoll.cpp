@@ -0,0 +1,66 @@
+#include "common.hpp"
+#include <posix/fd_map.hpp>
+#include <posix/epoll_fd.hpp>
+#include <signal.h>
+
+using namespace std::chrono;
+
+static long sys_epoll_create1(int /*flags*/)
+{
+  return FD_map::_open<Epoll_FD>().get_id();
+}
+
+static long sys_epoll_create(int size)
+{
+  if (size <= 0) return -EINVAL;
+  return sys_epoll_create1(0);
+}
+
+static long sys_epoll_ctl(int epfd, int op, int fd, struct epoll_event* event)
+{
+  auto* epoll = dynamic_cast<Epoll_FD*>(FD_map::_get(epfd));
+  if (epoll == nullptr) return -EBADF;
+  return epoll->ctl(op, fd, event);
+}
+
+static long sys_epoll_pwait(int epfd, struct epoll_event* events,
+                            int maxevents, int timeout, const sigset_t*)
+{
+  auto* epoll = dynamic_cast<Epoll_FD*>(FD_map::_get(epfd));
+  if (epoll == nullptr) return -EBADF;
+  const auto tmo = (timeout < 0) ? Epoll_FD::Timeout::max() : milliseconds(timeout);
+  return epoll->wait(events, maxevents, tmo);
+}
+
+static long sys_epoll_wait(int epfd, struct epoll_event* events,
+                           int maxevents, int timeout)
+{
+  return sys_epoll_pwait(epfd, events, maxevents, timeout, nullptr);
+}
+
+extern "C"
+long syscall_SYS_epoll_create(int size) {
+  return strace(sys_epoll_create, "epoll_create", size);
+}
+
+extern "C"
+long syscall_SYS_epoll_create1(int flags) {
+  return strace(sys_epoll_create1, "epoll_create1", flags);
+}
+
+extern "C"
+long syscall_SYS_epoll_ctl(int epfd, int op, int fd, struct epoll_event* event) {
+  return strace(sys_epoll_ctl, "epoll_ctl", epfd, op, fd, event);
+}
+
+extern "C"
+long syscall_SYS_epoll_wait(int epfd, struct epoll_event* events,
+                            int maxevents, int timeout) {
+  return strace(sys_epoll_wait, "epoll_wait", epfd, events, maxevents, timeout);
+}
+
+extern "C"
+long syscall_SYS_epoll_pwait(int epfd, struct epoll_event* events,
+                             int maxevents, int timeout, const sigset_t* sigmask) {
+  return strace(sys_epoll_pwait, "epoll_pwait", epfd, events, maxevents, timeout, sigmask);
+}
@@ -1,6 +1,8 @@
-#include "stub.hpp"
+#include "common.hpp"
+#include <kernel/futex.hpp>
+#include <algorithm>
 #include <errno.h>
-#include <kprint>
+#include <time.h>
 
 #define FUTEX_WAIT 0
 #define FUTEX_WAKE 1
@@ -12,38 +14,69 @@
 #define FUTEX_UNLOCK_PI 7
 #define FUTEX_TRYLOCK_PI 8
 #define FUTEX_WAIT_BITSET 9
+#define FUTEX_WAKE_BITSET 10
 #define FUTEX_PRIVATE 128
 #define FUTEX_CLOCK_REALTIME 256
 
-extern void print_backtrace();
+using namespace std::chrono;
 
-static int sys_futex(int *uaddr, int /*futex_op*/, int val,
-                      const struct timespec *timeout, int /*val3*/)
+static int64_t to_nanos(const struct timespec* ts)
 {
+  return ts->tv_sec * 1'000'000'000ll + ts->tv_nsec;
+}
 
-  if (*uaddr != val){
-    return EAGAIN;
-  } else {
-    *uaddr = 0;
-  }
+// FUTEX_WAIT has a relative timeout, FUTEX_WAIT_BITSET an absolute one
+static os::futex::Timeout timeout_of(int op, const struct timespec* timeout)
+{
+  if (timeout == nullptr)
+    return os::futex::Timeout::max();
+  if ((op & 127) == FUTEX_WAIT)
+    return nanoseconds(to_nanos(timeout));
 
-  if (timeout == nullptr){
-    kprintf("No timeout\n");
+  int64_t now;
+  if (op & FUTEX_CLOCK_REALTIME) {
+    const auto wall = __arch_wall_clock();
+    now = to_nanos(&wall);
+  }
+  else {
+    now = __arch_system_time();
   }
+  return nanoseconds(std::max(to_nanos(timeout) - now, (int64_t) 0));
+}
 
-  return 0;
+static int sys_futex(int *uaddr, int futex_op, int val,
+                      const struct timespec *timeout, int* uaddr2, int val3)
+{
+  // every futex is private to this (only) process
+  switch (futex_op & 127) {
+  case FUTEX_WAIT:
+    return os::futex::wait(uaddr, val, timeout_of(futex_op, timeout));
+  case FUTEX_WAIT_BITSET:
+    return os::futex::wait(uaddr, val, timeout_of(futex_op, timeout), val3);
+  case FUTEX_WAKE:
+    return os::futex::wake(uaddr, val);
+  case FUTEX_WAKE_BITSET:
+    return os::futex::wake(uaddr, val, val3);
+  // the timeout argument is the number of waiters to requeue
+  case FUTEX_REQUEUE:
+    return os::futex::requeue(uaddr, val, uaddr2, (int) (uintptr_t) timeout);
+  case FUTEX_CMP_REQUEUE:
+    return os::futex::cmp_requeue(uaddr, val, uaddr2, (int) (uintptr_t) timeout, val3);
+  default:
+    return -ENOSYS;
+  }
 }
 
 extern "C"
 int syscall_SYS_futex(int *uaddr, int futex_op, int val,
-                      const struct timespec *timeout, int val3)
+                      const struct timespec *timeout, int* uaddr2, int val3)
 {
-  return stubtrace(sys_futex, "futex", uaddr, futex_op, val, timeout, val3);
+  return strace(sys_futex, "futex", uaddr, futex_op, val, timeout, uaddr2, val3);
 }
 
 extern "C"
 int syscall_SYS_futex_time64(int *uaddr, int futex_op, int val,
-                      const struct timespec *timeout, int val3)
+                      const struct timespec *timeout, int* uaddr2, int val3)
 {
-  return stubtrace(sys_futex, "futex_time64", uaddr, futex_op, val, timeout, val3);
+  return strace(sys_futex, "futex_time64", uaddr, futex_op, val, timeout, uaddr2, val3);
 }
@@ -7,39 +7,158 @@
 #include <kernel/memory.hpp>
 #include <kernel.hpp>
 #include <kprint>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
 
 using Alloc = os::mem::Raw_allocator;
+using Slab_alloc = os::mem::Slab_allocator;
 static Alloc* alloc;
+static Slab_alloc* slabs;
 
 Alloc& os::mem::raw_allocator() {
   Expects(alloc);
   return *alloc;
 }
 
+Slab_alloc& os::mem::slab_allocator() {
+  Expects(slabs);
+  return *slabs;
+}
+
+extern bool os_huge_page_heap;
+
 uintptr_t __init_mmap(uintptr_t addr_begin, size_t size)
 {
   auto aligned_begin = (addr_begin + Alloc::align - 1) & ~(Alloc::align - 1);
   int64_t len = size & ~int64_t(Alloc::align - 1);
 
   alloc = Alloc::create((void*)aligned_begin, len);
+
+  // Buddy chunks are aligned to their size relative to the start of the pool,
+  // so with an aligned pool every chunk of huge page size or more is a huge page.
+  const auto huge = os::mem::huge_psize();
+  if (os_huge_page_heap and huge)
+  {
+    for (int tries = 0; tries < 4 and (alloc->addr_begin() & (huge - 1)) != 0; tries++)
+    {
+      const auto misalign = alloc->addr_begin() & (huge - 1);
+      aligned_begin += huge - misalign;
+      len -= huge - misalign;
+      alloc = Alloc::create((void*)aligned_begin, len);
+    }
+    if ((alloc->addr_begin() & (huge - 1)) != 0)
+      kprintf("[ mmap ] Pool at %p is not huge page aligned, "
+              "huge page allocations may fail\n",
+              (void*) alloc->addr_begin());
+  }
+  // small objects are served from per-CPU slabs, only pages reach the buddy
+  alignas(Slab_alloc) static char slab_storage[sizeof(Slab_alloc)];
+  slabs = new (slab_storage) Slab_alloc(*alloc);
   return aligned_begin + len;
 }
 
 extern "C" __attribute__((weak))
 void* kalloc(size_t size) {
   Expects(kernel::heap_ready());
-  return alloc->allocate(size);
+  return slabs->allocate(size);
 }
 
 extern "C" __attribute__((weak))
 void* kalloc_aligned(size_t alignment, size_t size) {
   Expects(kernel::heap_ready());
-  return alloc->do_allocate(size, alignment);
+  return slabs->do_allocate(size, alignment);
 }
 
 extern "C" __attribute__((weak))
 void kfree (void* ptr, size_t size) {
-  alloc->deallocate(ptr, size);
+  slabs->deallocate(ptr, size);
+}
+
+// C++ allocations go to the slabs, which hand sizes above their largest
+// class on to the buddy allocator. Memory from before the heap was ready
+// comes from, and goes back to, musl's malloc.
+static void* slab_new(size_t size, size_t align) noexcept
+{
+  if (UNLIKELY(not kernel::heap_ready()))
+    return aligned_alloc(align, util::bits::roundto(align, size));
+  // the buddy allocator only aligns chunks to pages
+  Expects(align <= os::mem::slab::slab_size);
+  return slabs->do_allocate(size ? size : 1, align);
+}
+
+static void slab_delete(void* ptr) noexcept
+{
+  if (ptr == nullptr) return;
+  if (UNLIKELY(alloc == nullptr or not alloc->in_range(ptr))) {
+    free(ptr);
+    return;
+  }
+  // slab objects know their slab, and the buddy allocator knows its chunks
+  slabs->deallocate(ptr, 0);
+}
+
+static void* throwing_new(size_t size, size_t align)
+{
+  void* ptr = slab_new(size, align);
+  if (UNLIKELY(ptr == nullptr)) throw std::bad_alloc();
+  return ptr;
+}
+
+static constexpr size_t default_align = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+void* operator new(size_t size)
+{ return throwing_new(size, default_align); }
+void* operator new[](size_t size)
+{ return throwing_new(size, default_align); }
+void* operator new(size_t size, std::align_val_t align)
+{ return throwing_new(size, std::max(default_align, (size_t) align)); }
+void* operator new[](size_t size, std::align_val_t align)
+{ return throwing_new(size, std::max(default_align, (size_t) align)); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{ return slab_new(size, default_align); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{ return slab_new(size, default_align); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{ return slab_new(size, std::max(default_align, (size_t) align)); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{ return slab_new(size, std::max(default_align, (size_t) align)); }
+
+void operator delete(void* ptr) noexcept { slab_delete(ptr); }
+void operator delete[](void* ptr) noexcept { slab_delete(ptr); }
+void operator delete(void* ptr, size_t) noexcept { slab_delete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { slab_delete(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { slab_delete(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { slab_delete(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { slab_delete(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { slab_delete(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { slab_delete(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { slab_delete(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { slab_delete(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { slab_delete(ptr); }
+
+void* os::mem::alloc_huge(size_t size)
+{
+  Expects(kernel::heap_ready());
+  const auto huge = huge_psize();
+  if (huge == 0) return nullptr;
+
+  size = util::bits::roundto(huge, size);
+  auto* region = alloc->allocate(size);
+  if (region == nullptr) return nullptr;
+
+  if (((uintptr_t) region & (huge - 1)) != 0) {
+    alloc->deallocate(region, size);
+    return nullptr;
+  }
+  map_huge((uintptr_t) region, size);
+  return region;
+}
+
+void os::mem::free_huge(void* addr, size_t size)
+{
+  alloc->deallocate(addr, util::bits::roundto(huge_psize(), size));
 }
 
 size_t mmap_bytes_used() {
@@ -103,7 +222,8 @@ static void* sys_mmap(void * addr, size_t length, int /*prot*/, int flags,
   // fd should be 0, address should be 0 for MAP_PRIVATE
   // (address is in any case ignored)
 
-  auto* res = kalloc(length);
+  // mappings are page aligned, so never served from a slab
+  auto* res = kalloc(util::bits::roundto(Alloc::min_size, length));
 
   if (UNLIKELY(res == nullptr)) {
     errno = ENOMEM;
@@ -1,32 +1,72 @@
-#include "stub.hpp"
+#include "common.hpp"
+#include <posix/fd_map.hpp>
+#include <kernel/rtc.hpp>
 #include <poll.h>
 #include <signal.h>
 
+using namespace std::chrono;
 
-static long sys_poll(struct pollfd *fds, nfds_t nfds, int /*timeout*/)
+static int revents_of(const struct pollfd& pfd)
 {
-  for (nfds_t i = 0; i < nfds; i++)
-  {
-    fds[i].revents = fds[i].events;
-  }
-  return nfds;
+  // errors and hangups are reported whether asked for or not
+  const int mask = pfd.events | POLLERR | POLLHUP;
+  if (auto* fildes = FD_map::_get(pfd.fd); fildes)
+    return fildes->poll_events() & mask;
+  // stdout and stderr are always writable
+  if (pfd.fd == 1 || pfd.fd == 2)
+    return pfd.events & (POLLOUT | POLLWRNORM);
+  if (pfd.fd == 0)
+    return 0;
+  return POLLNVAL;
 }
-static long sys_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec * /*timeout_ts*/, const sigset_t * /*sigmask*/)
+
+static long do_poll(struct pollfd *fds, nfds_t nfds, nanoseconds timeout)
 {
-  for (nfds_t i = 0; i < nfds; i++)
+  const bool forever = (timeout == nanoseconds::max());
+  const uint64_t deadline = forever ? 0 : RTC::nanos_now() + timeout.count();
+  while (true)
   {
-    fds[i].revents = fds[i].events;
+    // notifications after this are not missed while scanning
+    const int seq = FD::ready_sequence();
+    long count = 0;
+    for (nfds_t i = 0; i < nfds; i++)
+    {
+      // negative descriptors are ignored
+      fds[i].revents = (fds[i].fd >= 0) ? revents_of(fds[i]) : 0;
+      if (fds[i].revents) count++;
+    }
+    if (count > 0 || timeout == nanoseconds::zero())
+      return count;
+
+    auto left = nanoseconds::max();
+    if (not forever) {
+      const uint64_t now = RTC::nanos_now();
+      if (now >= deadline) return 0;
+      left = nanoseconds(deadline - now);
+    }
+    if (not FD::wait_ready(seq, left))
+      return 0;
   }
-  return nfds;
+}
+
+static long sys_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  return do_poll(fds, nfds, (timeout < 0) ? nanoseconds::max() : milliseconds(timeout));
+}
+static long sys_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *timeout_ts, const sigset_t * /*sigmask*/)
+{
+  if (timeout_ts == nullptr)
+    return do_poll(fds, nfds, nanoseconds::max());
+  return do_poll(fds, nfds, seconds(timeout_ts->tv_sec) + nanoseconds(timeout_ts->tv_nsec));
 }
 extern "C"
 long syscall_SYS_poll(struct pollfd *fds, nfds_t nfds, int timeout)
 {
-  return stubtrace(sys_poll, "poll", fds, nfds, timeout);
+  return strace(sys_poll, "poll", fds, nfds, timeout);
 }
 
 extern "C"
 int syscall_SYS_ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *timeout_ts, const sigset_t *sigmask)
 {
-	return stubtrace(sys_ppoll, "ppoll", fds, nfds, timeout_ts,sigmask);
+	return strace(sys_ppoll, "ppoll", fds, nfds, timeout_ts,sigmask);
 }
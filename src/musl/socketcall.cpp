@@ -14,6 +14,8 @@ static long sock_socket(int domain, int type, int protocol)
   // currently only support for AF_INET (IPv4, no local/unix or IP6)
   if (UNLIKELY(domain != AF_INET))
     return -EAFNOSUPPORT;
+  const bool non_blocking = type & SOCK_NONBLOCK;
+  type &= ~(SOCK_NONBLOCK | SOCK_CLOEXEC);
   // disallow RAW etc
   if (UNLIKELY(type < 0 || type > SOCK_DGRAM))
     return -EINVAL;
@@ -21,17 +23,22 @@ static long sock_socket(int domain, int type, int protocol)
   if (UNLIKELY(protocol < 0))
     return -EPROTONOSUPPORT;
 
-  return [](const int type)->int{
+  FD* fd = [](const int type)->FD*{
     switch(type)
     {
       case SOCK_STREAM:
-        return FD_map::_open<TCP_FD>().get_id();
+        return &FD_map::_open<TCP_FD>();
       case SOCK_DGRAM:
-        return FD_map::_open<UDP_FD>().get_id();
+        return &FD_map::_open<UDP_FD>();
       default:
-        return -EINVAL;
+        return nullptr;
     }
   }(type);
+  if (UNLIKELY(fd == nullptr))
+    return -EINVAL;
+
+  fd->set_blocking(not non_blocking);
+  return fd->get_id();
 }
 
 static long sock_connect(int sockfd, const struct sockaddr *addr,
@@ -43,19 +43,37 @@ namespace net {
   {
     assert(num != 0);
     assert(bufsize != 0);
-    available_.reserve(num);
 
-    this->create_new_pool();
-    assert(this->available_.capacity() == num);
-    assert(available() == num);
+    // Large pools are placed in huge pages to keep the TLB footprint of the
+    // packet buffers small. Only when the huge pages were obtained does the
+    // pool grow to use the whole pages for buffers.
+    uint8_t* pool = nullptr;
+    const auto huge = os::mem::huge_psize();
+    if (huge != 0 and poolsize_ > huge / 2) {
+      const auto rounded = util::bits::roundto(huge, poolsize_);
+      pool = (uint8_t*) os::mem::alloc_huge(rounded);
+      if (pool != nullptr)
+        poolsize_ = rounded - rounded % bufsize_;
+    }
+    available_.reserve(pool_buffers());
+
+    if (pool != nullptr)
+      this->add_pool(pool, true);
+    else
+      this->create_new_pool();
+    assert(available() == pool_buffers());
 
     static int bsidx = 0;
     this->index = ++bsidx;
   }
 
   BufferStore::~BufferStore() {
-    for (auto* pool : this->pools_)
-        free(pool);
+    for (size_t i = 0; i < this->pools_.size(); i++) {
+      if (this->huge_pools_[i])
+        os::mem::free_huge(this->pools_[i], poolsize_);
+      else
+        free(this->pools_[i]);
+    }
   }
 
   uint8_t* BufferStore::get_buffer()
@@ -80,11 +98,24 @@ namespace net {
 
   void BufferStore::create_new_pool()
   {
-    auto* pool = (uint8_t*) aligned_alloc(os::mem::min_psize(), poolsize_);
+    const auto huge = os::mem::huge_psize();
+    uint8_t* pool = nullptr;
+    if (huge != 0 and poolsize_ > huge / 2)
+      pool = (uint8_t*) os::mem::alloc_huge(poolsize_);
+
+    const bool is_huge = pool != nullptr;
+    if (not is_huge)
+      pool = (uint8_t*) aligned_alloc(os::mem::min_psize(), poolsize_);
     if (UNLIKELY(pool == nullptr)) {
       throw std::runtime_error("Buffer store failed to allocate memory");
     }
+    this->add_pool(pool, is_huge);
+  }
+
+  void BufferStore::add_pool(uint8_t* pool, bool is_huge)
+  {
     this->pools_.push_back(pool);
+    this->huge_pools_.push_back(is_huge);
 
     for (uint8_t* b = pool; b < pool + poolsize_; b += bufsize_) {
         this->available_.push_back(b);
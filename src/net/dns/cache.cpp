@@ -0,0 +1,190 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2015-2018 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/dns/cache.hpp>
+#include <algorithm>
+#include <cctype>
+
+namespace net::dns
+{
+  // rough per-entry overhead of the list and map nodes
+  static constexpr size_t NODE_OVERHEAD = 64;
+
+  static size_t record_bytes(const std::vector<Record>& records)
+  {
+    size_t bytes = 0;
+    for (const auto& rec : records)
+      bytes += sizeof(Record) + rec.name.size() + rec.rdata.size();
+    return bytes;
+  }
+
+  Cache::Key Cache::make_key(const std::string& name, Record_type type)
+  {
+    // names are case insensitive
+    Key key{name, type};
+    std::transform(key.name.begin(), key.name.end(), key.name.begin(),
+                   [] (unsigned char c) { return std::tolower(c); });
+    return key;
+  }
+
+  int64_t Cache::ttl_of(const Response& res)
+  {
+    if (res.rcode == Response_code::NO_ERROR and not res.answers.empty())
+    {
+      uint32_t ttl = UINT32_MAX;
+      for (const auto& rec : res.answers)
+        ttl = std::min(ttl, rec.ttl);
+      return ttl;
+    }
+    // RFC 2308: NXDOMAIN and NODATA are cached for the lowest of the
+    // SOA record TTL and its MINIMUM field, but not without a SOA.
+    if (res.rcode == Response_code::NAME_ERROR
+        or res.rcode == Response_code::NO_ERROR)
+    {
+      for (const auto& rec : res.auth)
+      {
+        if (rec.rtype == Record_type::SOA)
+          return std::min(rec.ttl, rec.get_soa_minimum());
+      }
+    }
+    return -1;
+  }
+
+  Response_ptr Cache::lookup(const std::string& name, Record_type type, timestamp_t now)
+  {
+    auto it = map_.find(make_key(name, type));
+    if (it == map_.end())
+    {
+      stats_.misses++;
+      return nullptr;
+    }
+
+    auto entry = it->second;
+    if (entry->expires <= now)
+    {
+      erase(entry);
+      stats_.expired++;
+      stats_.misses++;
+      return nullptr;
+    }
+
+    // move to front of LRU
+    lru_.splice(lru_.begin(), lru_, entry);
+
+    stats_.hits++;
+    if (entry->response.answers.empty())
+      stats_.negative_hits++;
+
+    auto res = std::make_unique<Response>(entry->response);
+    const uint32_t remaining = entry->expires - now;
+    for (auto& rec : res->answers)
+      rec.ttl = std::min(rec.ttl, remaining);
+    for (auto& rec : res->auth)
+      rec.ttl = std::min(rec.ttl, remaining);
+    return res;
+  }
+
+  bool Cache::insert(const std::string& name, Record_type type, const Response& res,
+                     timestamp_t now, std::chrono::seconds max_ttl)
+  {
+    const int64_t ttl = std::min<int64_t>(ttl_of(res), max_ttl.count());
+    if (ttl <= 0)
+      return false;
+
+    Entry entry{make_key(name, type), {}, now + ttl, 0};
+    entry.response.rcode = res.rcode;
+    if (not res.answers.empty())
+    {
+      entry.response.answers = res.answers;
+    }
+    else
+    {
+      // only the SOA is needed for a negative answer
+      for (const auto& rec : res.auth)
+      {
+        if (rec.rtype == Record_type::SOA) {
+          entry.response.auth.push_back(rec);
+          break;
+        }
+      }
+    }
+    entry.bytes = sizeof(Entry) + NODE_OVERHEAD + 2 * entry.key.name.size()
+                + record_bytes(entry.response.answers)
+                + record_bytes(entry.response.auth);
+    if (entry.bytes > max_bytes_)
+      return false;
+
+    auto it = map_.find(entry.key);
+    if (it != map_.end())
+      erase(it->second);
+
+    lru_.push_front(std::move(entry));
+    map_.emplace(lru_.front().key, lru_.begin());
+    bytes_ += lru_.front().bytes;
+    stats_.inserts++;
+
+    evict();
+    return true;
+  }
+
+  size_t Cache::flush_expired(timestamp_t now)
+  {
+    size_t count = 0;
+    for (auto it = lru_.begin(); it != lru_.end();)
+    {
+      auto next = std::next(it);
+      if (it->expires <= now)
+      {
+        erase(it);
+        count++;
+      }
+      it = next;
+    }
+    stats_.expired += count;
+    return count;
+  }
+
+  void Cache::clear()
+  {
+    map_.clear();
+    lru_.clear();
+    bytes_ = 0;
+  }
+
+  void Cache::set_max_bytes(size_t max_bytes)
+  {
+    max_bytes_ = max_bytes;
+    evict();
+  }
+
+  void Cache::erase(Entry_list::iterator it)
+  {
+    bytes_ -= it->bytes;
+    map_.erase(it->key);
+    lru_.erase(it);
+  }
+
+  void Cache::evict()
+  {
+    while (bytes_ > max_bytes_ and not lru_.empty())
+    {
+      erase(std::prev(lru_.end()));
+      stats_.evictions++;
+    }
+  }
+
+}
@@ -27,7 +27,7 @@ namespace net::dns
   Timer::duration_t Client::DEFAULT_RESOLVE_TIMEOUT{std::chrono::seconds(5)};
 #endif
   Timer::duration_t Client::DEFAULT_FLUSH_INTERVAL{std::chrono::seconds(30)};
-  std::chrono::seconds Client::DEFAULT_CACHE_TTL{std::chrono::seconds(60)};
+  std::chrono::seconds Client::DEFAULT_CACHE_TTL{std::chrono::hours(1)};
 
   Client::Client(Stack& stack)
     : stack_{stack},
@@ -46,21 +46,30 @@ namespace net::dns
     {
       hostname.append(".").append(stack_.domain_name());
     }
-    if(not force)
+    const auto rtype = (dns_server.is_v6() ? Record_type::AAAA : Record_type::A);
+    if(not force and cache_ttl_ > std::chrono::seconds::zero())
     {
-      auto it = cache_.find(hostname);
-      if(it != cache_.end())
+      auto res = cache_.lookup(hostname, rtype, timestamp());
+      if(res != nullptr)
       {
-        Error err;
-        func(nullptr, err); // fix
+        func(std::move(res), {});
         return;
       }
     }
+    // join a request already in flight for the same name
+    auto pending = pending_.find({hostname, rtype});
+    if(pending != pending_.end())
+    {
+      auto req = requests_.find(pending->second);
+      Expects(req != requests_.end());
+      req->second.waiters.push_back(std::move(func));
+      return;
+    }
     // Make sure we actually can bind to a socket
     auto& socket = (dns_server.is_v6()) ? stack_.udp().bind6() : stack_.udp().bind();
 
     // Create our query
-    Query query{std::move(hostname), (dns_server.is_v6() ? Record_type::AAAA : Record_type::A)};
+    Query query{std::move(hostname), rtype};
 #ifdef LIBFUZZER_ENABLED
     g_last_xid = query.id;
 #endif
@@ -72,6 +81,7 @@ namespace net::dns
 
     Ensures(emp.second && "Unable to insert");
     auto& req = emp.first->second;
+    pending_.emplace(std::make_pair(req.query.hostname, req.query.rtype), req.query.id);
     req.resolve(dns_server, timeout);
   }
 
@@ -112,14 +122,10 @@ namespace net::dns
       // TODO: Validate
       res->parse(data, len);
 
-      this->response = std::move(res);
-
-      // TODO: Cache
-      /*if(client.cache_ttl_ > std::chrono::seconds::zero())
-      {
-        add_cache_entry(...);
-      }*/
+      if(client.cache_ttl_ > std::chrono::seconds::zero())
+        client.add_cache_entry(query, *res);
 
+      this->response = std::move(res);
       finish({});
     }
     else
@@ -131,6 +137,14 @@ namespace net::dns
 
   void Client::Request::finish(const Error& err)
   {
+    // no longer joinable, the handlers may start a new lookup
+    client.pending_.erase({query.hostname, query.rtype});
+
+    auto waiters = std::move(this->waiters);
+    for(auto& waiter : waiters)
+    {
+      waiter(response ? std::make_unique<dns::Response>(*response) : nullptr, err);
+    }
     callback(std::move(response), err);
 
     auto erased = client.requests_.erase(query.id);
@@ -160,15 +174,13 @@ namespace net::dns
     flush_timer_.stop();
   }
 
-  void Client::add_cache_entry(const Hostname& hostname, Address addr, std::chrono::seconds ttl)
+  void Client::add_cache_entry(const dns::Query& query, const dns::Response& res)
   {
-    // cache the address
-    cache_.emplace(std::piecewise_construct,
-      std::forward_as_tuple(hostname),
-      std::forward_as_tuple(addr, timestamp() + ttl.count()));
+    if(not cache_.insert(query.hostname, query.rtype, res, timestamp(), cache_ttl_))
+      return;
 
-    debug("<DNSClient> Cache entry added: [%s] %s (%lld)\n",
-      hostname.c_str(), addr.to_string().c_str(), ttl.count());
+    debug("<DNSClient> Cache entry added: [%s] (%zu entries, %zu bytes)\n",
+      query.hostname.c_str(), cache_.size(), cache_.bytes());
 
     // start the timer if not already active
     if(not flush_timer_.is_running())
@@ -177,14 +189,7 @@ namespace net::dns
 
   void Client::flush_expired()
   {
-    const auto now = timestamp();
-    for(auto it = cache_.begin(); it != cache_.end();)
-    {
-      if(it->second.expires > now)
-        it++;
-      else
-        it = cache_.erase(it);
-    }
+    cache_.flush_expired(timestamp());
 
     if(not cache_.empty())
       flush_timer_.start(DEFAULT_FLUSH_INTERVAL);
@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include <cassert>
+#include <cstring>
 #include <net/dns/record.hpp>
 
 namespace net::dns {
@@ -28,8 +29,9 @@ namespace net::dns {
     int count = 0;
 
     const auto namelen = parse_name(reader, buffer, len, this->name);
+    if (UNLIKELY(namelen == 0))
+      throw std::runtime_error("Invalid record name");
     count += namelen;
-    assert(count >= 0);
 
     reader += namelen;
     const int remaining = len - (reader - buffer);
@@ -45,20 +47,27 @@ namespace net::dns {
     reader += sizeof(rr_data);
     count += sizeof(rr_data);
 
+    if (UNLIKELY(this->data_len > len - (reader - buffer)))
+      throw std::runtime_error("Record data out of bounds");
+
     switch(this->rtype)
     {
-      case Record_type::A:    // IPv4
-      case Record_type::AAAA: // IPv6
+      case Record_type::NS:
+      case Record_type::ALIAS:
       {
-        this->rdata.assign(reader, this->data_len);
-        count += data_len;
+        // the name may be compressed, so it is read from the whole message
+        if (UNLIKELY(parse_name(reader, buffer, len, this->rdata) == 0))
+          throw std::runtime_error("Invalid record data name");
         break;
       }
       default:
       {
-        count += parse_name(reader, buffer, len, this->rdata);
+        // A, AAAA and SOA (only the fixed fields are used), others kept raw
+        this->rdata.assign(reader, this->data_len);
       }
     }
+    // the next record always follows the record data
+    count += data_len;
 
     return count;
   }
@@ -77,60 +86,52 @@ namespace net::dns {
   {
     Expects(output.empty());
 
-    unsigned namelen = 0;
-    bool jumped = false;
+    const auto* ubuffer = (const unsigned char*) buffer;
+    const auto* end     = ubuffer + tot_len;
+    const auto* ureader = (const unsigned char*) reader;
 
+    bool jumped = false;
+    int jumps = 0;
     int count = 1;
-    const auto* ureader = (unsigned char*) reader;
 
-    while (*ureader)
+    // convert 3www6google3com0 to www.google.com while reading
+    while (ureader < end && *ureader)
     {
       if (*ureader >= 192)
       {
+        if (UNLIKELY(ureader + 1 >= end))
+          return 0;
         // read 16-bit offset, mask out the 2 top bits
-        uint16_t offset = (*ureader >> 8) | *(ureader+1);
-        offset &= 0x3fff; // remove 2 top bits
+        const uint16_t offset = ((*ureader << 8) | *(ureader+1)) & 0x3fff;
 
-        if(UNLIKELY(offset > tot_len))
+        // compression loops would never terminate
+        if(UNLIKELY(offset >= tot_len || ++jumps > 16))
           return 0;
 
-        ureader = (unsigned char*) &buffer[offset];
+        // the pointer itself counts 2, but the terminator is not ours
+        if (jumped == false) count++;
+        ureader = ubuffer + offset;
         jumped = true; // we have jumped to another location so counting wont go up!
+        continue;
       }
-      else
-      {
-        output[namelen++] = *ureader++;
-
-        // maximum label size
-        if(UNLIKELY(namelen > 63)) break;
-      }
-
-      // if we havent jumped to another location then we can count up
-      if (jumped == false) count++;
-    }
-
-    output.resize(namelen);
-    if (output.empty()) return 0;
 
-    // number of steps we actually moved forward in the packet
-    if (jumped)
-      count++;
+      const unsigned len = *ureader;
+      // maximum label size, and the label must be within the buffer
+      if (UNLIKELY(len > 63 || ureader + 1 + len > end))
+        return 0;
 
-    // now convert 3www6google3com0 to www.google.com
-    for(unsigned i = 0; i < output.size(); i++)
-    {
-      const uint8_t len = output[i];
+      if (not output.empty()) output.push_back('.');
+      output.append((const char*) ureader + 1, len);
+      ureader += 1 + len;
+      if (jumped == false) count += 1 + len;
 
-      for(unsigned j = 0; j < len; j++)
-      {
-        output[i] = output[i+1];
-        i++;
-      }
-      output[i] = '.';
+      if (UNLIKELY(output.size() > 255))
+        return 0;
     }
-    // remove the last dot by resizing down
-    output.resize(output.size()-1);
-    return count;
+
+    if (UNLIKELY(ureader >= end))
+      return 0;
+    return output.empty() ? 0 : count;
   }
 
   ip4::Addr Record::get_ipv4() const
@@ -145,6 +146,17 @@ namespace net::dns {
     return *(ip6::Addr*) rdata.data();
   }
 
+  uint32_t Record::get_soa_minimum() const
+  {
+    Expects(rtype == Record_type::SOA);
+    // MNAME, RNAME, SERIAL, REFRESH, RETRY, EXPIRE, MINIMUM
+    if (UNLIKELY(rdata.size() < 5 * sizeof(uint32_t)))
+      return 0;
+    uint32_t minimum;
+    std::memcpy(&minimum, rdata.data() + rdata.size() - sizeof(uint32_t), sizeof(minimum));
+    return ntohl(minimum);
+  }
+
   net::Addr Record::get_addr() const
   {
     switch(rtype)
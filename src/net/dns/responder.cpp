@@ -0,0 +1,402 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2015-2018 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/dns/responder.hpp>
+#include <net/util.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace net::dns
+{
+  static inline uint8_t to_lower(uint8_t c) noexcept
+  { return (c >= 'A' and c <= 'Z') ? c + ('a' - 'A') : c; }
+
+  // compare a stored (lower case) label with a label from the wire
+  static int compare_label(const std::string& a, const uint8_t* b, uint8_t blen) noexcept
+  {
+    const size_t n = std::min<size_t>(a.size(), blen);
+    for (size_t i = 0; i < n; i++)
+    {
+      const int d = (uint8_t) a[i] - to_lower(b[i]);
+      if (d != 0) return d;
+    }
+    return (int) a.size() - (int) blen;
+  }
+
+  // offsets of each label in an uncompressed wire format name
+  static int split_labels(const uint8_t* name, uint8_t* offsets) noexcept
+  {
+    int count = 0;
+    for (size_t pos = 0; name[pos] != 0; pos += name[pos] + 1)
+      offsets[count++] = pos;
+    return count;
+  }
+
+  size_t wire::skip_name(const uint8_t* msg, size_t len, size_t pos) noexcept
+  {
+    while (pos < len)
+    {
+      const uint8_t c = msg[pos];
+      if (c == 0)
+        return pos + 1;
+      if ((c & 0xC0) == 0xC0)
+        return (pos + 2 <= len) ? pos + 2 : 0;
+      if (c & 0xC0)
+        return 0;
+      pos += c + 1;
+    }
+    return 0;
+  }
+
+  std::vector<uint8_t> wire::encode_name(const std::string& name)
+  {
+    std::vector<uint8_t> out;
+    size_t start = 0;
+    while (start < name.size())
+    {
+      size_t end = name.find('.', start);
+      if (end == std::string::npos) end = name.size();
+      const size_t label = end - start;
+      if (label == 0 or label > 63)
+        return {};
+      out.push_back(label);
+      out.insert(out.end(), name.begin() + start, name.begin() + end);
+      start = end + 1;
+    }
+    out.push_back(0);
+    if (out.size() > MAX_NAME_LEN)
+      return {};
+    return out;
+  }
+
+  bool Question_view::parse(const uint8_t* msg, size_t len) noexcept
+  {
+    if (len < sizeof(Header))
+      return false;
+
+    size_t pos = sizeof(Header);
+    while (true)
+    {
+      if (pos >= len)
+        return false;
+      const uint8_t c = msg[pos];
+      if (c == 0) break;
+      // no compression in the question of a query
+      if (c > 63)
+        return false;
+      pos += c + 1;
+      if (pos - sizeof(Header) >= wire::MAX_NAME_LEN)
+        return false;
+    }
+    pos++;
+    if (pos + sizeof(Question) > len)
+      return false;
+
+    this->name     = msg + sizeof(Header);
+    this->name_len = pos - sizeof(Header);
+    this->qtype    = wire::read16(msg + pos);
+    this->qclass   = wire::read16(msg + pos + 2);
+    this->end      = pos + sizeof(Question);
+    return true;
+  }
+
+  Responder::Responder()
+  {
+    // the root
+    nodes_.emplace_back();
+  }
+
+  int32_t Responder::find_child(const Node& node, const uint8_t* label, uint8_t len) const noexcept
+  {
+    size_t lo = 0, hi = node.children.size();
+    while (lo < hi)
+    {
+      const size_t mid = (lo + hi) / 2;
+      const auto child = node.children[mid];
+      const int cmp = compare_label(nodes_[child].label, label, len);
+      if (cmp == 0) return child;
+      if (cmp < 0) lo = mid + 1;
+      else hi = mid;
+    }
+    return -1;
+  }
+
+  uint32_t Responder::find_or_create(const std::vector<uint8_t>& name)
+  {
+    uint8_t offsets[wire::MAX_NAME_LEN / 2 + 1];
+    const int labels = split_labels(name.data(), offsets);
+
+    uint32_t node = 0;
+    for (int i = labels-1; i >= 0; i--)
+    {
+      const uint8_t* label = &name[offsets[i] + 1];
+      const uint8_t  len   = name[offsets[i]];
+
+      const int32_t child = find_child(nodes_[node], label, len);
+      if (child >= 0) {
+        node = child;
+        continue;
+      }
+
+      Node created;
+      for (int c = 0; c < len; c++)
+        created.label.push_back(to_lower(label[c]));
+
+      const uint32_t index = nodes_.size();
+      auto& children = nodes_[node].children;
+      auto it = std::lower_bound(children.begin(), children.end(), created.label,
+        [this] (uint32_t child, const std::string& lbl) {
+          return nodes_[child].label < lbl;
+        });
+      children.insert(it, index);
+      nodes_.push_back(std::move(created));
+      node = index;
+    }
+    return node;
+  }
+
+  const Responder::Answer* Responder::find_answer(const Node& node, uint16_t type) noexcept
+  {
+    for (const auto& ans : node.answers)
+    {
+      if (ans.type == type) return &ans;
+    }
+    return nullptr;
+  }
+
+  void Responder::add_zone(const std::string& apex, const Soa& soa)
+  {
+    const auto name  = wire::encode_name(apex);
+    const auto mname = wire::encode_name(soa.mname);
+    const auto rname = wire::encode_name(soa.rname);
+    if (name.empty() or mname.empty() or rname.empty())
+      throw std::invalid_argument("Invalid zone or SOA name: " + apex);
+
+    const uint32_t node = find_or_create(name);
+    if (nodes_[node].zone >= 0)
+      throw std::invalid_argument("Zone already exists: " + apex);
+
+    Zone zone{node, {}};
+    auto& rr = zone.soa;
+    const size_t rdlen = mname.size() + rname.size() + 5 * sizeof(uint32_t);
+    rr.resize(sizeof(rr_data) + rdlen);
+    uint8_t* p = rr.data();
+    wire::write16(p, DNS_TYPE_SOA);
+    wire::write16(p + 2, DNS_CLASS_INET);
+    // RFC 2308: the SOA in negative answers is cached for min(ttl, minimum)
+    wire::write32(p + 4, std::min(soa.ttl, soa.minimum));
+    wire::write16(p + 8, rdlen);
+    p += sizeof(rr_data);
+    p = std::copy(mname.begin(), mname.end(), p);
+    p = std::copy(rname.begin(), rname.end(), p);
+    for (uint32_t field : {soa.serial, soa.refresh, soa.retry, soa.expire, soa.minimum})
+    {
+      wire::write32(p, field);
+      p += sizeof(uint32_t);
+    }
+
+    nodes_[node].zone = zones_.size();
+    zones_.push_back(std::move(zone));
+  }
+
+  void Responder::add_record(const std::string& owner, uint16_t type, uint32_t ttl,
+                             const void* rdata, size_t len)
+  {
+    const auto name = wire::encode_name(owner);
+    if (name.empty() or len > UINT16_MAX)
+      throw std::invalid_argument("Invalid record: " + owner);
+
+    // the name must be within one of our zones
+    uint8_t offsets[wire::MAX_NAME_LEN / 2 + 1];
+    const int labels = split_labels(name.data(), offsets);
+    bool in_zone = nodes_[0].zone >= 0;
+    uint32_t node = 0;
+    for (int i = labels-1; i >= 0 and not in_zone; i--)
+    {
+      const int32_t child = find_child(nodes_[node], &name[offsets[i] + 1], name[offsets[i]]);
+      if (child < 0) break;
+      node = child;
+      in_zone = nodes_[node].zone >= 0;
+    }
+    if (not in_zone)
+      throw std::invalid_argument("Record is not within any zone: " + owner);
+
+    auto& answers = nodes_[find_or_create(name)].answers;
+    auto it = std::find_if(answers.begin(), answers.end(),
+                           [type] (const Answer& a) { return a.type == type; });
+    if (it == answers.end())
+      it = answers.insert(answers.end(), Answer{type, 0, {}});
+
+    auto& wire = it->wire;
+    const size_t pos = wire.size();
+    wire.resize(pos + 2 + sizeof(rr_data) + len);
+    uint8_t* p = &wire[pos];
+    // owner name is a pointer to the question name
+    wire::write16(p, 0xC000 | sizeof(Header));
+    wire::write16(p + 2, type);
+    wire::write16(p + 4, DNS_CLASS_INET);
+    wire::write32(p + 6, ttl);
+    wire::write16(p + 10, len);
+    std::memcpy(p + 12, rdata, len);
+    it->count++;
+  }
+
+  void Responder::add_cname(const std::string& name, const std::string& target, uint32_t ttl)
+  {
+    const auto rdata = wire::encode_name(target);
+    if (rdata.empty())
+      throw std::invalid_argument("Invalid CNAME target: " + target);
+    add_record(name, DNS_TYPE_ALIAS, ttl, rdata.data(), rdata.size());
+  }
+
+  size_t Responder::write_error(const uint8_t* query, const Question_view* question,
+                                Response_code rcode, uint8_t* out) noexcept
+  {
+    const size_t len = question ? question->end : sizeof(Header);
+    std::memcpy(out, query, len);
+    auto& hdr = *(Header*) out;
+    hdr.qr = DNS_QR_RESPONSE;
+    hdr.aa = 0;
+    hdr.tc = DNS_TC_NONE;
+    hdr.ra = 0;
+    hdr.z  = DNS_Z_RESERVED;
+    hdr.ad = 0;
+    hdr.cd = 0;
+    hdr.rcode      = static_cast<uint8_t>(rcode);
+    hdr.q_count    = htons(question ? 1 : 0);
+    hdr.ans_count  = 0;
+    hdr.auth_count = 0;
+    hdr.add_count  = 0;
+    return len;
+  }
+
+  Responder::Result Responder::answer(const uint8_t* query, size_t len,
+                                      uint8_t* out, size_t& out_len)
+  {
+    stats_.queries++;
+    if (UNLIKELY(len < sizeof(Header)))
+    {
+      stats_.malformed++;
+      return Result::DROP;
+    }
+    const auto& qhdr = *(const Header*) query;
+    // never respond to responses
+    if (UNLIKELY(qhdr.qr != DNS_QR_QUERY))
+    {
+      stats_.malformed++;
+      return Result::DROP;
+    }
+    if (UNLIKELY(qhdr.opcode != 0))
+    {
+      out_len = write_error(query, nullptr, Response_code::NOT_IMPL, out);
+      return Result::ANSWERED;
+    }
+
+    Question_view q;
+    if (UNLIKELY(ntohs(qhdr.q_count) != 1 or not q.parse(query, len)))
+    {
+      stats_.malformed++;
+      out_len = write_error(query, nullptr, Response_code::FORMAT_ERROR, out);
+      return Result::ANSWERED;
+    }
+    if (UNLIKELY(q.qclass != DNS_CLASS_INET))
+    {
+      stats_.refused++;
+      out_len = write_error(query, &q, Response_code::OP_REFUSED, out);
+      return Result::ANSWERED;
+    }
+
+    // walk down the tree from the last label
+    uint8_t offsets[wire::MAX_NAME_LEN / 2 + 1];
+    const int labels = split_labels(q.name, offsets);
+    int32_t node = 0;
+    int32_t zone = nodes_[0].zone;
+    // the apex of the zone starts at this label
+    int zone_label = labels;
+    for (int i = labels-1; i >= 0; i--)
+    {
+      node = find_child(nodes_[node], q.name + offsets[i] + 1, q.name[offsets[i]]);
+      if (node < 0) break;
+      if (nodes_[node].zone >= 0)
+      {
+        zone = nodes_[node].zone;
+        zone_label = i;
+      }
+    }
+
+    if (zone < 0)
+    {
+      stats_.refused++;
+      out_len = write_error(query, &q, Response_code::OP_REFUSED, out);
+      return Result::NOT_AUTHORITATIVE;
+    }
+
+    size_t pos = write_error(query, &q, Response_code::NO_ERROR, out);
+    auto& hdr = *(Header*) out;
+    hdr.aa = 1;
+
+    const Answer* ans = nullptr;
+    if (node >= 0)
+    {
+      ans = find_answer(nodes_[node], q.qtype);
+      if (ans == nullptr and q.qtype != DNS_TYPE_ALIAS)
+        ans = find_answer(nodes_[node], DNS_TYPE_ALIAS);
+    }
+
+    if (ans != nullptr)
+    {
+      if (UNLIKELY(pos + ans->wire.size() > MAX_UDP_SIZE))
+      {
+        // no EDNS support, the client will retry over TCP
+        hdr.tc = DNS_TC_TRUNC;
+        stats_.truncated++;
+      }
+      else
+      {
+        std::memcpy(out + pos, ans->wire.data(), ans->wire.size());
+        pos += ans->wire.size();
+        hdr.ans_count = htons(ans->count);
+        stats_.answered++;
+      }
+      out_len = pos;
+      return Result::ANSWERED;
+    }
+
+    // negative answer with the SOA of the zone in the authority section
+    if (node < 0) {
+      hdr.rcode = static_cast<uint8_t>(Response_code::NAME_ERROR);
+      stats_.nxdomain++;
+    }
+    else {
+      stats_.nodata++;
+    }
+    const auto& soa = zones_[zone].soa;
+    if (LIKELY(pos + 2 + soa.size() <= MAX_UDP_SIZE))
+    {
+      const size_t apex = sizeof(Header)
+          + (zone_label < labels ? offsets[zone_label] : q.name_len - 1);
+      wire::write16(out + pos, 0xC000 | apex);
+      std::memcpy(out + pos + 2, soa.data(), soa.size());
+      pos += 2 + soa.size();
+      hdr.auth_count = htons(1);
+    }
+    out_len = pos;
+    return Result::ANSWERED;
+  }
+
+}
@@ -64,29 +64,30 @@ namespace net::dns {
     Expects(len >= sizeof(Header));
 
     const auto& hdr = *(const Header*) buffer;
+    this->rcode = static_cast<Response_code>(hdr.rcode);
 
     // move ahead of the dns header and the query field
     const char* reader = (char*)buffer + sizeof(Header);
     // Iterate past the question string we sent ...
-    while (*reader) reader++;
-    // .. and past the question data
-    reader += sizeof(Question);
+    while (reader < buffer + len && *reader) reader++;
+    // .. its terminator, and past the question data
+    reader += 1 + sizeof(Question);
 
     if(UNLIKELY(reader > (buffer + len)))
       return -1;
 
+    // records are only kept once completely parsed
+    auto parse_into = [&] (std::vector<Record>& list, int count) {
+      for (int i = 0; i < count; i++) {
+        Record rec;
+        reader += rec.parse(reader, buffer, len);
+        list.push_back(std::move(rec));
+      }
+    };
     try {
-      // parse answers
-      for(int i = 0; i < ntohs(hdr.ans_count); i++)
-        reader += answers.emplace_back().parse(reader, buffer, len);
-
-      // parse authorities
-      for (int i = 0; i < ntohs(hdr.auth_count); i++)
-        reader += auth.emplace_back().parse(reader, buffer, len);
-
-      // parse additional
-      for (int i = 0; i < ntohs(hdr.add_count); i++)
-        reader += addit.emplace_back().parse(reader, buffer, len);
+      parse_into(answers, ntohs(hdr.ans_count));
+      parse_into(auth,    ntohs(hdr.auth_count));
+      parse_into(addit,   ntohs(hdr.add_count));
     }
     catch (const std::runtime_error&) {
       // packet probably too short
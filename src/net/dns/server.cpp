@@ -0,0 +1,284 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2015-2018 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/dns/server.hpp>
+#include <net/inet>
+#include <kernel/rng.hpp>
+#include <cstring>
+
+namespace net::dns
+{
+  Timer::duration_t Server::FORWARD_TIMEOUT{std::chrono::seconds(2)};
+
+  Server::Server(Stack& stack, Responder& responder, udp::port_t port)
+    : stack_{stack},
+      responder_{responder},
+      socket_{stack.udp().bind(port)},
+      timeout_timer_{{this, &Server::expire_pending}}
+  {
+    socket_.on_read({this, &Server::receive});
+  }
+
+  Server::~Server()
+  {
+    timeout_timer_.stop();
+    if (upstream_socket_) upstream_socket_->close();
+    socket_.close();
+  }
+
+  void Server::forward_to(net::Addr upstream, udp::port_t port)
+  {
+    if (upstream_socket_) upstream_socket_->close();
+    upstream_socket_ = &(upstream.is_v6() ? stack_.udp().bind6() : stack_.udp().bind());
+    upstream_socket_->on_read({this, &Server::receive_upstream});
+    upstream_ = upstream;
+    upstream_port_ = port;
+    pending_.clear();
+  }
+
+  std::string_view Server::make_key(const Question_view& q) noexcept
+  {
+    // lower case name followed by the query type
+    for (size_t i = 0; i < q.name_len; i++)
+    {
+      const uint8_t c = q.name[i];
+      key_buffer_[i] = (c >= 'A' and c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    wire::write16((uint8_t*) &key_buffer_[q.name_len], q.qtype);
+    return {key_buffer_.data(), q.name_len + sizeof(uint16_t)};
+  }
+
+  void Server::receive(net::Addr addr, udp::port_t port, const char* data, size_t len)
+  {
+    const auto* query = (const uint8_t*) data;
+    size_t out_len = 0;
+    const auto result = responder_.answer(query, len, buffer_.data(), out_len);
+
+    if (result == Responder::Result::NOT_AUTHORITATIVE and upstream_socket_ != nullptr)
+    {
+      Question_view q;
+      q.parse(query, len);
+      if (answer_cached(addr, port, query, make_key(q)))
+        return;
+      forward(addr, port, query, len, q);
+      return;
+    }
+    if (result != Responder::Result::DROP)
+      socket_.sendto(addr, port, buffer_.data(), out_len);
+  }
+
+  bool Server::answer_cached(net::Addr addr, udp::port_t port,
+                             const uint8_t* query, std::string_view key)
+  {
+    auto it = cache_.find(key);
+    if (it == cache_.end())
+      return false;
+
+    auto entry = it->second;
+    const auto now = RTC::time_since_boot();
+    if (entry->expires <= now)
+    {
+      cache_erase(entry);
+      return false;
+    }
+    lru_.splice(lru_.begin(), lru_, entry);
+
+    std::memcpy(buffer_.data(), entry->msg.data(), entry->msg.size());
+    // the id of the query
+    std::memcpy(buffer_.data(), query, sizeof(uint16_t));
+    age_ttls(buffer_.data(), entry->msg.size(), now - entry->stored);
+    socket_.sendto(addr, port, buffer_.data(), entry->msg.size());
+    stats_.cache_hits++;
+    return true;
+  }
+
+  void Server::forward(net::Addr addr, udp::port_t port,
+                       const uint8_t* query, size_t len, const Question_view& q)
+  {
+    if (UNLIKELY(pending_.size() >= MAX_PENDING or len > MAX_MESSAGE))
+    {
+      stats_.overloaded++;
+      const size_t out_len = Responder::write_error(query, &q, Response_code::SERVER_FAIL, buffer_.data());
+      socket_.sendto(addr, port, buffer_.data(), out_len);
+      return;
+    }
+
+    // a random id, making spoofed answers harder to get accepted
+    uint16_t id;
+    do {
+      id = rng_extract_uint32();
+    } while (pending_.count(id));
+
+    const auto key = make_key(q);
+    pending_.emplace(id, Pending{addr, port, wire::read16(query), std::string(key),
+                                 RTC::time_since_boot()});
+
+    std::memcpy(buffer_.data(), query, len);
+    wire::write16(buffer_.data(), id);
+    upstream_socket_->sendto(upstream_, upstream_port_, buffer_.data(), len);
+    stats_.forwarded++;
+
+    if (not timeout_timer_.is_running())
+      timeout_timer_.start(FORWARD_TIMEOUT);
+  }
+
+  void Server::receive_upstream(net::Addr addr, udp::port_t port, const char* data, size_t len)
+  {
+    if (UNLIKELY(addr != upstream_ or port != upstream_port_
+                 or len < sizeof(Header) or len > MAX_MESSAGE))
+      return;
+
+    const auto* msg = (const uint8_t*) data;
+    auto it = pending_.find(wire::read16(msg));
+    if (it == pending_.end())
+      return;
+
+    // the answer must be for the question we asked
+    Question_view q;
+    if (not q.parse(msg, len) or make_key(q) != it->second.key)
+      return;
+
+    const auto ttl = cacheable_ttl(msg, len);
+    if (ttl > 0)
+      cache_insert(it->second.key, msg, len, ttl);
+
+    std::memcpy(buffer_.data(), msg, len);
+    wire::write16(buffer_.data(), it->second.id);
+    socket_.sendto(it->second.client, it->second.port, buffer_.data(), len);
+    pending_.erase(it);
+  }
+
+  void Server::expire_pending()
+  {
+    const auto timeout = std::chrono::duration_cast<std::chrono::seconds>(FORWARD_TIMEOUT).count();
+    const auto now = RTC::time_since_boot();
+    for (auto it = pending_.begin(); it != pending_.end();)
+    {
+      if (now - it->second.sent >= (RTC::timestamp_t) timeout)
+      {
+        // the client will retry
+        it = pending_.erase(it);
+        stats_.timeouts++;
+      }
+      else ++it;
+    }
+    if (not pending_.empty())
+      timeout_timer_.start(FORWARD_TIMEOUT);
+  }
+
+  void Server::cache_insert(std::string_view key, const uint8_t* msg, size_t len, int64_t ttl)
+  {
+    auto it = cache_.find(key);
+    if (it != cache_.end())
+      cache_erase(it->second);
+
+    const auto now = RTC::time_since_boot();
+    lru_.push_front(Cached{std::string(key), {msg, msg + len}, now, now + ttl});
+    auto& entry = lru_.front();
+    cache_.emplace(std::string_view(entry.key), lru_.begin());
+    cache_bytes_ += sizeof(Cached) + entry.key.size() + entry.msg.size();
+    evict();
+  }
+
+  void Server::cache_erase(Cache_list::iterator entry)
+  {
+    cache_bytes_ -= sizeof(Cached) + entry->key.size() + entry->msg.size();
+    cache_.erase(std::string_view(entry->key));
+    lru_.erase(entry);
+  }
+
+  void Server::evict()
+  {
+    while (cache_bytes_ > cache_limit_ and not lru_.empty())
+      cache_erase(std::prev(lru_.end()));
+  }
+
+  // skip the question section, returning the position of the first RR
+  static size_t skip_questions(const uint8_t* msg, size_t len) noexcept
+  {
+    size_t pos = sizeof(Header);
+    for (int i = wire::read16(msg + 4); i > 0; i--)
+    {
+      pos = wire::skip_name(msg, len, pos);
+      if (pos == 0 or pos + sizeof(Question) > len) return 0;
+      pos += sizeof(Question);
+    }
+    return pos;
+  }
+
+  void Server::age_ttls(uint8_t* msg, size_t len, uint32_t elapsed) noexcept
+  {
+    if (elapsed == 0 or len < sizeof(Header)) return;
+    size_t pos = skip_questions(msg, len);
+    if (pos == 0) return;
+
+    int records = wire::read16(msg + 6) + wire::read16(msg + 8) + wire::read16(msg + 10);
+    for (; records > 0; records--)
+    {
+      pos = wire::skip_name(msg, len, pos);
+      if (pos == 0 or pos + sizeof(rr_data) > len) return;
+      // the TTL field of OPT is not a TTL
+      if (wire::read16(msg + pos) != 41)
+      {
+        const uint32_t ttl = wire::read32(msg + pos + 4);
+        wire::write32(msg + pos + 4, ttl > elapsed ? ttl - elapsed : 0);
+      }
+      pos += sizeof(rr_data) + wire::read16(msg + pos + 8);
+    }
+  }
+
+  int64_t Server::cacheable_ttl(const uint8_t* msg, size_t len) noexcept
+  {
+    const auto& hdr = *(const Header*) msg;
+    if (hdr.tc) return -1;
+    const auto rcode = static_cast<Response_code>(hdr.rcode);
+    if (rcode != Response_code::NO_ERROR and rcode != Response_code::NAME_ERROR)
+      return -1;
+
+    size_t pos = skip_questions(msg, len);
+    if (pos == 0) return -1;
+
+    const int answers = ntohs(hdr.ans_count);
+    const int auth    = ntohs(hdr.auth_count);
+    int64_t ttl = -1;
+    for (int i = 0; i < answers + auth; i++)
+    {
+      pos = wire::skip_name(msg, len, pos);
+      if (pos == 0 or pos + sizeof(rr_data) > len) return -1;
+      const uint16_t type  = wire::read16(msg + pos);
+      const uint32_t rttl  = wire::read32(msg + pos + 4);
+      const uint16_t rdlen = wire::read16(msg + pos + 8);
+      pos += sizeof(rr_data);
+      if (pos + rdlen > len) return -1;
+
+      if (i < answers)
+      {
+        if (rcode == Response_code::NO_ERROR)
+          ttl = (ttl < 0) ? rttl : std::min<int64_t>(ttl, rttl);
+      }
+      else if (answers == 0 and type == DNS_TYPE_SOA and rdlen >= 5 * sizeof(uint32_t))
+      {
+        // RFC 2308 negative caching
+        const uint32_t minimum = wire::read32(msg + pos + rdlen - sizeof(uint32_t));
+        return std::min(rttl, minimum);
+      }
+      pos += rdlen;
+    }
+    return ttl;
+  }
+
+}
@@ -76,7 +76,7 @@ namespace http
     connect(
       std::make_unique<net::botan::Server> (
         std::make_unique<net::tcp::Stream>(
-          std::move(conn)), rng, *credman)
+          std::move(conn)), rng, *credman, &sessions)
     );
   }
 
@@ -2,6 +2,8 @@
 #include <net/https/openssl_server.hpp>
 #include <net/openssl/init.hpp>
 #include <net/openssl/tls_stream.hpp>
+#include <net/tls/session_cache.hpp>
+#include <net/tls/ticket_keys.hpp>
 #include <memdisk>
 
 namespace http
@@ -21,6 +23,9 @@ namespace http
     openssl::verify_rng();
 
     this->m_ctx = openssl::create_server(certif.c_str(), key.c_str());
+    // returning clients resume on any core, and across LiveUpdate
+    openssl::enable_resumption((SSL_CTX*) this->m_ctx,
+        net::tls::Session_cache::get(), net::tls::Ticket_keys::get());
     assert(ERR_get_error() == 0);
   }
   OpenSSL_server::~OpenSSL_server()
@@ -17,6 +17,8 @@
 
 #include <net/https/s2n_server.hpp>
 #include <net/s2n/stream.hpp>
+#include <net/tls/session_cache.hpp>
+#include <net/tls/ticket_keys.hpp>
 using s2n::print_s2n_error;
 
 // allow all clients
@@ -24,6 +26,34 @@ static uint8_t verify_host_passthrough(const char*, size_t, void* /*data*/) {
     return 1;
 }
 
+static int cache_store(s2n_connection*, void*, uint64_t,
+                       const void* key, uint64_t key_size,
+                       const void* value, uint64_t value_size)
+{
+  net::tls::Session_cache::get().insert(
+      {(const char*) key, key_size}, value, value_size);
+  return 0;
+}
+
+static int cache_retrieve(s2n_connection*, void*,
+                          const void* key, uint64_t key_size,
+                          void* value, uint64_t* value_size)
+{
+  std::vector<uint8_t> buffer;
+  if (not net::tls::Session_cache::get().lookup({(const char*) key, key_size}, buffer)
+      || buffer.size() > *value_size) return -1;
+  memcpy(value, buffer.data(), buffer.size());
+  *value_size = buffer.size();
+  return 0;
+}
+
+static int cache_delete(s2n_connection*, void*,
+                        const void* key, uint64_t key_size)
+{
+  net::tls::Session_cache::get().erase({(const char*) key, key_size});
+  return 0;
+}
+
 namespace http
 {
   void S2N_server::initialize(
@@ -55,6 +85,29 @@ namespace http
       print_s2n_error("Error setting verify-host callback");
       exit(1);
     }
+
+    // resume sessions through the shared session cache and ticket keys
+    s2n_config_set_cache_store_callback(config, cache_store, nullptr);
+    s2n_config_set_cache_retrieve_callback(config, cache_retrieve, nullptr);
+    s2n_config_set_cache_delete_callback(config, cache_delete, nullptr);
+    s2n_config_set_session_cache_onoff(config, 1);
+    s2n_config_set_session_tickets_onoff(config, 1);
+    this->update_ticket_key();
+  }
+
+  void S2N_server::update_ticket_key()
+  {
+    auto key = net::tls::Ticket_keys::get().current();
+    if (key.created == this->m_ticket_key) return;
+    // s2n keeps the older keys around for decryption by itself
+    int res = s2n_config_add_ticket_crypto_key((s2n_config*) this->m_config,
+          key.name.data(), key.name.size(),
+          key.aes_key.data(), key.aes_key.size(), key.created);
+    if (res < 0) {
+      print_s2n_error("Error adding session ticket key");
+      return;
+    }
+    this->m_ticket_key = key.created;
   }
   
   S2N_server::~S2N_server()
@@ -70,6 +123,7 @@ namespace http
 
   void S2N_server::on_connect(TCP_conn conn)
   {
+    this->update_ticket_key();
     connect(
       std::make_unique<s2n::TLS_stream> (
         (s2n_config*) this->m_config,
@@ -0,0 +1,96 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/memcached/cache.hpp>
+#include <expects>
+
+namespace net::memcached {
+
+  Cache::Cache(size_t memory, size_t shards, double growth)
+    : pool_{memory, memory / (shards ? shards : SMP::cpu_count())},
+      shards_(shards ? shards : SMP::cpu_count()),
+      memory_{memory}
+  {
+    Expects(memory >= shards_.size() * Store::page_size);
+    for (auto& shard : shards_)
+      shard.store = std::make_unique<Store>(pool_.get_resource(), growth);
+  }
+
+  Result Cache::store(Mode mode, std::string_view key, uint32_t flags,
+                      uint32_t exptime, std::string_view value, uint32_t now,
+                      uint64_t cas)
+  {
+    const size_t h = hash(key);
+    auto& shard = shard_for(h);
+    std::lock_guard<Spinlock> lock(shard.lock);
+    return shard.store->store(mode, key, h, flags, exptime, value, now, cas);
+  }
+
+  Result Cache::remove(std::string_view key, uint32_t now)
+  {
+    const size_t h = hash(key);
+    auto& shard = shard_for(h);
+    std::lock_guard<Spinlock> lock(shard.lock);
+    return shard.store->remove(key, h, now);
+  }
+
+  Result Cache::touch(std::string_view key, uint32_t exptime, uint32_t now)
+  {
+    const size_t h = hash(key);
+    auto& shard = shard_for(h);
+    std::lock_guard<Spinlock> lock(shard.lock);
+    return shard.store->touch(key, h, exptime, now);
+  }
+
+  Result Cache::arith(std::string_view key, bool incr, uint64_t delta,
+                      uint64_t& value, uint32_t now)
+  {
+    const size_t h = hash(key);
+    auto& shard = shard_for(h);
+    std::lock_guard<Spinlock> lock(shard.lock);
+    return shard.store->arith(key, h, incr, delta, value, now);
+  }
+
+  void Cache::flush_all(uint32_t when, uint32_t now)
+  {
+    for (auto& shard : shards_)
+    {
+      std::lock_guard<Spinlock> lock(shard.lock);
+      shard.store->flush_all(when, now);
+    }
+  }
+
+  Store::Stats Cache::stats() const
+  {
+    Store::Stats total;
+    for (const auto& shard : shards_)
+    {
+      std::lock_guard<Spinlock> lock(shard.lock);
+      const auto& stats = shard.store->stats();
+      total.get_hits   += stats.get_hits;
+      total.get_misses += stats.get_misses;
+      total.sets       += stats.sets;
+      total.evictions  += stats.evictions;
+      total.expired    += stats.expired;
+      total.items      += stats.items;
+      total.bytes      += stats.bytes;
+      total.pages      += stats.pages;
+      total.reassigned += stats.reassigned;
+    }
+    return total;
+  }
+
+}
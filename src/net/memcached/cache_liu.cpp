@@ -0,0 +1,99 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/memcached/cache.hpp>
+#include <kernel/rtc.hpp>
+#include <liveupdate.hpp>
+#include <cstring>
+
+namespace net::memcached {
+
+// serialized item: header, key, value
+struct Stored_item {
+  uint64_t cas;
+  uint32_t exptime;
+  uint32_t time;
+  uint32_t flags;
+  uint32_t nbytes;
+  uint8_t  nkey;
+  uint8_t  segment;
+
+  // the key, then the value
+  char* data() noexcept { return (char*) (this + 1); }
+  const char* data() const noexcept { return (const char*) (this + 1); }
+} __attribute__((packed));
+
+// items are packed together into buffers of about this size
+static const size_t BATCH_SIZE = 64 * 1024;
+
+void Cache::store(uint16_t id, liu::Storage& store) const
+{
+  const uint32_t now = RTC::now();
+  std::vector<char> buffer;
+  buffer.reserve(BATCH_SIZE + sizeof(Stored_item) + Store::page_size);
+  for (const auto& shard : shards_)
+  {
+    std::lock_guard<Spinlock> lock(shard.lock);
+    shard.store->for_each([&] (const Item& item) {
+      const size_t pos = buffer.size();
+      buffer.resize(pos + sizeof(Stored_item) + item.nkey + item.nbytes);
+      auto* stored = (Stored_item*) &buffer[pos];
+      stored->cas     = item.cas;
+      stored->exptime = item.exptime;
+      stored->time    = item.time;
+      stored->flags   = item.flags;
+      stored->nbytes  = item.nbytes;
+      stored->nkey    = item.nkey;
+      stored->segment = item.segment;
+      std::memcpy(stored->data(), item.data(), item.nkey + item.nbytes);
+      if (buffer.size() >= BATCH_SIZE) {
+        store.add_buffer(id, buffer.data(), buffer.size());
+        buffer.clear();
+      }
+    }, now);
+  }
+  if (not buffer.empty())
+    store.add_buffer(id, buffer.data(), buffer.size());
+  store.put_marker(id);
+}
+
+void Cache::restore(liu::Restore& store)
+{
+  const uint32_t now = RTC::now();
+  while (not store.is_marker() && not store.is_end())
+  {
+    const char* pos = (const char*) store.data();
+    const char* end = pos + store.length();
+    while (store.is_buffer() && pos + sizeof(Stored_item) <= end)
+    {
+      const auto* stored = (const Stored_item*) pos;
+      const size_t len = sizeof(Stored_item) + stored->nkey + stored->nbytes;
+      if (len > size_t(end - pos)) break;
+      const std::string_view key {stored->data(), stored->nkey};
+      const size_t h = hash(key);
+      auto& shard = shard_for(h);
+      std::lock_guard<Spinlock> lock(shard.lock);
+      shard.store->restore(key, h, stored->flags, stored->exptime, stored->time,
+                           stored->cas, stored->segment,
+                           {stored->data() + stored->nkey, stored->nbytes}, now);
+      pos += len;
+    }
+    store.go_next();
+  }
+  store.pop_marker();
+}
+
+} // < namespace net::memcached
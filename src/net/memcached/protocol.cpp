@@ -0,0 +1,316 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/memcached/protocol.hpp>
+#include <kernel/rtc.hpp>
+#include <charconv>
+#include <likely>
+
+namespace net::memcached {
+
+  static const char* VERSION = "1.6.0";
+
+  static std::string_view next_token(std::string_view& line)
+  {
+    const auto begin = line.find_first_not_of(' ');
+    if (begin == line.npos) {
+      line = {};
+      return {};
+    }
+    line.remove_prefix(begin);
+    const auto end = std::min(line.find(' '), line.size());
+    auto token = line.substr(0, end);
+    line.remove_prefix(end);
+    return token;
+  }
+
+  template <typename T>
+  static bool to_number(std::string_view token, T& value)
+  {
+    if (token.empty()) return false;
+    auto res = std::from_chars(token.data(), token.data() + token.size(), value);
+    return res.ec == std::errc() and res.ptr == token.data() + token.size();
+  }
+
+  // removes a trailing noreply from the arguments
+  static bool noreply(std::string_view& args)
+  {
+    while (not args.empty() and args.back() == ' ') args.remove_suffix(1);
+    static const std::string_view word {"noreply"};
+    if (args.size() < word.size() or args.substr(args.size() - word.size()) != word)
+      return false;
+    const auto before = args.size() - word.size();
+    if (before > 0 and args[before - 1] != ' ') return false;
+    args.remove_suffix(word.size());
+    return true;
+  }
+
+  static void reply(Result result, std::string& out)
+  {
+    switch (result) {
+    case Result::STORED:      out += "STORED\r\n"; break;
+    case Result::NOT_STORED:  out += "NOT_STORED\r\n"; break;
+    case Result::EXISTS:      out += "EXISTS\r\n"; break;
+    case Result::NOT_FOUND:   out += "NOT_FOUND\r\n"; break;
+    case Result::DELETED:     out += "DELETED\r\n"; break;
+    case Result::TOUCHED:     out += "TOUCHED\r\n"; break;
+    case Result::NON_NUMERIC:
+      out += "CLIENT_ERROR cannot increment or decrement non-numeric value\r\n";
+      break;
+    case Result::TOO_LARGE:
+      out += "SERVER_ERROR object too large for cache\r\n";
+      break;
+    case Result::NO_MEMORY:
+      out += "SERVER_ERROR out of memory storing object\r\n";
+      break;
+    }
+  }
+
+  uint32_t Connection::now() const
+  {
+    return clock_ ? clock_() : RTC::now();
+  }
+
+  bool Connection::feed(const char* data, size_t len, std::string& out)
+  {
+    if (UNLIKELY(closed_)) return false;
+    const bool buffered = not buffer_.empty();
+    if (buffered) buffer_.append(data, len);
+    const std::string_view input = buffered ? std::string_view{buffer_}
+                                            : std::string_view{data, len};
+    size_t pos = 0;
+    while (pos < input.size() and not closed_)
+    {
+      const size_t n = process(input.substr(pos), out);
+      if (n == 0) break;
+      pos += n;
+    }
+    // keep what is left for later
+    if (buffered) buffer_.erase(0, pos);
+    else buffer_.assign(input.substr(pos));
+    return not closed_;
+  }
+
+  size_t Connection::process(std::string_view data, std::string& out)
+  {
+    if (swallow_ > 0) {
+      const size_t n = std::min(swallow_, data.size());
+      swallow_ -= n;
+      return n;
+    }
+    const auto eol = data.find('\n');
+    if (UNLIKELY(std::min(eol, data.size()) > max_line)) {
+      out += "CLIENT_ERROR line too long\r\n";
+      closed_ = true;
+      return 0;
+    }
+    if (eol == data.npos) return 0;
+    auto line = data.substr(0, eol);
+    if (not line.empty() and line.back() == '\r') line.remove_suffix(1);
+    return process_line(line, eol + 1, data.substr(eol + 1), out);
+  }
+
+  size_t Connection::process_line(std::string_view line, size_t consumed,
+                                  std::string_view rest, std::string& out)
+  {
+    auto args = line;
+    const auto cmd = next_token(args);
+
+    if (cmd == "get")   { retrieve(args, false, false, out); return consumed; }
+    if (cmd == "gets")  { retrieve(args, true,  false, out); return consumed; }
+    if (cmd == "gat")   { retrieve(args, false, true,  out); return consumed; }
+    if (cmd == "gats")  { retrieve(args, true,  true,  out); return consumed; }
+
+    Mode mode;
+    if      (cmd == "set")     mode = Mode::SET;
+    else if (cmd == "add")     mode = Mode::ADD;
+    else if (cmd == "replace") mode = Mode::REPLACE;
+    else if (cmd == "append")  mode = Mode::APPEND;
+    else if (cmd == "prepend") mode = Mode::PREPEND;
+    else if (cmd == "cas")     mode = Mode::CAS;
+    else
+    {
+      const size_t mark = out.size();
+      const bool quiet = noreply(args);
+      if (cmd == "delete")
+      {
+        const auto key = next_token(args);
+        const auto extra = next_token(args);
+        if (key.empty() or key.size() > Store::max_key or (not extra.empty() and extra != "0"))
+          out += "CLIENT_ERROR bad command line format\r\n";
+        else
+          reply(cache_.remove(key, now()), out);
+      }
+      else if (cmd == "incr" or cmd == "decr")
+      {
+        const auto key = next_token(args);
+        uint64_t delta, value;
+        if (key.empty() or key.size() > Store::max_key)
+          out += "CLIENT_ERROR bad command line format\r\n";
+        else if (not to_number(next_token(args), delta))
+          out += "CLIENT_ERROR invalid numeric delta argument\r\n";
+        else {
+          const auto res = cache_.arith(key, cmd == "incr", delta, value, now());
+          if (res == Result::STORED) out += std::to_string(value) + "\r\n";
+          else reply(res, out);
+        }
+      }
+      else if (cmd == "touch")
+      {
+        const auto key = next_token(args);
+        int64_t exptime;
+        if (key.empty() or key.size() > Store::max_key
+            or not to_number(next_token(args), exptime))
+          out += "CLIENT_ERROR bad command line format\r\n";
+        else {
+          const uint32_t t = now();
+          reply(cache_.touch(key, Store::expiry(exptime, t), t), out);
+        }
+      }
+      else if (cmd == "flush_all")
+      {
+        const auto delay = next_token(args);
+        int64_t when = 0;
+        if (not delay.empty() and not to_number(delay, when))
+          out += "CLIENT_ERROR bad command line format\r\n";
+        else {
+          const uint32_t t = now();
+          cache_.flush_all(when > 0 ? Store::expiry(when, t) : t, t);
+          out += "OK\r\n";
+        }
+      }
+      else if (cmd == "verbosity")
+        out += "OK\r\n";
+      else if (cmd == "version")
+        out += std::string("VERSION ") + VERSION + "\r\n";
+      else if (cmd == "stats")
+        stats(out);
+      else if (cmd == "quit")
+        closed_ = true;
+      else
+        out += "ERROR\r\n";
+
+      if (quiet) out.resize(mark);
+      return consumed;
+    }
+
+    // <cmd> <key> <flags> <exptime> <bytes> [<cas unique>] [noreply]
+    const bool quiet = noreply(args);
+    const auto key = next_token(args);
+    uint32_t flags;
+    int64_t  exptime;
+    size_t   bytes;
+    uint64_t cas = 0;
+    if (key.empty() or key.size() > Store::max_key
+        or not to_number(next_token(args), flags)
+        or not to_number(next_token(args), exptime)
+        or not to_number(next_token(args), bytes)
+        or (mode == Mode::CAS and not to_number(next_token(args), cas))
+        or not next_token(args).empty())
+    {
+      out += "CLIENT_ERROR bad command line format\r\n";
+      return consumed;
+    }
+    if (bytes > Store::max_value)
+    {
+      if (not quiet) reply(Result::TOO_LARGE, out);
+      swallow_ = bytes + 2;
+      return consumed;
+    }
+    // wait for the whole data block
+    if (rest.size() < bytes + 2) return 0;
+    if (rest.substr(bytes, 2) != "\r\n")
+    {
+      out += "CLIENT_ERROR bad data chunk\r\n";
+      return consumed + bytes + 2;
+    }
+    const uint32_t t = now();
+    const auto res = cache_.store(mode, key, flags, Store::expiry(exptime, t),
+                                  rest.substr(0, bytes), t, cas);
+    if (not quiet) reply(res, out);
+    return consumed + bytes + 2;
+  }
+
+  void Connection::retrieve(std::string_view args, bool cas, bool touch,
+                            std::string& out)
+  {
+    const uint32_t t = now();
+    uint32_t exptime = 0;
+    if (touch) {
+      int64_t value;
+      if (not to_number(next_token(args), value)) {
+        out += "CLIENT_ERROR bad command line format\r\n";
+        return;
+      }
+      exptime = Store::expiry(value, t);
+    }
+    auto key = next_token(args);
+    if (key.empty()) {
+      out += "ERROR\r\n";
+      return;
+    }
+    for (; not key.empty(); key = next_token(args))
+    {
+      if (key.size() > Store::max_key) {
+        out += "CLIENT_ERROR bad command line format\r\n";
+        return;
+      }
+      cache_.get(key, t, [&out, cas] (const Cache::Item& item) {
+        out += "VALUE ";
+        out += item.key();
+        out += ' ';
+        out += std::to_string(item.flags);
+        out += ' ';
+        out += std::to_string(item.nbytes);
+        if (cas) {
+          out += ' ';
+          out += std::to_string(item.cas);
+        }
+        out += "\r\n";
+        out += item.value();
+        out += "\r\n";
+      }, touch ? &exptime : nullptr);
+    }
+    out += "END\r\n";
+  }
+
+  void Connection::stats(std::string& out)
+  {
+    const auto stats = cache_.stats();
+    auto stat = [&out] (const char* name, uint64_t value) {
+      out += "STAT ";
+      out += name;
+      out += ' ';
+      out += std::to_string(value);
+      out += "\r\n";
+    };
+    out += std::string("STAT version ") + VERSION + "\r\n";
+    stat("time",           now());
+    stat("threads",        cache_.shards());
+    stat("curr_items",     stats.items);
+    stat("total_items",    stats.sets);
+    stat("bytes",          stats.bytes);
+    stat("limit_maxbytes", cache_.capacity());
+    stat("get_hits",       stats.get_hits);
+    stat("get_misses",     stats.get_misses);
+    stat("evictions",      stats.evictions);
+    stat("expired",        stats.expired);
+    stat("slab_pages",     stats.pages);
+    stat("slab_reassigned", stats.reassigned);
+    out += "END\r\n";
+  }
+
+}
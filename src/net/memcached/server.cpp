@@ -0,0 +1,65 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/memcached/server.hpp>
+#include <net/inet>
+
+namespace net::memcached {
+
+  Server::Server(Stack& stack, Cache& cache, uint16_t port)
+    : stack_{stack}, cache_{cache},
+      listener_{stack.tcp().listen(port, {this, &Server::accept})}
+  {}
+
+  Server::~Server()
+  {
+    for (auto& entry : clients_)
+    {
+      entry.second->conn->on_close(nullptr);
+      entry.second->conn->close();
+    }
+    listener_.close();
+  }
+
+  void Server::accept(tcp::Connection_ptr conn)
+  {
+    stats_.accepted++;
+    auto* raw = conn.get();
+    auto& client = *clients_.emplace(raw,
+        new Client{conn, Connection{cache_}, {}}).first->second;
+
+    conn->on_read(READ_SIZE, [this, &client] (tcp::buffer_t buf) {
+      receive(client, std::move(buf));
+    });
+    conn->on_close([this, raw] {
+      clients_.erase(raw);
+    });
+  }
+
+  void Server::receive(Client& client, tcp::buffer_t buf)
+  {
+    const bool open = client.protocol.feed((const char*) buf->data(), buf->size(), client.out);
+    if (not client.out.empty()) {
+      client.conn->write(client.out.data(), client.out.size());
+      client.out.clear();
+    }
+    if (not open) {
+      stats_.closed++;
+      client.conn->close();
+    }
+  }
+
+}
@@ -0,0 +1,500 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/memcached/store.hpp>
+#include <expects>
+#include <likely>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace net::memcached {
+
+  static constexpr size_t INITIAL_BUCKETS = 1024;
+  static constexpr size_t PAGE_ALIGN      = 64;
+
+  // items in HOT and WARM, in percent of the slab class
+  static constexpr uint32_t HOT_PERCENT  = 20;
+  static constexpr uint32_t WARM_PERCENT = 40;
+  // items moved between segments per change, at most
+  static constexpr int BALANCE_MOVES = 4;
+
+  static size_t align8(size_t n) noexcept
+  { return (n + 7) & ~size_t(7); }
+
+  Store::Store(Memory memory, double growth)
+    : memory_{std::move(memory)},
+      buckets_(INITIAL_BUCKETS, nullptr)
+  {
+    Expects(growth > 1.0);
+    size_t size = min_chunk;
+    while (size < page_size / 2 and classes_ < max_classes - 1)
+    {
+      slabs_[classes_].size     = size;
+      slabs_[classes_].per_page = page_size / size;
+      classes_++;
+      size = std::max(align8(size * growth), size + 8);
+    }
+    // the largest items take a page each
+    slabs_[classes_].size     = page_size;
+    slabs_[classes_].per_page = 1;
+    classes_++;
+  }
+
+  Store::~Store()
+  {
+    for (int cls = 0; cls < classes_; cls++)
+      for (void* page : slabs_[cls].pages)
+        memory_->deallocate(page, page_size, PAGE_ALIGN);
+  }
+
+  uint32_t Store::expiry(int64_t exptime, uint32_t now) noexcept
+  {
+    if (exptime == 0) return 0;
+    // already expired, but not never
+    if (exptime < 0) return 1;
+    if (exptime <= max_relative_exptime) return now + exptime;
+    return exptime;
+  }
+
+  bool Store::is_live(const Item& item, uint32_t now) const noexcept
+  {
+    if (item.exptime != 0 and item.exptime <= now) return false;
+    if (flushed_at_ != 0 and flushed_at_ <= now and item.time <= flushed_at_)
+      return false;
+    return true;
+  }
+
+  int Store::class_for(size_t size) const noexcept
+  {
+    auto* begin = slabs_.data();
+    auto* end   = slabs_.data() + classes_;
+    auto* it = std::lower_bound(begin, end, size,
+        [] (const Slab_class& slab, size_t size) { return slab.size < size; });
+    return it != end ? it - begin : -1;
+  }
+
+  Store::Item* Store::find(std::string_view key, uint32_t hash, uint32_t now)
+  {
+    now_ = now;
+    for (Item* item = buckets_[hash & (buckets_.size() - 1)]; item; item = item->h_next)
+    {
+      if (item->hash != hash or item->key() != key) continue;
+      if (LIKELY(is_live(*item, now))) return item;
+      stats_.expired++;
+      unlink(item);
+      free(item);
+      return nullptr;
+    }
+    return nullptr;
+  }
+
+  const Store::Item* Store::get(std::string_view key, size_t hash, uint32_t now)
+  {
+    Item* item = find(key, bucket_hash(hash), now);
+    if (item == nullptr) {
+      stats_.get_misses++;
+      return nullptr;
+    }
+    stats_.get_hits++;
+    bump(item);
+    return item;
+  }
+
+  Result Store::store(Mode mode, std::string_view key, size_t hash,
+                      uint32_t flags, uint32_t exptime, std::string_view value,
+                      uint32_t now, uint64_t cas)
+  {
+    const uint32_t h = bucket_hash(hash);
+    Item* old = find(key, h, now);
+    switch (mode) {
+    case Mode::ADD:
+      if (old) {
+        bump(old);
+        return Result::NOT_STORED;
+      }
+      break;
+    case Mode::REPLACE:
+    case Mode::APPEND:
+    case Mode::PREPEND:
+      if (old == nullptr) return Result::NOT_STORED;
+      break;
+    case Mode::CAS:
+      if (old == nullptr) return Result::NOT_FOUND;
+      if (old->cas != cas) return Result::EXISTS;
+      break;
+    case Mode::SET:
+      break;
+    }
+
+    const bool extend = mode == Mode::APPEND or mode == Mode::PREPEND;
+    const size_t nbytes = value.size() + (extend ? old->nbytes : 0);
+    if (UNLIKELY(key.size() > max_key or sizeof(Item) + key.size() + nbytes > page_size))
+    {
+      // the old value is gone, like in memcached
+      if (old and not extend) {
+        unlink(old);
+        free(old);
+      }
+      return Result::TOO_LARGE;
+    }
+
+    // keep the old item from being evicted to make room for the new one
+    pinned_ = old;
+    Item* item = alloc(key, h, nbytes);
+    pinned_ = nullptr;
+    if (UNLIKELY(item == nullptr)) return Result::NO_MEMORY;
+
+    char* dst = item->data() + item->nkey;
+    if (mode == Mode::APPEND) {
+      std::memcpy(dst, old->value().data(), old->nbytes);
+      std::memcpy(dst + old->nbytes, value.data(), value.size());
+    }
+    else if (mode == Mode::PREPEND) {
+      std::memcpy(dst, value.data(), value.size());
+      std::memcpy(dst + value.size(), old->value().data(), old->nbytes);
+    }
+    else {
+      std::memcpy(dst, value.data(), value.size());
+    }
+    item->flags   = extend ? old->flags : flags;
+    item->exptime = extend ? old->exptime : exptime;
+    item->time    = now;
+    item->cas     = ++cas_;
+
+    if (old) {
+      unlink(old);
+      free(old);
+    }
+    link(item, HOT);
+    balance(slabs_[item->cls]);
+    stats_.sets++;
+    return Result::STORED;
+  }
+
+  Result Store::remove(std::string_view key, size_t hash, uint32_t now)
+  {
+    Item* item = find(key, bucket_hash(hash), now);
+    if (item == nullptr) return Result::NOT_FOUND;
+    unlink(item);
+    free(item);
+    return Result::DELETED;
+  }
+
+  Result Store::touch(std::string_view key, size_t hash, uint32_t exptime, uint32_t now)
+  {
+    Item* item = find(key, bucket_hash(hash), now);
+    if (item == nullptr) return Result::NOT_FOUND;
+    item->exptime = exptime;
+    bump(item);
+    return Result::TOUCHED;
+  }
+
+  Result Store::arith(std::string_view key, size_t hash, bool incr, uint64_t delta,
+                      uint64_t& value, uint32_t now)
+  {
+    Item* item = find(key, bucket_hash(hash), now);
+    if (item == nullptr) return Result::NOT_FOUND;
+
+    const auto text = item->value();
+    if (text.empty() or text.size() > 20) return Result::NON_NUMERIC;
+    uint64_t current = 0;
+    for (char c : text) {
+      if (c < '0' or c > '9') return Result::NON_NUMERIC;
+      if (__builtin_mul_overflow(current, 10, &current) or
+          __builtin_add_overflow(current, uint64_t(c - '0'), &current))
+        return Result::NON_NUMERIC;
+    }
+    value = incr ? current + delta : (delta > current ? 0 : current - delta);
+
+    char digits[24];
+    const size_t len = snprintf(digits, sizeof(digits), "%llu", (unsigned long long) value);
+    if (len == item->nbytes) {
+      std::memcpy(item->data() + item->nkey, digits, len);
+      item->cas = ++cas_;
+      bump(item);
+      return Result::STORED;
+    }
+    // the new value has another length, store it as a new item
+    char copy[max_key];
+    std::memcpy(copy, key.data(), key.size());
+    return store(Mode::SET, {copy, key.size()}, hash, item->flags,
+                 item->exptime, {digits, len}, now);
+  }
+
+  void Store::flush_all(uint32_t when, uint32_t now)
+  {
+    if (when > now) {
+      flushed_at_ = when;
+      return;
+    }
+    flushed_at_ = 0;
+    for (int cls = 0; cls < classes_; cls++)
+      for (int seg = HOT; seg < SEGMENTS; seg++)
+        while (Item* item = slabs_[cls].tail[seg]) {
+          unlink(item);
+          free(item);
+        }
+  }
+
+  bool Store::restore(std::string_view key, size_t hash, uint32_t flags,
+                      uint32_t exptime, uint32_t time, uint64_t cas,
+                      uint8_t segment, std::string_view value, uint32_t now)
+  {
+    if (key.size() > max_key or sizeof(Item) + key.size() + value.size() > page_size)
+      return false;
+    const uint32_t h = bucket_hash(hash);
+    if (Item* old = find(key, h, now)) {
+      unlink(old);
+      free(old);
+    }
+    Item* item = alloc(key, h, value.size());
+    if (item == nullptr) return false;
+    std::memcpy(item->data() + item->nkey, value.data(), value.size());
+    item->flags   = flags;
+    item->exptime = exptime;
+    item->time    = time;
+    item->cas     = cas;
+    cas_ = std::max(cas_, cas);
+    link(item, segment < SEGMENTS ? segment : uint8_t(COLD));
+    return true;
+  }
+
+  Store::Item* Store::alloc(std::string_view key, uint32_t hash, size_t nbytes)
+  {
+    const int cls = class_for(sizeof(Item) + key.size() + nbytes);
+    if (UNLIKELY(cls < 0)) return nullptr;
+    auto& slab = slabs_[cls];
+
+    Item* item;
+    if (slab.free or grow(slab, cls) or (slab.items == 0 and reassign(slab, cls))) {
+      item = slab.free;
+      slab.free = item->h_next;
+    }
+    else {
+      item = evict(slab);
+      if (item == nullptr) return nullptr;
+    }
+
+    item->h_next  = nullptr;
+    item->prev    = nullptr;
+    item->next    = nullptr;
+    item->cas     = 0;
+    item->hash    = hash;
+    item->exptime = 0;
+    item->time    = 0;
+    item->flags   = 0;
+    item->nbytes  = nbytes;
+    item->nkey    = key.size();
+    item->cls     = cls;
+    item->segment = HOT;
+    item->active  = 0;
+    std::memcpy(item->data(), key.data(), key.size());
+    return item;
+  }
+
+  bool Store::grow(Slab_class& slab, int cls)
+  {
+    if (memory_->allocatable() < page_size) return false;
+    void* page;
+    try {
+      page = memory_->allocate(page_size, PAGE_ALIGN);
+    }
+    catch (const std::bad_alloc&) {
+      return false;
+    }
+    stats_.pages++;
+    carve(slab, cls, page);
+    return true;
+  }
+
+  bool Store::reassign(Slab_class& slab, int cls)
+  {
+    // the class with the most pages gives one up, but keeps one
+    int victim = -1;
+    size_t most = 1;
+    for (int i = 0; i < classes_; i++)
+      if (i != cls and slabs_[i].pages.size() > most) {
+        victim = i;
+        most = slabs_[i].pages.size();
+      }
+    if (victim < 0) return false;
+
+    auto& from = slabs_[victim];
+    const size_t span = from.per_page * from.size;
+    auto inside = [span] (const void* ptr, const char* page) {
+      return ptr >= page and ptr < page + span;
+    };
+    auto pick = from.pages.end() - 1;
+    if (inside(pinned_, static_cast<char*>(*pick))) pick = from.pages.begin();
+    auto* page = static_cast<char*>(*pick);
+    from.pages.erase(pick);
+    auto* end = page + span;
+    for (char* chunk = page; chunk < end; chunk += from.size)
+    {
+      auto* item = reinterpret_cast<Item*>(chunk);
+      if (item->segment == SEGMENTS) continue;
+      stats_.evictions++;
+      unlink(item);
+    }
+    for (Item** link = &from.free; *link;)
+    {
+      auto* chunk = reinterpret_cast<char*>(*link);
+      if (chunk >= page and chunk < end) *link = (*link)->h_next;
+      else link = &(*link)->h_next;
+    }
+    stats_.reassigned++;
+    carve(slab, cls, page);
+    return true;
+  }
+
+  void Store::carve(Slab_class& slab, int cls, void* page)
+  {
+    slab.pages.push_back(page);
+    auto* chunk = static_cast<char*>(page);
+    for (uint32_t i = 0; i < slab.per_page; i++, chunk += slab.size)
+    {
+      auto* item = reinterpret_cast<Item*>(chunk);
+      item->cls = cls;
+      item->segment = SEGMENTS;
+      item->h_next = slab.free;
+      slab.free = item;
+    }
+  }
+
+  Store::Item* Store::evict(Slab_class& slab)
+  {
+    for (auto seg : {COLD, HOT, WARM})
+    {
+      Item* item = slab.tail[seg];
+      if (item and item == pinned_) item = item->prev;
+      if (item == nullptr) continue;
+      if (is_live(*item, now_)) stats_.evictions++;
+      else stats_.expired++;
+      unlink(item);
+      return item;
+    }
+    return nullptr;
+  }
+
+  void Store::link(Item* item, uint8_t segment)
+  {
+    auto& bucket = buckets_[item->hash & (buckets_.size() - 1)];
+    item->h_next = bucket;
+    bucket = item;
+    hashed_++;
+    lru_push(item, segment);
+    slabs_[item->cls].items++;
+    stats_.items++;
+    stats_.bytes += item->nkey + item->nbytes;
+    if (UNLIKELY(hashed_ > buckets_.size() + buckets_.size() / 2))
+      rehash();
+  }
+
+  void Store::unlink(Item* item)
+  {
+    Item** link = &buckets_[item->hash & (buckets_.size() - 1)];
+    while (*link != item) link = &(*link)->h_next;
+    *link = item->h_next;
+    hashed_--;
+    lru_remove(item);
+    slabs_[item->cls].items--;
+    stats_.items--;
+    stats_.bytes -= item->nkey + item->nbytes;
+  }
+
+  void Store::free(Item* item)
+  {
+    auto& slab = slabs_[item->cls];
+    item->segment = SEGMENTS;
+    item->h_next = slab.free;
+    slab.free = item;
+  }
+
+  void Store::lru_push(Item* item, uint8_t segment)
+  {
+    auto& slab = slabs_[item->cls];
+    item->segment = segment;
+    item->prev = nullptr;
+    item->next = slab.head[segment];
+    if (item->next) item->next->prev = item;
+    else slab.tail[segment] = item;
+    slab.head[segment] = item;
+    slab.count[segment]++;
+  }
+
+  void Store::lru_remove(Item* item)
+  {
+    auto& slab = slabs_[item->cls];
+    const auto seg = item->segment;
+    if (item->prev) item->prev->next = item->next;
+    else slab.head[seg] = item->next;
+    if (item->next) item->next->prev = item->prev;
+    else slab.tail[seg] = item->prev;
+    item->prev = item->next = nullptr;
+    slab.count[seg]--;
+  }
+
+  void Store::bump(Item* item)
+  {
+    if (item->segment != COLD) {
+      item->active = 1;
+      return;
+    }
+    // used while cold, it has earned a place in WARM
+    lru_remove(item);
+    item->active = 0;
+    lru_push(item, WARM);
+    balance(slabs_[item->cls]);
+  }
+
+  void Store::balance(Slab_class& slab)
+  {
+    const uint32_t hot_max  = std::max<uint32_t>(slab.items * HOT_PERCENT / 100, 1);
+    const uint32_t warm_max = std::max<uint32_t>(slab.items * WARM_PERCENT / 100, 1);
+
+    for (int i = 0; i < BALANCE_MOVES and slab.count[HOT] > hot_max; i++)
+    {
+      Item* item = slab.tail[HOT];
+      lru_remove(item);
+      lru_push(item, item->active ? WARM : COLD);
+      item->active = 0;
+    }
+    for (int i = 0; i < BALANCE_MOVES and slab.count[WARM] > warm_max; i++)
+    {
+      Item* item = slab.tail[WARM];
+      lru_remove(item);
+      // active items get another round in WARM
+      lru_push(item, item->active ? WARM : COLD);
+      item->active = 0;
+    }
+  }
+
+  void Store::rehash()
+  {
+    std::vector<Item*> buckets(buckets_.size() * 2, nullptr);
+    for (Item* chain : buckets_)
+      while (chain) {
+        Item* next = chain->h_next;
+        auto& bucket = buckets[chain->hash & (buckets.size() - 1)];
+        chain->h_next = bucket;
+        bucket = chain;
+        chain = next;
+      }
+    buckets_ = std::move(buckets);
+  }
+
+}
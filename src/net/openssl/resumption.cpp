@@ -0,0 +1,132 @@
+#include <net/openssl/init.hpp>
+#include <net/tls/session_cache.hpp>
+#include <net/tls/ticket_keys.hpp>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <kernel/rng.hpp>
+#include <cassert>
+#include <cstring>
+
+namespace openssl
+{
+  struct Resumption {
+    net::tls::Session_cache& cache;
+    net::tls::Ticket_keys&   keys;
+  };
+
+  static void free_resumption(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*)
+  {
+    delete (Resumption*) ptr;
+  }
+
+  static int resumption_index()
+  {
+    static const int index =
+        SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, free_resumption);
+    return index;
+  }
+
+  static Resumption& get_resumption(SSL_CTX* ctx)
+  {
+    auto* res = (Resumption*) SSL_CTX_get_ex_data(ctx, resumption_index());
+    assert(res != nullptr);
+    return *res;
+  }
+
+  static int new_session_cb(SSL* ssl, SSL_SESSION* sess)
+  {
+    auto& res = get_resumption(SSL_get_SSL_CTX(ssl));
+    unsigned int id_len = 0;
+    const auto* id = SSL_SESSION_get_id(sess, &id_len);
+
+    const int len = i2d_SSL_SESSION(sess, nullptr);
+    if (len <= 0) return 0;
+    std::vector<uint8_t> buffer(len);
+    auto* p = buffer.data();
+    i2d_SSL_SESSION(sess, &p);
+
+    res.cache.insert({(const char*) id, id_len}, buffer.data(), buffer.size());
+    // we did not keep a reference to the session
+    return 0;
+  }
+
+  static SSL_SESSION* get_session_cb(SSL* ssl, const unsigned char* id,
+                                     int id_len, int* copy)
+  {
+    auto& res = get_resumption(SSL_get_SSL_CTX(ssl));
+    *copy = 0;
+    std::vector<uint8_t> buffer;
+    if (not res.cache.lookup({(const char*) id, (size_t) id_len}, buffer))
+        return nullptr;
+    const auto* p = buffer.data();
+    return d2i_SSL_SESSION(nullptr, &p, buffer.size());
+  }
+
+  static void remove_session_cb(SSL_CTX* ctx, SSL_SESSION* sess)
+  {
+    auto& res = get_resumption(ctx);
+    unsigned int id_len = 0;
+    const auto* id = SSL_SESSION_get_id(sess, &id_len);
+    res.cache.erase({(const char*) id, id_len});
+  }
+
+  static int init_hmac(EVP_MAC_CTX* hctx, const uint8_t* key, size_t len)
+  {
+    static char digest[] = "SHA256";
+    const OSSL_PARAM params[] {
+      OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, (void*) key, len),
+      OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+      OSSL_PARAM_construct_end()
+    };
+    return EVP_MAC_CTX_set_params(hctx, params);
+  }
+
+  static int ticket_key_cb(SSL* ssl, unsigned char* key_name, unsigned char* iv,
+                           EVP_CIPHER_CTX* cctx, EVP_MAC_CTX* hctx, int enc)
+  {
+    auto& res = get_resumption(SSL_get_SSL_CTX(ssl));
+    if (enc)
+    {
+      const auto key = res.keys.current();
+      rng_extract(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc()));
+      std::memcpy(key_name, key.name.data(), key.name.size());
+      if (EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), nullptr,
+                             key.aes_key.data(), iv) != 1) return -1;
+      if (init_hmac(hctx, key.hmac_key.data(), key.hmac_key.size()) != 1) return -1;
+      return 1;
+    }
+    bool is_current = false;
+    const auto key = res.keys.find(key_name, is_current);
+    // unknown or expired key: fall back to a full handshake
+    if (not key) return 0;
+    if (init_hmac(hctx, key->hmac_key.data(), key->hmac_key.size()) != 1) return -1;
+    if (EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), nullptr,
+                           key->aes_key.data(), iv) != 1) return -1;
+    // 2 makes OpenSSL issue a new ticket with the current key
+    return is_current ? 1 : 2;
+  }
+
+  void enable_resumption(SSL_CTX* ctx,
+                         net::tls::Session_cache& cache,
+                         net::tls::Ticket_keys& keys)
+  {
+    auto* res = (Resumption*) SSL_CTX_get_ex_data(ctx, resumption_index());
+    delete res;
+    res = new Resumption{cache, keys};
+    SSL_CTX_set_ex_data(ctx, resumption_index(), res);
+
+    static const unsigned char sid_ctx[] = "IncludeOS";
+    SSL_CTX_set_session_id_context(ctx, sid_ctx, sizeof(sid_ctx) - 1);
+    // the internal cache is per context, use the shared cache instead
+    SSL_CTX_set_session_cache_mode(ctx,
+        SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_set_timeout(ctx, cache.lifetime().count());
+    SSL_CTX_sess_set_new_cb(ctx, new_session_cb);
+    SSL_CTX_sess_set_get_cb(ctx, get_session_cb);
+    SSL_CTX_sess_set_remove_cb(ctx, remove_session_cb);
+
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticket_key_cb);
+  }
+}
@@ -1,25 +1,29 @@
 #include <net/openssl/tls_stream.hpp>
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 using namespace openssl;
 
+// room for one full record including header, padding and MAC
+static constexpr size_t TX_RESERVE = SSL3_RT_MAX_ENCRYPTED_LENGTH + SSL3_RT_HEADER_LENGTH;
+
 TLS_stream::TLS_stream(SSL_CTX* ctx, Stream_ptr t, bool outgoing)
   : m_transport(std::move(t))
 {
   ERR_clear_error(); // prevent old errors from mucking things up
-  this->m_bio_rd = BIO_new(BIO_s_mem());
-  this->m_bio_wr = BIO_new(BIO_s_mem());
-  assert(ERR_get_error() == 0 && "Initializing BIOs");
   this->m_ssl = SSL_new(ctx);
   assert(this->m_ssl != nullptr);
   assert(ERR_get_error() == 0 && "Initializing SSL");
+  // unsent plaintext is retried from a copy
+  SSL_set_mode(this->m_ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
   // TLS server-mode
   if (outgoing == false)
       SSL_set_accept_state(this->m_ssl);
   else
       SSL_set_connect_state(this->m_ssl);
 
-  SSL_set_bio(this->m_ssl, this->m_bio_rd, this->m_bio_wr);
+  this->attach_bio();
 
   // always-on callbacks
   m_transport->on_data({this,&TLS_stream::handle_data});
@@ -31,9 +35,11 @@ TLS_stream::TLS_stream(SSL_CTX* ctx, Stream_ptr t, bool outgoing)
     if (this->tls_perform_handshake() < 0) return;
   }
 }
-TLS_stream::TLS_stream(Stream_ptr t, SSL* ssl, BIO* rd, BIO* wr)
-  : m_transport(std::move(t)), m_ssl(ssl), m_bio_rd(rd), m_bio_wr(wr)
+TLS_stream::TLS_stream(Stream_ptr t, SSL* ssl)
+  : m_transport(std::move(t)), m_ssl(ssl)
 {
+  SSL_set_mode(this->m_ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+  this->attach_bio();
   // always-on callbacks
   m_transport->on_data({this, &TLS_stream::handle_data});
   m_transport->on_close({this, &TLS_stream::close_callback_once});
@@ -41,26 +47,148 @@ TLS_stream::TLS_stream(Stream_ptr t, SSL* ssl, BIO* rd, BIO* wr)
 TLS_stream::~TLS_stream()
 {
   assert(m_busy == 0 && "Cannot delete stream while in its call stack");
+  m_flush_timer.stop();
   SSL_free(this->m_ssl);
 }
 
+void TLS_stream::attach_bio()
+{
+  BIO* bio = BIO_new(bio_method());
+  assert(bio != nullptr && "Initializing BIO");
+  BIO_set_data(bio, this);
+  BIO_set_init(bio, 1);
+  // the same BIO is used in both directions, SSL_free releases it
+  SSL_set_bio(this->m_ssl, bio, bio);
+}
+
+BIO_METHOD* TLS_stream::bio_method()
+{
+  static BIO_METHOD* method = nullptr;
+  if (method == nullptr)
+  {
+    method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "IncludeOS stream");
+    BIO_meth_set_write(method, &TLS_stream::bio_write);
+    BIO_meth_set_read(method, &TLS_stream::bio_read);
+    BIO_meth_set_ctrl(method, &TLS_stream::bio_ctrl);
+  }
+  return method;
+}
+
+int TLS_stream::bio_write(BIO* bio, const char* data, int len)
+{
+  auto* self = (TLS_stream*) BIO_get_data(bio);
+  BIO_clear_retry_flags(bio);
+  // append the record(s) directly to the buffer handed to the transport
+  if (self->m_tx == nullptr)
+  {
+    self->m_tx = self->construct_write_buffer();
+    if (UNLIKELY(self->m_tx == nullptr)) {
+      BIO_set_retry_write(bio);
+      return -1;
+    }
+    self->m_tx->reserve(std::max((size_t) len, TX_RESERVE));
+  }
+  self->m_tx->insert(self->m_tx->end(), data, data + len);
+  return len;
+}
+
+int TLS_stream::bio_read(BIO* bio, char* out, int len)
+{
+  auto* self = (TLS_stream*) BIO_get_data(bio);
+  BIO_clear_retry_flags(bio);
+  if (self->m_rx_pending == 0) {
+    BIO_set_retry_read(bio);
+    return -1;
+  }
+  // copy straight out of the transport buffers
+  int total = 0;
+  auto& chain = self->m_rx_chain;
+  while (total < len && not chain.empty())
+  {
+    auto& front = chain.front();
+    const size_t avail = front->size() - self->m_rx_offset;
+    const size_t count = std::min(avail, (size_t) (len - total));
+    std::memcpy(out + total, front->data() + self->m_rx_offset, count);
+    total += count;
+    self->m_rx_offset += count;
+    if (self->m_rx_offset == front->size()) {
+      chain.pop_front();
+      self->m_rx_offset = 0;
+    }
+  }
+  self->m_rx_pending -= total;
+  return total;
+}
+
+long TLS_stream::bio_ctrl(BIO* bio, int cmd, long, void*)
+{
+  auto* self = (TLS_stream*) BIO_get_data(bio);
+  switch (cmd) {
+  case BIO_CTRL_PENDING:
+      return self->m_rx_pending;
+  case BIO_CTRL_WPENDING:
+      return self->m_tx ? self->m_tx->size() : 0;
+  case BIO_CTRL_FLUSH:
+      // records are handed to the transport once OpenSSL returns
+      return 1;
+  case BIO_CTRL_DUP:
+      return 1;
+  default:
+      return 0;
+  }
+}
+
+void TLS_stream::set_write_batching(Timer::duration_t delay)
+{
+  this->m_batch_delay = delay;
+  if (delay == Timer::duration_t::zero()) this->flush();
+}
+
+void TLS_stream::flush()
+{
+  m_flush_timer.stop();
+  if (m_plain == nullptr || m_plain->empty()) return;
+  auto plain = std::move(m_plain);
+  if (UNLIKELY(this->is_connected() == false)) return;
+
+  // the whole batch is encrypted in one go, and all the resulting
+  // records are handed to the transport as a single buffer
+  if (not tls_write(plain->data(), plain->size())) return;
+  tls_perform_stream_write();
+
+  if (this->m_deferred_close) {
+    TLS_PRINT("::flush() close on m_deferred_close after tls_perform_stream_write\n");
+    this->close();
+  }
+}
+
 void TLS_stream::write(buffer_t buffer)
 {
   if (UNLIKELY(this->is_connected() == false)) {
     TLS_PRINT("::write() called on closed stream\n");
     return;
   }
-  int n = SSL_write(this->m_ssl, buffer->data(), buffer->size());
-  auto status = this->status(n);
-  if (status == STATUS_FAIL) {
-    TLS_PRINT("::write() Fail status %d\n",n);
-    this->close();
+
+  if (m_batch_delay != Timer::duration_t::zero() && buffer->size() < RECORD_SIZE)
+  {
+    if (m_plain == nullptr) {
+      m_plain = construct_write_buffer();
+      if (UNLIKELY(m_plain == nullptr)) return;
+      m_plain->reserve(RECORD_SIZE);
+    }
+    m_plain->insert(m_plain->end(), buffer->begin(), buffer->end());
+    if (m_plain->size() >= RECORD_SIZE)
+      this->flush();
+    else if (not m_flush_timer.is_running())
+      m_flush_timer.start(m_batch_delay);
     return;
   }
+  // keep ordering with what has been batched so far
+  this->flush();
+  if (this->m_deferred_close || this->is_connected() == false) return;
 
-  do {
-    n = tls_perform_stream_write();
-  } while (n > 0);
+  if (not tls_write(buffer->data(), buffer->size())) return;
+  tls_perform_stream_write();
 
   if (this->m_deferred_close) {
     TLS_PRINT("::write() close on m_deferred_close after tls_perform_stream_write\n");
@@ -82,51 +210,51 @@ void TLS_stream::write(const void* data, const size_t len)
   write(net::StreamBuffer::construct_write_buffer(buf, buf + len));
 }
 
-int TLS_stream::decrypt(const void *indata, int size)
+bool TLS_stream::tls_write(const uint8_t* data, size_t len)
 {
-  int n = BIO_write(this->m_bio_rd, indata, size);
-  if (UNLIKELY(n < 0)) {
-    //TODO can we handle this more gracefully?
-    TLS_PRINT("BIO_write failed\n");
-    this->close();
-    return -1;
+  // keep the order with what OpenSSL could not take before
+  if (m_unsent != nullptr) {
+    m_unsent->insert(m_unsent->end(), data, data + len);
+    return write_unsent();
   }
+  return ssl_write(data, len);
+}
 
-  // if we aren't finished initializing session
-  if (UNLIKELY(!handshake_completed()))
+bool TLS_stream::write_unsent()
+{
+  auto plain = std::move(m_unsent);
+  return ssl_write(plain->data(), plain->size());
+}
+
+bool TLS_stream::ssl_write(const uint8_t* data, size_t len)
+{
+  ERR_clear_error();
+  while (len > 0)
   {
-    int num = SSL_do_handshake(this->m_ssl);
-    auto status = this->status(num);
-    // OpenSSL wants to write
-    if (status == STATUS_WANT_IO)
-    {
-      tls_perform_stream_write();
-    }
-    else if (status == STATUS_FAIL)
-    {
-      if (num < 0) {
-        TLS_PRINT("TLS_stream::SSL_do_handshake() returned %d\n", num);
-        #ifdef VERBOSE_OPENSSL
-          ERR_print_errors_fp(stdout);
-        #endif
+    size_t written = 0;
+    const int n = SSL_write_ex(this->m_ssl, data, len, &written);
+    if (n <= 0) {
+      auto status = this->status(n);
+      if (status == STATUS_FAIL) {
+        TLS_PRINT("::write() Fail status %d\n",n);
+        this->close();
+        return false;
       }
-      this->close();
-      return -1;
-    }
-    // nothing more to do if still not finished
-    if (handshake_completed() == false) return 0;
-    // handshake success
-    this->m_busy += 1;
-    connected();
-    this->m_busy -= 1;
-
-    if (this->m_deferred_close) {
-      TLS_PRINT("::read() close on m_deferred_close after tls_perform_stream_write\n");
-      this->close();
-      return -1;
+      // OpenSSL needs to read, or is out of memory for the records:
+      // keep the rest until the stream can make progress again
+      m_unsent = construct_write_buffer(data, data + len);
+      if (UNLIKELY(m_unsent == nullptr)) {
+        TLS_PRINT("::write() Unable to keep %zu unsent bytes\n", len);
+        this->close();
+        return false;
+      }
+      tls_perform_stream_write();
+      return false;
     }
+    data += written;
+    len  -= written;
   }
-  return n;
+  return true;
 }
 
 int TLS_stream::send_decrypted()
@@ -134,8 +262,8 @@ int TLS_stream::send_decrypted()
   int n;
   // read decrypted data
   do {
-    //TODO "increase the size or constructor based ??")
-    auto buffer=StreamBuffer::construct_read_buffer(8192);
+    // one full record fits in a single buffer
+    auto buffer=StreamBuffer::construct_read_buffer(RECORD_SIZE);
     if (!buffer) return 0;
     n = SSL_read(this->m_ssl,buffer->data(),buffer->size());
     if (n > 0) {
@@ -165,7 +293,8 @@ void TLS_stream::handle_write_congestion()
 {
   //this should resolve the potential malloc congestion
   //might be missing some TLS signalling but without malloc we cant do that either
-  while(tls_perform_stream_write() >  0);
+  if (m_unsent != nullptr && not write_unsent()) return;
+  tls_perform_stream_write();
 }
 void TLS_stream::handle_data()
 {
@@ -187,59 +316,84 @@ bool TLS_stream::tls_read(buffer_t buffer)
 {
   assert(buffer != nullptr);
   ERR_clear_error();
-  uint8_t* buf_ptr = buffer->data();
-  int      len = buffer->size();
+  if (buffer->empty()) return false;
 
-  while (len > 0)
+  // hand the buffer to OpenSSL without copying it
+  this->m_rx_pending += buffer->size();
+  this->m_rx_chain.push_back(std::move(buffer));
+
+  if (this->m_deferred_close) {
+    TLS_PRINT("::read() close on m_deferred_close");
+    this->close();
+    return true;
+  }
+
+  // if we aren't finished initializing session
+  if (UNLIKELY(!handshake_completed()))
   {
-    if (this->m_deferred_close) {
-      TLS_PRINT("::read() close on m_deferred_close");
+    int num = SSL_do_handshake(this->m_ssl);
+    auto status = this->status(num);
+    // OpenSSL may have produced handshake messages
+    tls_perform_stream_write();
+    if (status == STATUS_FAIL)
+    {
+      if (num < 0) {
+        TLS_PRINT("TLS_stream::SSL_do_handshake() returned %d\n", num);
+        #ifdef VERBOSE_OPENSSL
+          ERR_print_errors_fp(stdout);
+        #endif
+      }
       this->close();
       return true;
     }
+    // nothing more to do if still not finished
+    if (handshake_completed() == false) return false;
+    // handshake success
+    this->m_busy += 1;
+    connected();
+    this->m_busy -= 1;
 
-    const int decrypted_bytes = decrypt(buf_ptr, len);
-    if (UNLIKELY(decrypted_bytes == 0)) {
-      return false;
-    }
-    else if (UNLIKELY(decrypted_bytes < 0)) {
-      return true;
-    }
-    buf_ptr += decrypted_bytes;
-    len -= decrypted_bytes;
-
-    // enqueues decrypted data
-    int ret = send_decrypted();
-
-    // this goes here?
-    if (UNLIKELY(this->is_closing() || this->is_closed())) {
-      TLS_PRINT("TLS_stream::SSL_read closed during read\n");
-      return true;
-    }
     if (this->m_deferred_close) {
-      TLS_PRINT("::read() close on m_deferred_close");
+      TLS_PRINT("::read() close on m_deferred_close after tls_perform_stream_write\n");
       this->close();
       return true;
     }
+  }
 
-    auto status = this->status(ret);
-    // did peer request stream renegotiation?
-    if (status == STATUS_WANT_IO)
-    {
-      TLS_PRINT("::read() STATUS_WANT_IO\n");
-      int ret;
-      do {
-        ret = tls_perform_stream_write();
-      } while (ret > 0);
-    }
-    else if (status == STATUS_FAIL)
-    {
-      TLS_PRINT("::read() close on STATUS_FAIL after tls_perform_stream_write\n");
-      this->close();
-      return true;
-    }
+  // enqueues decrypted data
+  int ret = send_decrypted();
 
-  } // while it < end
+  // this goes here?
+  if (UNLIKELY(this->is_closing() || this->is_closed())) {
+    TLS_PRINT("TLS_stream::SSL_read closed during read\n");
+    return true;
+  }
+  if (this->m_deferred_close) {
+    TLS_PRINT("::read() close on m_deferred_close");
+    this->close();
+    return true;
+  }
+
+  auto status = this->status(ret);
+  // did peer request stream renegotiation?
+  if (status == STATUS_WANT_IO)
+  {
+    TLS_PRINT("::read() STATUS_WANT_IO\n");
+    tls_perform_stream_write();
+  }
+  else if (status == STATUS_FAIL)
+  {
+    TLS_PRINT("::read() close on STATUS_FAIL after tls_perform_stream_write\n");
+    this->close();
+    return true;
+  }
+
+  // plaintext that was waiting for the peer can go now
+  if (m_unsent != nullptr && handshake_completed())
+  {
+    if (write_unsent()) tls_perform_stream_write();
+    if (UNLIKELY(this->is_closing() || this->is_closed())) return true;
+  }
 
   //forward data
   this->m_busy += 1;
@@ -259,61 +413,31 @@ bool TLS_stream::tls_read(buffer_t buffer)
 
 int TLS_stream::tls_perform_stream_write()
 {
-  ERR_clear_error();
-  int pending = BIO_ctrl_pending(this->m_bio_wr);
-  if (pending > 0)
-  {
-    TLS_PRINT("::tls_perform_stream_write() pending=%d bytes\n",pending);
-    auto buffer = net::StreamBuffer::construct_write_buffer(pending);
-    if (buffer == nullptr) {
-      return 0;
-    }
-    int n = BIO_read(this->m_bio_wr, buffer->data(), buffer->size());
-    assert(n == pending);
-    //What if we cant write..
-    if (m_transport->is_writable())
-    {
-      m_transport->write(buffer);
-
-      this->m_busy += 1;
-      stream_on_write(n);
-      this->m_busy -= 1;
-    }
+  if (m_tx == nullptr || m_tx->empty()) return 0;
+  // keep the records until the transport can take them
+  if (not m_transport->is_writable()) return 0;
 
-    if (UNLIKELY((pending = BIO_ctrl_pending(this->m_bio_wr)) > 0))
-    {
-      return pending;
-    }
-    return 0;
-  }
+  auto buffer = std::move(m_tx);
+  const int n = buffer->size();
+  TLS_PRINT("::tls_perform_stream_write() pending=%d bytes\n", n);
+  m_transport->write(std::move(buffer));
 
-  BIO_read(this->m_bio_wr, nullptr, 0);
-
-  if (!BIO_should_retry(this->m_bio_wr))
-  {
-    TLS_PRINT("::tls_perform_stream_write() close on !BIO_should_retry\n");
-    this->close();
-    return -1;
-  }
+  this->m_busy += 1;
+  stream_on_write(n);
+  this->m_busy -= 1;
   return 0;
 }
 
 int TLS_stream::tls_perform_handshake()
 {
   ERR_clear_error(); // prevent old errors from mucking things up
-  // will return -1:SSL_ERROR_WANT_WRITE
+  // will return -1:SSL_ERROR_WANT_READ
   int ret = SSL_do_handshake(this->m_ssl);
   int n = this->status(ret);
   ERR_print_errors_fp(stderr);
   if (n == STATUS_WANT_IO)
   {
-    do {
-      n = tls_perform_stream_write();
-      if (n < 0) {
-        TLS_PRINT("TLS_stream::tls_perform_handshake() stream write failed\n");
-      }
-    } while (n > 0);
-    return n;
+    return tls_perform_stream_write();
   }
   else {
     TLS_PRINT("TLS_stream::tls_perform_handshake() returned %d\n", ret);
@@ -330,6 +454,15 @@ void TLS_stream::close()
     TLS_PRINT("::close() deferred\n");
     this->m_deferred_close = true; return;
   }
+  // send whatever has been batched so far
+  if (m_plain != nullptr && this->is_connected())
+  {
+    this->m_busy += 1;
+    this->flush();
+    this->m_busy -= 1;
+  }
+  m_flush_timer.stop();
+  m_plain = nullptr;
   CloseCallback func = getCloseCallback();
   this->reset_callbacks();
   if (m_transport->is_connected())
@@ -346,6 +479,7 @@ void TLS_stream::close_callback_once()
     TLS_PRINT("TLS_stream::close_callback_once() deferred\n");
     this->m_deferred_close = true; return;
   }
+  m_flush_timer.stop();
   CloseCallback func = getCloseCallback();
   this->reset_callbacks();
   if (func) func();
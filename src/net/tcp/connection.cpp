@@ -389,6 +389,8 @@ __attribute__((weak))
 void Connection::deserialize_from(void*) {}
 __attribute__((weak))
 int  Connection::serialize_to(void*) const {  return 0;  }
+__attribute__((weak))
+int  Connection::serialized_size() const {  return 0;  }
 
 Packet_view_ptr Connection::create_outgoing_packet()
 {
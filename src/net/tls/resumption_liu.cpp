@@ -0,0 +1,105 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/tls/session_cache.hpp>
+#include <net/tls/ticket_keys.hpp>
+#include <kernel/rtc.hpp>
+#include <liveupdate.hpp>
+#include <cstring>
+#include <mutex>
+
+namespace net::tls {
+
+// serialized session: expires, id length, then the id and session data
+struct Stored_session {
+  uint64_t expires;
+  uint8_t  id_len;
+
+  char* id() noexcept { return (char*) (this + 1); }
+  const char* id() const noexcept { return (const char*) (this + 1); }
+} __attribute__((packed));
+
+void Session_cache::store(uint16_t id, liu::Storage& store) const
+{
+  const uint64_t now = RTC::now();
+  std::vector<uint8_t> buffer;
+  for (const auto& shard : m_shards)
+  {
+    std::lock_guard<Spinlock> lock(shard.lock);
+    for (const auto& entry : shard.lru)
+    {
+      if (entry.expires <= now || entry.id.size() > UINT8_MAX) continue;
+      buffer.resize(sizeof(Stored_session) + entry.id.size() + entry.data.size());
+      auto* stored = (Stored_session*) buffer.data();
+      stored->expires = entry.expires;
+      stored->id_len  = entry.id.size();
+      std::memcpy(stored->id(), entry.id.data(), entry.id.size());
+      std::memcpy(stored->id() + entry.id.size(), entry.data.data(), entry.data.size());
+      store.add_buffer(id, buffer.data(), buffer.size());
+    }
+  }
+  store.put_marker(id);
+}
+
+void Session_cache::restore(liu::Restore& store)
+{
+  const uint64_t now = RTC::now();
+  while (not store.is_marker() && not store.is_end())
+  {
+    const size_t len = store.length();
+    const auto* stored = (const Stored_session*) store.data();
+    if (store.is_buffer() && len >= sizeof(Stored_session)
+        && len >= sizeof(Stored_session) + stored->id_len
+        && stored->expires > now)
+    {
+      const size_t data_len = len - sizeof(Stored_session) - stored->id_len;
+      this->insert({stored->id(), stored->id_len},
+                   stored->id() + stored->id_len, data_len, stored->expires);
+    }
+    store.go_next();
+  }
+  store.pop_marker();
+}
+
+// stored keys: the current, and optionally the previous key
+struct Stored_keys {
+  uint8_t    count;
+  Ticket_key keys[2];
+};
+
+void Ticket_keys::store(uint16_t id, liu::Storage& store) const
+{
+  Stored_keys stored {};
+  {
+    std::lock_guard<Spinlock> lock(m_lock);
+    if (m_has_current)  stored.keys[stored.count++] = m_current;
+    if (m_has_previous) stored.keys[stored.count++] = m_previous;
+  }
+  store.add<Stored_keys>(id, stored);
+}
+
+void Ticket_keys::restore(liu::Restore& store)
+{
+  const auto& stored = store.as_type<Stored_keys>();
+  std::lock_guard<Spinlock> lock(m_lock);
+  m_has_current  = stored.count >= 1;
+  m_has_previous = stored.count >= 2;
+  if (m_has_current)  m_current  = stored.keys[0];
+  if (m_has_previous) m_previous = stored.keys[1];
+}
+
+} // < namespace net::tls
@@ -0,0 +1,133 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/tls/session_cache.hpp>
+#include <kernel/rtc.hpp>
+#include <mutex>
+
+namespace net::tls {
+
+Session_cache& Session_cache::get()
+{
+  static Session_cache cache;
+  return cache;
+}
+
+Session_cache::Session_cache(size_t max_entries, std::chrono::seconds lifetime)
+  : m_max_per_shard{std::max<size_t>(1, max_entries / SHARDS)},
+    m_lifetime{lifetime}
+{}
+
+void Session_cache::insert(std::string_view id, const void* data, size_t len)
+{
+  this->insert(id, data, len, RTC::now() + m_lifetime.count());
+}
+
+void Session_cache::insert(std::string_view id, const void* data, size_t len,
+                           uint64_t expires)
+{
+  if (id.empty()) return;
+  auto& shard = shard_for(id);
+  std::lock_guard<Spinlock> lock(shard.lock);
+
+  auto it = shard.map.find(id);
+  if (it != shard.map.end()) {
+    erase_locked(shard, it->second);
+  }
+  else if (shard.lru.size() >= m_max_per_shard) {
+    erase_locked(shard, std::prev(shard.lru.end()));
+    shard.stats.evictions++;
+  }
+
+  const auto* begin = static_cast<const uint8_t*>(data);
+  shard.lru.push_front(Entry{std::string(id), {begin, begin + len}, expires});
+  auto& entry = shard.lru.front();
+  shard.map.emplace(std::string_view(entry.id), shard.lru.begin());
+  shard.stats.inserts++;
+}
+
+bool Session_cache::lookup(std::string_view id, std::vector<uint8_t>& out)
+{
+  auto& shard = shard_for(id);
+  std::lock_guard<Spinlock> lock(shard.lock);
+
+  auto it = shard.map.find(id);
+  if (it == shard.map.end()) {
+    shard.stats.misses++;
+    return false;
+  }
+  auto entry = it->second;
+  if (entry->expires <= RTC::now()) {
+    erase_locked(shard, entry);
+    shard.stats.expired++;
+    shard.stats.misses++;
+    return false;
+  }
+  // move to front of LRU
+  shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+  out.assign(entry->data.begin(), entry->data.end());
+  shard.stats.hits++;
+  return true;
+}
+
+bool Session_cache::erase(std::string_view id)
+{
+  auto& shard = shard_for(id);
+  std::lock_guard<Spinlock> lock(shard.lock);
+
+  auto it = shard.map.find(id);
+  if (it == shard.map.end()) return false;
+  erase_locked(shard, it->second);
+  return true;
+}
+
+size_t Session_cache::clear()
+{
+  size_t count = 0;
+  for (auto& shard : m_shards)
+  {
+    std::lock_guard<Spinlock> lock(shard.lock);
+    count += shard.lru.size();
+    shard.map.clear();
+    shard.lru.clear();
+  }
+  return count;
+}
+
+void Session_cache::erase_locked(Shard& shard, Entry_list::iterator entry)
+{
+  shard.map.erase(std::string_view(entry->id));
+  shard.lru.erase(entry);
+}
+
+Session_cache::Stats Session_cache::stats() const
+{
+  Stats total;
+  for (const auto& shard : m_shards)
+  {
+    std::lock_guard<Spinlock> lock(shard.lock);
+    total.hits      += shard.stats.hits;
+    total.misses    += shard.stats.misses;
+    total.inserts   += shard.stats.inserts;
+    total.evictions += shard.stats.evictions;
+    total.expired   += shard.stats.expired;
+    total.entries   += shard.lru.size();
+  }
+  return total;
+}
+
+} // < namespace net::tls
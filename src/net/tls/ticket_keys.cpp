@@ -0,0 +1,83 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/tls/ticket_keys.hpp>
+#include <kernel/rng.hpp>
+#include <kernel/rtc.hpp>
+#include <cstring>
+#include <mutex>
+
+namespace net::tls {
+
+Ticket_keys& Ticket_keys::get()
+{
+  static Ticket_keys keys;
+  return keys;
+}
+
+void Ticket_keys::rotate_locked(uint64_t now)
+{
+  m_previous = m_current;
+  m_has_previous = m_has_current;
+  m_has_current  = true;
+  rng_extract(m_current.name.data(),     m_current.name.size());
+  rng_extract(m_current.aes_key.data(),  m_current.aes_key.size());
+  rng_extract(m_current.hmac_key.data(), m_current.hmac_key.size());
+  m_current.created = now;
+}
+
+Ticket_key Ticket_keys::current()
+{
+  const uint64_t now = RTC::now();
+  std::lock_guard<Spinlock> lock(m_lock);
+  if (not m_has_current || now >= m_current.created + m_interval.count()) {
+    rotate_locked(now);
+  }
+  return m_current;
+}
+
+std::optional<Ticket_key> Ticket_keys::find(const uint8_t* name, bool& is_current)
+{
+  const uint64_t now = RTC::now();
+  std::lock_guard<Spinlock> lock(m_lock);
+  // no ticket is issued with an expired key, even if current() has not
+  // been called since. As the previous key it decrypts for one more interval.
+  if (m_has_current && now >= m_current.created + m_interval.count()) {
+    rotate_locked(now);
+  }
+  if (m_has_current
+      && memcmp(name, m_current.name.data(), Ticket_key::NAME_LEN) == 0)
+  {
+    is_current = true;
+    return m_current;
+  }
+  if (previous_valid(now)
+      && memcmp(name, m_previous.name.data(), Ticket_key::NAME_LEN) == 0)
+  {
+    is_current = false;
+    return m_previous;
+  }
+  return std::nullopt;
+}
+
+void Ticket_keys::rotate()
+{
+  std::lock_guard<Spinlock> lock(m_lock);
+  rotate_locked(RTC::now());
+}
+
+} // < namespace net::tls
@@ -20,6 +20,7 @@
 #include <memory>
 #include <net/udp/socket.hpp>
 #include <net/udp/udp.hpp>
+#include <net/inet>
 
 namespace net::udp
 {
@@ -43,6 +44,17 @@ namespace net::udp
      error_handler ecb)
   {
     if (UNLIKELY(length == 0)) return;
+
+    // fast path: a single datagram with nothing queued ahead of it is
+    // written straight into a packet, without copying it to the sendq
+    if (cb == nullptr and ecb == nullptr and udp_.sendq.empty()
+        and length <= udp_.max_datagram_size()
+        and udp_.stack().transmit_queue_available() > 0)
+    {
+      udp_.transmit(socket_, net::Socket{destIP, port}, (const uint8_t*) buffer, length);
+      return;
+    }
+
     udp_.sendq.emplace_back(this->udp_,
       socket_, net::Socket{destIP, port},
       (const uint8_t*) buffer, length,
@@ -221,21 +221,48 @@ namespace net {
   }
 
   void UDP::transmit(udp::Packet_view_ptr udp)
+  {
+    transmit(*udp);
+  }
+
+  void UDP::transmit(udp::Packet_view& udp)
   {
     PRINT("<UDP> Transmitting %u bytes (data=%u) from %s to %s:%i\n",
-           udp->udp_length(), udp->udp_data_length(),
-           udp->ip_src().to_string().c_str(),
-           udp->ip_dst().to_string().c_str(), udp->dst_port());
+           udp.udp_length(), udp.udp_data_length(),
+           udp.ip_src().to_string().c_str(),
+           udp.ip_dst().to_string().c_str(), udp.dst_port());
 
-    Expects(udp->udp_length() >= sizeof(udp::Header));
+    Expects(udp.udp_length() >= sizeof(udp::Header));
 
-    if(udp->ipv() == Protocol::IPv6) {
-      udp->set_udp_checksum(); // mandatory in IPv6
-      network_layer_out6_(udp->release());
+    if(udp.ipv() == Protocol::IPv6) {
+      udp.set_udp_checksum(); // mandatory in IPv6
+      network_layer_out6_(udp.release());
     }
     else {
-      //udp->set_udp_checksum(); // optional in IPv4
-      network_layer_out4_(udp->release());
+      //udp.set_udp_checksum(); // optional in IPv4
+      network_layer_out4_(udp.release());
+    }
+  }
+
+  void UDP::transmit(const net::Socket& src, const net::Socket& dst,
+                     const uint8_t* data, size_t length)
+  {
+    // the views live on the stack, only the packet buffer is pooled
+    if (src.address().is_v6())
+    {
+      Expects(dst.address().is_v6());
+      udp::Packet6_view pkt{stack_.create_ip6_packet(Protocol::UDP)};
+      pkt.init(src, dst);
+      pkt.fill(data, length);
+      transmit(pkt);
+    }
+    else
+    {
+      Expects(dst.address().is_v4());
+      udp::Packet4_view pkt{stack_.create_ip_packet(Protocol::UDP)};
+      pkt.init(src, dst);
+      pkt.fill(data, length);
+      transmit(pkt);
     }
   }
 
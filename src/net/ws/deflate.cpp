@@ -0,0 +1,399 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <net/ws/deflate.hpp>
+#include <likely>
+#include <smp>
+#include <algorithm>
+#include <cassert>
+#include <zlib.h>
+
+namespace net {
+
+// ---------------------- negotiation ----------------------
+
+static std::string_view trim(std::string_view sv) noexcept
+{
+  while (!sv.empty() && (sv.front() == ' ' || sv.front() == '\t'))
+    sv.remove_prefix(1);
+  while (!sv.empty() && (sv.back() == ' ' || sv.back() == '\t'))
+    sv.remove_suffix(1);
+  return sv;
+}
+
+static bool parse_window_bits(std::string_view value, uint8_t& bits) noexcept
+{
+  // quoted-string form is allowed by the RFC
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+    value = value.substr(1, value.size() - 2);
+  if (value.empty() || value.size() > 2) return false;
+
+  unsigned v = 0;
+  for (char c : value) {
+    if (c < '0' || c > '9') return false;
+    v = v * 10 + (c - '0');
+  }
+  if (v < WS_deflate_options::MIN_WINDOW_BITS
+   || v > WS_deflate_options::MAX_WINDOW_BITS) return false;
+  bits = v;
+  return true;
+}
+
+static std::optional<WS_deflate_options> parse_element(std::string_view elem)
+{
+  WS_deflate_options opts;
+  opts.enabled = true;
+  bool seen_server_bits = false;
+  bool first = true;
+
+  while (!elem.empty())
+  {
+    const auto end = elem.find(';');
+    auto token = trim(elem.substr(0, end));
+    elem = (end == std::string_view::npos) ? std::string_view{} : elem.substr(end + 1);
+
+    if (first) {
+      if (token != "permessage-deflate") return std::nullopt;
+      first = false;
+      continue;
+    }
+
+    std::string_view name = token, value;
+    const auto eq = token.find('=');
+    if (eq != std::string_view::npos) {
+      name  = trim(token.substr(0, eq));
+      value = trim(token.substr(eq + 1));
+    }
+
+    // each parameter may only appear once, and unknown ones are invalid
+    if (name == "server_no_context_takeover") {
+      if (opts.server_no_context_takeover || !value.empty()) return std::nullopt;
+      opts.server_no_context_takeover = true;
+    }
+    else if (name == "client_no_context_takeover") {
+      if (opts.client_no_context_takeover || !value.empty()) return std::nullopt;
+      opts.client_no_context_takeover = true;
+    }
+    else if (name == "server_max_window_bits") {
+      if (seen_server_bits) return std::nullopt;
+      if (!parse_window_bits(value, opts.server_max_window_bits)) return std::nullopt;
+      seen_server_bits = true;
+    }
+    else if (name == "client_max_window_bits") {
+      if (opts.client_max_window_bits_offered) return std::nullopt;
+      if (!value.empty() && !parse_window_bits(value, opts.client_max_window_bits))
+        return std::nullopt;
+      opts.client_max_window_bits_offered = true;
+    }
+    else {
+      return std::nullopt;
+    }
+  }
+  if (first) return std::nullopt;
+  return opts;
+}
+
+std::optional<WS_deflate_options> WS_deflate_options::parse(std::string_view header)
+{
+  // a client may offer several alternatives, use the first valid one
+  while (!header.empty())
+  {
+    const auto end = header.find(',');
+    auto result = parse_element(header.substr(0, end));
+    if (result) return result;
+    if (end == std::string_view::npos) break;
+    header = header.substr(end + 1);
+  }
+  return std::nullopt;
+}
+
+WS_deflate_options WS_deflate_options::accept(const WS_deflate_options& offer) const noexcept
+{
+  WS_deflate_options res = *this;
+  res.enabled = true;
+  res.server_no_context_takeover =
+      offer.server_no_context_takeover || this->server_no_context_takeover;
+  res.client_no_context_takeover =
+      offer.client_no_context_takeover || this->client_no_context_takeover;
+  res.server_max_window_bits =
+      std::min(offer.server_max_window_bits, this->server_max_window_bits);
+  // we may only limit the client window when the client said it supports it
+  res.client_max_window_bits_offered = offer.client_max_window_bits_offered;
+  if (offer.client_max_window_bits_offered)
+    res.client_max_window_bits =
+        std::min(offer.client_max_window_bits, this->client_max_window_bits);
+  else
+    res.client_max_window_bits = MAX_WINDOW_BITS;
+  return res;
+}
+
+std::optional<WS_deflate_options>
+WS_deflate_options::confirm(const WS_deflate_options& response) const noexcept
+{
+  // the server must honor what we asked for
+  if (this->server_no_context_takeover && !response.server_no_context_takeover)
+    return std::nullopt;
+  if (response.server_max_window_bits > this->server_max_window_bits)
+    return std::nullopt;
+  if (response.client_max_window_bits > this->client_max_window_bits)
+    return std::nullopt;
+
+  WS_deflate_options res = response;
+  res.mem_level = this->mem_level;
+  res.min_size  = this->min_size;
+  res.client_no_context_takeover =
+      response.client_no_context_takeover || this->client_no_context_takeover;
+  return res;
+}
+
+std::string WS_deflate_options::offer_string() const
+{
+  std::string str = "permessage-deflate";
+  if (server_no_context_takeover)
+    str += "; server_no_context_takeover";
+  if (client_no_context_takeover)
+    str += "; client_no_context_takeover";
+  if (server_max_window_bits < MAX_WINDOW_BITS)
+    str += "; server_max_window_bits=" + std::to_string(server_max_window_bits);
+  // always announce that we support limiting our own window
+  if (client_max_window_bits < MAX_WINDOW_BITS)
+    str += "; client_max_window_bits=" + std::to_string(client_max_window_bits);
+  else
+    str += "; client_max_window_bits";
+  return str;
+}
+
+std::string WS_deflate_options::response_string() const
+{
+  std::string str = "permessage-deflate";
+  if (server_no_context_takeover)
+    str += "; server_no_context_takeover";
+  if (client_no_context_takeover)
+    str += "; client_no_context_takeover";
+  if (server_max_window_bits < MAX_WINDOW_BITS)
+    str += "; server_max_window_bits=" + std::to_string(server_max_window_bits);
+  if (client_max_window_bits_offered && client_max_window_bits < MAX_WINDOW_BITS)
+    str += "; client_max_window_bits=" + std::to_string(client_max_window_bits);
+  return str;
+}
+
+// ---------------------- context pool ----------------------
+
+struct WS_deflate_pool::Context
+{
+  z_stream strm;
+  WS_deflate_pool* pool;
+  bool deflate;
+  int  window_bits;
+  int  mem_level;
+};
+
+void WS_deflate_pool::Context_deleter::operator() (Context* ctx) const
+{
+  ctx->pool->release(ctx);
+}
+
+static void destroy_context(WS_deflate_pool::Context* ctx)
+{
+  if (ctx->deflate) deflateEnd(&ctx->strm);
+  else              inflateEnd(&ctx->strm);
+  delete ctx;
+}
+
+WS_deflate_pool& WS_deflate_pool::get()
+{
+  static SMP::Array<WS_deflate_pool> pools;
+  return PER_CPU(pools);
+}
+
+WS_deflate_pool::Context_ptr WS_deflate_pool::deflater(int window_bits, int mem_level)
+{
+  // zlib does not support a 256 byte window for raw deflate
+  return acquire(true, std::max(window_bits, 9), mem_level);
+}
+WS_deflate_pool::Context_ptr WS_deflate_pool::inflater(int window_bits)
+{
+  // inflating with a larger window than the peer used is always fine
+  return acquire(false, std::max(window_bits, 9), 0);
+}
+
+WS_deflate_pool::Context_ptr
+WS_deflate_pool::acquire(bool deflate, int window_bits, int mem_level)
+{
+  for (auto it = m_idle.begin(); it != m_idle.end(); ++it)
+  {
+    auto* ctx = *it;
+    if (ctx->deflate == deflate && ctx->window_bits == window_bits
+        && ctx->mem_level == mem_level)
+    {
+      *it = m_idle.back();
+      m_idle.pop_back();
+      m_stats.idle--;
+      m_stats.in_use++;
+      return Context_ptr{ctx};
+    }
+  }
+
+  auto* ctx = new Context{};
+  ctx->pool = this;
+  ctx->deflate = deflate;
+  ctx->window_bits = window_bits;
+  ctx->mem_level = mem_level;
+  // negative window bits means raw deflate (no zlib header)
+  const int res = deflate
+    ? deflateInit2(&ctx->strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                   -window_bits, mem_level, Z_DEFAULT_STRATEGY)
+    : inflateInit2(&ctx->strm, -window_bits);
+  if (res != Z_OK) {
+    delete ctx;
+    return nullptr;
+  }
+  m_stats.created++;
+  m_stats.in_use++;
+  return Context_ptr{ctx};
+}
+
+void WS_deflate_pool::release(Context* ctx)
+{
+  m_stats.in_use--;
+  if (m_idle.size() >= max_idle) {
+    destroy_context(ctx);
+    return;
+  }
+  if (ctx->deflate) deflateReset(&ctx->strm);
+  else              inflateReset(&ctx->strm);
+  m_idle.push_back(ctx);
+  m_stats.idle++;
+}
+
+WS_deflate_pool::~WS_deflate_pool()
+{
+  for (auto* ctx : m_idle) destroy_context(ctx);
+}
+
+// ---------------------- per-connection ----------------------
+
+WS_deflate::WS_deflate(const WS_deflate_options& negotiated, bool client)
+  : m_opts(negotiated)
+{
+  if (client) {
+    m_deflate_bits  = negotiated.client_max_window_bits;
+    m_inflate_bits  = negotiated.server_max_window_bits;
+    m_keep_deflater = not negotiated.client_no_context_takeover;
+    m_keep_inflater = not negotiated.server_no_context_takeover;
+  }
+  else {
+    m_deflate_bits  = negotiated.server_max_window_bits;
+    m_inflate_bits  = negotiated.client_max_window_bits;
+    m_keep_deflater = not negotiated.server_no_context_takeover;
+    m_keep_inflater = not negotiated.client_no_context_takeover;
+  }
+}
+
+std::string_view WS_deflate::compress(const char* data, size_t len)
+{
+  auto& pool = WS_deflate_pool::get();
+  if (m_deflater == nullptr)
+      m_deflater = pool.deflater(m_deflate_bits, m_opts.mem_level);
+  if (UNLIKELY(m_deflater == nullptr)) return {};
+
+  auto& strm = m_deflater->strm;
+  auto& out  = pool.scratch();
+  const size_t bound = deflateBound(&strm, len) + 16;
+  if (out.size() < bound) out.resize(bound);
+
+  strm.next_in  = (Bytef*) data;
+  strm.avail_in = len;
+  size_t total = 0;
+  do {
+    if (total == out.size()) out.resize(out.size() * 2);
+    strm.next_out  = out.data() + total;
+    strm.avail_out = out.size() - total;
+    const int res = deflate(&strm, Z_SYNC_FLUSH);
+    total = out.size() - strm.avail_out;
+    if (UNLIKELY(res != Z_OK && res != Z_BUF_ERROR)) {
+      m_deflater.reset();
+      return {};
+    }
+  } while (strm.avail_out == 0);
+
+  if (not m_keep_deflater) m_deflater.reset();
+
+  // a sync flush always ends with an empty stored block: 00 00 ff ff
+  assert(total >= 4 && out[total-2] == 0xff && out[total-1] == 0xff);
+  return {(const char*) out.data(), total - 4};
+}
+
+// inflate into out starting at total, returns a zlib status code
+static int inflate_into(z_stream& strm, const uint8_t* data, size_t len,
+                        std::vector<uint8_t>& out, size_t& total, size_t max_size)
+{
+  strm.next_in  = (Bytef*) data;
+  strm.avail_in = len;
+  do {
+    if (total == out.size())
+    {
+      // room for one byte past max_size tells a message of exactly
+      // max_size apart from a longer one
+      if (max_size != 0 && out.size() > max_size) return Z_MEM_ERROR;
+      size_t next = std::max(out.size() * 2, (size_t) 1024);
+      if (max_size != 0) next = std::min(next, max_size + 1);
+      out.resize(next);
+    }
+    strm.next_out  = out.data() + total;
+    strm.avail_out = out.size() - total;
+    const int res = inflate(&strm, Z_SYNC_FLUSH);
+    total = out.size() - strm.avail_out;
+    if (res == Z_STREAM_END) return res;
+    if (res != Z_OK && res != Z_BUF_ERROR) return res;
+    if (res == Z_BUF_ERROR && strm.avail_out != 0) break;
+  } while (strm.avail_in > 0 || strm.avail_out == 0);
+  return Z_OK;
+}
+
+bool WS_deflate::decompress(const uint8_t* data, size_t len,
+                            std::vector<uint8_t>& out, size_t max_size)
+{
+  static const uint8_t tail[4] {0x0, 0x0, 0xff, 0xff};
+
+  if (m_inflater == nullptr)
+      m_inflater = WS_deflate_pool::get().inflater(m_inflate_bits);
+  if (UNLIKELY(m_inflater == nullptr)) return false;
+
+  auto& strm = m_inflater->strm;
+  out.clear();
+  out.resize(std::max(len * 2, (size_t) 256));
+  if (max_size != 0 && out.size() > max_size) out.resize(max_size + 1);
+  size_t total = 0;
+
+  int res = inflate_into(strm, data, len, out, total, max_size);
+  // re-append the empty stored block that the sender removed
+  if (res == Z_OK)
+      res = inflate_into(strm, tail, sizeof(tail), out, total, max_size);
+  // the sender used a final block, which ends the deflate stream
+  if (res == Z_STREAM_END) {
+    inflateReset(&strm);
+    res = Z_OK;
+  }
+  if (max_size != 0 && total > max_size) res = Z_MEM_ERROR;
+  out.resize(total);
+
+  if (res != Z_OK || not m_keep_inflater) m_inflater.reset();
+  return res == Z_OK;
+}
+
+} // < namespace net
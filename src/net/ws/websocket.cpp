@@ -54,7 +54,8 @@ const char* WebSocket::to_string(op_code code)
   }
 }
 
-WebSocket_ptr WebSocket::upgrade(http::Request& req, http::Response_writer& writer)
+WebSocket_ptr WebSocket::upgrade(http::Request& req, http::Response_writer& writer,
+                                 const WS_deflate_options& deflate)
 {
   // validate handshake
   auto view = req.header().value("Sec-WebSocket-Version");
@@ -75,6 +76,17 @@ WebSocket_ptr WebSocket::upgrade(http::Request& req, http::Response_writer& writ
   header.set_field(http::header::Connection, "Upgrade");
   header.set_field(http::header::Upgrade,    "WebSocket");
   header.set_field("Sec-WebSocket-Accept", encode_hash(std::string(key)));
+
+  // negotiate permessage-deflate, if the client offered it
+  WS_deflate_options negotiated;
+  if (deflate.enabled)
+  {
+    auto offer = WS_deflate_options::parse(req.header().value("Sec-WebSocket-Extensions"));
+    if (offer) {
+      negotiated = deflate.accept(*offer);
+      header.set_field("Sec-WebSocket-Extensions", negotiated.response_string());
+    }
+  }
   writer.write_header(http::Switching_Protocols);
 
   auto stream = writer.connection().release();
@@ -82,12 +94,13 @@ WebSocket_ptr WebSocket::upgrade(http::Request& req, http::Response_writer& writ
   // discard streams which can be FIN-WAIT-1
   if (stream->is_connected()) {
     // for now, only accept fully connected streams
-    return std::make_unique<WebSocket>(std::move(stream), false);
+    return std::make_unique<WebSocket>(std::move(stream), false, negotiated);
   }
   return nullptr;
 }
 
-WebSocket_ptr WebSocket::upgrade(http::Error err, http::Response& res, http::Connection& conn, const std::string& key)
+WebSocket_ptr WebSocket::upgrade(http::Error err, http::Response& res, http::Connection& conn,
+                                 const std::string& key, const WS_deflate_options& deflate)
 {
   if (err or res.status_code() != http::Switching_Protocols)
   {
@@ -101,11 +114,23 @@ WebSocket_ptr WebSocket::upgrade(http::Error err, http::Response& res, http::Con
     {
       return nullptr;
     }
+    /// validate extensions, the server may not use what we didn't offer
+    WS_deflate_options negotiated;
+    auto ext = res.header().value("Sec-WebSocket-Extensions");
+    if (not ext.empty())
+    {
+      if (not deflate.enabled) return nullptr;
+      auto response = WS_deflate_options::parse(ext);
+      if (not response) return nullptr;
+      auto confirmed = deflate.confirm(*response);
+      if (not confirmed) return nullptr;
+      negotiated = *confirmed;
+    }
     /// create open websocket
     auto stream = conn.release();
     assert(stream->is_connected());
     // create client websocket and call callback
-    return std::make_unique<WebSocket>(std::move(stream), true);
+    return std::make_unique<WebSocket>(std::move(stream), true, negotiated);
   }
 }
 
@@ -122,12 +147,13 @@ std::vector<char> WebSocket::generate_key()
 }
 
 http::Server::Request_handler WebSocket::create_request_handler(
-  Connect_handler on_connect, Accept_handler on_accept)
+  Connect_handler on_connect, Accept_handler on_accept, WS_deflate_options deflate)
 {
   return http::Server::Request_handler::make_packed(
     [
       on_connect{std::move(on_connect)},
-      on_accept{std::move(on_accept)}
+      on_accept{std::move(on_accept)},
+      deflate
     ]
     (http::Request_ptr req, http::Response_writer_ptr writer)
     {
@@ -142,23 +168,24 @@ http::Server::Request_handler WebSocket::create_request_handler(
           return;
         }
       }
-      auto ws = WebSocket::upgrade(*req, *writer);
+      auto ws = WebSocket::upgrade(*req, *writer, deflate);
 
       on_connect(std::move(ws));
     });
 }
 
 http::Basic_client::Response_handler WebSocket::create_response_handler(
-  Connect_handler on_connect, std::string key)
+  Connect_handler on_connect, std::string key, WS_deflate_options deflate)
 {
   return http::Basic_client::Response_handler::make_packed(
     [
       on_connect{std::move(on_connect)},
-      key{std::move(key)}
+      key{std::move(key)},
+      deflate
     ]
     (http::Error err, http::Response_ptr res, http::Connection& conn)
     {
-      auto ws = WebSocket::upgrade(err, *res, conn, key);
+      auto ws = WebSocket::upgrade(err, *res, conn, key, deflate);
 
       on_connect(std::move(ws));
     });
@@ -167,7 +194,8 @@ http::Basic_client::Response_handler WebSocket::create_response_handler(
 void WebSocket::connect(
       http::Basic_client&   client,
       uri::URI              remote,
-      Connect_handler       callback)
+      Connect_handler       callback,
+      const WS_deflate_options& deflate)
 {
   // doesn't have to be extremely random, just random
   std::string key  = base64::encode(generate_key());
@@ -178,9 +206,11 @@ void WebSocket::connect(
       {"Sec-WebSocket-Version", "13"},
       {"Sec-WebSocket-Key",     key }
   };
+  if (deflate.enabled)
+    ws_headers.emplace_back("Sec-WebSocket-Extensions", deflate.offer_string());
   // send HTTP request
   client.get(remote, ws_headers,
-    WS_client_connector::create_response_handler(std::move(callback), std::move(key)));
+    WS_client_connector::create_response_handler(std::move(callback), std::move(key), deflate));
 }
 
 void WebSocket::read_data(Stream::buffer_t buf)
@@ -271,6 +301,18 @@ size_t WebSocket::create_message(const uint8_t* buf, size_t len)
     hdr.data_length(), hdr.data_offset());
   */
 
+  // RSV1 is only valid on data frames with permessage-deflate
+  if (hdr.is_compressed()) {
+    if (m_deflate == nullptr) {
+      failure("Read compressed message without permessage-deflate");
+      return len;
+    }
+    if (hdr.opcode() != op_code::TEXT and hdr.opcode() != op_code::BINARY) {
+      failure("Read compressed control frame");
+      return len;
+    }
+  }
+
   // discard invalid messages
   if (hdr.is_masked()) {
     if (clientside == true) {
@@ -294,6 +336,8 @@ void WebSocket::finalize_message()
   switch (hdr.opcode()) {
   case op_code::TEXT:
   case op_code::BINARY:
+    if (message->is_compressed() and not this->inflate_message())
+      return; // failure has been called and stream closed
     /// .. call on_read
     if (this->on_read) {
       this->m_busy = true;
@@ -330,6 +374,20 @@ void WebSocket::finalize_message()
   message.reset();
 }
 
+bool WebSocket::inflate_message()
+{
+  std::vector<uint8_t> data;
+  if (not m_deflate->decompress((const uint8_t*) message->data(), message->size(),
+                                data, max_msg_size))
+  {
+    message.reset();
+    failure("read: Invalid or oversized compressed message");
+    return false;
+  }
+  message->set_data(std::move(data));
+  return true;
+}
+
 /** create a websocket message with only the header present
     with the intention of appending the message on the returned buffer */
 static Stream::buffer_t create_wsmsg(size_t len, op_code code, bool client)
@@ -365,6 +423,11 @@ void WebSocket::write(const char* data, size_t len, op_code code)
   Expects((code == op_code::TEXT or code == op_code::BINARY)
       && "Write currently only supports TEXT or BINARY");
 
+  if (m_deflate and m_deflate->should_compress(len)) {
+    write_compressed(data, len, code);
+    return;
+  }
+
   // fill header
   auto buf = create_wsmsg(len, code, clientside);
   // get data offset & fill in data into buffer
@@ -398,12 +461,35 @@ void WebSocket::write(Stream::buffer_t buffer, op_code code)
   Expects((code == op_code::TEXT or code == op_code::BINARY)
         && "Write currently only supports TEXT or BINARY");
 
+  if (m_deflate and m_deflate->should_compress(buffer->size())) {
+    write_compressed((const char*) buffer->data(), buffer->size(), code);
+    return;
+  }
+
   /// write header
   auto header = create_wsmsg(buffer->size(), code, false);
   this->stream->write(header);
   /// write shared buffer
   this->stream->write(buffer);
 }
+void WebSocket::write_compressed(const char* data, size_t len, op_code code)
+{
+  const auto payload = m_deflate->compress(data, len);
+  if (UNLIKELY(payload.empty())) {
+    failure("write: Compression failed");
+    return;
+  }
+  auto buf = create_wsmsg(payload.size(), code, clientside);
+  ((ws_header*) buf->data())->set_compressed();
+  buf->insert(buf->end(), payload.begin(), payload.end());
+  if (clientside)
+  {
+    auto& hdr = *(ws_header*) buf->data();
+    hdr.masking_algorithm(hdr.data());
+  }
+  this->stream->write(buf);
+}
+
 bool WebSocket::write_opcode(op_code code, const char* buffer, size_t datalen)
 {
   if (UNLIKELY(stream == nullptr || stream->is_writable() == false)) {
@@ -418,10 +504,13 @@ bool WebSocket::write_opcode(op_code code, const char* buffer, size_t datalen)
   return true;
 }
 
-WebSocket::WebSocket(net::Stream_ptr stream_ptr, bool client)
+WebSocket::WebSocket(net::Stream_ptr stream_ptr, bool client,
+                     const WS_deflate_options& deflate)
   : stream(std::move(stream_ptr)), max_msg_size(0), clientside(client)
 {
   assert(stream != nullptr);
+  if (deflate.enabled)
+    this->m_deflate = std::make_unique<WS_deflate>(deflate, client);
   this->stream->on_read(8*1024, {this, &WebSocket::read_data});
   this->stream->on_close({this, &WebSocket::close_callback_once});
 }
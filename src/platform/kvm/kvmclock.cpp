@@ -82,13 +82,15 @@ uint64_t KVM_clock::system_time()
   do
   {
     version = vcpu.version;
-    asm("mfence" ::: "memory");
+    // loads are not reordered with other loads on x86, so only the
+    // compiler and rdtsc need holding back, no full fence
+    asm volatile("lfence" ::: "memory");
     // nanosecond offset based on TSC
     uint64_t delta = (os::Arch::cpu_cycles() - vcpu.tsc_timestamp);
     time_ns = pvclock_scale_delta(delta, vcpu.tsc_to_system_mul, vcpu.tsc_shift);
     // base system time
     time_ns += vcpu.system_time;
-    asm("mfence" ::: "memory");
+    asm volatile("" ::: "memory");
   }
   while ((vcpu.version & 0x1) || (version != vcpu.version));
   return time_ns;
@@ -4,6 +4,7 @@
 #include "clocks.hpp"
 #include "idt.hpp"
 #include <kernel/events.hpp>
+#include <kernel/smp_work.hpp>
 //#include <kernel/os.hpp>
 #include <os.hpp>
 #include <kernel/rng.hpp>
@@ -60,6 +61,8 @@ static void revenant_task_handler()
 {
   auto& system = PER_CPU(smp_system);
   system.work_done = false;
+  // work posted directly to this CPU
+  os::smp::drain();
   // cpu-specific tasks
   while(revenant_task_doer(PER_CPU(smp_system)));
   // global tasks (by taking from index 0)
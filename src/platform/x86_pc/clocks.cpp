@@ -18,24 +18,32 @@
 #include "clocks.hpp"
 #include "../kvm/kvmclock.hpp"
 #include "cmos_clock.hpp"
+#include "tsc_clock.hpp"
 #include "platform.hpp"
 #include <util/units.hpp>
 #include <kernel/cpuid.hpp>
+#include <kernel/smp_work.hpp>
 #include <arch.hpp>
 #include <delegate>
 #include <info>
 #include <smp>
+#include <algorithm>
+#include <array>
+#include <atomic>
 
 using namespace util::literals;
 
 struct sysclock_t
 {
-  typedef delegate<uint64_t()> system_time_t;
+  // a plain pointer, read on every RTC::nanos_now()
+  typedef uint64_t (*system_time_t)();
   typedef delegate<timespec()> wall_time_t;
   typedef delegate<KHz()> tsc_khz_t;
-  system_time_t system_time = nullptr;
+  std::atomic<system_time_t> system_time {nullptr};
   wall_time_t   wall_time   = nullptr;
   tsc_khz_t     tsc_khz     = nullptr;
+  const char*   source      = "none";
+  uint32_t      cost        = 0; // cycles per system_time() call
 };
 static sysclock_t current_clock;
 
@@ -48,7 +56,8 @@ namespace x86
     {
       KVM_clock::init();
       if (SMP::cpu_id() == 0) {
-        current_clock.system_time = {&KVM_clock::system_time};
+        current_clock.system_time = &KVM_clock::system_time;
+        current_clock.source      = "kvmclock";
         current_clock.wall_time   = {&KVM_clock::wall_clock};
         current_clock.tsc_khz     = {&KVM_clock::get_tsc_khz};
         x86::register_deactivation_function(KVM_clock::deactivate);
@@ -59,7 +68,8 @@ namespace x86
     {
       // fallback with CMOS
       if (SMP::cpu_id() == 0) {
-        current_clock.system_time = {&CMOS_clock::system_time};
+        current_clock.system_time = &CMOS_clock::system_time;
+        current_clock.source      = "cmos";
         current_clock.wall_time   = {&CMOS_clock::wall_clock};
         current_clock.tsc_khz     = {&CMOS_clock::get_tsc_khz};
         CMOS_clock::init();
@@ -72,11 +82,91 @@ namespace x86
   {
     return current_clock.tsc_khz();
   }
+
+  // the median cost in cycles of reading a clock
+  static uint32_t measure_cost(sysclock_t::system_time_t clock)
+  {
+    static const int ROUNDS = 9;
+    static const int CALLS  = 64;
+    std::array<uint64_t, ROUNDS> samples;
+    for (auto& sample : samples)
+    {
+      const uint64_t t0 = os::Arch::cpu_cycles();
+      for (int i = 0; i < CALLS; i++) {
+        volatile uint64_t ns = clock();
+        (void) ns;
+      }
+      sample = (os::Arch::cpu_cycles() - t0) / CALLS;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[ROUNDS / 2];
+  }
+
+  // run the TSC warp check on every CPU at once
+  static bool tsc_synced_on_all_cpus()
+  {
+    static const int ROUNDS = 20000;
+    std::atomic<int> running {0};
+    std::atomic<bool> synced {true};
+#ifdef INCLUDEOS_SMP_ENABLE
+    for (int cpu = 1; cpu < SMP::cpu_count(); cpu++)
+    {
+      running++;
+      const bool posted = os::smp::post(cpu, [&running, &synced] {
+        if (!TSC_clock::check_sync(ROUNDS)) synced = false;
+        running--;
+      });
+      if (!posted) running--;
+    }
+    os::smp::flush();
+#endif
+    if (!TSC_clock::check_sync(ROUNDS)) synced = false;
+    while (running.load() > 0) os::Arch::cpu_relax();
+    return synced;
+  }
+
+  void Clocks::select_source(KHz tsc_khz)
+  {
+    const char* base = current_clock.source;
+    const uint32_t base_cost = measure_cost(current_clock.system_time);
+    current_clock.cost = base_cost;
+
+    if (TSC_clock::available() && tsc_khz.count() > 0)
+    {
+      TSC_clock::init(tsc_khz, current_clock.system_time.load()());
+      if (tsc_synced_on_all_cpus())
+      {
+        const uint32_t tsc_cost = measure_cost(&TSC_clock::system_time);
+        if (tsc_cost < base_cost) {
+          current_clock.system_time = &TSC_clock::system_time;
+          current_clock.source = "tsc";
+          current_clock.cost   = tsc_cost;
+        }
+        INFO2("+--> Invariant TSC: %u cycles, %s: %u cycles",
+              tsc_cost, base, base_cost);
+      }
+      else {
+        INFO2("+--> TSC is not in sync between CPUs, not using it");
+      }
+    }
+    INFO("x86", "Clock source: %s, %u cycles per read",
+         current_clock.source, current_clock.cost);
+  }
+
+  const char* Clocks::source() noexcept
+  {
+    return current_clock.source;
+  }
+
+  uint32_t Clocks::read_cost() noexcept
+  {
+    return current_clock.cost;
+  }
 }
 
 uint64_t __arch_system_time() noexcept
 {
-  return current_clock.system_time();
+  return current_clock.system_time.load(std::memory_order_relaxed)();
 }
 timespec __arch_wall_clock() noexcept
 {
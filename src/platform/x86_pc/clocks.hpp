@@ -24,5 +24,15 @@ namespace x86
   struct Clocks {
     static void init();
     static util::KHz  get_khz();
+    /**
+     * Pick the cheapest of the clock sources that can be trusted, measured
+     * by cycles per read. The invariant TSC is calibrated to tsc_khz and
+     * checked for warps between CPUs before it can be picked.
+     * Call on CPU 0 once the other CPUs are running.
+     */
+    static void select_source(util::KHz tsc_khz);
+    static const char* source() noexcept;
+    /** Measured cycles per read of the selected clock source */
+    static uint32_t read_cost() noexcept;
   };
 }
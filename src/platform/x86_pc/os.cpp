@@ -47,6 +47,8 @@ extern uintptr_t _LOAD_START_;
 extern uintptr_t _ELF_END_;
 // in kernel/os.cpp
 extern bool os_default_stdout;
+// in kernel/heap.cpp
+extern bool os_huge_page_heap;
 
 struct alignas(SMP_ALIGN) OS_CPU {
   uint64_t cycles_hlt = 0;
@@ -129,6 +131,13 @@ void kernel::start(uint32_t boot_magic, uint32_t boot_addr)
   kernel::state().heap_max = kernel::memory_end() - 1;
   assert(kernel::heap_begin() != 0x0 and kernel::heap_max() != 0x0);
 
+  if (os_huge_page_heap) {
+    PROFILE("Huge pages");
+    const auto begin = util::bits::roundto(os::mem::huge_psize(), kernel::heap_begin());
+    const int tables = os::mem::map_huge(begin, kernel::memory_end() - begin);
+    INFO2("* Heap mapped with huge pages, replaced %d page tables", tables);
+  }
+
   PROFILE("Memory map");
   // Assign memory ranges used by the kernel
   auto& memmap = os::mem::vmmap();
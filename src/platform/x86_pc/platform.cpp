@@ -90,6 +90,7 @@ void __platform_init()
     kernel::state().cpu_khz = x86::Clocks::get_khz();
   }
   INFO2("+--> %f MHz", os::cpu_freq().count() / 1000.0);
+  x86::Clocks::select_source(os::cpu_freq());
 
   // Note: CPU freq must be known before we can start timer system
   // Initialize APIC timers and timer systems
@@ -22,6 +22,7 @@
 #include "pit.hpp"
 #include <os.hpp>
 #include <kernel/events.hpp>
+#include <kernel/smp_work.hpp>
 #include <malloc.h>
 #include <algorithm>
 #include <cstring>
@@ -144,6 +145,8 @@ void init_SMP()
   // subscribe to IPIs
   Events::get().subscribe(BSP_LAPIC_IPI_IRQ,
   [] {
+    // work posted directly to the BSP
+    os::smp::drain();
     int next = smp_main.bitmap.first_set();
     while (next != -1)
     {
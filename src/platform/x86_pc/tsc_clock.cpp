@@ -0,0 +1,100 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tsc_clock.hpp"
+#include "../kvm/bsd_pvclock.hpp"
+#include <kernel/cpuid.hpp>
+#include <arch.hpp>
+#include <atomic>
+
+namespace x86
+{
+  // the same layout as a pvclock page, but written once and never updated
+  struct alignas(64) tsc_page_t {
+    uint64_t tsc_base = 0;
+    uint64_t ns_base  = 0;
+    uint32_t mul      = 0;
+    int8_t   shift    = 0;
+  };
+  static tsc_page_t tsc_page;
+  // the latest time any CPU has seen during a sync check
+  static std::atomic<uint64_t> sync_last {0};
+
+  static inline uint64_t rdtsc_ordered() noexcept
+  {
+    // keep rdtsc from running ahead of earlier loads
+    asm volatile("lfence" ::: "memory");
+    return os::Arch::cpu_cycles();
+  }
+
+  // find mul and shift so that ns = ((tsc << shift) * mul) >> 32,
+  // done the same way as the KVM host fills in pvclock pages
+  static void time_scale(uint64_t scaled_hz, uint64_t base_hz,
+                         uint32_t& mul, int8_t& shift)
+  {
+    int s = 0;
+    uint64_t tps64 = base_hz;
+    while (tps64 > scaled_hz * 2 || (tps64 & 0xffffffff00000000ull)) {
+      tps64 >>= 1;
+      s--;
+    }
+    uint32_t tps32 = (uint32_t) tps64;
+    uint64_t scaled64 = scaled_hz;
+    while (tps32 <= scaled64 || (scaled64 & 0xffffffff00000000ull)) {
+      if ((scaled64 & 0xffffffff00000000ull) || (tps32 & 0x80000000))
+        scaled64 >>= 1;
+      else
+        tps32 <<= 1;
+      s++;
+    }
+    mul   = (uint32_t) ((scaled64 << 32) / tps32);
+    shift = s;
+  }
+
+  bool TSC_clock::available()
+  {
+    return CPUID::has_feature(CPUID::Feature::TSC_INV);
+  }
+
+  void TSC_clock::init(util::KHz khz, uint64_t now_ns)
+  {
+    const uint64_t hz = khz.count() * 1000.0;
+    time_scale(1000000000ull, hz, tsc_page.mul, tsc_page.shift);
+    tsc_page.tsc_base = rdtsc_ordered();
+    tsc_page.ns_base  = now_ns;
+  }
+
+  uint64_t TSC_clock::system_time()
+  {
+    const uint64_t delta = rdtsc_ordered() - tsc_page.tsc_base;
+    return tsc_page.ns_base
+         + pvclock_scale_delta(delta, tsc_page.mul, tsc_page.shift);
+  }
+
+  bool TSC_clock::check_sync(const int rounds)
+  {
+    bool synced = true;
+    for (int i = 0; i < rounds; i++)
+    {
+      uint64_t last = sync_last.load();
+      const uint64_t now = system_time();
+      if (now < last) synced = false;
+      // publish our time, unless someone was ahead of us meanwhile
+      while (now > last && !sync_last.compare_exchange_weak(last, now));
+    }
+    return synced;
+  }
+}
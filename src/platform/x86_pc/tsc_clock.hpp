@@ -0,0 +1,43 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include "clocks.hpp"
+#include <cstdint>
+
+namespace x86
+{
+  /**
+   * Nanoseconds from the TSC alone: a rdtsc, a multiply and a shift.
+   *
+   * Only usable with an invariant TSC, which keeps its rate through
+   * power states and ticks in step on all cores. The scale is fixed once
+   * calibrated, so readers need no locks nor retries.
+   **/
+  struct TSC_clock
+  {
+    /** Whether the CPU has an invariant TSC */
+    static bool available();
+    /** Calibrate for a TSC ticking at khz, continuing from now_ns */
+    static void init(util::KHz khz, uint64_t now_ns);
+    static uint64_t system_time();
+    /**
+     * Check that the TSC never goes backwards between this and other
+     * CPUs running the check at the same time. Returns false on a warp.
+     **/
+    static bool check_sync(int rounds);
+  };
+}
@@ -18,12 +18,17 @@
 
 #include <os>
 #include <syslogd>
+#include <kernel/async_log.hpp>
 
 void register_plugin_syslogd() {
   INFO("Syslog", "Sending buffered data to syslog plugin");
 
   Syslog::set_facility(std::make_unique<Syslog_udp>());
 
+  // Send the datagrams from the log flusher, not from the callers
+  Syslog::set_async(true);
+  os::async_log::start();
+
   /*
     @todo
     Get dmesg (kernel logs) and send to syslog
@@ -0,0 +1,184 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <posix/epoll_fd.hpp>
+#include <posix/fd_map.hpp>
+#include <kernel/futex.hpp>
+#include <kernel/rtc.hpp>
+#include <algorithm>
+#include <climits>
+
+// always reported, whether asked for or not
+static constexpr uint32_t EPOLL_ALWAYS = EPOLLERR | EPOLLHUP;
+
+Epoll_FD::~Epoll_FD()
+{
+  forget_all();
+}
+
+int Epoll_FD::close()
+{
+  forget_all();
+  return 0;
+}
+
+void Epoll_FD::forget_all()
+{
+  for (auto& it : interest_)
+    it.first->remove_watcher(this);
+  interest_.clear();
+  ready_.clear();
+}
+
+int Epoll_FD::poll_events()
+{
+  return ready_.empty() ? 0 : POLLIN;
+}
+
+void Epoll_FD::enqueue(Interest& in)
+{
+  if (in.queued or in.disabled) return;
+  in.queued = true;
+  ready_.push_back(&in);
+  __atomic_add_fetch(&seq_, 1, __ATOMIC_SEQ_CST);
+  os::futex::wake(&seq_, INT_MAX);
+}
+
+void Epoll_FD::unqueue(Interest& in)
+{
+  if (not in.queued) return;
+  ready_.erase(std::find(ready_.begin(), ready_.end(), &in));
+  in.queued = false;
+}
+
+void Epoll_FD::fd_ready(FD& fd)
+{
+  auto it = interest_.find(&fd);
+  if (it == interest_.end()) return;
+  const bool was_empty = ready_.empty();
+  enqueue(it->second);
+  // we became readable, for anyone polling this epoll instance
+  if (was_empty and not ready_.empty())
+    this->notify_ready();
+}
+
+void Epoll_FD::fd_closed(FD& fd)
+{
+  auto it = interest_.find(&fd);
+  if (it == interest_.end()) return;
+  unqueue(it->second);
+  interest_.erase(it);
+}
+
+long Epoll_FD::ctl(int op, int fd, struct epoll_event* event)
+{
+  auto* target = FD_map::_get(fd);
+  if (target == nullptr)
+    return -EBADF;
+  if (target == this)
+    return -EINVAL;
+  if (op != EPOLL_CTL_DEL and event == nullptr)
+    return -EFAULT;
+
+  auto it = interest_.find(target);
+  switch (op) {
+  case EPOLL_CTL_ADD:
+    {
+      if (it != interest_.end())
+        return -EEXIST;
+      auto& in = interest_.emplace(target,
+          Interest{target, event->events, event->data}).first->second;
+      target->add_watcher(this);
+      // report what is already ready
+      if (target->poll_events() & (in.events | EPOLL_ALWAYS))
+        enqueue(in);
+      return 0;
+    }
+  case EPOLL_CTL_MOD:
+    {
+      if (it == interest_.end())
+        return -ENOENT;
+      auto& in = it->second;
+      in.events   = event->events;
+      in.data     = event->data;
+      in.disabled = false;
+      if (target->poll_events() & (in.events | EPOLL_ALWAYS))
+        enqueue(in);
+      else
+        unqueue(in);
+      return 0;
+    }
+  case EPOLL_CTL_DEL:
+    {
+      if (it == interest_.end())
+        return -ENOENT;
+      unqueue(it->second);
+      interest_.erase(it);
+      target->remove_watcher(this);
+      return 0;
+    }
+  default:
+    return -EINVAL;
+  }
+}
+
+long Epoll_FD::wait(struct epoll_event* events, int maxevents, Timeout timeout)
+{
+  if (maxevents <= 0)
+    return -EINVAL;
+
+  const bool forever = (timeout == Timeout::max());
+  const uint64_t deadline = forever ? 0 : RTC::nanos_now() + timeout.count();
+  while (true)
+  {
+    const int seq = __atomic_load_n(&seq_, __ATOMIC_SEQ_CST);
+    int count = 0;
+    // look at every queued descriptor once
+    for (size_t n = ready_.size(); n > 0 and count < maxevents; n--)
+    {
+      auto& in = *ready_.front();
+      ready_.pop_front();
+      in.queued = false;
+
+      const uint32_t revents = in.fd->poll_events() & (in.events | EPOLL_ALWAYS);
+      // no longer ready, the next edge queues it again
+      if (revents == 0) continue;
+
+      events[count].events = revents;
+      events[count].data   = in.data;
+      count++;
+
+      if (in.events & EPOLLONESHOT)
+        in.disabled = true;
+      else if (not (in.events & EPOLLET)) {
+        // level-triggered: report again until not ready
+        in.queued = true;
+        ready_.push_back(&in);
+      }
+    }
+    if (count > 0 or timeout == Timeout::zero())
+      return count;
+
+    Timeout left = Timeout::max();
+    if (not forever) {
+      const uint64_t now = RTC::nanos_now();
+      if (now >= deadline) return 0;
+      left = Timeout(deadline - now);
+    }
+    if (os::futex::wait(&seq_, seq, left) == -ETIMEDOUT)
+      return 0;
+  }
+}
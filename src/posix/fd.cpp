@@ -16,10 +16,46 @@
 // limitations under the License.
 
 #include <posix/fd.hpp>
+#include <kernel/futex.hpp>
 #include <fcntl.h>
+#include <algorithm>
+#include <climits>
 #include <cstdarg>
 #include <errno.h>
 
+// futex word for everyone waiting in poll() and friends
+static int ready_seq = 0;
+
+FD::~FD()
+{
+  for (auto* w : watchers_)
+    w->fd_closed(*this);
+}
+
+void FD::notify_ready()
+{
+  for (size_t i = 0; i < watchers_.size(); i++)
+    watchers_[i]->fd_ready(*this);
+  __atomic_add_fetch(&ready_seq, 1, __ATOMIC_SEQ_CST);
+  os::futex::wake(&ready_seq, INT_MAX);
+}
+
+void FD::remove_watcher(FD_watcher* w)
+{
+  watchers_.erase(std::remove(watchers_.begin(), watchers_.end(), w),
+                  watchers_.end());
+}
+
+int FD::ready_sequence() noexcept
+{
+  return __atomic_load_n(&ready_seq, __ATOMIC_SEQ_CST);
+}
+
+bool FD::wait_ready(int seq, std::chrono::nanoseconds timeout)
+{
+  return os::futex::wait(&ready_seq, seq, timeout) != -ETIMEDOUT;
+}
+
 int FD::fcntl(int cmd, va_list list)
 {
   //PRINT("fcntl(%d)\n", cmd);
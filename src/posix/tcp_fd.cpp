@@ -46,6 +46,12 @@ int TCP_FD::write(const void* data, size_t len)
 
 int TCP_FD::close()
 {
+  // non-blocking connect still in progress
+  if (this->pending) {
+    PRINT("TCP: close(%s)\n", pending->to_string().c_str());
+    cancel_connect();
+    return 0;
+  }
   // connection
   if (this->cd) {
     PRINT("TCP: close(%s)\n", cd->to_string().c_str());
@@ -81,6 +87,9 @@ long TCP_FD::connect(const struct sockaddr* address, socklen_t address_len)
       return -EALREADY;
     }
   }
+  if (this->connecting) {
+    return -EALREADY;
+  }
 
   if (address_len != sizeof(sockaddr_in)) {
     return -EINVAL; // checkme?
@@ -94,16 +103,31 @@ long TCP_FD::connect(const struct sockaddr* address, socklen_t address_len)
 
   auto outgoing = net_stack().tcp().connect({addr, port});
 
-  bool refused = false;
-  outgoing->on_connect([&refused](auto conn) {
-    refused = (conn == nullptr);
-  });
   // O_NONBLOCK is set for the file descriptor for the socket and the connection
   // cannot be immediately established; the connection shall be established asynchronously.
   if (this->is_blocking() == false) {
+    this->connecting = true;
+    this->connect_failed = false;
+    this->pending = outgoing;
+    // the callback is cleared if this FD is closed first
+    outgoing->on_connect([this] (auto conn) {
+      this->connecting = false;
+      this->pending = nullptr;
+      if (conn != nullptr and conn->is_connected())
+        this->attach(std::make_unique<TCP_FD_Conn>(conn));
+      else
+        this->connect_failed = true;
+      // writable (or failed), for anyone polling
+      this->notify_ready();
+    });
     return -EINPROGRESS;
   }
 
+  bool refused = false;
+  outgoing->on_connect([&refused](auto conn) {
+    refused = (conn == nullptr);
+  });
+
   // wait for connection state to change
   while (not (outgoing->is_connected() or
               outgoing->is_closing() or
@@ -115,8 +139,7 @@ long TCP_FD::connect(const struct sockaddr* address, socklen_t address_len)
   // set connection whether good or bad
   if (outgoing->is_connected()) {
     // out with the old, in with the new
-    this->cd = std::make_unique<TCP_FD_Conn>(outgoing);
-    cd->set_default_read();
+    this->attach(std::make_unique<TCP_FD_Conn>(outgoing));
     return 0;
   }
   // failed to connect
@@ -125,11 +148,25 @@ long TCP_FD::connect(const struct sockaddr* address, socklen_t address_len)
 }
 
 
+void TCP_FD::cancel_connect()
+{
+  pending->on_connect(nullptr);
+  pending->abort();
+  pending = nullptr;
+  connecting = false;
+}
+
+TCP_FD::~TCP_FD()
+{
+  if (this->pending) cancel_connect();
+}
+
 ssize_t TCP_FD::send(const void* data, size_t len, int fmt)
 {
   if (!cd) {
     return -EINVAL;
   }
+  if (not is_blocking()) fmt |= MSG_DONTWAIT;
   return cd->send(data, len, fmt);
 }
 ssize_t TCP_FD::sendto(const void* data, size_t len, int fmt,
@@ -144,6 +181,10 @@ ssize_t TCP_FD::recv(void* dest, size_t len, int flags)
   if (!cd) {
     return -EINVAL;
   }
+  if ((not is_blocking() or (flags & MSG_DONTWAIT))
+      and not (cd->poll_events() & POLLIN)) {
+    return -EAGAIN;
+  }
   return cd->recv(dest, len, flags);
 }
 
@@ -157,6 +198,9 @@ long TCP_FD::accept(struct sockaddr *__restrict__ addr, socklen_t *__restrict__
   if (!ld) {
     return -EINVAL;
   }
+  if (not is_blocking() and not has_connq()) {
+    return -EAGAIN;
+  }
   return ld->accept(addr, addr_len);
 }
 long TCP_FD::listen(int backlog)
@@ -195,7 +239,7 @@ long TCP_FD::bind(const struct sockaddr *addr, socklen_t addrlen)
       delete ld;
     }
     // create new one
-    ld = new TCP_FD_Listen(L);
+    ld = new TCP_FD_Listen(L, *this);
     return 0;
 
   } catch (...) {
@@ -210,6 +254,27 @@ int TCP_FD::shutdown(int mode)
   return cd->shutdown(mode);
 }
 
+int TCP_FD::poll_events()
+{
+  if (cd) {
+    return cd->poll_events();
+  }
+  if (ld) {
+    return ld->connq.empty() ? 0 : POLLIN;
+  }
+  if (connect_failed) {
+    return POLLERR | POLLHUP;
+  }
+  // like Linux, a socket that was never connected is hung up
+  return connecting ? 0 : (POLLOUT | POLLHUP);
+}
+
+void TCP_FD::attach(std::unique_ptr<TCP_FD_Conn> conn)
+{
+  this->cd = std::move(conn);
+  cd->owner = this;
+}
+
 /// socket as connection
 TCP_FD_Conn::TCP_FD_Conn(net::tcp::Connection_ptr c)
   : conn{std::move(c)},
@@ -218,8 +283,11 @@ TCP_FD_Conn::TCP_FD_Conn(net::tcp::Connection_ptr c)
   assert(conn != nullptr);
   set_default_read();
 
+  set_default_write();
+
   conn->on_disconnect([this](auto self, auto reason) {
     this->recv_disc = true;
+    this->notify();
     (void) reason;
     //printf("dc: %s - %s\n", reason.to_string().c_str(), self->to_string().c_str());
     // do nothing, avoid close
@@ -228,15 +296,54 @@ TCP_FD_Conn::TCP_FD_Conn(net::tcp::Connection_ptr c)
       self->close();
   });
 }
+TCP_FD_Conn::~TCP_FD_Conn()
+{
+  // the connection outlives us while queued data is sent,
+  // so it must not call back into this or the owner
+  owner = nullptr;
+  conn->reset_callbacks();
+}
 void TCP_FD_Conn::set_default_read()
 {
-  conn->on_data({this, &TCP_FD_Conn::retrieve_buffer});
+  conn->on_data([this] {
+    this->retrieve_buffer();
+    this->notify();
+  });
+}
+void TCP_FD_Conn::set_default_write()
+{
+  conn->on_write([this] (size_t) { this->notify(); });
 }
-ssize_t TCP_FD_Conn::send(const void* data, size_t len, int)
+void TCP_FD_Conn::notify()
+{
+  if (owner != nullptr) owner->notify_ready();
+}
+int TCP_FD_Conn::poll_events() const
+{
+  int events = 0;
+  if (buffer != nullptr or conn->next_size() > 0)
+    events |= POLLIN;
+  // end of stream is readable
+  if (recv_disc)
+    events |= POLLIN | POLLRDHUP;
+  if (conn->is_closed())
+    events |= POLLIN | POLLHUP;
+  // one write at a time is let through without blocking
+  if (conn->is_writable() and conn->sendq_remaining() == 0)
+    events |= POLLOUT;
+  return events;
+}
+ssize_t TCP_FD_Conn::send(const void* data, size_t len, int flags)
 {
   if (not conn->is_connected()) {
     return -ENOTCONN;
   }
+  // queue the data and return, unless the last write is still queued
+  if (flags & MSG_DONTWAIT) {
+    if (not (poll_events() & POLLOUT)) return -EAGAIN;
+    conn->write(data, len);
+    return len;
+  }
 
   bool written = false;
   conn->on_write([&written] (bool) { written = true; }); // temp
@@ -244,12 +351,11 @@ ssize_t TCP_FD_Conn::send(const void* data, size_t len, int)
   conn->write(data, len);
 
   // sometimes we can just write and forget
-  if (written) return len;
   while (!written) {
     os::block();
   }
 
-  conn->on_write(nullptr); // temp
+  set_default_write();
   return len;
 }
 
@@ -331,6 +437,7 @@ long TCP_FD_Listen::listen(int backlog)
     // new connection
     this->connq.push_front(std::make_unique<TCP_FD_Conn>(conn));
     /// if someone is blocking they should be leaving right about now
+    owner.notify_ready();
   });
   return 0;
 }
@@ -347,7 +454,7 @@ long TCP_FD_Listen::accept(struct sockaddr *__restrict__ addr, socklen_t *__rest
   assert(sock != nullptr);
   // create connected TCP socket
   auto& fd = FD_map::_open<TCP_FD>();
-  fd.cd = std::move(sock);
+  fd.attach(std::move(sock));
   // set address and length
   if(addr != nullptr and addr_len != nullptr)
   {
@@ -0,0 +1,126 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <util/coro.hpp>
+#include <smp>
+#include <array>
+#include <cstdio>
+#include <new>
+
+namespace os::coro {
+
+  struct Free_frame {
+    Free_frame* next;
+  };
+
+  struct alignas(SMP_ALIGN) Frame_cache {
+    std::array<Free_frame*, Frame_pool::classes> free {};
+    Frame_pool::Stats stats;
+  };
+  static SMP::Array<Frame_cache> caches;
+
+  static int class_of(size_t size) noexcept
+  {
+    int cls = 0;
+    size_t class_size = Frame_pool::min_size;
+    while (class_size < size) {
+      class_size <<= 1;
+      cls++;
+    }
+    return cls;
+  }
+
+  // split a new chunk into frames of one class
+  static void refill(Frame_cache& cache, int cls)
+  {
+    const size_t size = Frame_pool::min_size << cls;
+    char* chunk = (char*) ::operator new(Frame_pool::chunk_size);
+    cache.stats.chunks++;
+    for (size_t off = 0; off + size <= Frame_pool::chunk_size; off += size) {
+      auto* frame = (Free_frame*) (chunk + off);
+      frame->next = cache.free[cls];
+      cache.free[cls] = frame;
+    }
+  }
+
+  void* Frame_pool::allocate(size_t size)
+  {
+    auto& cache = PER_CPU(caches);
+    cache.stats.allocs++;
+    if (UNLIKELY(size > max_size)) {
+      cache.stats.oversized++;
+      return ::operator new(size);
+    }
+    const int cls = class_of(size);
+    if (UNLIKELY(cache.free[cls] == nullptr))
+      refill(cache, cls);
+    Free_frame* frame = cache.free[cls];
+    cache.free[cls] = frame->next;
+    return frame;
+  }
+
+  void Frame_pool::deallocate(void* ptr, size_t size) noexcept
+  {
+    auto& cache = PER_CPU(caches);
+    cache.stats.frees++;
+    if (UNLIKELY(size > max_size)) {
+      ::operator delete(ptr);
+      return;
+    }
+    // chunks are never released, so frames can go to any CPU's free list
+    const int cls = class_of(size);
+    auto* frame = (Free_frame*) ptr;
+    frame->next = cache.free[cls];
+    cache.free[cls] = frame;
+  }
+
+  Frame_pool::Stats Frame_pool::stats(int cpu)
+  {
+    return caches.at(cpu).stats;
+  }
+
+  // a coroutine that owns itself, and is gone when it finishes
+  struct Detached {
+    struct promise_type : detail::Pooled_frame {
+      Detached get_return_object() const noexcept { return {}; }
+      std::suspend_never initial_suspend() const noexcept { return {}; }
+      std::suspend_never final_suspend() const noexcept { return {}; }
+      void return_void() const noexcept {}
+      void unhandled_exception() const noexcept {
+        try {
+          throw;
+        }
+        catch (const std::exception& e) {
+          fprintf(stderr, "coro: spawned task threw: %s\n", e.what());
+        }
+        catch (...) {
+          fprintf(stderr, "coro: spawned task threw\n");
+        }
+      }
+    };
+  };
+
+  static Detached run_detached(Task<void> task)
+  {
+    co_await task;
+  }
+
+  void spawn(Task<void> task)
+  {
+    run_detached(std::move(task));
+  }
+
+}
@@ -18,9 +18,22 @@
 #include <net/interfaces>
 #include <unistd.h> // getpid
 #include <ctime>
+#include <algorithm>
 
 const int TIMELEN = 32;
 
+static void timestamp(char* timebuf) {
+  time_t now;
+  time(&now);
+  strftime(timebuf, TIMELEN, "%FT%T.000Z", localtime(&now));
+}
+
+// the length snprintf wrote, which may have been cut to fit
+static size_t clamp_length(int len, size_t size) {
+  if (len < 0) return 0;
+  return std::min((size_t) len, size - 1);
+}
+
 // Syslog_udp (plugin)
 
 void Syslog_udp::syslog(const std::string& log_message) {
@@ -50,36 +63,31 @@ void Syslog_udp::send_udp_data(const std::string& data) {
   sock_->sendto( ip_, port_, data.c_str(), data.size() );
 }
 
-std::string Syslog_udp::build_message_prefix(const std::string& binary_name) {
+size_t Syslog_udp::format_message_prefix(char* buf, size_t size, const char* binary_name) {
   /* Building the log message based on RFC5424 */
 
   /* Header: PRI VERSION SP TIMESTAMP SP HOSTNAME SP APP-NAME SP PROCID SP MSGID */
 
-  // First: Priority- and facility-value (PRIVAL) and Syslog-version
-  std::string message = "<" + std::to_string(calculate_pri()) + ">1 ";
-
-  // Second: Timestamp
+  // Timestamp
   char timebuf[TIMELEN];
-  time_t now;
-  time(&now);
-  strftime(timebuf, TIMELEN, "%FT%T.000Z", localtime(&now));
-
-  // Third: Hostname ( Preferably: 1. FQDN (RFC1034) 2. Static IP address 3. Hostname 4. Dynamic IP address 5. NILVALUE (-) )
-  message += std::string{timebuf} + " " + net::Interfaces::get(0).ip_addr().str() + " ";
-
-  // Fourth: App-name, PROCID (LOG_PID) and MSGID
-  message += std::string(binary_name) + " " + std::to_string(getpid()) + " UDPOUT ";
-
-  /* Structured data: SD-element (SD-ID PARAM-NAME=PARAM-VALUE) */
-  message += "- ";  // NILVALUE
-
-  /* Message */
-
-  // Add ident before message (buf) if is set (through openlog)
-  if (ident_is_set())
-    message += std::string{ident()} + " ";
+  timestamp(timebuf);
+
+  // Hostname ( Preferably: 1. FQDN (RFC1034) 2. Static IP address 3. Hostname 4. Dynamic IP address 5. NILVALUE (-) )
+  const auto host = net::Interfaces::get(0).ip_addr().str();
+
+  // Priority- and facility-value (PRIVAL), Syslog-version, the header,
+  // a NILVALUE as structured data and the ident (set through openlog)
+  const int len = snprintf(buf, size, "<%d>1 %s %s %s %d UDPOUT - %s%s",
+                           calculate_pri(), timebuf, host.c_str(), binary_name,
+                           getpid(), ident_is_set() ? ident() : "",
+                           ident_is_set() ? " " : "");
+  return clamp_length(len, size);
+}
 
-  return message;
+std::string Syslog_udp::build_message_prefix(const std::string& binary_name) {
+  char buf[prefix_max];
+  const auto len = format_message_prefix(buf, sizeof(buf), binary_name.c_str());
+  return std::string(buf, len);
 }
 
 Syslog_udp::~Syslog_udp() {
@@ -100,42 +108,32 @@ void Syslog_print::syslog(const std::string& log_message) {
   printf("%s\n", log_message.c_str());
 }
 
-std::string Syslog_print::build_message_prefix(const std::string& binary_name) {
+size_t Syslog_print::format_message_prefix(char* buf, size_t size, const char* binary_name) {
   /* PRI FAC_NAME PRI_NAME TIMESTAMP APP-NAME IDENT PROCID */
 
-  // First: Priority- and facility-value (PRIVAL)
-  std::string message = "<" + std::to_string(calculate_pri()) + "> ";
-
-  // Second : Facility and priority/severity in plain text with colors
-  message += pri_colors.at(priority()) + "<" + facility_name() + "." +
-    priority_name() + "> " + COLOR_END;
-
-  // Third: Timestamp
   char timebuf[TIMELEN];
-  time_t now;
-  time(&now);
-  strftime(timebuf, TIMELEN, "%FT%T.000Z", localtime(&now));
-  message += std::string{timebuf} + " ";
-
-  // Fourth: App-name
-  message += std::string(binary_name);
+  timestamp(timebuf);
 
-  // Fifth: Add ident if is set (through openlog)
-  if (ident_is_set())
-    message += " " + std::string{ident()};
-
-  // Sixth: Add PID (PROCID) if LOG_PID is specified (through openlog)
+  // PROCID if LOG_PID is specified (through openlog)
+  char pid[16] = "";
   if (logopt() & LOG_PID)
-    message += "[" + std::to_string(getpid()) + "]";
-
-  message += ": ";
-
-  // NEW: Was only in plugin
-  // Add ident before message (buf) if is set (through openlog)
-  // if (ident_is_set())
-  //    message += std::string{ident()} + " ";
+    snprintf(pid, sizeof(pid), "[%d]", getpid());
+
+  // Priority- and facility-value (PRIVAL), facility and priority/severity
+  // in plain text with colors, timestamp, app-name and ident (through openlog)
+  const int len = snprintf(buf, size, "<%d> %s<%s.%s> %s%s %s%s%s%s: ",
+                           calculate_pri(), pri_colors.at(priority()).c_str(),
+                           facility_name().c_str(), priority_name().c_str(),
+                           COLOR_END.c_str(), timebuf, binary_name,
+                           ident_is_set() ? " " : "", ident_is_set() ? ident() : "",
+                           pid);
+  return clamp_length(len, size);
+}
 
-  return message;
+std::string Syslog_print::build_message_prefix(const std::string& binary_name) {
+  char buf[prefix_max];
+  const auto len = format_message_prefix(buf, sizeof(buf), binary_name.c_str());
+  return std::string(buf, len);
 }
 
 // < Syslog_print (printf)
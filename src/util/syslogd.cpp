@@ -16,10 +16,36 @@
 
 #include <syslogd>
 #include <service>
+#include <kernel/async_log.hpp>
 #include <errno.h>		// errno
 #include <unistd.h>		// getpid
 
 std::unique_ptr<Syslog_facility> Syslog::fac_ = std::make_unique<Syslog_print>();
+bool Syslog::async_  = false;
+int  Syslog::channel_ = -1;
+
+// Replace %m in fmt with the error message, escaped as a format string
+static const char* expand_errno(const char* fmt, const char* error, char* out, size_t size)
+{
+  size_t n = 0;
+  for (const char* p = fmt; *p and n < size - 2; p++)
+  {
+    if (p[0] == '%' and p[1] == 'm') {
+      for (const char* e = error; *e and n < size - 2; e++) {
+        if (*e == '%') out[n++] = '%';
+        out[n++] = *e;
+      }
+      p++;
+      continue;
+    }
+    // %% stays as is, and is not the start of %m
+    if (p[0] == '%' and p[1] == '%')
+      out[n++] = *p++;
+    out[n++] = *p;
+  }
+  out[n] = 0;
+  return out;
+}
 
 void Syslog::syslog(const int priority, const char* fmt, ...)
 {
@@ -34,13 +60,12 @@ void Syslog::syslog(const int priority, const char* fmt, va_list args)
 {
   // due to musl "bug" (strftime setting errno..)
   const int save_errno = errno;
-  // snprintf removes % if calling syslog with %m in addition to arguments
-  // Find %m here first and escape % if found
-  std::regex m_regex{"\\%m"};
-  std::string msg = std::regex_replace(fmt, m_regex, "%%m");
+  // %m converts no arguments, so it is replaced before formatting
+  char format[1024];
+  expand_errno(fmt, strerror(save_errno), format, sizeof(format));
 
   char buf[2048];
-  vsnprintf(buf, sizeof(buf), msg.c_str(), args);
+  vsnprintf(buf, sizeof(buf), format, args);
 
 	/*
   	All syslog-calls comes through here in the end, so
@@ -59,8 +84,10 @@ void Syslog::syslog(const int priority, const char* fmt, va_list args)
   }
  	fac_->set_priority(priority);
 
-  /* Building the log message based on the facility used */
-  std::string message = fac_->build_message_prefix(Service::binary_name());
+  /* Building the log message based on the facility used, on the stack */
+  char prefix[Syslog_facility::prefix_max];
+  const size_t prefix_len =
+    fac_->format_message_prefix(prefix, sizeof(prefix), Service::binary_name());
 
  	/*
  		%m:
@@ -74,13 +101,32 @@ void Syslog::syslog(const int priority, const char* fmt, va_list args)
 		added if needed.
 	*/
   errno = save_errno;
-  // Handle %m (replace it with strerror(errno)) and add the message (buf)
-  message += std::regex_replace(buf, m_regex, strerror(errno));
+
+  // The flusher sends it, so error storms don't stall the caller.
+  // The record is formatted straight into the ring, nothing is allocated
+  if (async_ and os::async_log::is_running()) {
+    os::async_log::printf(channel_, priority, "%.*s%s", (int) prefix_len, prefix, buf);
+    return;
+  }
+  std::string message(prefix, prefix_len);
+  message += buf;
 
  	/* Last: Send the log string */
  	fac_->syslog(message);
 }
 
+void Syslog::set_async(bool async)
+{
+  if (async and channel_ < 0) {
+    channel_ = os::async_log::add_channel(
+      [] (const os::async_log::Record* records, size_t count) {
+        for (size_t i = 0; i < count; i++)
+          fac_->syslog(std::string{records[i].text});
+      });
+  }
+  async_ = async;
+}
+
 void Syslog::openlog(const char* ident, int logopt, int facility) {
   fac_->set_ident(ident);
 
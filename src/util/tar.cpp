@@ -16,6 +16,7 @@
 // limitations under the License.
 
 #include <util/tar.hpp>
+#include <util/tar_view.hpp>
 #include <cstdlib>  // strtol
 #include <expects>
 
@@ -140,3 +141,51 @@ Tar_data Reader::decompress(const uint8_t* data, const size_t size, unsigned int
   Ensures(dest.size() == dlen);
   return dest;
 }
+
+// -------------------- Gunzip --------------------
+
+Gunzip::Gunzip(std::string_view gz)
+  : dict_{new uint8_t[window]}, d_{}
+{
+  if (!has_uzlib_init) {
+    uzlib_init();
+    has_uzlib_init = true;
+  }
+  d_.source = (const unsigned char*) gz.data();
+
+  int res = uzlib_gzip_parse_header(&d_);
+  if (res != TINF_OK)
+    throw Tar_exception(std::string{"Error parsing header: " + std::to_string(res)});
+
+  // back references go to the window, so the output can be dropped
+  uzlib_uncompress_init(&d_, dict_.get(), window);
+}
+
+size_t Gunzip::read(uint8_t* out, size_t len)
+{
+  if (done_ or len == 0)
+    return 0;
+
+  d_.dest = out;
+  d_.destSize = len;
+  const int res = uzlib_uncompress_chksum(&d_);
+
+  if (res == TINF_DONE)
+    done_ = true;
+  else if (res != TINF_OK)
+    throw Tar_exception(std::string{"Error during decompression. Res: " + std::to_string(res)});
+
+  return d_.dest - out;
+}
+
+void Stream::feed_gz(std::string_view gz)
+{
+  Gunzip gunzip {gz};
+  uint8_t chunk[SECTOR_SIZE * 8];
+  size_t len;
+  while ((len = gunzip.read(chunk, sizeof(chunk))) > 0)
+  {
+    if (not feed({(const char*) chunk, len}))
+      return;
+  }
+}
@@ -0,0 +1,232 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <util/tar_view.hpp>
+#include <expects>
+#include <algorithm>
+#include <cstddef>
+
+namespace tar {
+
+// ---------------------------- Header_view ----------------------------
+
+uint64_t Header_view::number(const char* str, size_t len) noexcept
+{
+  const auto* p = (const uint8_t*) str;
+  uint64_t value = 0;
+  // base-256, the high bit of the first byte is a flag
+  if (p[0] & 0x80) {
+    value = p[0] & 0x7F;
+    for (size_t i = 1; i < len; i++)
+      value = (value << 8) | p[i];
+    return value;
+  }
+  size_t i = 0;
+  while (i < len and (p[i] == ' ' or p[i] == 0)) i++;
+  for (; i < len and p[i] >= '0' and p[i] <= '7'; i++)
+    value = (value << 3) | (p[i] - '0');
+  return value;
+}
+
+bool Header_view::checksum_ok() const noexcept
+{
+  const auto* p = (const uint8_t*) header_;
+  const size_t start = offsetof(Tar_header, checksum);
+  // the checksum field itself counts as spaces
+  uint32_t sum = ' ' * LENGTH_CHECKSUM;
+  int32_t  signed_sum = sum;
+  for (size_t i = 0; i < sizeof(Tar_header); i++) {
+    if (i >= start and i < start + LENGTH_CHECKSUM) continue;
+    sum += p[i];
+    signed_sum += (int8_t) p[i];
+  }
+  // some old tars summed signed chars
+  const uint64_t expected = number(header_->checksum, LENGTH_CHECKSUM);
+  return expected == sum or expected == (uint32_t) signed_sum;
+}
+
+static bool is_zero_block(const char* block) noexcept
+{
+  return std::all_of(block, block + SECTOR_SIZE, [] (char c) { return c == 0; });
+}
+
+// -------------------------------- View --------------------------------
+
+View::iterator::iterator(std::string_view data, size_t pos)
+  : data_{data}, pos_{pos}
+{
+  load();
+}
+
+void View::iterator::load()
+{
+  // the archive ends with zero blocks, or just ends
+  if (pos_ + SECTOR_SIZE > data_.size() or is_zero_block(&data_[pos_])) {
+    pos_ = std::string_view::npos;
+    entry_ = {};
+    return;
+  }
+  Header_view header {(const Tar_header*) &data_[pos_]};
+  if (not header.checksum_ok())
+    throw Tar_exception("Invalid checksum in tar header at " + std::to_string(pos_));
+  const uint64_t size = header.size();
+  if (size > data_.size() - pos_ - SECTOR_SIZE)
+    throw Tar_exception(std::string{"Truncated tar member "} + std::string{header.name()});
+  entry_ = {header, data_.substr(pos_ + SECTOR_SIZE, size)};
+}
+
+View::iterator& View::iterator::operator++()
+{
+  pos_ += SECTOR_SIZE + entry_.header.padded_size();
+  load();
+  return *this;
+}
+
+Entry_view View::find(std::string_view name) const
+{
+  if (indexed_) {
+    auto it = index_.find(name);
+    if (it == index_.end()) return {};
+    return *iterator{data_, it->second};
+  }
+  for (const auto& entry : *this)
+    if (entry.name() == name) return entry;
+  return {};
+}
+
+void View::build_index()
+{
+  index_.clear();
+  for (auto it = begin(); it != end(); ++it)
+    index_.emplace(it->name(), it.pos_);
+  indexed_ = true;
+}
+
+// ------------------------------- Stream -------------------------------
+
+bool Stream::feed(std::string_view data)
+{
+  while (not data.empty() and state_ != DONE)
+  {
+    if (state_ == HEADER)
+    {
+      auto* block = (char*) &header_;
+      const size_t take = std::min(sizeof(Tar_header) - have_, data.size());
+      memcpy(block + have_, data.data(), take);
+      data.remove_prefix(take);
+      have_ += take;
+      if (have_ < sizeof(Tar_header)) break;
+      have_ = 0;
+
+      if (is_zero_block(block)) {
+        state_ = DONE;
+        break;
+      }
+      Header_view header {&header_};
+      if (not header.checksum_ok())
+        throw Tar_exception("Invalid checksum in tar header");
+      remaining_ = header.size();
+      padding_   = header.padded_size() - remaining_;
+      state_ = DATA;
+      on_entry_(header);
+    }
+    else if (state_ == DATA)
+    {
+      const size_t take = std::min<uint64_t>(remaining_, data.size());
+      if (take > 0 and on_data_)
+        on_data_(Header_view{&header_}, data.substr(0, take));
+      data.remove_prefix(take);
+      remaining_ -= take;
+    }
+    else // PADDING
+    {
+      const size_t take = std::min<uint64_t>(padding_, data.size());
+      data.remove_prefix(take);
+      padding_ -= take;
+    }
+    // move on once the content (and then the padding) is through
+    if (state_ == DATA and remaining_ == 0) state_ = PADDING;
+    if (state_ == PADDING and padding_ == 0) state_ = HEADER;
+  }
+  return state_ != DONE;
+}
+
+void Stream::feed(hw::Block_device& dev, on_done_func done,
+                  hw::Block_device::block_t first, size_t chunk)
+{
+  Expects(dev_ == nullptr && chunk > 0);
+  dev_     = &dev;
+  next_    = first;
+  chunk_   = chunk;
+  on_done_ = std::move(done);
+  result_  = READING;
+  read_blocks();
+}
+
+void Stream::read_blocks()
+{
+  // drivers like MemDisk call back before read() returns,
+  // so loop here instead of recursing once per chunk
+  reading_ = true;
+  do {
+    again_ = false;
+    if (next_ >= dev_->size()) {
+      result_ = FINISHED;
+      break;
+    }
+    const auto blk = next_;
+    const size_t count = std::min<uint64_t>(chunk_, dev_->size() - blk);
+    next_ += count;
+    dev_->read(blk, count, {this, &Stream::blocks_read});
+  } while (again_);
+  reading_ = false;
+  // done may delete this stream, so it is called last
+  if (result_ != READING) finish();
+}
+
+void Stream::blocks_read(hw::Block_device::buffer_t buffer)
+{
+  if (buffer == nullptr) {
+    result_ = FAILED;
+  }
+  else {
+    try {
+      if (not feed({(const char*) buffer->data(), buffer->size()}))
+        result_ = FINISHED;
+    }
+    catch (const Tar_exception&) {
+      result_ = FAILED;
+    }
+  }
+  // the read loop carries on, or finishes, once read() returns
+  if (reading_) {
+    again_ = result_ == READING;
+    return;
+  }
+  if (result_ != READING) finish();
+  else read_blocks();
+}
+
+void Stream::finish()
+{
+  const bool error = result_ == FAILED;
+  dev_ = nullptr;
+  auto done = std::move(on_done_);
+  on_done_ = nullptr;
+  if (done) done(error);
+}
+
+} // namespace tar
@@ -223,6 +223,12 @@ void Virtio::move_to_this_cpu()
   }
 }
 
+void Virtio::move_queue_to_this_cpu(uint16_t index, uint8_t irq)
+{
+  assert(has_msix() && index < get_msix_vectors());
+  _pcidev.rebalance_msix_vector(index, SMP::cpu_id(), IRQ_BASE + irq);
+}
+
 void Virtio::setup_complete(bool ok)
 {
   uint8_t value = hw::inp(_iobase + VIRTIO_PCI_STATUS);
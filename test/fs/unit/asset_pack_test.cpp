@@ -0,0 +1,124 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <fs/asset_pack.hpp>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+using Encoding = fs::Asset_pack::Encoding;
+
+static std::string load_pack()
+{
+  std::string path = "memdisk.pack";
+  if (access(path.c_str(), F_OK) == -1)
+  {
+    const char* rootp(getenv("INCLUDEOS_SRC"));
+    if (rootp == nullptr) path = "..";
+    else path = std::string(rootp) + "/test";
+    path += "/memdisk.pack";
+  }
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+CASE("Asset pack finds files in place")
+{
+  static const std::string image = load_pack();
+  EXPECT(image.size() == 6 * 4096u);
+  fs::Asset_pack pack{image};
+  EXPECT(pack.is_valid());
+  EXPECT(pack.size() == 3u);
+
+  auto index = pack.find("/index.html");
+  EXPECT(index.is_valid());
+  EXPECT(index.path() == "index.html");
+  EXPECT(pack.find("index.html").path() == "index.html");
+  auto html = index.data();
+  EXPECT(html.substr(0, 15) == "<!DOCTYPE html>");
+  // the data is a view into the image, page aligned
+  EXPECT(html.data() >= image.data());
+  EXPECT(html.data() + html.size() <= image.data() + image.size());
+  EXPECT((html.data() - image.data()) % 4096 == 0);
+
+  // a gzip variant was made, it's worth it
+  EXPECT(index.has(Encoding::gzip));
+  EXPECT(not index.has(Encoding::brotli));
+  EXPECT(index.size(Encoding::gzip) < index.size());
+  EXPECT(index.data(Encoding::gzip).substr(0, 2) == "\x1f\x8b");
+
+  // app.js.gz was packed as the gzip variant of app.js
+  auto app = pack.find("js/app.js");
+  EXPECT(app.has(Encoding::gzip));
+  EXPECT(not pack.find("js/app.js.gz"));
+
+  // too small to compress
+  auto css = pack.find("css/site.css");
+  EXPECT(css.data() == "body { margin: 0; }\n");
+  EXPECT(not css.has(Encoding::gzip));
+
+  EXPECT(not pack.find("missing.html"));
+  EXPECT(not pack.find("css"));
+  EXPECT(not pack.find(""));
+}
+
+CASE("Asset pack lists files in path order")
+{
+  static const std::string image = load_pack();
+  fs::Asset_pack pack{image};
+  EXPECT(pack.at(0).path() == "css/site.css");
+  EXPECT(pack.at(1).path() == "index.html");
+  EXPECT(pack.at(2).path() == "js/app.js");
+  EXPECT(not pack.at(3));
+
+  auto js = pack.list("/js/");
+  EXPECT(js.size() == 1u);
+  EXPECT(js.at(0).path() == "js/app.js");
+  EXPECT(pack.list().size() == 3u);
+  EXPECT(pack.list("img/").empty());
+}
+
+CASE("Asset pack picks the encoding a client accepts")
+{
+  static const std::string image = load_pack();
+  fs::Asset_pack pack{image};
+  auto index = pack.find("index.html");
+  EXPECT(index.best("") == Encoding::identity);
+  EXPECT(index.best("gzip, deflate, br") == Encoding::gzip);
+  EXPECT(index.best("deflate") == Encoding::identity);
+  EXPECT(index.best("gzip;q=0, br") == Encoding::identity);
+  EXPECT(index.best("gzip;q=0.5") == Encoding::gzip);
+  EXPECT(pack.find("css/site.css").best("gzip") == Encoding::identity);
+}
+
+CASE("Asset pack rejects malformed images")
+{
+  EXPECT(not fs::Asset_pack{}.is_valid());
+  EXPECT(not fs::Asset_pack{"IOSPACK1"}.is_valid());
+
+  std::string image = load_pack();
+  // entries running past the end
+  image.resize(4096);
+  fs::Asset_pack cut{image};
+  EXPECT(not cut.is_valid());
+  EXPECT(cut.empty());
+  EXPECT(not cut.find("index.html"));
+
+  image = load_pack();
+  image[0] = 'X';
+  EXPECT(not fs::Asset_pack{image}.is_valid());
+}
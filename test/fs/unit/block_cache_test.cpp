@@ -0,0 +1,135 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <common.cxx>
+#include <fs/block_cache.hpp>
+#include <memdisk>
+
+// counts the sectors actually read from the disk
+class Counting_disk : public fs::MemDisk {
+public:
+  using fs::MemDisk::MemDisk;
+
+  buffer_t read_sync(block_t blk, size_t cnt) override {
+    reads++;
+    sectors += cnt;
+    return fs::MemDisk::read_sync(blk, cnt);
+  }
+  int    reads = 0;
+  size_t sectors = 0;
+};
+
+static char image[256 * fs::MemDisk::SECTOR_SIZE];
+
+static void fill_image()
+{
+  for (size_t i = 0; i < sizeof(image); i++)
+    image[i] = i / fs::MemDisk::SECTOR_SIZE;
+}
+
+CASE("Block cache serves repeated reads from memory")
+{
+  fill_image();
+  Counting_disk disk{image, image + sizeof(image)};
+  fs::Block_cache cache{disk, 16, 0};
+
+  auto buf = cache.read_sync(3, 2);
+  EXPECT(buf != nullptr);
+  EXPECT(buf->size() == 2 * fs::MemDisk::SECTOR_SIZE);
+  EXPECT(buf->at(0) == 3);
+  EXPECT(buf->at(fs::MemDisk::SECTOR_SIZE) == 4);
+  EXPECT(disk.reads == 1);
+  EXPECT(cache.stats().misses == 2u);
+
+  // callers own the buffers they get
+  buf->resize(1);
+  buf = cache.read_sync(3, 2);
+  EXPECT(buf->size() == 2 * fs::MemDisk::SECTOR_SIZE);
+  EXPECT(disk.reads == 1);
+  EXPECT(cache.stats().hits == 2u);
+
+  // only the missing range goes to the disk, in one read
+  bool done = false;
+  cache.read(2, 4,
+    [&lest_env, &done] (auto buf) {
+      EXPECT(buf != nullptr);
+      EXPECT(buf->at(0) == 2);
+      EXPECT(buf->at(3 * fs::MemDisk::SECTOR_SIZE) == 5);
+      done = true;
+    });
+  EXPECT(done);
+  EXPECT(disk.reads == 2);
+  EXPECT(disk.sectors == 2u + 4u);
+  EXPECT(cache.size() == 4u);
+
+  // past the end of the disk
+  EXPECT(cache.read_sync(256) == nullptr);
+}
+
+CASE("Block cache reads ahead when reading sequentially")
+{
+  fill_image();
+  Counting_disk disk{image, image + sizeof(image)};
+  fs::Block_cache cache{disk, 64, 8};
+
+  cache.read_sync(10);
+  EXPECT(cache.stats().read_ahead == 0u);
+  // continues where the last read ended
+  cache.read_sync(11);
+  EXPECT(disk.reads == 2);
+  EXPECT(cache.stats().read_ahead == 8u);
+  for (int blk = 12; blk < 20; blk++) {
+    auto buf = cache.read_sync(blk);
+    EXPECT(buf->at(0) == blk);
+  }
+  EXPECT(disk.reads == 2);
+
+  // read-ahead stops at the end of the disk
+  cache.read_sync(250);
+  cache.read_sync(251);
+  EXPECT(cache.contains(255));
+  EXPECT(cache.stats().read_ahead == 8u + 4u);
+}
+
+CASE("Block cache evicts the least recently used sectors")
+{
+  fill_image();
+  Counting_disk disk{image, image + sizeof(image)};
+  fs::Block_cache cache{disk, 4, 0, 4};
+
+  for (int blk = 0; blk < 4; blk++)
+    cache.read_sync(blk * 2);
+  // keep sector 0 in use
+  cache.read_sync(0);
+  cache.read_sync(100);
+  EXPECT(cache.size() == 4u);
+  EXPECT(cache.contains(0));
+  EXPECT(not cache.contains(2));
+  EXPECT(cache.contains(100));
+
+  // big reads go around the cache
+  const int reads = disk.reads;
+  auto buf = cache.read_sync(0, 8);
+  EXPECT(buf->at(7 * fs::MemDisk::SECTOR_SIZE) == 7);
+  EXPECT(disk.reads == reads + 1);
+  EXPECT(not cache.contains(1));
+
+  cache.invalidate();
+  EXPECT(cache.size() == 0u);
+  cache.read_sync(0);
+  EXPECT(disk.reads == reads + 2);
+}
@@ -41,3 +41,43 @@ CASE("memdisk properties")
     });
   EXPECT(enumerated_partitions == true);
 }
+
+CASE("memdisk runs a batch of operations")
+{
+  static char image[4 * fs::MemDisk::SECTOR_SIZE];
+  for (size_t i = 0; i < sizeof(image); i++)
+    image[i] = i / fs::MemDisk::SECTOR_SIZE;
+  fs::MemDisk memdisk{image, image + sizeof(image)};
+
+  using Op = hw::Block_device::Io_request::Op;
+  hw::Block_device::Io_batch batch(4);
+  batch[0] = {Op::READ, false, false, 1, 2, nullptr};
+  batch[1] = {Op::READ, false, false, 3, 1, nullptr};
+  // past the end of the disk
+  batch[2] = {Op::READ, false, false, 4, 1, nullptr};
+  // a memdisk is read-only
+  batch[3] = {Op::WRITE, false, false, 0, 0, fs::construct_buffer(512)};
+
+  bool done = false;
+  memdisk.submit(std::move(batch),
+    [&done, &lest_env] (hw::Block_device::Io_batch result)
+    {
+      done = true;
+      EXPECT(result.size() == 4u);
+      EXPECT(not result[0].error);
+      EXPECT(result[0].buffer->size() == 1024u);
+      EXPECT(result[0].buffer->at(0) == 1);
+      EXPECT(result[0].buffer->at(512) == 2);
+      EXPECT(not result[1].error);
+      EXPECT(result[1].buffer->at(0) == 3);
+      EXPECT(result[2].error);
+      EXPECT(result[3].error);
+    });
+  EXPECT(done);
+
+  bool empty_done = false;
+  memdisk.submit({}, [&empty_done] (auto result) {
+    empty_done = result.empty();
+  });
+  EXPECT(empty_done);
+}
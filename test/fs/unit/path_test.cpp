@@ -172,3 +172,32 @@ CASE("back expects that path is not empty")
   path.pop_back();
   EXPECT_THROWS(auto back = path.back());
 }
+
+CASE("Path_view finds the same components as Path")
+{
+  for (const std::string str : {"/usr/local/bin", "usr/local/bin/", "/", "",
+                                "./a/./b/.", "/a/../b", "/a//b/c", "//a", ".hidden/x"})
+  {
+    const fs::Path path {str};
+    const fs::Path_view view {str};
+    std::vector<std::string> parts(path.begin(), path.end());
+    std::vector<std::string> found;
+    for (auto part : view)
+      found.emplace_back(part);
+    EXPECT(found == parts);
+    EXPECT(view.empty() == path.empty());
+  }
+}
+
+CASE("Path_view components point into the viewed string")
+{
+  const std::string str {"/var/./log/messages"};
+  const fs::Path_view view {str};
+  auto it = view.begin();
+  EXPECT(*it == "var");
+  EXPECT(it.offset() == 1u);
+  EXPECT((*++it).data() == str.data() + 7);
+  EXPECT(*it++ == "log");
+  EXPECT(*it == "messages");
+  EXPECT(++it == view.end());
+}
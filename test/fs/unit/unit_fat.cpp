@@ -1,6 +1,8 @@
 #include <common.cxx>
 #include <fs/disk.hpp>
 #include <fs/memdisk.hpp>
+#include <fs/fat_internal.hpp>
+#include <fs/mbr.hpp>
 #include <util/sha1.hpp>
 #include <unistd.h>
 using namespace fs;
@@ -152,3 +154,93 @@ CASE("Stat /folder/file.txt")
   const std::string text((const char*) buffer.data(), buffer.size());
   EXPECT(text == "This file contains text\n");
 }
+
+static void set_fat12(uint8_t* fat, uint32_t cl, uint16_t value)
+{
+  const uint32_t ofs = cl + cl / 2;
+  if (cl & 1) {
+    fat[ofs]     = (fat[ofs] & 0x0F) | (value << 4);
+    fat[ofs + 1] = value >> 4;
+  }
+  else {
+    fat[ofs]     = value;
+    fat[ofs + 1] = (fat[ofs + 1] & 0xF0) | (value >> 8);
+  }
+}
+
+CASE("Read a file spread over the disk")
+{
+  // FAT12 image: boot sector, one FAT sector, one root directory sector,
+  // then the clusters (one sector each) starting with cluster 2 at sector 3
+  static uint8_t image[64 * 512];
+  auto* mbr = (MBR::mbr*) image;
+  auto* bpb = mbr->bpb();
+  bpb->bytes_per_sector    = 512;
+  bpb->sectors_per_cluster = 1;
+  bpb->reserved_sectors    = 1;
+  bpb->fa_tables           = 1;
+  bpb->root_entries        = 16;
+  bpb->small_sectors       = 64;
+  bpb->media_type          = 0xF8;
+  bpb->sectors_per_fat     = 1;
+  bpb->signature           = 0x29;
+  mbr->magic               = 0xAA55;
+
+  // the file goes through clusters 3, 4, 9, 10 and 6
+  const uint32_t chain[] {3, 4, 9, 10, 6};
+  for (int i = 0; i < 5; i++) {
+    set_fat12(&image[512], chain[i], (i < 4) ? chain[i+1] : 0xFFF);
+    memset(&image[(chain[i] + 1) * 512], 'a' + i, 512);
+  }
+  auto* ent = (cl_dir*) &image[2 * 512];
+  memcpy(ent->shortname, "SPREAD     ", 11);
+  ent->attrib     = 0x20;
+  ent->cluster_lo = chain[0];
+  ent->filesize   = 5 * 512;
+
+  MemDisk memdisk{(char*) image, (char*) image + sizeof(image)};
+  Disk spread{memdisk};
+  spread.init_fs(
+    [&lest_env] (auto err, File_system&) {
+      EXPECT(!err);
+    });
+  auto& fs = spread.fs();
+  auto file = fs.stat("/SPREAD");
+  EXPECT(file.is_file());
+  EXPECT(file.size() == 5 * 512u);
+
+  auto buffer = fs.read(file, 0, file.size());
+  EXPECT(buffer.size() == 5 * 512u);
+  for (int i = 0; i < 5; i++)
+    EXPECT(buffer.data()[i * 512 + 100] == 'a' + i);
+
+  // across two runs, not on sector boundaries
+  buffer = fs.read(file, 3 * 512 + 500, 100);
+  EXPECT(buffer.size() == 100u);
+  EXPECT(buffer.data()[0]  == 'd');
+  EXPECT(buffer.data()[11] == 'd');
+  EXPECT(buffer.data()[12] == 'e');
+
+  bool done = false;
+  fs.read(file, 512, 2 * 512,
+    [&lest_env, &done] (auto err, auto buf) {
+      EXPECT(!err);
+      EXPECT(buf->size() == 2 * 512u);
+      EXPECT(buf->at(0) == 'b');
+      EXPECT(buf->at(512) == 'c');
+      done = true;
+    });
+  EXPECT(done);
+
+  // reading at the end of the file completes with nothing
+  done = false;
+  fs.read(file, file.size(), 512,
+    [&lest_env, &done] (auto err, auto buf) {
+      EXPECT(!err);
+      EXPECT(buf->empty());
+      done = true;
+    });
+  EXPECT(done);
+  buffer = fs.read(file, file.size(), 512);
+  EXPECT(buffer.size() == 0u);
+}
@@ -0,0 +1,78 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <fs/vfs.hpp>
+#include <chrono>
+
+static const int LEVELS    = 4;
+static const int SIBLINGS  = 64;
+static const int LOOKUPS   = 10000; // smaller for coverage
+
+static std::vector<std::string> paths;
+static char leaf {'x'};
+
+template <typename Func>
+static double ns_per_lookup(const char* what, Func func)
+{
+  using namespace std::chrono;
+  const auto start = steady_clock::now();
+  for (int i = 0; i < LOOKUPS; i++)
+    func(paths[i % paths.size()]);
+  const auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+  const double result = double(ns) / LOOKUPS;
+  printf("%-28s %8.1f ns/lookup\n", what, result);
+  return result;
+}
+
+CASE("Setup a wide VFS tree")
+{
+  // every level is a directory with many siblings, the last one wins
+  std::string dir;
+  for (int level = 0; level < LEVELS; level++)
+  {
+    for (int i = 0; i < SIBLINGS; i++)
+      fs::mount(dir + "/dir" + std::to_string(i) + "/leaf", leaf, "leaf");
+    dir += "/dir" + std::to_string(SIBLINGS - 1);
+  }
+  for (int i = 0; i < SIBLINGS; i++)
+    paths.push_back(dir + "/file" + std::to_string(i));
+  for (int i = 0; i < SIBLINGS; i++)
+    fs::mount(dir + "/file" + std::to_string(i), leaf, "leaf");
+  EXPECT(fs::VFS::root().child_count() == SIBLINGS);
+}
+
+CASE("VFS lookup benchmark")
+{
+  size_t found = 0;
+  ns_per_lookup("Path parsing", [&found] (const std::string& str) {
+    found += fs::Path{str}.size();
+  });
+  ns_per_lookup("Path lookup", [&found] (const std::string& str) {
+    found += fs::get<char>(fs::Path{str}) == 'x';
+  });
+  ns_per_lookup("Path_view parsing", [&found] (const std::string& str) {
+    for (auto part : fs::Path_view{str}) found += part.size() > 0;
+  });
+  ns_per_lookup("string lookup (cached)", [&found] (const std::string& str) {
+    found += fs::get<char>(str) == 'x';
+  });
+  ns_per_lookup("C string lookup (cached)", [&found] (const std::string& str) {
+    found += fs::get<char>(str.c_str()) == 'x';
+  });
+  EXPECT(found > 0u);
+  EXPECT(fs::VFS::lookup_cache_size() == paths.size());
+}
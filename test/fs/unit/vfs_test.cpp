@@ -114,3 +114,39 @@ CASE("VFS can mount entries in a tree")
   EXPECT_THROWS(auto dir = fs::get<fs::Dirent>("/mnt/chars/c"));
   EXPECT_NO_THROW(our_char = fs::get<char>("/mnt/chars/c"));
 }
+
+CASE("VFS looks up plain string paths through a cache")
+{
+  char x {'x'};
+  EXPECT_NO_THROW(fs::mount("/mnt/chars/x", x, "the letter x"));
+  EXPECT(fs::VFS::lookup_cache_size() == 0u);
+
+  // string views and C strings walk the tree without building a Path
+  std::string_view path {"/mnt/chars/x"};
+  EXPECT(fs::get<char>(path) == 'x');
+  EXPECT(fs::VFS::lookup_cache_size() == 1u);
+  EXPECT(fs::get<char>("/mnt/chars/x") == 'x');
+  EXPECT(fs::VFS::lookup_cache_size() == 1u);
+  EXPECT(fs::get<char>("mnt/./chars/x/") == 'x');
+  EXPECT(fs::get<char>(fs::Path{"/mnt/chars/x"}) == 'x');
+
+  // misses are not remembered
+  EXPECT_THROWS_AS(fs::get<char>("/mnt/chars/y"), fs::Err_not_found);
+  EXPECT_THROWS_AS(fs::get<char>("/mnt/chars/x/y"), fs::Err_not_found);
+  EXPECT(fs::VFS::lookup_cache_size() == 2u);
+
+  // mounting starts over, and the new entry is found
+  char y {'y'};
+  EXPECT_NO_THROW(fs::mount("/mnt/chars/y", y, "the letter y"));
+  EXPECT(fs::VFS::lookup_cache_size() == 0u);
+  EXPECT(fs::get<char>("/mnt/chars/y") == 'y');
+  EXPECT(fs::get<char>("/mnt/chars/x") == 'x');
+
+  // the cache is bounded
+  std::string dots {"/mnt/chars/x"};
+  for (size_t i = 0; i <= fs::VFS::lookup_cache_max; i++) {
+    dots.insert(0, "/.");
+    EXPECT(fs::get<char>(dots) == 'x');
+  }
+  EXPECT(fs::VFS::lookup_cache_size() <= fs::VFS::lookup_cache_max);
+}
@@ -0,0 +1,108 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <common.cxx>
+#include <hw/napi.hpp>
+#include <kernel/events.hpp>
+
+// a receive queue that has packets arriving, and counts the interrupt masking
+struct Fake_queue {
+  int  waiting = 0;
+  int  received = 0;
+  bool irq_enabled = true;
+  int  irq_changes = 0;
+  // packets showing up right as the interrupt gets unmasked
+  int  late_arrivals = 0;
+
+  int poll(int budget) {
+    const int n = std::min(waiting, budget);
+    waiting  -= n;
+    received += n;
+    return n;
+  }
+  bool pending() { return waiting > 0; }
+  void irq(bool enable) {
+    irq_enabled = enable;
+    irq_changes++;
+    if (enable) {
+      waiting += late_arrivals;
+      late_arrivals = 0;
+    }
+  }
+};
+
+static hw::Napi make_napi(Fake_queue& q, int budget)
+{
+  return hw::Napi{{&q, &Fake_queue::poll}, {&q, &Fake_queue::pending},
+                  {&q, &Fake_queue::irq}, budget};
+}
+
+CASE("Napi handles a light load from the interrupt")
+{
+  Fake_queue q;
+  auto napi = make_napi(q, 16);
+  q.waiting = 3;
+  napi.interrupt();
+  EXPECT(q.received == 3);
+  EXPECT(q.irq_enabled);
+  EXPECT(not napi.is_polling());
+  EXPECT(napi.stats().interrupts == 1u);
+  EXPECT(napi.stats().polls == 1u);
+  EXPECT(napi.stats().exhausted == 0u);
+}
+
+CASE("Napi keeps polling with interrupts masked under load")
+{
+  Fake_queue q;
+  auto napi = make_napi(q, 16);
+  q.waiting = 40;
+  napi.interrupt();
+  // one budget from the interrupt, the rest is left for the event loop
+  EXPECT(q.received == 16);
+  EXPECT(not q.irq_enabled);
+  EXPECT(napi.is_polling());
+  // interrupts while polling are absorbed
+  napi.interrupt();
+  EXPECT(q.received == 16);
+  EXPECT(napi.stats().interrupts == 2u);
+
+  // polls take turns with other events until the queue runs dry
+  Events::get().process_events();
+  EXPECT(q.received == 40);
+  EXPECT(q.irq_enabled);
+  EXPECT(not napi.is_polling());
+  EXPECT(napi.stats().polls == 3u);
+  EXPECT(napi.stats().packets == 40u);
+  EXPECT(napi.stats().exhausted == 2u);
+}
+
+CASE("Napi picks up packets arriving as interrupts are unmasked")
+{
+  Fake_queue q;
+  auto napi = make_napi(q, 16);
+  q.waiting = 2;
+  q.late_arrivals = 5;
+  napi.interrupt();
+  // the late packets raised no interrupt, so the queue is masked again
+  EXPECT(q.received == 2);
+  EXPECT(not q.irq_enabled);
+  EXPECT(napi.is_polling());
+  Events::get().process_events();
+  EXPECT(q.received == 7);
+  EXPECT(q.irq_enabled);
+  EXPECT(not napi.is_polling());
+}
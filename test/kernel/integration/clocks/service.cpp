@@ -0,0 +1,69 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <service>
+#include <rtc>
+#include <info>
+#include <smp>
+#include <kernel/smp_work.hpp>
+#include <atomic>
+#include <cstdio>
+
+static const int CALLS = 1000000;
+
+static std::atomic<uint64_t> latest {0};
+static std::atomic<int> backwards {0};
+
+// read the clock over and over, counting any time it goes backwards,
+// also compared to what the other CPUs have read
+static void race_clocks(size_t first, size_t last)
+{
+  for (size_t i = first; i < last; i++)
+  {
+    uint64_t seen = latest.load();
+    const uint64_t now = RTC::nanos_now();
+    if (now < seen) backwards++;
+    while (now > seen && !latest.compare_exchange_weak(seen, now));
+  }
+}
+
+void Service::start()
+{
+  // cost per call, on this CPU
+  uint64_t prev = RTC::nanos_now();
+  int local_backwards = 0;
+  const uint64_t c0 = os::Arch::cpu_cycles();
+  const uint64_t t0 = RTC::nanos_now();
+  for (int i = 0; i < CALLS; i++)
+  {
+    const uint64_t now = RTC::nanos_now();
+    if (now < prev) local_backwards++;
+    prev = now;
+  }
+  const uint64_t cycles = os::Arch::cpu_cycles() - c0;
+  const uint64_t nanos  = RTC::nanos_now() - t0;
+  printf("RTC::nanos_now(): %lu cycles, %lu ns per call (%d calls)\n",
+         cycles / CALLS, nanos / CALLS, CALLS);
+  CHECKSERT(local_backwards == 0, "Time never went backwards on CPU 0");
+  CHECKSERT(nanos > 0, "Time moved forward");
+
+  // all CPUs at once
+  os::smp::parallel_for(0, CALLS, race_clocks, CALLS / 64);
+  printf("Raced %d reads on %d CPUs\n", CALLS, SMP::cpu_count());
+  CHECKSERT(backwards == 0, "Time never went backwards between CPUs");
+
+  printf("SUCCESS\n");
+}
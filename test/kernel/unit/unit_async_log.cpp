@@ -0,0 +1,104 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <kernel/async_log.hpp>
+#include <syslog.h>
+#include <string>
+#include <vector>
+
+using namespace os;
+
+struct Received {
+  std::vector<std::string> records;
+  std::vector<size_t>      batches;
+};
+static Received first, second;
+
+static void receive(Received& into, const async_log::Record* records, size_t count)
+{
+  into.batches.push_back(count);
+  for (size_t i = 0; i < count; i++)
+    into.records.emplace_back(records[i].text);
+}
+
+CASE("Queued records reach the sink of their channel when flushed")
+{
+  const int one = async_log::add_channel({[] (auto* r, size_t n) { receive(first, r, n); }});
+  const int two = async_log::add_channel({[] (auto* r, size_t n) { receive(second, r, n); }});
+  EXPECT(one != two);
+
+  EXPECT(async_log::write(one, LOG_INFO, "a", 1));
+  EXPECT(async_log::write(one, LOG_INFO, "b", 1));
+  EXPECT(async_log::printf(two, LOG_ERR, "error %d", 42));
+  EXPECT(async_log::write(one, LOG_INFO, "c", 1));
+  // nothing is sent from the caller
+  EXPECT(first.records.empty());
+
+  async_log::flush();
+  EXPECT(first.records == (std::vector<std::string>{"a", "b", "c"}));
+  EXPECT(second.records == std::vector<std::string>{"error 42"});
+  // consecutive records of a channel go in one batch
+  EXPECT(first.batches == (std::vector<size_t>{2, 1}));
+
+  const auto stats = async_log::stats(0);
+  EXPECT(stats.written == 4u);
+  EXPECT(stats.flushed == 4u);
+  EXPECT(stats.dropped == 0u);
+  first = {}; second = {};
+}
+
+CASE("Long formatted records are cut, not dropped")
+{
+  const std::string big(async_log::max_record * 2, 'x');
+  const auto before = async_log::stats(0);
+  EXPECT(async_log::printf(0, LOG_ERR, "%s", big.c_str()));
+  EXPECT(async_log::printf(0, LOG_ERR, "%.300s!", big.c_str()));
+  EXPECT(async_log::write(0, LOG_ERR, big.data(), big.size()));
+  EXPECT(async_log::stats(0).truncated == before.truncated + 2);
+  async_log::flush();
+  EXPECT(first.records.size() == 3u);
+  EXPECT(first.records.at(0).size() == async_log::max_record - 1);
+  EXPECT(first.records.at(1) == big.substr(0, 300) + "!");
+  EXPECT(first.records.at(2).size() == async_log::max_record);
+  first = {}; second = {};
+}
+
+CASE("Full rings drop records, count them and report the drops")
+{
+  const std::string text(200, 'i');
+  const auto before = async_log::stats(0);
+  // informational records leave room for errors
+  int written = 0;
+  while (async_log::write(0, LOG_INFO, text.data(), text.size())) written++;
+  EXPECT(written > 0);
+  EXPECT(async_log::write(1, LOG_ERR, text.data(), text.size()));
+  while (async_log::write(1, LOG_ERR, text.data(), text.size())) {}
+
+  const auto after = async_log::stats(0);
+  EXPECT(after.dropped == before.dropped + 2);
+  EXPECT(after.written > before.written + written);
+
+  async_log::flush();
+  EXPECT(first.records.size() == size_t(written) + 1);
+  EXPECT(first.records.back() == "async_log: 2 records dropped on CPU 0\n");
+  EXPECT(second.records.back() == "async_log: 2 records dropped on CPU 0\n");
+  // reported once
+  async_log::flush();
+  EXPECT(first.records.size() == size_t(written) + 1);
+  // and there is room again
+  EXPECT(async_log::write(0, LOG_INFO, text.data(), text.size()));
+}
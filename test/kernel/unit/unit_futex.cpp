@@ -0,0 +1,116 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <kernel/futex.hpp>
+#include <kernel/events.hpp>
+#include <kernel/scheduler.hpp>
+#include <kernel/timers.hpp>
+#include <cerrno>
+
+namespace futex = os::futex;
+
+CASE("futex::wait returns at once when the value has changed")
+{
+  int word = 1;
+  EXPECT(futex::wait(&word, 0) == -EAGAIN);
+  EXPECT(futex::wait(&word, 1, futex::Timeout::zero()) == -ETIMEDOUT);
+  EXPECT(futex::wait(&word, 1, futex::Timeout::max(), 0) == -EINVAL);
+  EXPECT(futex::waiters(&word) == 0u);
+  EXPECT(futex::wake(&word, 1) == 0);
+}
+
+CASE("futex::wait blocks until woken from the event loop")
+{
+  static int word = 0;
+  static int wakes = 0;
+  auto ev = Events::get().subscribe(
+    [&] () {
+      EXPECT(futex::waiters(&word) == 1u);
+      // a different bitset does not wake the waiter
+      wakes = futex::wake(&word, 1, 0x2);
+      EXPECT(futex::waiters(&word) == 1u);
+      word = 1;
+      wakes += futex::wake(&word, INT32_MAX, 0x1);
+      EXPECT(futex::waiters(&word) == 0u);
+    });
+  Events::get().trigger_event(ev);
+
+  EXPECT(futex::wait(&word, 0, futex::Timeout::max(), 0x1) == 0);
+  EXPECT(wakes == 1);
+  EXPECT(word == 1);
+  Events::get().unsubscribe(ev);
+}
+
+CASE("futex::requeue moves waiters to another futex")
+{
+  static int cond  = 0;
+  static int mutex = 0;
+  static int result = -1;
+  auto ev = Events::get().subscribe(
+    [&] () {
+      EXPECT(futex::cmp_requeue(&cond, 0, &mutex, 1, 1) == -EAGAIN);
+      EXPECT(futex::requeue(&cond, 0, &mutex, 1) == 1);
+      EXPECT(futex::waiters(&cond) == 0u);
+      EXPECT(futex::waiters(&mutex) == 1u);
+      // waking the old futex does nothing
+      EXPECT(futex::wake(&cond, 1) == 0);
+      result = futex::wake(&mutex, 1);
+    });
+  Events::get().trigger_event(ev);
+
+  EXPECT(futex::wait(&cond, 0) == 0);
+  EXPECT(result == 1);
+  EXPECT(futex::waiters(&mutex) == 0u);
+  Events::get().unsubscribe(ev);
+}
+
+extern delegate<uint64_t()> systime_override;
+static uint64_t current_time = 0;
+
+CASE("futex::wait with a timeout in a task stops or fires its timer")
+{
+  using namespace std::chrono;
+  systime_override = [] () -> uint64_t { return current_time; };
+  if (not Timers::is_ready()) {
+    Timers::init([] (Timers::duration_t) {}, [] () {});
+    Timers::ready();
+  }
+  static int word = 0;
+  static int result = 1;
+
+  // woken before the timeout, the timer is stopped
+  Scheduler::spawn([] { result = futex::wait(&word, 0, 1s); });
+  Events::get().process_events();
+  EXPECT(futex::waiters(&word) == 1u);
+  EXPECT(Timers::active() == 1u);
+  EXPECT(futex::wake(&word, 1) == 1);
+  Events::get().process_events();
+  EXPECT(result == 0);
+  EXPECT(Timers::active() == 0u);
+
+  // not woken, the timer wakes the task
+  Scheduler::spawn([] { result = futex::wait(&word, 0, 1s); });
+  Events::get().process_events();
+  EXPECT(Timers::active() == 1u);
+  current_time += duration_cast<nanoseconds>(2s).count();
+  Timers::timers_handler();
+  Events::get().process_events();
+  EXPECT(result == -ETIMEDOUT);
+  EXPECT(futex::waiters(&word) == 0u);
+  EXPECT(Timers::active() == 0u);
+  systime_override = [] () -> uint64_t { return 0; };
+}
@@ -15,6 +15,9 @@ using namespace liu;
 
 #include <net/inet>
 #include <net/interfaces>
+#include <net/tls/session_cache.hpp>
+#include <net/tls/ticket_keys.hpp>
+#include <net/memcached/cache.hpp>
 #include <nic_mock.hpp>
 static net::Inet* inet = nullptr;
 
@@ -132,6 +135,244 @@ CASE("Setup LiveUpdate and perform no-op update")
   EXPECT_THROWS_AS(LiveUpdate::exec(not_a_kernel, storage_area), liveupdate_exec_success);
 }
 
+struct region_node
+{
+  region_node* next;
+  int          value;
+};
+static region_node* region_list = nullptr;
+static size_t region_size = 0;
+static std::vector<size_t> region_pointers;
+static Region restored_region;
+
+static void store_region(Storage& store, const buffer_t*)
+{
+  if (region_list == nullptr) return;
+  store.add_region(10, region_list, region_size, region_pointers);
+}
+static void restore_region(Restore& thing)
+{
+  assert(thing.get_id() == 10);
+  assert(thing.is_region());
+  restored_region = thing.as_region(); thing.go_next();
+  assert(thing.is_end());
+}
+
+CASE("Keep a region in place across an update")
+{
+  Default_paging p{};
+  const size_t AREA_SIZE = 16*1024*1024;
+  auto* area = new char[AREA_SIZE];
+
+  region_size = 64 * 1024;
+  auto* nodes = (region_node*) LiveUpdate::reserve_region(region_size, area, AREA_SIZE);
+  EXPECT((char*) nodes > area);
+  EXPECT((char*) nodes + region_size <= area + AREA_SIZE);
+  EXPECT(LiveUpdate::reserved_bytes(area) == region_size);
+
+  // a linked list, with pointers into the region
+  const int count = region_size / sizeof(region_node);
+  for (int i = 0; i < count; i++)
+  {
+    nodes[i].next  = (i+1 < count) ? &nodes[i+1] : nullptr;
+    nodes[i].value = i;
+    region_pointers.push_back(i * sizeof(region_node) + offsetof(region_node, next));
+  }
+  region_list = nodes;
+  LiveUpdate::register_partition("region", store_region);
+  EXPECT_THROWS_AS(LiveUpdate::exec(not_a_kernel, area), liveupdate_exec_success);
+  LiveUpdate::restore_environment();
+  // the region itself was not copied into the stored data
+  EXPECT(LiveUpdate::stored_data_length(area) < region_size);
+
+  // the new kernel finds the whole area somewhere else
+  auto* moved = new char[AREA_SIZE];
+  memcpy(moved, area, AREA_SIZE);
+  LiveUpdate::resume_from_heap(moved, "region", restore_region);
+  EXPECT(restored_region.length == region_size);
+  EXPECT(restored_region.moved == moved - area);
+  EXPECT(restored_region.data == (char*) nodes + (moved - area));
+
+  int found = 0;
+  auto* first = (region_node*) restored_region.data;
+  for (auto* node = first; node != nullptr; node = node->next)
+  {
+    if (node->value != found) break;
+    if (node < first || node >= first + count) break;
+    found++;
+  }
+  EXPECT(found == count);
+
+  // the restored region can be stored again, now without moving
+  region_list = first;
+  EXPECT_THROWS_AS(LiveUpdate::exec(not_a_kernel, moved), liveupdate_exec_success);
+  LiveUpdate::restore_environment();
+  LiveUpdate::resume_from_heap(moved, "region", restore_region);
+  EXPECT(restored_region.data == (char*) first);
+  EXPECT(restored_region.moved == 0);
+  EXPECT(first->next == first + 1);
+
+  // reservations after resuming stay clear of the region
+  auto* more = (char*) LiveUpdate::reserve_region(4096, moved, AREA_SIZE);
+  EXPECT(more + 4096 <= (char*) restored_region.data);
+  // only reserved memory can be stored as a region
+  EXPECT_THROWS_AS(LiveUpdate::exec(not_a_kernel, area), std::runtime_error);
+  LiveUpdate::restore_environment();
+
+  region_list = nullptr;
+  delete[] area;
+  delete[] moved;
+}
+
+static std::vector<char> overflow_data;
+static void store_overflow(Storage& store, const buffer_t*)
+{
+  if (overflow_data.empty()) return;
+  store.add_buffer(11, overflow_data.data(), overflow_data.size());
+}
+
+CASE("Stored data never overwrites a reserved region")
+{
+  Default_paging p{};
+  const size_t AREA_SIZE = 16*1024*1024;
+  auto* area = new char[AREA_SIZE];
+
+  const size_t size = AREA_SIZE - 2*1024*1024;
+  auto* region = (char*) LiveUpdate::reserve_region(size, area, AREA_SIZE);
+  memset(region, 0xA5, size);
+
+  // more data than there is room for below the region
+  overflow_data.resize(4*1024*1024, 0x5A);
+  LiveUpdate::register_partition("overflow", store_overflow);
+  EXPECT_THROWS_AS(LiveUpdate::exec(not_a_kernel, area), std::runtime_error);
+  LiveUpdate::restore_environment();
+
+  size_t intact = 0;
+  while (intact < size && region[intact] == (char) 0xA5) intact++;
+  EXPECT(intact == size);
+
+  overflow_data.clear();
+  overflow_data.shrink_to_fit();
+  delete[] area;
+}
+
+static net::tls::Session_cache* tls_cache = nullptr;
+static net::tls::Ticket_keys*   tls_keys  = nullptr;
+
+static void store_tls(Storage& store, const buffer_t*)
+{
+  if (tls_cache == nullptr) return;
+  tls_cache->store(20, store);
+  tls_keys->store(21, store);
+}
+static void restore_tls(Restore& thing)
+{
+  tls_cache->restore(thing);
+  assert(thing.get_id() == 21);
+  tls_keys->restore(thing); thing.go_next();
+  assert(thing.is_end());
+}
+
+CASE("Resume TLS sessions and ticket keys after an update")
+{
+  Default_paging p{};
+  net::tls::Session_cache cache{64};
+  net::tls::Ticket_keys keys;
+  const std::string session = "serialized session";
+  cache.insert("session-1", session.data(), session.size());
+  cache.insert("session-2", "x", 1);
+  const auto previous = keys.current();
+  keys.rotate();
+  const auto current = keys.current();
+
+  tls_cache = &cache;
+  tls_keys  = &keys;
+  LiveUpdate::register_partition("tls", store_tls);
+  EXPECT_THROWS_AS(LiveUpdate::exec(not_a_kernel, storage_area), liveupdate_exec_success);
+  LiveUpdate::restore_environment();
+
+  net::tls::Session_cache new_cache{64};
+  net::tls::Ticket_keys new_keys;
+  tls_cache = &new_cache;
+  tls_keys  = &new_keys;
+  LiveUpdate::resume_from_heap(storage_area, "tls", restore_tls);
+  tls_cache = nullptr;
+  tls_keys  = nullptr;
+
+  std::vector<uint8_t> data;
+  EXPECT(new_cache.lookup("session-1", data));
+  EXPECT(std::string(data.begin(), data.end()) == session);
+  EXPECT(new_cache.lookup("session-2", data));
+  EXPECT(data.size() == 1u);
+  EXPECT(not new_cache.lookup("session-3", data));
+
+  bool is_current = false;
+  auto key = new_keys.find(current.name.data(), is_current);
+  EXPECT(key.has_value());
+  EXPECT(is_current);
+  key = new_keys.find(previous.name.data(), is_current);
+  EXPECT(key.has_value());
+  EXPECT(not is_current);
+  EXPECT(key->aes_key  == previous.aes_key);
+  EXPECT(key->hmac_key == previous.hmac_key);
+}
+
+static net::memcached::Cache* mc_cache = nullptr;
+
+static void store_memcached(Storage& store, const buffer_t*)
+{
+  if (mc_cache == nullptr) return;
+  mc_cache->store(30, store);
+}
+static void restore_memcached(Restore& thing)
+{
+  mc_cache->restore(thing);
+  assert(thing.is_end());
+}
+
+CASE("Keep a memcached cache warm across an update")
+{
+  using namespace net::memcached;
+  Default_paging p{};
+  const uint32_t now = RTC::now();
+  Cache cache{16 * Store::page_size, 2};
+  // enough items to span several stored buffers, and one large value
+  for (int i = 0; i < 1000; i++) {
+    const auto key = "key-" + std::to_string(i);
+    EXPECT(cache.store(Mode::SET, key, i, 0, "value-" + key, now) == Result::STORED);
+  }
+  const std::string large(100 * 1024, 'L');
+  EXPECT(cache.store(Mode::SET, "large", 7, 0, large, now) == Result::STORED);
+  uint64_t cas = 0;
+  cache.get("large", now, [&] (const auto& item) { cas = item.cas; });
+
+  mc_cache = &cache;
+  LiveUpdate::register_partition("memcached", store_memcached);
+  EXPECT_THROWS_AS(LiveUpdate::exec(not_a_kernel, storage_area), liveupdate_exec_success);
+  LiveUpdate::restore_environment();
+
+  Cache new_cache{16 * Store::page_size, 2};
+  mc_cache = &new_cache;
+  LiveUpdate::resume_from_heap(storage_area, "memcached", restore_memcached);
+  mc_cache = nullptr;
+
+  EXPECT(new_cache.stats().items == cache.stats().items);
+  for (int i = 0; i < 1000; i++) {
+    const auto key = "key-" + std::to_string(i);
+    bool same = false;
+    new_cache.get(key, now, [&] (const auto& item) {
+      same = item.value() == "value-" + key && item.flags == uint32_t(i);
+    });
+    EXPECT(same);
+  }
+  bool same = false;
+  new_cache.get("large", now, [&] (const auto& item) {
+    same = item.value() == large && item.flags == 7u && item.cas == cas;
+  });
+  EXPECT(same);
+  EXPECT(not new_cache.get("missing", now, [] (const auto&) {}));
+}
+
 CASE("Store some data and restore it")
 {
   Default_paging p{};
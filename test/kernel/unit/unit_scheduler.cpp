@@ -0,0 +1,136 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <common.cxx>
+#include <kernel/events.hpp>
+#include <kernel/scheduler.hpp>
+#include <smp>
+#include <string>
+#include <vector>
+
+// the CPU count the SMP mock reports
+extern int __mock_cpu_count;
+
+// tasks run from the event loop of their CPU
+static void run_events()
+{
+  Events::get().process_events();
+}
+
+CASE("Scheduler runs spawned tasks from the event loop")
+{
+  EXPECT(Scheduler::current() == nullptr);
+  // outside of a task there is nothing to yield to
+  Scheduler::yield();
+
+  static int runs = 0;
+  for (int i = 0; i < 3; i++)
+    Scheduler::spawn([] { runs++; });
+  Scheduler::spawn([] { runs++; }, 0);
+
+  auto st = Scheduler::stats(0);
+  EXPECT(st.spawned == 4u);
+  EXPECT(st.ready == 4u);
+  EXPECT(st.finished == 0u);
+  EXPECT(st.pooled == 0u);
+  EXPECT(runs == 0);
+
+  run_events();
+  st = Scheduler::stats(0);
+  EXPECT(runs == 4);
+  EXPECT(st.ready == 0u);
+  EXPECT(st.finished == 4u);
+  EXPECT(st.pooled == 4u);
+  EXPECT(Scheduler::current() == nullptr);
+}
+
+CASE("Tasks yield to each other and reuse restarted fibers")
+{
+  static std::string order;
+  static bool in_task = false;
+  order.clear();
+  const auto before = Scheduler::stats(0);
+  Scheduler::spawn([] {
+    order += "a1 ";
+    Scheduler::yield();
+    order += "a2 ";
+  });
+  Scheduler::spawn([] {
+    in_task = Scheduler::current() != nullptr;
+    order += "b1 ";
+    Scheduler::yield();
+    order += "b2 ";
+  });
+  run_events();
+  EXPECT(order == "a1 b1 a2 b2 ");
+  EXPECT(in_task);
+
+  auto st = Scheduler::stats(0);
+  EXPECT(st.finished == before.finished + 2);
+  // both came from the pool, and went back to it
+  EXPECT(st.pooled == before.pooled);
+  // started twice and resumed twice
+  EXPECT(st.switches == before.switches + 4);
+
+  // a blocking task is retried on the next round of events
+  static int rounds = 0;
+  static bool ready = false;
+  rounds = 0;
+  ready = false;
+  Scheduler::spawn([] {
+    while (not ready) {
+      rounds++;
+      Scheduler::block();
+    }
+  });
+  run_events();
+  EXPECT(rounds == 1);
+  EXPECT(Scheduler::stats(0).blocked == 1u);
+  run_events();
+  EXPECT(rounds == 2);
+  ready = true;
+  run_events();
+  EXPECT(rounds == 2);
+  EXPECT(Scheduler::stats(0).blocked == 0u);
+  EXPECT(Scheduler::stats(0).finished == before.finished + 3);
+}
+
+CASE("An idle CPU steals half of the queue of a busy one")
+{
+  if (SMP_MAX_CORES < 2) return;
+  __mock_cpu_count = 2;
+  const auto before = Scheduler::stats(0);
+
+  // how many tasks the busy CPU had left when each task ran
+  static std::vector<uint32_t> left;
+  left.clear();
+  auto task = [] { left.push_back(Scheduler::stats(1).ready); };
+  for (int i = 0; i < 4; i++)
+    Scheduler::spawn(task, 1);
+  EXPECT(Scheduler::stats(1).ready == 4u);
+
+  // CPU 1 never runs here. CPU 0 runs its own task, and then runs out of
+  // work and takes the tasks of CPU 1, half of what is left each time.
+  Scheduler::spawn(task, 0);
+  run_events();
+  EXPECT(left == (std::vector<uint32_t>{4, 2, 2, 1, 0}));
+  EXPECT(Scheduler::stats(1).ready == 0u);
+  EXPECT(Scheduler::stats(0).steals == before.steals + 4);
+  EXPECT(Scheduler::stats(0).finished == before.finished + 5);
+
+  __mock_cpu_count = 1;
+}
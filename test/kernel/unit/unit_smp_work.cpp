@@ -0,0 +1,117 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <common.cxx>
+#include <kernel/smp_work.hpp>
+#include <kernel/events.hpp>
+#include <util/mpsc_ring.hpp>
+#include <thread>
+#include <vector>
+
+CASE("Mpsc_ring keeps the order of each producer, and never loses items")
+{
+  static Mpsc_ring<uint64_t, 64> ring;
+  constexpr int producers = 4;
+  constexpr uint64_t per_producer = 20000;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++)
+    threads.emplace_back([p] {
+      for (uint64_t i = 0; i < per_producer; i++)
+        while (not ring.push((uint64_t(p) << 32) | i))
+          std::this_thread::yield();
+    });
+
+  std::vector<uint64_t> next(producers, 0);
+  uint64_t received = 0;
+  bool ordered = true;
+  while (received < producers * per_producer) {
+    uint64_t item;
+    if (not ring.pop(item)) continue;
+    const int p = item >> 32;
+    ordered = ordered and (item & 0xffffffff) == next[p];
+    next[p]++;
+    received++;
+  }
+  for (auto& t : threads) t.join();
+
+  EXPECT(ordered);
+  EXPECT(ring.empty());
+  uint64_t item;
+  EXPECT(not ring.pop(item));
+}
+
+CASE("Work posted to this CPU runs from the event loop, with one notification")
+{
+  auto before = os::smp::stats(0);
+  int runs = 0;
+  for (int i = 0; i < 10; i++)
+    EXPECT(os::smp::post(0, [&runs] { runs++; }));
+  os::smp::flush();
+  EXPECT(runs == 0);
+
+  Events::get().process_events();
+  EXPECT(runs == 10);
+
+  auto after = os::smp::stats(0);
+  EXPECT(after.posted - before.posted == 10u);
+  EXPECT(after.executed - before.executed == 10u);
+  // the local CPU is woken by an event, not an IPI
+  EXPECT(after.ipis == before.ipis);
+
+  // done comes back after the work
+  std::vector<int> order;
+  EXPECT(os::smp::run_on(0, [&order] { order.push_back(1); },
+                            [&order] { order.push_back(2); }));
+  Events::get().process_events();
+  EXPECT(order == (std::vector<int>{1, 2}));
+}
+
+CASE("A full ring refuses work")
+{
+  int runs = 0;
+  size_t posted = 0;
+  while (os::smp::post(0, [&runs] { runs++; })) posted++;
+  EXPECT(posted == os::smp::ring_size);
+  EXPECT(os::smp::stats(0).full >= 1u);
+  os::smp::drain();
+  EXPECT(runs == (int) posted);
+}
+
+CASE("parallel_for and parallel_reduce cover the whole range")
+{
+  std::vector<int> hits(1000, 0);
+  os::smp::parallel_for(0, hits.size(),
+    [&hits] (size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) hits[i]++;
+    }, 16);
+  EXPECT(std::count(hits.begin(), hits.end(), 1) == 1000);
+
+  auto sum = os::smp::parallel_reduce(size_t(1), size_t(101), uint64_t(0),
+    [] (size_t begin, size_t end) {
+      uint64_t s = 0;
+      for (size_t i = begin; i < end; i++) s += i;
+      return s;
+    },
+    [] (uint64_t a, uint64_t b) { return a + b; });
+  EXPECT(sum == 5050u);
+
+  // an empty range calls nothing
+  int calls = 0;
+  os::smp::parallel_for(5, 5, [&calls] (size_t, size_t) { calls++; });
+  EXPECT(calls == 0);
+}
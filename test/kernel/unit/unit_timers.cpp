@@ -23,6 +23,8 @@ extern delegate<uint64_t()> systime_override;
 static uint64_t current_time = 0;
 
 static int magic_performed = 0;
+static Timers::duration_t hw_armed {};
+static int hw_stopped = 0;
 void perform_magic(int) {
   magic_performed += 1;
 }
@@ -33,8 +35,8 @@ CASE("Initialize timer system")
     [] () -> uint64_t { return current_time; };
 
   Timers::init(
-    [] (Timers::duration_t) {},
-    [] () {}
+    [] (Timers::duration_t when) { hw_armed = when; },
+    [] () { hw_stopped++; }
   );
   Timers::ready();
 
@@ -156,6 +158,27 @@ CASE("Test a periodic timer")
   current_time = 0;
 }
 
+#include <kernel/events.hpp>
+CASE("Stopping the next timer re-arms the hardware timer")
+{
+  current_time = 0;
+  magic_performed = 0;
+  int first = Timers::oneshot(1ms, perform_magic);
+  int later = Timers::oneshot(5ms, perform_magic);
+  Timers::timers_handler();
+  EXPECT(hw_armed == 1ms);
+  // the hardware gets armed for the remaining timer
+  Timers::stop(first);
+  Events::get().process_events();
+  EXPECT(hw_armed == 5ms);
+  // and stopped with no timers left
+  const int stopped = hw_stopped;
+  Timers::stop(later);
+  EXPECT(hw_stopped == stopped + 1);
+  EXPECT(Timers::active() == 0);
+  EXPECT(magic_performed == 0);
+}
+
 #include <util/timer.hpp>
 CASE("Test util timer")
 {
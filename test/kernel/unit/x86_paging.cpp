@@ -440,6 +440,44 @@ CASE("x86::paging controlling page sizes"){
    **/
 }
 
+CASE("x86::paging collapsing page tables into huge pages")
+{
+  using namespace util;
+  using namespace x86;
+
+  init_default_paging();
+  const auto rw = paging::Flags::present | paging::Flags::writable | paging::Flags::no_exec;
+
+  // fragment an identity mapped range into 4KiB pages
+  paging::Map req {42_MiB, 42_MiB, rw, 10_MiB, 4_KiB};
+  auto res = __pml4->map_r(req);
+  EXPECT(res.page_sizes == 4_KiB);
+  EXPECT(__pml4->active_page_size(44_MiB) == 4_KiB);
+  const auto before = __pml4->summary();
+
+  // only the 2MiB ranges fully covered are replaced
+  req = {42_MiB, 42_MiB, rw, 9_MiB, 2_MiB};
+  EXPECT(__pml4->collapse_r(req, true) == 4);
+  EXPECT(__pml4->active_page_size(42_MiB) == 2_MiB);
+  EXPECT(__pml4->active_page_size(48_MiB) == 2_MiB);
+  EXPECT(__pml4->active_page_size(51_MiB) == 4_KiB);
+  EXPECT(__pml4->summary().pages_4k == before.pages_4k - 4 * 512);
+
+  // the mapping is unchanged
+  for (auto addr : {42_MiB, 45_MiB + 4_KiB, 49_MiB + 42_KiB}) {
+    EXPECT(os::mem::virt_to_phys(addr) == (addr & ~(2_MiB - 1)));
+    EXPECT(os::mem::flags(addr) == (os::mem::Access::read | os::mem::Access::write));
+  }
+
+  // nothing left to collapse
+  EXPECT(__pml4->collapse_r(req, true) == 0);
+
+  // 4KiB only requests don't collapse anything
+  req = {50_MiB, 50_MiB, rw, 2_MiB, 4_KiB};
+  EXPECT(__pml4->collapse_r(req, true) == 0);
+  EXPECT(__pml4->active_page_size(51_MiB) == 4_KiB);
+}
+
 CASE ("x86::paging Verify default paging setup")
 {
   SETUP("Initialize paging")
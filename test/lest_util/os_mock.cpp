@@ -91,12 +91,71 @@ void os::event_loop() {}
 void os::halt() noexcept {}
 void os::reboot() noexcept {}
 
+// fibers switch stacks like src/arch/x86_64/fiber_asm.asm does
+#if defined(__x86_64__)
+asm(R"(
+  .text
+  .globl __fiber_jumpstart
+  .type  __fiber_jumpstart, @function
+__fiber_jumpstart:
+  push %rbp
+  push %rbx
+  push %r12
+  push %r13
+  push %r14
+  push %r15
+  mov  %rsp, (%rdx)
+  mov  %rdi, %rsp
+  push %rdx
+  push %rbp
+  mov  %rsi, %rdi
+  call fiber_jumpstarter@PLT
+  pop  %rbp
+  pop  %rdx
+  mov  (%rdx), %rsp
+  pop  %r15
+  pop  %r14
+  pop  %r13
+  pop  %r12
+  pop  %rbx
+  pop  %rbp
+  ret
+
+  .globl __fiber_yield
+  .type  __fiber_yield, @function
+__fiber_yield:
+  push %rbp
+  push %rbx
+  push %r12
+  push %r13
+  push %r14
+  push %r15
+  mov  %rsp, (%rsi)
+  mov  %rdi, %rsp
+  pop  %r15
+  pop  %r14
+  pop  %r13
+  pop  %r12
+  pop  %rbx
+  pop  %rbp
+  ret
+)");
+#else
+extern "C" void __fiber_jumpstart(volatile void*, volatile void*, volatile void*) {}
+extern "C" void __fiber_yield(volatile void*, volatile void*) {}
+#endif
+
 void __x86_init_paging(void*){};
 namespace x86 {
 namespace paging {
   void invalidate(void* /* pageaddr */){};
 }}
 
+#include <kernel/memory.hpp>
+// no huge page regions in the unit tests
+void* os::mem::alloc_huge(size_t) { return nullptr; }
+void os::mem::free_huge(void*, size_t) {}
+
 //void OS::multiboot(unsigned) {}
 
 #include <system_log>
@@ -200,6 +259,11 @@ uint32_t __arch_rand32()
 int SMP::cpu_id() noexcept {
   return 0;
 }
+// tests may pretend to have more CPUs, up to SMP_MAX_CORES
+int __mock_cpu_count = 1;
+int SMP::cpu_count() noexcept {
+  return __mock_cpu_count;
+}
 void SMP::global_lock() noexcept {}
 void SMP::global_unlock() noexcept {}
 void SMP::add_task(SMP::task_func func, int) { func(); }
@@ -52,3 +52,12 @@ CASE("Randomly release bufferstore buffers")
     EXPECT(bufstore.available() == BUFFER_CNT * BS_CHAINS);
   }
 }
+
+CASE("Pools are only rounded up to huge pages when huge pages are obtained")
+{
+  // the unit tests have no huge page regions, so the pool keeps its size
+  BufferStore bufstore(600, BUFFER_SZ);
+  EXPECT(bufstore.poolsize() == 600u * BUFFER_SZ);
+  EXPECT(bufstore.total_buffers() == 600u);
+  EXPECT(bufstore.available() == 600u);
+}
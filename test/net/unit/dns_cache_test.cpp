@@ -0,0 +1,199 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2015-2018 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/dns/cache.hpp>
+
+using namespace net;
+using namespace net::dns;
+
+static Record make_a(const std::string& name, uint32_t ttl, ip4::Addr addr)
+{
+  Record rec;
+  rec.name   = name;
+  rec.rtype  = Record_type::A;
+  rec.rclass = Class::INET;
+  rec.ttl    = ttl;
+  rec.data_len = sizeof(addr);
+  rec.rdata.assign((const char*) &addr, sizeof(addr));
+  return rec;
+}
+
+static Record make_soa(const std::string& zone, uint32_t ttl, uint32_t minimum)
+{
+  Record rec;
+  rec.name   = zone;
+  rec.rtype  = Record_type::SOA;
+  rec.rclass = Class::INET;
+  rec.ttl    = ttl;
+  // compressed MNAME and RNAME, then 5 fields where the last is MINIMUM
+  rec.rdata.assign("\xc0\x0c\xc0\x0c", 4);
+  const uint32_t fields[5] {htonl(1), htonl(7200), htonl(900), htonl(1209600), htonl(minimum)};
+  rec.rdata.append((const char*) fields, sizeof(fields));
+  rec.data_len = rec.rdata.size();
+  return rec;
+}
+
+CASE("Positive responses are cached for the lowest record TTL")
+{
+  Cache cache;
+  Response res;
+  res.answers.push_back(make_a("includeos.org", 300, {10,0,0,1}));
+  res.answers.push_back(make_a("includeos.org", 120, {10,0,0,2}));
+  EXPECT(Cache::ttl_of(res) == 120);
+
+  EXPECT(cache.insert("includeos.org", Record_type::A, res, 1000, std::chrono::hours(1)));
+  EXPECT(cache.size() == 1u);
+  // a different record type is a different entry
+  EXPECT(cache.lookup("includeos.org", Record_type::AAAA, 1000) == nullptr);
+
+  // names are case insensitive, and TTLs count down
+  auto hit = cache.lookup("IncludeOS.org", Record_type::A, 1100);
+  EXPECT(hit != nullptr);
+  EXPECT(hit->get_first_ipv4() == ip4::Addr(10,0,0,1));
+  EXPECT(hit->answers.at(0).ttl == 20u);
+
+  EXPECT(cache.lookup("includeos.org", Record_type::A, 1120) == nullptr);
+  EXPECT(cache.size() == 0u);
+  EXPECT(cache.stats().hits == 1u);
+  EXPECT(cache.stats().expired == 1u);
+}
+
+CASE("The cache TTL caps record TTLs, zero TTLs are not cached")
+{
+  Cache cache;
+  Response res;
+  res.answers.push_back(make_a("includeos.org", 86400, {10,0,0,1}));
+  EXPECT(cache.insert("includeos.org", Record_type::A, res, 0, std::chrono::seconds(60)));
+  EXPECT(cache.lookup("includeos.org", Record_type::A, 59) != nullptr);
+  EXPECT(cache.lookup("includeos.org", Record_type::A, 60) == nullptr);
+
+  res.answers.at(0).ttl = 0;
+  EXPECT(not cache.insert("includeos.org", Record_type::A, res, 0, std::chrono::seconds(60)));
+  EXPECT(not cache.insert("includeos.org", Record_type::A, res, 0, std::chrono::seconds(0)));
+}
+
+CASE("Negative responses are cached using the SOA (RFC 2308)")
+{
+  Cache cache;
+  Response nx;
+  nx.rcode = Response_code::NAME_ERROR;
+  // not cacheable without SOA
+  EXPECT(Cache::ttl_of(nx) == -1);
+  EXPECT(not cache.insert("nope.includeos.org", Record_type::A, nx, 0, std::chrono::hours(1)));
+
+  nx.auth.push_back(make_soa("includeos.org", 3600, 300));
+  EXPECT(Cache::ttl_of(nx) == 300);
+  EXPECT(cache.insert("nope.includeos.org", Record_type::A, nx, 0, std::chrono::hours(1)));
+
+  auto hit = cache.lookup("nope.includeos.org", Record_type::A, 299);
+  EXPECT(hit != nullptr);
+  EXPECT(hit->is_name_error());
+  EXPECT(not hit->has_addr());
+  EXPECT(cache.stats().negative_hits == 1u);
+  EXPECT(cache.lookup("nope.includeos.org", Record_type::A, 300) == nullptr);
+
+  // server failures are not cached
+  Response fail;
+  fail.rcode = Response_code::SERVER_FAIL;
+  fail.auth.push_back(make_soa("includeos.org", 3600, 300));
+  EXPECT(not cache.insert("includeos.org", Record_type::A, fail, 0, std::chrono::hours(1)));
+}
+
+CASE("The least recently used entries are evicted under the memory limit")
+{
+  Cache cache;
+  Response res;
+  res.answers.push_back(make_a("host", 300, {10,0,0,1}));
+  EXPECT(cache.insert("host0", Record_type::A, res, 0, std::chrono::hours(1)));
+  const size_t entry_size = cache.bytes();
+  cache.set_max_bytes(entry_size * 3);
+
+  EXPECT(cache.insert("host1", Record_type::A, res, 0, std::chrono::hours(1)));
+  EXPECT(cache.insert("host2", Record_type::A, res, 0, std::chrono::hours(1)));
+  // touch host0, so host1 is the least recently used
+  EXPECT(cache.lookup("host0", Record_type::A, 1) != nullptr);
+  EXPECT(cache.insert("host3", Record_type::A, res, 0, std::chrono::hours(1)));
+
+  EXPECT(cache.size() == 3u);
+  EXPECT(cache.bytes() <= cache.max_bytes());
+  EXPECT(cache.stats().evictions == 1u);
+  EXPECT(cache.lookup("host1", Record_type::A, 1) == nullptr);
+  EXPECT(cache.lookup("host0", Record_type::A, 1) != nullptr);
+
+  EXPECT(cache.flush_expired(300) == 3u);
+  EXPECT(cache.empty());
+  EXPECT(cache.bytes() == 0u);
+}
+
+static void append_record(std::string& msg, const std::string& name, uint16_t type,
+                          const std::string& rdata)
+{
+  msg += name;
+  const rr_data rr {htons(type), htons(1), htonl(300), htons(rdata.size())};
+  msg.append((const char*) &rr, sizeof(rr));
+  msg += rdata;
+}
+
+static std::string make_response(int answers)
+{
+  Header hdr {};
+  hdr.qr = 1;
+  hdr.q_count   = htons(1);
+  hdr.ans_count = htons(answers);
+  std::string msg((const char*) &hdr, sizeof(hdr));
+  // the question name is at offset 12, which records point back to
+  msg.append("\3www\7example\3com\0", 17);
+  const Question q {htons(1), htons(1)};
+  msg.append((const char*) &q, sizeof(q));
+  return msg;
+}
+
+CASE("Responses skip record data by its length and drop malformed names")
+{
+  std::string msg = make_response(3);
+  // an MX record, whose data does not start with a name
+  append_record(msg, "\xc0\x0c", 15, std::string("\0\x0a\4mail\xc0\x0c", 9));
+  append_record(msg, "\xc0\x0c", (uint16_t) Record_type::ALIAS, "\3web\xc0\x10");
+  const ip4::Addr addr {10,0,0,1};
+  append_record(msg, "\3web\xc0\x10", (uint16_t) Record_type::A,
+                std::string((const char*) &addr, sizeof(addr)));
+
+  Response res;
+  EXPECT(res.parse(msg.data(), msg.size()) == (int) msg.size());
+  EXPECT(res.answers.size() == 3u);
+  EXPECT(res.answers.at(0).rdata.size() == 9u);
+  EXPECT(res.answers.at(1).rdata == "web.example.com");
+  EXPECT(res.answers.at(2).name == "web.example.com");
+  EXPECT(res.get_first_ipv4() == addr);
+
+  // a label longer than 63 bytes makes the name invalid
+  std::string bad = make_response(1);
+  append_record(bad, std::string(1, '\x50') + std::string(0x50, 'a'),
+                (uint16_t) Record_type::A, std::string((const char*) &addr, sizeof(addr)));
+  Response none;
+  none.parse(bad.data(), bad.size());
+  EXPECT(none.answers.empty());
+
+  // record data that runs past the message
+  std::string cut = make_response(1);
+  append_record(cut, "\xc0\x0c", (uint16_t) Record_type::A, "\x0a\x00");
+  cut[cut.size() - 3] = 4;
+  Response trunc;
+  trunc.parse(cut.data(), cut.size());
+  EXPECT(trunc.answers.empty());
+}
@@ -0,0 +1,183 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2015-2018 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/dns/responder.hpp>
+#include <net/dns/response.hpp>
+#include <net/dns/server.hpp>
+#include <chrono>
+
+using namespace net;
+using namespace net::dns;
+
+static std::vector<uint8_t> make_query(uint16_t id, const std::string& name, uint16_t qtype)
+{
+  std::vector<uint8_t> msg(sizeof(Header), 0);
+  auto& hdr = *(Header*) msg.data();
+  hdr.id = htons(id);
+  hdr.rd = 1;
+  hdr.q_count = htons(1);
+  const auto qname = wire::encode_name(name);
+  msg.insert(msg.end(), qname.begin(), qname.end());
+  msg.resize(msg.size() + sizeof(Question));
+  wire::write16(&msg[msg.size() - 4], qtype);
+  wire::write16(&msg[msg.size() - 2], DNS_CLASS_INET);
+  return msg;
+}
+
+static Responder make_responder()
+{
+  Responder responder;
+  responder.add_zone("example.com", {"ns1.example.com", "hostmaster.example.com",
+                                     2024, 7200, 900, 1209600, 60, 3600});
+  responder.add("example.com", ip4::Addr{10,0,0,1}, 300);
+  responder.add("www.example.com", ip4::Addr{10,0,0,2}, 300);
+  responder.add("www.example.com", ip4::Addr{10,0,0,3}, 300);
+  responder.add("v6.example.com", ip6::Addr{0xfe80, 0, 0, 0, 0, 0, 0, 1}, 300);
+  responder.add_cname("alias.example.com", "www.example.com", 600);
+  return responder;
+}
+
+CASE("Responder answers A and AAAA queries from precompiled answers")
+{
+  auto responder = make_responder();
+  std::array<uint8_t, Responder::MAX_UDP_SIZE> out;
+  size_t len = 0;
+
+  auto query = make_query(0x1234, "WWW.Example.com", DNS_TYPE_A);
+  EXPECT(responder.answer(query.data(), query.size(), out.data(), len) == Responder::Result::ANSWERED);
+
+  const auto& hdr = *(const Header*) out.data();
+  EXPECT(ntohs(hdr.id) == 0x1234);
+  EXPECT(hdr.qr == DNS_QR_RESPONSE);
+  EXPECT(hdr.aa == 1);
+  EXPECT(hdr.rd == 1);
+  EXPECT(ntohs(hdr.ans_count) == 2);
+
+  Response res{(const char*) out.data(), len};
+  EXPECT(res.answers.size() == 2u);
+  EXPECT(res.answers.at(0).get_ipv4() == ip4::Addr(10,0,0,2));
+  EXPECT(res.answers.at(1).get_ipv4() == ip4::Addr(10,0,0,3));
+  EXPECT(res.answers.at(0).ttl == 300u);
+  // a truncated record is not kept
+  Response cut{(const char*) out.data(), len - 2};
+  EXPECT(cut.answers.size() == 1u);
+  EXPECT(cut.answers.at(0).get_ipv4() == ip4::Addr(10,0,0,2));
+
+  query = make_query(1, "v6.example.com", DNS_TYPE_AAAA);
+  EXPECT(responder.answer(query.data(), query.size(), out.data(), len) == Responder::Result::ANSWERED);
+  Response res6{(const char*) out.data(), len};
+  EXPECT(res6.get_first_ipv6() == ip6::Addr(0xfe80, 0, 0, 0, 0, 0, 0, 1));
+
+  // apex and CNAME
+  query = make_query(2, "example.com", DNS_TYPE_A);
+  responder.answer(query.data(), query.size(), out.data(), len);
+  EXPECT(ntohs(((const Header*) out.data())->ans_count) == 1);
+  query = make_query(3, "alias.example.com", DNS_TYPE_A);
+  responder.answer(query.data(), query.size(), out.data(), len);
+  EXPECT(ntohs(((const Header*) out.data())->ans_count) == 1);
+  EXPECT(wire::read16(out.data() + query.size() + 2) == DNS_TYPE_ALIAS);
+}
+
+CASE("Responder gives negative answers with the zone SOA")
+{
+  auto responder = make_responder();
+  std::array<uint8_t, Responder::MAX_UDP_SIZE> out;
+  size_t len = 0;
+
+  auto query = make_query(7, "nope.example.com", DNS_TYPE_A);
+  EXPECT(responder.answer(query.data(), query.size(), out.data(), len) == Responder::Result::ANSWERED);
+  const auto& hdr = *(const Header*) out.data();
+  EXPECT(hdr.rcode == static_cast<uint8_t>(Response_code::NAME_ERROR));
+  EXPECT(ntohs(hdr.ans_count) == 0);
+  EXPECT(ntohs(hdr.auth_count) == 1);
+  // cacheable for min(SOA ttl, minimum)
+  EXPECT(Server::cacheable_ttl(out.data(), len) == 60);
+
+  // the name exists, but has no records of this type
+  query = make_query(8, "www.example.com", DNS_TYPE_AAAA);
+  responder.answer(query.data(), query.size(), out.data(), len);
+  EXPECT(hdr.rcode == static_cast<uint8_t>(Response_code::NO_ERROR));
+  EXPECT(ntohs(hdr.auth_count) == 1);
+
+  EXPECT(responder.stats().nxdomain == 1u);
+  EXPECT(responder.stats().nodata == 1u);
+}
+
+CASE("Responder refuses names outside its zones and drops garbage")
+{
+  auto responder = make_responder();
+  std::array<uint8_t, Responder::MAX_UDP_SIZE> out;
+  size_t len = 0;
+
+  auto query = make_query(9, "includeos.org", DNS_TYPE_A);
+  EXPECT(responder.answer(query.data(), query.size(), out.data(), len) == Responder::Result::NOT_AUTHORITATIVE);
+  EXPECT(((const Header*) out.data())->rcode == static_cast<uint8_t>(Response_code::OP_REFUSED));
+
+  // a response is never answered
+  ((Header*) query.data())->qr = DNS_QR_RESPONSE;
+  EXPECT(responder.answer(query.data(), query.size(), out.data(), len) == Responder::Result::DROP);
+  EXPECT(responder.answer(query.data(), 4, out.data(), len) == Responder::Result::DROP);
+
+  // truncated question
+  query = make_query(10, "www.example.com", DNS_TYPE_A);
+  EXPECT(responder.answer(query.data(), query.size() - 3, out.data(), len) == Responder::Result::ANSWERED);
+  EXPECT(((const Header*) out.data())->rcode == static_cast<uint8_t>(Response_code::FORMAT_ERROR));
+
+  EXPECT_THROWS(responder.add("www.includeos.org", ip4::Addr{10,0,0,1}, 60));
+  EXPECT_THROWS(responder.add_zone("example.com", {"a", "b"}));
+}
+
+CASE("Cached answers have their TTLs aged")
+{
+  auto responder = make_responder();
+  std::array<uint8_t, Responder::MAX_UDP_SIZE> out;
+  size_t len = 0;
+  auto query = make_query(11, "www.example.com", DNS_TYPE_A);
+  responder.answer(query.data(), query.size(), out.data(), len);
+  EXPECT(Server::cacheable_ttl(out.data(), len) == 300);
+
+  Server::age_ttls(out.data(), len, 100);
+  Response res{(const char*) out.data(), len};
+  EXPECT(res.answers.at(0).ttl == 200u);
+  EXPECT(Server::cacheable_ttl(out.data(), len) == 200);
+}
+
+CASE("Responder benchmark")
+{
+  using namespace std::chrono;
+  auto responder = make_responder();
+  std::vector<std::vector<uint8_t>> queries {
+    make_query(1, "www.example.com", DNS_TYPE_A),
+    make_query(2, "v6.example.com", DNS_TYPE_AAAA),
+    make_query(3, "nope.example.com", DNS_TYPE_A),
+    make_query(4, "alias.example.com", DNS_TYPE_A),
+  };
+  std::array<uint8_t, Responder::MAX_UDP_SIZE> out;
+  size_t len = 0;
+  static const int ROUNDS = 250000;
+
+  const auto start = high_resolution_clock::now();
+  for (int i = 0; i < ROUNDS; i++)
+  {
+    const auto& q = queries[i % queries.size()];
+    responder.answer(q.data(), q.size(), out.data(), len);
+  }
+  const auto elapsed = duration_cast<duration<double>>(high_resolution_clock::now() - start);
+  printf("DNS responder: %.0f kqps\n", ROUNDS / elapsed.count() / 1000.0);
+  EXPECT(responder.stats().queries == (uint64_t) ROUNDS);
+}
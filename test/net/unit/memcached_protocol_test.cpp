@@ -0,0 +1,135 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/memcached/protocol.hpp>
+#include <string>
+
+using namespace net::memcached;
+
+static uint32_t test_time = 1700000000;
+
+struct Client {
+  Cache cache {4 * Store::page_size, 2};
+  Connection conn {cache};
+  bool open = true;
+
+  Client() { conn.set_clock([] { return test_time; }); }
+
+  std::string send(const std::string& data)
+  {
+    std::string out;
+    open = conn.feed(data.data(), data.size(), out);
+    return out;
+  }
+};
+
+CASE("Storage and retrieval commands")
+{
+  Client c;
+  EXPECT(c.send("get foo\r\n") == "END\r\n");
+  EXPECT(c.send("set foo 5 0 3\r\nbar\r\n") == "STORED\r\n");
+  EXPECT(c.send("get foo\r\n") == "VALUE foo 5 3\r\nbar\r\nEND\r\n");
+  EXPECT(c.send("add foo 0 0 1\r\nx\r\n") == "NOT_STORED\r\n");
+  EXPECT(c.send("append foo 0 0 1\r\n!\r\n") == "STORED\r\n");
+  EXPECT(c.send("prepend foo 0 0 1\r\n>\r\n") == "STORED\r\n");
+  EXPECT(c.send("set baz 0 0 0\r\n\r\n") == "STORED\r\n");
+  EXPECT(c.send("get foo missing baz\r\n")
+         == "VALUE foo 5 5\r\n>bar!\r\nVALUE baz 0 0\r\n\r\nEND\r\n");
+
+  // cas with the unique value from gets
+  const auto reply = c.send("gets foo\r\n");
+  const auto start = reply.find(' ', std::string("VALUE foo 5 5").size());
+  const auto cas = reply.substr(start + 1, reply.find('\r') - start - 1);
+  EXPECT(c.send("cas foo 0 0 1 " + cas + "0\r\nx\r\n") == "EXISTS\r\n");
+  EXPECT(c.send("cas foo 0 0 1 " + cas + "\r\ny\r\n") == "STORED\r\n");
+  EXPECT(c.send("cas nope 0 0 1 1\r\ny\r\n") == "NOT_FOUND\r\n");
+
+  EXPECT(c.send("delete foo\r\n") == "DELETED\r\n");
+  EXPECT(c.send("delete foo\r\n") == "NOT_FOUND\r\n");
+  EXPECT(c.send("set n 0 0 2\r\n10\r\nincr n 5\r\ndecr n 20\r\n") == "STORED\r\n15\r\n0\r\n");
+  EXPECT(c.send("incr baz x\r\n") == "CLIENT_ERROR invalid numeric delta argument\r\n");
+  EXPECT(c.send("incr nothing 1\r\n") == "NOT_FOUND\r\n");
+  EXPECT(c.send("set s 0 0 1\r\na\r\nincr s 1\r\n")
+         == "STORED\r\nCLIENT_ERROR cannot increment or decrement non-numeric value\r\n");
+  EXPECT(c.open);
+}
+
+CASE("Commands split over several reads")
+{
+  Client c;
+  const std::string cmds = "set key 1 0 11\r\nhello world\r\nget key\r\n";
+  std::string out;
+  for (char ch : cmds) out += c.send(std::string(1, ch));
+  EXPECT(out == "STORED\r\nVALUE key 1 11\r\nhello world\r\nEND\r\n");
+}
+
+CASE("Expiry, touch and flush_all")
+{
+  Client c;
+  c.send("set a 0 10 1\r\n1\r\n");
+  c.send("set b 0 0 1\r\n2\r\n");
+  test_time += 5;
+  EXPECT(c.send("touch a 100\r\n") == "TOUCHED\r\n");
+  test_time += 50;
+  EXPECT(c.send("get a\r\n") == "VALUE a 0 1\r\n1\r\nEND\r\n");
+  EXPECT(c.send("gat 1 a\r\n") == "VALUE a 0 1\r\n1\r\nEND\r\n");
+  test_time += 1;
+  EXPECT(c.send("get a\r\n") == "END\r\n");
+  EXPECT(c.send("touch a 10\r\n") == "NOT_FOUND\r\n");
+  // negative exptime expires right away
+  EXPECT(c.send("set c 0 -1 1\r\n3\r\nget c\r\n") == "STORED\r\nEND\r\n");
+
+  EXPECT(c.send("flush_all\r\n") == "OK\r\n");
+  test_time += 1;
+  EXPECT(c.send("get b\r\n") == "END\r\n");
+  EXPECT(c.send("set b 0 0 1\r\n4\r\nget b\r\n") == "STORED\r\nVALUE b 0 1\r\n4\r\nEND\r\n");
+}
+
+CASE("noreply and errors")
+{
+  Client c;
+  EXPECT(c.send("set q 0 0 1 noreply\r\nx\r\n") == "");
+  EXPECT(c.send("delete q noreply\r\nget q\r\n") == "END\r\n");
+  EXPECT(c.send("bogus\r\n") == "ERROR\r\n");
+  EXPECT(c.send("get\r\n") == "ERROR\r\n");
+  EXPECT(c.send("set k 0 0 x\r\n") == "CLIENT_ERROR bad command line format\r\n");
+  EXPECT(c.send("set k 0 0 1\r\nxyz\r\n").find("CLIENT_ERROR bad data chunk") == 0);
+  EXPECT(c.send("verbosity 1\r\n") == "OK\r\n");
+  EXPECT(c.send("version\r\n").find("VERSION ") == 0);
+
+  // a value too large for the cache is skipped, the next command works
+  const std::string huge(2 * Store::page_size, 'h');
+  EXPECT(c.send("set big 0 0 " + std::to_string(huge.size()) + "\r\n")
+         == "SERVER_ERROR object too large for cache\r\n");
+  EXPECT(c.send(huge + "\r\nget big\r\n") == "END\r\n");
+
+  const auto stats = c.send("stats\r\n");
+  EXPECT(stats.find("STAT threads 2\r\n") != std::string::npos);
+  EXPECT(stats.find("STAT limit_maxbytes 4194304\r\n") != std::string::npos);
+  EXPECT(stats.substr(stats.size() - 5) == "END\r\n");
+  EXPECT(c.open);
+
+  EXPECT(c.send("quit\r\nget q\r\n") == "");
+  EXPECT(not c.open);
+}
+
+CASE("Overlong lines close the connection")
+{
+  Client c;
+  EXPECT(c.send(std::string(Connection::max_line + 1, 'a')).find("CLIENT_ERROR") == 0);
+  EXPECT(not c.open);
+}
@@ -0,0 +1,217 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/memcached/store.hpp>
+#include <functional>
+#include <string>
+
+using namespace net::memcached;
+
+static const uint32_t NOW = 1700000000;
+
+struct Test_store {
+  os::mem::Pmr_pool pool;
+  Store store;
+
+  explicit Test_store(size_t pages)
+    : pool{pages * Store::page_size, pages * Store::page_size},
+      store{pool.get_resource()} {}
+
+  static size_t hash(std::string_view key)
+  { return std::hash<std::string_view>{}(key); }
+
+  Result set(std::string_view key, std::string_view value,
+             uint32_t exptime = 0, uint32_t now = NOW)
+  { return store.store(Mode::SET, key, hash(key), 0, exptime, value, now); }
+
+  Result put(Mode mode, std::string_view key, std::string_view value, uint64_t cas = 0)
+  { return store.store(mode, key, hash(key), 0, 0, value, NOW, cas); }
+
+  const Store::Item* get(std::string_view key, uint32_t now = NOW)
+  { return store.get(key, hash(key), now); }
+
+  std::string value(std::string_view key, uint32_t now = NOW)
+  {
+    auto* item = get(key, now);
+    return item ? std::string(item->value()) : std::string("<none>");
+  }
+};
+
+CASE("Storage commands follow memcached semantics")
+{
+  Test_store t {1};
+  EXPECT(t.get("foo") == nullptr);
+  EXPECT(t.put(Mode::REPLACE, "foo", "x") == Result::NOT_STORED);
+  EXPECT(t.put(Mode::APPEND, "foo", "x") == Result::NOT_STORED);
+  EXPECT(t.put(Mode::ADD, "foo", "bar") == Result::STORED);
+  EXPECT(t.put(Mode::ADD, "foo", "baz") == Result::NOT_STORED);
+  EXPECT(t.value("foo") == "bar");
+
+  EXPECT(t.put(Mode::APPEND, "foo", "!") == Result::STORED);
+  EXPECT(t.put(Mode::PREPEND, "foo", ">") == Result::STORED);
+  EXPECT(t.value("foo") == ">bar!");
+  EXPECT(t.put(Mode::REPLACE, "foo", "new") == Result::STORED);
+  EXPECT(t.value("foo") == "new");
+
+  // cas only succeeds with the current unique value
+  const uint64_t cas = t.get("foo")->cas;
+  EXPECT(t.put(Mode::CAS, "foo", "stale", cas + 1) == Result::EXISTS);
+  EXPECT(t.put(Mode::CAS, "foo", "fresh", cas) == Result::STORED);
+  EXPECT(t.get("foo")->cas != cas);
+  EXPECT(t.put(Mode::CAS, "missing", "x", 1) == Result::NOT_FOUND);
+
+  EXPECT(t.store.remove("foo", t.hash("foo"), NOW) == Result::DELETED);
+  EXPECT(t.store.remove("foo", t.hash("foo"), NOW) == Result::NOT_FOUND);
+  EXPECT(t.store.stats().items == 0u);
+
+  // too long keys and values are refused
+  const std::string long_key(Store::max_key + 1, 'k');
+  EXPECT(t.set(long_key, "x") != Result::STORED);
+  const std::string huge(Store::page_size, 'v');
+  EXPECT(t.set("huge", huge) == Result::TOO_LARGE);
+}
+
+CASE("Items expire, relative or absolute")
+{
+  Test_store t {1};
+  EXPECT(Store::expiry(0, NOW) == 0u);
+  EXPECT(Store::expiry(10, NOW) == NOW + 10);
+  EXPECT(Store::expiry(NOW + 5, NOW) == NOW + 5);
+  EXPECT(Store::expiry(-1, NOW) < NOW);
+
+  t.set("short", "1", Store::expiry(10, NOW));
+  t.set("never", "2");
+  EXPECT(t.value("short", NOW + 9) == "1");
+  EXPECT(t.get("short", NOW + 10) == nullptr);
+  EXPECT(t.value("never", NOW + 1000000) == "2");
+
+  // touch moves the expiry time
+  t.set("touched", "3", Store::expiry(10, NOW));
+  EXPECT(t.store.touch("touched", t.hash("touched"), NOW + 100, NOW) == Result::TOUCHED);
+  EXPECT(t.value("touched", NOW + 50) == "3");
+
+  // flush_all invalidates what was stored up until then
+  t.store.flush_all(NOW + 1, NOW + 1);
+  EXPECT(t.get("never", NOW + 1) == nullptr);
+  t.set("after", "4", 0, NOW + 2);
+  EXPECT(t.value("after", NOW + 2) == "4");
+}
+
+CASE("incr and decr work on decimal values")
+{
+  Test_store t {1};
+  uint64_t value = 0;
+  auto arith = [&t, &value] (std::string_view key, bool incr, uint64_t delta) {
+    return t.store.arith(key, t.hash(key), incr, delta, value, NOW);
+  };
+  EXPECT(arith("n", true, 1) == Result::NOT_FOUND);
+  t.set("n", "41");
+  EXPECT(arith("n", true, 1) == Result::STORED);
+  EXPECT(value == 42u);
+  EXPECT(t.value("n") == "42");
+  // decr stops at zero
+  EXPECT(arith("n", false, 100) == Result::STORED);
+  EXPECT(value == 0u);
+  // incr wraps at 64 bits
+  t.set("n", "18446744073709551615");
+  EXPECT(arith("n", true, 2) == Result::STORED);
+  EXPECT(value == 1u);
+  t.set("s", "abc");
+  EXPECT(arith("s", true, 1) == Result::NON_NUMERIC);
+  // a longer result is stored in a larger item
+  t.set("n", "9");
+  EXPECT(arith("n", true, 1) == Result::STORED);
+  EXPECT(t.value("n") == "10");
+}
+
+CASE("A full store evicts the coldest items first")
+{
+  Test_store t {2};
+  const std::string value(200, 'v');
+  t.set("hot", value);
+  int i = 0;
+  while (t.store.stats().evictions < 1000)
+  {
+    t.set("key" + std::to_string(i++), value);
+    // used now and then, so it is kept in WARM
+    if (i % 100 == 0) EXPECT(t.get("hot") != nullptr);
+  }
+  EXPECT(t.store.stats().pages == 2u);
+  EXPECT(t.get("hot") != nullptr);
+  EXPECT(t.get("key0") == nullptr);
+  EXPECT(t.get("key" + std::to_string(i - 1)) != nullptr);
+
+  // the segments keep their share of the class
+  const int cls = t.get("hot")->cls;
+  const size_t items = t.store.segment_size(cls, Store::HOT)
+                     + t.store.segment_size(cls, Store::WARM)
+                     + t.store.segment_size(cls, Store::COLD);
+  EXPECT(items == t.store.stats().items);
+  EXPECT(t.store.segment_size(cls, Store::COLD) > items / 2);
+  EXPECT(t.store.segment_size(cls, Store::WARM) >= 1u);
+}
+
+CASE("Pages move to slab classes that have none")
+{
+  Test_store t {3};
+  const std::string small(100, 's');
+  for (int i = 0; t.store.stats().pages < 3 or i < 40000; i++)
+    t.set("small" + std::to_string(i), small);
+  EXPECT(t.store.stats().reassigned == 0u);
+
+  // no memory left, but a large item still finds a page
+  const std::string large(100 * 1024, 'L');
+  EXPECT(t.set("large", large) == Result::STORED);
+  EXPECT(t.value("large") == large);
+  EXPECT(t.store.stats().reassigned == 1u);
+  EXPECT(t.store.stats().pages == 3u);
+  EXPECT(t.store.pages(t.get("large")->cls) == 1u);
+
+  // the remaining small items are intact
+  size_t found = 0, intact = 0;
+  t.store.for_each([&] (const Store::Item& item) {
+    if (item.key().substr(0, 5) != "small") return;
+    found++;
+    if (item.value() == small) intact++;
+  }, NOW);
+  EXPECT(found + 1 == t.store.stats().items);
+  EXPECT(intact == found);
+}
+
+CASE("Restored items keep their cas and segment")
+{
+  Test_store from {1}, to {1};
+  from.set("a", "1");
+  from.set("b", "2");
+  from.set("c", "3");
+  from.store.for_each([&to] (const Store::Item& item) {
+    to.store.restore(item.key(), Test_store::hash(item.key()), item.flags,
+                     item.exptime, item.time, item.cas, item.segment,
+                     item.value(), NOW);
+  }, NOW);
+  for (auto key : {"a", "b", "c"})
+  {
+    auto* before = from.get(key);
+    auto* after  = to.get(key);
+    EXPECT(after != nullptr);
+    EXPECT(after->value() == before->value());
+    EXPECT(after->cas == before->cas);
+  }
+  // new items get a unique cas after the restored ones
+  to.set("d", "4");
+  EXPECT(to.get("d")->cas > to.get("c")->cas);
+}
@@ -0,0 +1,151 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <common.cxx>
+#include <net/tls/session_cache.hpp>
+#include <net/tls/ticket_keys.hpp>
+#include <string>
+
+#include <delegate>
+extern delegate<uint64_t()> systime_override;
+
+using namespace net::tls;
+
+static uint64_t my_time = 0;
+static uint64_t get_time() { return my_time; }
+
+CASE("Sessions can be inserted, looked up and erased")
+{
+  systime_override = get_time;
+  my_time = 1000;
+
+  Session_cache cache{64, std::chrono::seconds(60)};
+  const std::string data = "serialized session";
+  cache.insert("session-1", data.data(), data.size());
+
+  std::vector<uint8_t> out;
+  EXPECT(cache.lookup("session-1", out));
+  EXPECT(std::string(out.begin(), out.end()) == data);
+  EXPECT(not cache.lookup("session-2", out));
+
+  // replacing keeps a single entry
+  cache.insert("session-1", "new", 3);
+  EXPECT(cache.lookup("session-1", out));
+  EXPECT(out.size() == 3u);
+  EXPECT(cache.stats().entries == 1u);
+
+  EXPECT(cache.erase("session-1"));
+  EXPECT(not cache.erase("session-1"));
+  EXPECT(cache.stats().hits == 2u);
+  EXPECT(cache.stats().misses == 1u);
+}
+
+CASE("Sessions expire after their lifetime")
+{
+  systime_override = get_time;
+  my_time = 1000;
+
+  Session_cache cache{64, std::chrono::seconds(60)};
+  cache.insert("session", "x", 1);
+  std::vector<uint8_t> out;
+  my_time += 59;
+  EXPECT(cache.lookup("session", out));
+  my_time += 1;
+  EXPECT(not cache.lookup("session", out));
+  EXPECT(cache.stats().expired == 1u);
+  EXPECT(cache.stats().entries == 0u);
+}
+
+CASE("The least recently used session is evicted when full")
+{
+  systime_override = get_time;
+  my_time = 1000;
+
+  Session_cache cache{Session_cache::SHARDS, std::chrono::seconds(60)};
+  const size_t capacity = cache.capacity();
+  for (size_t i = 0; i < capacity * 4; i++) {
+    const auto id = std::to_string(i);
+    cache.insert(id, id.data(), id.size());
+  }
+  const auto stats = cache.stats();
+  EXPECT(stats.entries <= capacity);
+  EXPECT(stats.evictions == stats.inserts - stats.entries);
+  // the last inserted session is always present
+  std::vector<uint8_t> out;
+  EXPECT(cache.lookup(std::to_string(capacity * 4 - 1), out));
+  EXPECT(cache.clear() == stats.entries);
+}
+
+CASE("Ticket keys rotate and keep the previous key for decryption")
+{
+  systime_override = get_time;
+  my_time = 1000;
+
+  Ticket_keys keys{std::chrono::seconds(100)};
+  const auto first = keys.current();
+  EXPECT(first.created == 1000u);
+  EXPECT(keys.current().name == first.name);
+
+  bool is_current = false;
+  EXPECT(keys.find(first.name.data(), is_current).has_value());
+  EXPECT(is_current);
+
+  my_time += 100;
+  const auto second = keys.current();
+  EXPECT(second.name != first.name);
+
+  // the previous key still decrypts, but tickets should be renewed
+  auto found = keys.find(first.name.data(), is_current);
+  EXPECT(found.has_value());
+  EXPECT(not is_current);
+  EXPECT(found->aes_key == first.aes_key);
+
+  // until it is two intervals old
+  my_time += 100;
+  EXPECT(not keys.find(first.name.data(), is_current).has_value());
+
+  std::array<uint8_t, Ticket_key::NAME_LEN> unknown {};
+  EXPECT(not keys.find(unknown.data(), is_current).has_value());
+}
+
+CASE("An expired current key is rotated when looked up")
+{
+  systime_override = get_time;
+  my_time = 1000;
+
+  Ticket_keys keys{std::chrono::seconds(100)};
+  const auto first = keys.current();
+
+  // no new tickets are issued in between, so current() is not called
+  my_time += 150;
+  bool is_current = true;
+  auto found = keys.find(first.name.data(), is_current);
+  EXPECT(found.has_value());
+  EXPECT(not is_current);
+  EXPECT(keys.current().name != first.name);
+
+  // and it is rejected two intervals after it was created
+  my_time = 1000 + 200;
+  EXPECT(not keys.find(first.name.data(), is_current).has_value());
+
+  // even when the keys are not used for a long time
+  Ticket_keys idle{std::chrono::seconds(100)};
+  const auto key = idle.current();
+  my_time += 1000;
+  EXPECT(not idle.find(key.name.data(), is_current).has_value());
+}
@@ -0,0 +1,303 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/openssl/tls_stream.hpp>
+#include <openssl/x509.h>
+#include <kernel/timers.hpp>
+#include <deque>
+#include <string>
+
+#include <delegate>
+extern delegate<uint64_t()> systime_override;
+
+static uint64_t current_time = 0;
+
+// One end of an in-memory connection. What is written stays in the
+// outbox until pump() hands it to the peer, in pieces of any size.
+struct Loopback : public net::Stream
+{
+  Loopback* peer = nullptr;
+  std::deque<buffer_t> outbox;
+  std::deque<buffer_t> inbox;
+  int  writes = 0;
+  bool writable = true;
+  bool closed = false;
+  bool peer_told = false;
+
+  void write(buffer_t buffer) override {
+    writes++;
+    outbox.push_back(std::move(buffer));
+  }
+  void write(const std::string& str) override {
+    write(construct_buffer(str.begin(), str.end()));
+  }
+  void write(const void* data, size_t len) override {
+    auto* buf = (const uint8_t*) data;
+    write(construct_buffer(buf, buf + len));
+  }
+  void close() override { closed = true; }
+
+  void on_connect(ConnectCallback) override {}
+  void on_read(size_t, ReadCallback) override {}
+  void on_data(DataCallback cb) override { m_on_data = std::move(cb); }
+  void on_close(CloseCallback cb) override { m_on_close = std::move(cb); }
+  void on_write(WriteCallback) override {}
+  void reset_callbacks() override {
+    m_on_data = nullptr;
+    m_on_close = nullptr;
+  }
+
+  size_t next_size() override {
+    return inbox.empty() ? 0 : inbox.front()->size();
+  }
+  buffer_t read_next() override {
+    if (inbox.empty()) return nullptr;
+    auto buffer = std::move(inbox.front());
+    inbox.pop_front();
+    return buffer;
+  }
+
+  net::Socket local() const override { return {}; }
+  net::Socket remote() const override { return {}; }
+  std::string to_string() const override { return "loopback"; }
+  bool is_connected() const noexcept override { return not closed; }
+  bool is_writable() const noexcept override { return writable and not closed; }
+  bool is_readable() const noexcept override { return not closed; }
+  bool is_closing() const noexcept override { return closed; }
+  bool is_closed() const noexcept override { return closed; }
+  int get_cpuid() const noexcept override { return 0; }
+  Stream* transport() noexcept override { return nullptr; }
+
+  // deliver everything written so far to the peer, chunk bytes at a time
+  void pump(size_t chunk = SIZE_MAX)
+  {
+    while (not outbox.empty()) {
+      auto buffer = std::move(outbox.front());
+      outbox.pop_front();
+      for (size_t off = 0; off < buffer->size(); off += chunk) {
+        const size_t len = std::min(chunk, buffer->size() - off);
+        auto* data = buffer->data() + off;
+        peer->inbox.push_back(construct_buffer(data, data + len));
+        if (peer->m_on_data) peer->m_on_data();
+      }
+    }
+    if (closed and not peer_told) {
+      peer_told = true;
+      peer->closed = true;
+      if (peer->m_on_close) peer->m_on_close();
+    }
+  }
+
+private:
+  DataCallback  m_on_data  = nullptr;
+  CloseCallback m_on_close = nullptr;
+};
+
+static EVP_PKEY* make_key()
+{
+  EVP_PKEY* pkey = nullptr;
+  auto* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+  EVP_PKEY_keygen_init(ctx);
+  EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1);
+  EVP_PKEY_keygen(ctx, &pkey);
+  EVP_PKEY_CTX_free(ctx);
+  return pkey;
+}
+
+// a server context with a fresh self-signed certificate
+static SSL_CTX* make_server_ctx()
+{
+  auto* pkey = make_key();
+  auto* cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, pkey);
+  auto* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*) "loopback", -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  X509_sign(cert, pkey, EVP_sha256());
+
+  auto* ctx = SSL_CTX_new(TLS_server_method());
+  SSL_CTX_use_certificate(ctx, cert);
+  SSL_CTX_use_PrivateKey(ctx, pkey);
+  X509_free(cert);
+  EVP_PKEY_free(pkey);
+  return ctx;
+}
+
+struct Connection
+{
+  SSL_CTX* server_ctx = make_server_ctx();
+  SSL_CTX* client_ctx = SSL_CTX_new(TLS_client_method());
+  Loopback* client_transport = new Loopback;
+  Loopback* server_transport = new Loopback;
+  std::unique_ptr<openssl::TLS_stream> client;
+  std::unique_ptr<openssl::TLS_stream> server;
+  std::string received;
+  bool client_connected = false;
+  bool server_connected = false;
+
+  Connection()
+  {
+    client_transport->peer = server_transport;
+    server_transport->peer = client_transport;
+    server = std::make_unique<openssl::TLS_stream>(
+        server_ctx, net::Stream_ptr(server_transport), false);
+    client = std::make_unique<openssl::TLS_stream>(
+        client_ctx, net::Stream_ptr(client_transport), true);
+    server->on_connect([this] (net::Stream&) { server_connected = true; });
+    client->on_connect([this] (net::Stream&) { client_connected = true; });
+    server->on_read(0, [this] (net::Stream::buffer_t buffer) {
+      received.append((const char*) buffer->data(), buffer->size());
+    });
+    pump();
+  }
+  ~Connection()
+  {
+    client = nullptr;
+    server = nullptr;
+    SSL_CTX_free(client_ctx);
+    SSL_CTX_free(server_ctx);
+  }
+  // run both directions until nothing moves
+  void pump(size_t chunk = SIZE_MAX)
+  {
+    while (not client_transport->outbox.empty() or not server_transport->outbox.empty()) {
+      client_transport->pump(chunk);
+      server_transport->pump(chunk);
+    }
+  }
+};
+
+static std::string pattern(size_t len)
+{
+  std::string data(len, '\0');
+  for (size_t i = 0; i < len; i++) data[i] = 'a' + (i * 7) % 26;
+  return data;
+}
+
+static void init_timers()
+{
+  systime_override = [] () -> uint64_t { return current_time; };
+  if (not Timers::is_ready()) {
+    Timers::init([] (Timers::duration_t) {}, [] () {});
+    Timers::ready();
+  }
+}
+
+CASE("TLS_stream handshakes over a loopback transport")
+{
+  init_timers();
+  Connection conn;
+  EXPECT(conn.client_connected);
+  EXPECT(conn.server_connected);
+  EXPECT(conn.client->is_connected());
+  EXPECT(conn.server->is_connected());
+}
+
+CASE("TLS_stream writes larger than a record arrive whole, in pieces")
+{
+  init_timers();
+  Connection conn;
+  const std::string data = pattern(3 * openssl::TLS_stream::RECORD_SIZE + 1000);
+
+  const int writes = conn.client_transport->writes;
+  conn.client->write(data);
+  // every record of the write goes to the transport in one buffer
+  EXPECT(conn.client_transport->writes == writes + 1);
+
+  // the records reach the server a few bytes at a time
+  conn.pump(777);
+  EXPECT(conn.received.size() == data.size());
+  EXPECT(conn.received == data);
+
+  // records are kept while the transport can't take them
+  conn.client_transport->writable = false;
+  conn.client->write(std::string("held back"));
+  EXPECT(conn.client_transport->outbox.empty());
+  conn.client_transport->writable = true;
+  conn.client->write(std::string(" and sent"));
+  conn.pump();
+  EXPECT(conn.received == data + "held back and sent");
+}
+
+CASE("TLS_stream batches small writes into one flush")
+{
+  init_timers();
+  Connection conn;
+  conn.client->set_write_batching(std::chrono::milliseconds(5));
+
+  const int writes = conn.client_transport->writes;
+  std::string expected;
+  for (int i = 0; i < 10; i++) {
+    const std::string part = "message " + std::to_string(i) + "\n";
+    conn.client->write(part);
+    expected += part;
+  }
+  // nothing is sent until the batch is flushed
+  EXPECT(conn.client_transport->writes == writes);
+  conn.client->flush();
+  EXPECT(conn.client_transport->writes == writes + 1);
+  conn.pump();
+  EXPECT(conn.received == expected);
+
+  // the timer flushes when no one else does
+  conn.client->write(std::string("late"));
+  EXPECT(conn.client_transport->writes == writes + 1);
+  current_time += 10'000'000;
+  Timers::timers_handler();
+  EXPECT(conn.client_transport->writes == writes + 2);
+  conn.pump();
+  EXPECT(conn.received == expected + "late");
+
+  // a full record is sent right away
+  conn.client->write(pattern(openssl::TLS_stream::RECORD_SIZE - 1));
+  conn.client->write(std::string("xy"));
+  EXPECT(conn.client_transport->writes == writes + 3);
+  // and turning batching off sends what is left
+  conn.client->write(std::string("z"));
+  EXPECT(conn.client_transport->writes == writes + 3);
+  conn.client->set_write_batching(Timer::duration_t::zero());
+  EXPECT(conn.client_transport->writes == writes + 4);
+  conn.pump();
+  EXPECT(conn.received.size() == expected.size() + 4 + openssl::TLS_stream::RECORD_SIZE + 2);
+}
+
+CASE("TLS_stream sends batched data when closed")
+{
+  init_timers();
+  Connection conn;
+  bool client_closed = false;
+  bool server_closed = false;
+  conn.client->on_close([&] { client_closed = true; });
+  conn.server->on_close([&] { server_closed = true; });
+  conn.client->set_write_batching(std::chrono::milliseconds(5));
+
+  const std::string data = pattern(500);
+  conn.client->write(data);
+  EXPECT(conn.client_transport->outbox.empty());
+  conn.client->close();
+  EXPECT(client_closed);
+  EXPECT(conn.client_transport->closed);
+  // the data went out before the transport was closed
+  EXPECT(not conn.client_transport->outbox.empty());
+
+  conn.pump();
+  EXPECT(conn.received == data);
+  EXPECT(server_closed);
+}
@@ -0,0 +1,144 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2016-2017 Oslo and Akershus University College of Applied Sciences
+// and Alfred Bratterud
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <net/ws/deflate.hpp>
+#include <string>
+
+using namespace net;
+
+CASE("Parsing permessage-deflate offers")
+{
+  auto opts = WS_deflate_options::parse("permessage-deflate; client_max_window_bits");
+  EXPECT(opts.has_value());
+  EXPECT(opts->client_max_window_bits_offered);
+  EXPECT(opts->client_max_window_bits == 15);
+  EXPECT(not opts->server_no_context_takeover);
+
+  opts = WS_deflate_options::parse(
+      "x-webkit-deflate-frame, permessage-deflate; server_no_context_takeover;"
+      " server_max_window_bits=10");
+  EXPECT(opts.has_value());
+  EXPECT(opts->server_no_context_takeover);
+  EXPECT(opts->server_max_window_bits == 10);
+  EXPECT(not opts->client_max_window_bits_offered);
+
+  // quoted values are allowed
+  opts = WS_deflate_options::parse("permessage-deflate; client_max_window_bits=\"12\"");
+  EXPECT(opts.has_value());
+  EXPECT(opts->client_max_window_bits == 12);
+}
+
+CASE("Invalid permessage-deflate offers are declined")
+{
+  EXPECT(not WS_deflate_options::parse(""));
+  EXPECT(not WS_deflate_options::parse("x-webkit-deflate-frame"));
+  EXPECT(not WS_deflate_options::parse("permessage-deflate; server_max_window_bits=16"));
+  EXPECT(not WS_deflate_options::parse("permessage-deflate; server_max_window_bits=7"));
+  EXPECT(not WS_deflate_options::parse("permessage-deflate; server_max_window_bits"));
+  EXPECT(not WS_deflate_options::parse("permessage-deflate; unknown_param"));
+  EXPECT(not WS_deflate_options::parse(
+      "permessage-deflate; server_no_context_takeover; server_no_context_takeover"));
+}
+
+CASE("Server accepts offer and client confirms response")
+{
+  auto server = WS_deflate_options::defaults();
+  server.client_max_window_bits = 12;
+
+  auto client = WS_deflate_options::defaults();
+  client.client_no_context_takeover = false;
+  client.server_no_context_takeover = false;
+  auto offer = WS_deflate_options::parse(client.offer_string());
+  EXPECT(offer.has_value());
+
+  auto accepted = server.accept(*offer);
+  EXPECT(accepted.enabled);
+  EXPECT(accepted.server_no_context_takeover);
+  EXPECT(accepted.client_max_window_bits == 12);
+
+  const auto response = accepted.response_string();
+  EXPECT(response == "permessage-deflate; server_no_context_takeover; client_no_context_takeover; client_max_window_bits=12");
+
+  auto parsed = WS_deflate_options::parse(response);
+  EXPECT(parsed.has_value());
+  auto confirmed = client.confirm(*parsed);
+  EXPECT(confirmed.has_value());
+  EXPECT(confirmed->client_max_window_bits == 12);
+
+  // a server may not ignore our server_no_context_takeover request
+  client.server_no_context_takeover = true;
+  EXPECT(not client.confirm(*WS_deflate_options::parse("permessage-deflate")));
+}
+
+CASE("Compressed messages round-trip with and without context takeover")
+{
+  const std::string text =
+    "{\"id\": 1234, \"name\": \"IncludeOS\", \"tags\": [\"unikernel\", \"c++\"]}"
+    "{\"id\": 1235, \"name\": \"IncludeOS\", \"tags\": [\"unikernel\", \"c++\"]}";
+
+  for (bool takeover : {true, false})
+  {
+    auto opts = WS_deflate_options::defaults();
+    opts.server_no_context_takeover = not takeover;
+    opts.client_no_context_takeover = not takeover;
+    WS_deflate server{opts, false};
+    WS_deflate client{opts, true};
+
+    for (int i = 0; i < 3; i++)
+    {
+      auto payload = server.compress(text.data(), text.size());
+      EXPECT(not payload.empty());
+      EXPECT(payload.size() < text.size());
+
+      std::vector<uint8_t> out;
+      EXPECT(client.decompress((const uint8_t*) payload.data(), payload.size(), out, 0));
+      EXPECT(std::string(out.begin(), out.end()) == text);
+    }
+  }
+  // only contexts held for takeover are in use, the rest were pooled
+  EXPECT(WS_deflate_pool::get().stats().in_use == 0u);
+  EXPECT(WS_deflate_pool::get().stats().idle > 0u);
+}
+
+CASE("Decompression respects the maximum message size")
+{
+  WS_deflate server{WS_deflate_options::defaults(), false};
+  WS_deflate client{WS_deflate_options::defaults(), true};
+  const std::string text(64 * 1024, 'a');
+
+  auto payload = server.compress(text.data(), text.size());
+  std::vector<uint8_t> out;
+  EXPECT(not client.decompress((const uint8_t*) payload.data(), payload.size(), out, 1024));
+  // a message of exactly the maximum size is accepted
+  EXPECT(client.decompress((const uint8_t*) payload.data(), payload.size(), out, text.size()));
+  EXPECT(out.size() == text.size());
+  EXPECT(not client.decompress((const uint8_t*) payload.data(), payload.size(), out, text.size() - 1));
+}
+
+CASE("Connections hold no zlib state between messages by default")
+{
+  const auto before = WS_deflate_pool::get().stats().in_use;
+  WS_deflate server{WS_deflate_options::defaults(), false};
+  WS_deflate client{WS_deflate_options::defaults(), true};
+  const std::string text(4096, 'a');
+
+  auto payload = server.compress(text.data(), text.size());
+  std::vector<uint8_t> out;
+  EXPECT(client.decompress((const uint8_t*) payload.data(), payload.size(), out, 0));
+  EXPECT(WS_deflate_pool::get().stats().in_use == before);
+}
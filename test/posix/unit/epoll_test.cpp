@@ -0,0 +1,172 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <posix/epoll_fd.hpp>
+#include <posix/fd_map.hpp>
+#include <kernel/events.hpp>
+
+class Ready_fd : public FD {
+public:
+  Ready_fd(const int id) : FD(id) {}
+
+  int close() override
+  { return 0; }
+
+  int poll_events() override
+  { return events; }
+
+  void set(int ev) {
+    events = ev;
+    notify_ready();
+  }
+
+  int events = 0;
+};
+
+using namespace std::chrono;
+
+static epoll_event interest(uint32_t events, int id)
+{
+  epoll_event ev {};
+  ev.events  = events;
+  ev.data.fd = id;
+  return ev;
+}
+
+CASE("epoll reports level-triggered descriptors until they are not ready")
+{
+  auto& ep = FD_map::_open<Epoll_FD>();
+  auto& fd = FD_map::_open<Ready_fd>();
+  auto ev = interest(EPOLLIN, fd.get_id());
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, fd.get_id(), &ev) == 0);
+  EXPECT(ep.watched() == 1u);
+
+  epoll_event out[4];
+  EXPECT(ep.wait(out, 4, 0ms) == 0);
+  EXPECT(ep.poll_events() == 0);
+
+  // writable is not interesting
+  fd.set(POLLOUT);
+  EXPECT(ep.wait(out, 4, 0ms) == 0);
+
+  fd.set(POLLIN | POLLOUT);
+  EXPECT(ep.poll_events() == POLLIN);
+  for (int i = 0; i < 3; i++) {
+    EXPECT(ep.wait(out, 4, 0ms) == 1);
+    EXPECT(out[0].events == (uint32_t) EPOLLIN);
+    EXPECT(out[0].data.fd == fd.get_id());
+  }
+  // level-triggered descriptors drop off when no longer ready
+  fd.events = 0;
+  EXPECT(ep.wait(out, 4, 0ms) == 0);
+
+  // errors are always reported
+  fd.set(POLLERR);
+  EXPECT(ep.wait(out, 4, 0ms) == 1);
+  EXPECT(out[0].events == (uint32_t) EPOLLERR);
+
+  FD_map::close(fd.get_id());
+  EXPECT(ep.watched() == 0u);
+  EXPECT(ep.wait(out, 4, 0ms) == 0);
+  FD_map::close(ep.get_id());
+}
+
+CASE("epoll edge-triggered and oneshot descriptors")
+{
+  auto& ep = FD_map::_open<Epoll_FD>();
+  auto& edge = FD_map::_open<Ready_fd>();
+  auto& once = FD_map::_open<Ready_fd>();
+  auto ev1 = interest(EPOLLIN | EPOLLET, edge.get_id());
+  auto ev2 = interest(EPOLLIN | EPOLLONESHOT, once.get_id());
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, edge.get_id(), &ev1) == 0);
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, once.get_id(), &ev2) == 0);
+
+  epoll_event out[4];
+  edge.set(POLLIN);
+  once.set(POLLIN);
+  EXPECT(ep.wait(out, 4, 0ms) == 2);
+  // both are still readable, but neither is reported again
+  EXPECT(ep.wait(out, 4, 0ms) == 0);
+
+  // a new edge is reported, the oneshot is disabled
+  edge.set(POLLIN);
+  once.set(POLLIN);
+  EXPECT(ep.wait(out, 4, 0ms) == 1);
+  EXPECT(out[0].data.fd == edge.get_id());
+
+  // until rearmed
+  EXPECT(ep.ctl(EPOLL_CTL_MOD, once.get_id(), &ev2) == 0);
+  EXPECT(ep.wait(out, 4, 0ms) == 1);
+  EXPECT(out[0].data.fd == once.get_id());
+
+  // maxevents limits the events returned
+  edge.set(POLLIN);
+  EXPECT(ep.ctl(EPOLL_CTL_MOD, once.get_id(), &ev2) == 0);
+  EXPECT(ep.wait(out, 1, 0ms) == 1);
+  EXPECT(ep.wait(out, 1, 0ms) == 1);
+  EXPECT(ep.wait(out, 1, 0ms) == 0);
+
+  FD_map::close(ep.get_id());
+  FD_map::close(edge.get_id());
+  FD_map::close(once.get_id());
+}
+
+CASE("epoll_ctl errors")
+{
+  auto& ep = FD_map::_open<Epoll_FD>();
+  auto& fd = FD_map::_open<Ready_fd>();
+  auto ev = interest(EPOLLIN, fd.get_id());
+  EXPECT(ep.ctl(EPOLL_CTL_MOD, fd.get_id(), &ev) == -ENOENT);
+  EXPECT(ep.ctl(EPOLL_CTL_DEL, fd.get_id(), nullptr) == -ENOENT);
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, 12345, &ev) == -EBADF);
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, ep.get_id(), &ev) == -EINVAL);
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, fd.get_id(), nullptr) == -EFAULT);
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, fd.get_id(), &ev) == 0);
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, fd.get_id(), &ev) == -EEXIST);
+  EXPECT(ep.ctl(EPOLL_CTL_DEL, fd.get_id(), nullptr) == 0);
+  EXPECT(ep.watched() == 0u);
+
+  // the descriptor no longer tells the closed epoll anything
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, fd.get_id(), &ev) == 0);
+  FD_map::close(ep.get_id());
+  fd.set(POLLIN);
+  FD_map::close(fd.get_id());
+}
+
+CASE("epoll_wait blocks until a descriptor becomes ready")
+{
+  auto& ep = FD_map::_open<Epoll_FD>();
+  auto& fd = FD_map::_open<Ready_fd>();
+  auto ev = interest(EPOLLIN, fd.get_id());
+  EXPECT(ep.ctl(EPOLL_CTL_ADD, fd.get_id(), &ev) == 0);
+
+  auto evt = Events::get().subscribe(
+    [&] () {
+      fd.set(POLLIN);
+    });
+  Events::get().trigger_event(evt);
+
+  const int seq = FD::ready_sequence();
+  epoll_event out[4];
+  EXPECT(ep.wait(out, 4, Epoll_FD::Timeout::max()) == 1);
+  EXPECT(out[0].data.fd == fd.get_id());
+  EXPECT(FD::ready_sequence() != seq);
+  Events::get().unsubscribe(evt);
+
+  FD_map::close(ep.get_id());
+  FD_map::close(fd.get_id());
+}
@@ -69,3 +69,43 @@ CASE("Adding a implemented FD descriptor in FD_map")
   const int bet = 322; // this used to be a throw
   EXPECT(FD_map::_get(bet) == nullptr);
 }
+
+CASE("FD_map hands out the lowest free descriptor")
+{
+  auto& a = FD_map::_open<Test_fd>();
+  auto& b = FD_map::_open<Test_fd>();
+  auto& c = FD_map::_open<Hest_fd>("neigh");
+  // the first descriptor closed by the previous test
+  EXPECT(a.get_id() == FD_map::first_id);
+  EXPECT(b.get_id() > a.get_id());
+  EXPECT(c.get_id() == b.get_id() + 1);
+
+  // a closed descriptor is reused first
+  const auto b_id = b.get_id();
+  FD_map::close(b_id);
+  EXPECT(FD_map::_get(b_id) == nullptr);
+  auto& d = FD_map::_open<Test_fd>();
+  EXPECT(d.get_id() == b_id);
+
+  // the table grows past the first words
+  std::vector<FD_map::id_t> ids;
+  for (int i = 0; i < 300; i++)
+    ids.push_back(FD_map::_open<Test_fd>().get_id());
+  for (size_t i = 1; i < ids.size(); i++)
+    EXPECT(ids[i] == ids[i-1] + 1);
+  EXPECT(FD_map::_get(ids.back())->read(nullptr, 0) == 1);
+
+  FD_map::close(ids[250]);
+  FD_map::close(ids[10]);
+  EXPECT(FD_map::_open<Test_fd>().get_id() == ids[10]);
+  EXPECT(FD_map::_open<Test_fd>().get_id() == ids[250]);
+  EXPECT(FD_map::_open<Test_fd>().get_id() == ids.back() + 1);
+
+  for (auto id : ids) FD_map::close(id);
+  FD_map::close(ids.back() + 1);
+  FD_map::close(a.get_id());
+  FD_map::close(c.get_id());
+  FD_map::close(d.get_id());
+  EXPECT(FD_map::_open<Test_fd>().get_id() == FD_map::first_id);
+  FD_map::close(FD_map::first_id);
+}
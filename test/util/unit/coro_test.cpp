@@ -0,0 +1,133 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <common.cxx>
+#include <util/coro.hpp>
+#include <deque>
+#include <stdexcept>
+
+namespace coro = os::coro;
+
+static coro::Task<int> add(int a, int b)
+{
+  co_return a + b;
+}
+
+static coro::Task<int> sum(int n)
+{
+  int total = 0;
+  for (int i = 0; i < n; i++)
+    total += co_await add(i, 1);
+  co_return total;
+}
+
+static coro::Task<> fail()
+{
+  throw std::runtime_error("fail");
+  co_return;
+}
+
+CASE("coro::Task chains results and exceptions through awaiting tasks")
+{
+  int result = -1;
+  bool caught = false;
+  // the lambda must outlive its coroutine, which refers to the captures
+  auto task = [&] () -> coro::Task<> {
+    result = co_await sum(100);
+    try {
+      co_await fail();
+    }
+    catch (const std::runtime_error&) {
+      caught = true;
+    }
+  };
+  coro::spawn(task());
+  // nothing waits, so it all ran right away
+  EXPECT(result == 5050);
+  EXPECT(caught);
+
+  // frames are recycled, a single chunk per size class is enough
+  auto st = coro::Frame_pool::stats(0);
+  EXPECT(st.allocs == st.frees);
+  EXPECT(st.allocs > 0u);
+  EXPECT(st.chunks <= 3u);
+  EXPECT(st.oversized == 0u);
+}
+
+CASE("coro::yield continues from the event loop")
+{
+  int steps = 0;
+  auto task = [&] () -> coro::Task<> {
+    steps++;
+    co_await coro::yield();
+    steps++;
+  };
+  coro::spawn(task());
+  EXPECT(steps == 1);
+  Events::get().process_events();
+  EXPECT(steps == 2);
+}
+
+// completes reads right away, or later from complete_all()
+struct Fake_disk : public hw::Block_device {
+  std::string device_name() const override { return "fake0"; }
+  const char* driver_name() const noexcept override { return "fake"; }
+  block_t size() const noexcept override { return 64; }
+  block_t block_size() const noexcept override { return 512; }
+  void deactivate() override {}
+
+  void read(block_t blk, size_t count, on_read_func reader) override {
+    if (sync) reader(read_sync(blk, count));
+    else pending.push_back({read_sync(blk, count), std::move(reader)});
+  }
+  buffer_t read_sync(block_t blk, size_t count) override {
+    if (blk + count > size()) return nullptr;
+    return std::make_shared<os::mem::buffer>(count * block_size(), (uint8_t) blk);
+  }
+  void complete_all() {
+    while (not pending.empty()) {
+      auto p = std::move(pending.front());
+      pending.pop_front();
+      p.second(std::move(p.first));
+    }
+  }
+
+  bool sync = true;
+  std::deque<std::pair<buffer_t, on_read_func>> pending;
+};
+
+CASE("coro::read awaits block device reads")
+{
+  Fake_disk disk;
+  std::vector<size_t> sizes;
+  auto reader = [&] () -> coro::Task<> {
+    for (int blk : {1, 2, 100}) {
+      auto buf = co_await coro::read(disk, blk, 2);
+      sizes.push_back(buf ? buf->size() : 0);
+    }
+  };
+
+  coro::spawn(reader());
+  EXPECT(sizes == (std::vector<size_t>{1024, 1024, 0}));
+
+  sizes.clear();
+  disk.sync = false;
+  coro::spawn(reader());
+  EXPECT(sizes.empty());
+  disk.complete_all();
+  EXPECT(sizes == (std::vector<size_t>{1024, 1024, 0}));
+}
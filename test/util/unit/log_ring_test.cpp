@@ -0,0 +1,122 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <util/log_ring.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Ring = Log_ring<256>;
+
+static std::vector<std::string> read_all(Ring& ring)
+{
+  std::vector<std::string> records;
+  ring.read([&records] (uint32_t tag, std::string_view text) {
+    records.emplace_back(std::to_string(tag) + ":" + std::string(text));
+  });
+  ring.release();
+  return records;
+}
+
+CASE("Log_ring hands out records in order, with their tags")
+{
+  static Ring ring;
+  EXPECT(ring.empty());
+  EXPECT(ring.write("hello", 1));
+  EXPECT(ring.write("", 2));
+  char* dst = ring.reserve(32);
+  EXPECT(dst != nullptr);
+  const int len = snprintf(dst, 32, "in place %d", 42);
+  ring.commit(len, 3);
+  EXPECT(not ring.empty());
+
+  const std::vector<std::string> expected {"1:hello", "2:", "3:in place 42"};
+  EXPECT(read_all(ring) == expected);
+  EXPECT(ring.empty());
+  EXPECT(ring.used() == 0u);
+}
+
+CASE("Log_ring drops new records when full, and keeps the room until released")
+{
+  static Ring ring;
+  const std::string record(Ring::max_record, 'x');
+  // each record takes a quarter of the ring with its header
+  int written = 0;
+  while (ring.write(record, 0)) written++;
+  EXPECT(written == 4);
+  EXPECT(not ring.write("y", 0));
+
+  // records that are read still take room, until released
+  size_t count = ring.read([] (uint32_t, std::string_view) {}, 2);
+  EXPECT(count == 2u);
+  EXPECT(not ring.write("y", 0));
+  ring.release();
+  EXPECT(ring.write("y", 0));
+  EXPECT(read_all(ring).size() == 3u);
+
+  // too long for any ring
+  EXPECT(ring.reserve(Ring::max_record + 1) == nullptr);
+}
+
+CASE("Log_ring records never wrap around the end")
+{
+  static Log_ring<1024> ring;
+  // leave less than a record at the end of the ring
+  for (int i = 0; i < 4; i++)
+    EXPECT(ring.write(std::string(200, 'a'), 1));
+  ring.read([] (uint32_t, std::string_view) {});
+  ring.release();
+  const std::string tail(240, 'b');
+  EXPECT(ring.write(tail, 2));
+  std::string_view found;
+  EXPECT(ring.read([&found] (uint32_t, std::string_view text) { found = text; }) == 1u);
+  EXPECT(found == tail);
+}
+
+CASE("Log_ring limits let records keep room for others")
+{
+  static Log_ring<1024> ring;
+  EXPECT(ring.write(std::string(100, 'a'), 0, 128));
+  EXPECT(not ring.write(std::string(100, 'a'), 0, 128));
+  EXPECT(ring.write(std::string(100, 'a'), 0));
+}
+
+CASE("Log_ring moves records from one thread to another")
+{
+  static Log_ring<1024> ring;
+  constexpr int records = 20000;
+  std::thread producer([] {
+    for (int i = 0; i < records; i++) {
+      const auto text = std::to_string(i);
+      while (not ring.write(text, i & 0xff))
+        std::this_thread::yield();
+    }
+  });
+
+  int next = 0;
+  bool ordered = true;
+  while (next < records) {
+    ring.read([&] (uint32_t tag, std::string_view text) {
+      ordered = ordered and text == std::to_string(next) and tag == uint32_t(next & 0xff);
+      next++;
+    });
+    ring.release();
+  }
+  producer.join();
+  EXPECT(ordered);
+  EXPECT(ring.empty());
+}
@@ -0,0 +1,156 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <util/alloc_buddy.hpp>
+#include <util/alloc_slab.hpp>
+#include <set>
+#include <vector>
+
+using namespace util::literals;
+namespace slab = os::mem::slab;
+
+struct Pool {
+  using Buddy = os::mem::buddy::Alloc<false>;
+
+  Pool(size_t s) {
+    auto sz  = Buddy::max_bufsize(s);
+    auto res = posix_memalign(&addr, Buddy::min_size, sz);
+    Expects(res == 0);
+    buddy = Buddy::create<Buddy::Policy::overbook>(addr, sz);
+  }
+
+  ~Pool() {
+    free(addr);
+  }
+
+  Buddy* buddy = nullptr;
+  void* addr = nullptr;
+};
+
+using Slab_alloc = slab::Alloc<Pool::Buddy, 4>;
+
+CASE("mem::slab size classes")
+{
+  EXPECT(slab::class_of(1) == 0);
+  EXPECT(slab::class_of(16) == 0);
+  EXPECT(slab::class_of(17) == 1);
+  EXPECT(slab::class_of(slab::max_size) == (int) slab::size_classes.size() - 1);
+
+  for (auto size : slab::size_classes) {
+    EXPECT(size % slab::min_align == 0);
+    // every class fills at least one object per slab
+    EXPECT(size <= slab::slab_size - sizeof(slab::Slab));
+  }
+}
+
+CASE("mem::slab small objects share pages, large allocations go to the backend")
+{
+  Pool pool(1_MiB);
+  Slab_alloc alloc(*pool.buddy);
+
+  std::vector<void*> objs;
+  std::set<void*> unique;
+  for (int i = 0; i < 1000; i++) {
+    auto* p = alloc.allocate_on(0, 40);
+    EXPECT(p != nullptr);
+    EXPECT(((uintptr_t) p % slab::min_align) == 0u);
+    EXPECT(slab::is_slab_object(p));
+    memset(p, 0xff, 40);
+    objs.push_back(p);
+    unique.insert(p);
+  }
+  EXPECT(unique.size() == objs.size());
+
+  auto st = alloc.stats(slab::class_of(40));
+  EXPECT(st.size == 48u);
+  EXPECT(st.in_use == 1000u);
+  const size_t per_slab = (slab::slab_size - sizeof(slab::Slab)) / 48;
+  EXPECT(st.slabs == (1000 + per_slab - 1) / per_slab);
+  EXPECT(pool.buddy->bytes_used() == st.slabs * slab::slab_size);
+
+  // page sized allocations bypass the slabs
+  auto* page = alloc.allocate_on(0, 3000);
+  EXPECT(not slab::is_slab_object(page));
+  EXPECT(pool.buddy->bytes_used() == (st.slabs + 1) * slab::slab_size);
+  alloc.deallocate_on(0, page, 3000);
+
+  for (auto* p : objs) alloc.deallocate_on(0, p, 40);
+  st = alloc.stats(slab::class_of(40));
+  EXPECT(st.in_use == 0u);
+  // one empty slab is kept for the next allocation
+  EXPECT(st.slabs == 1u);
+  EXPECT(pool.buddy->bytes_used() == slab::slab_size);
+
+  // freed objects are reused
+  auto* a = alloc.allocate_on(0, 48);
+  alloc.deallocate_on(0, a, 48);
+  EXPECT(alloc.allocate_on(0, 48) == a);
+  alloc.deallocate_on(0, a, 48);
+}
+
+CASE("mem::slab objects freed on another CPU go back to the owner")
+{
+  Pool pool(1_MiB);
+  Slab_alloc alloc(*pool.buddy);
+
+  std::vector<void*> objs;
+  for (int i = 0; i < 500; i++)
+    objs.push_back(alloc.allocate_on(1, 128));
+
+  // CPU 2 frees everything CPU 1 allocated
+  for (auto* p : objs) alloc.deallocate_on(2, p, 128);
+  auto st = alloc.stats(slab::class_of(128));
+  EXPECT(st.remote_frees == 500u);
+  EXPECT(st.in_use == 500u); // not yet seen by the owner
+
+  // the owner picks them up on its next allocation
+  auto* p = alloc.allocate_on(1, 128);
+  st = alloc.stats(slab::class_of(128));
+  EXPECT(st.in_use == 1u);
+  EXPECT(st.slabs == 1u);
+  EXPECT(slab::slab_of(p)->owner == 1);
+  alloc.deallocate_on(1, p, 128);
+
+  // CPUs have their own slabs
+  auto* p0 = alloc.allocate_on(0, 128);
+  auto* p3 = alloc.allocate_on(3, 128);
+  EXPECT(slab::slab_of(p0) != slab::slab_of(p3));
+  alloc.deallocate_on(0, p0, 128);
+  alloc.deallocate_on(3, p3, 128);
+}
+
+CASE("mem::slab as a PMR resource")
+{
+  Pool pool(1_MiB);
+  Slab_alloc alloc(*pool.buddy);
+  {
+    std::pmr::vector<int> vec(&alloc);
+    for (int i = 0; i < 100; i++) vec.push_back(i);
+    EXPECT(vec.at(99) == 99);
+    EXPECT(alloc.stats(slab::class_of(512)).in_use > 0u);
+
+    // over-aligned allocations are pages
+    std::pmr::memory_resource& res = alloc;
+    auto* p = res.allocate(64, 64);
+    EXPECT(not slab::is_slab_object(p));
+    res.deallocate(p, 64, 64);
+  }
+  size_t in_use = 0;
+  for (int i = 0; i < Slab_alloc::classes; i++)
+    in_use += alloc.stats(i).in_use;
+  EXPECT(in_use == 0u);
+}
@@ -53,3 +53,21 @@ CASE("logopt-related functions get/set logopt")
   EXPECT_NOT(sf.logopt() == LOG_USER);
   EXPECT(sf.logopt() == (LOG_NOWAIT));
 }
+
+CASE("format_message_prefix() writes the prefix without allocating, cut to fit")
+{
+  Syslog_print sf("ident", LOG_DAEMON);
+  sf.set_priority(LOG_ERR);
+  sf.set_logopt(LOG_PID);
+
+  char buf[Syslog_facility::prefix_max];
+  const auto len = sf.format_message_prefix(buf, sizeof(buf), "service");
+  const std::string prefix(buf, len);
+  EXPECT(prefix.find("<DAEMON.ERR> ") != std::string::npos);
+  EXPECT(prefix.find(" service ident[") != std::string::npos);
+  EXPECT(prefix.substr(len - 3) == "]: ");
+
+  char small[8];
+  EXPECT(sf.format_message_prefix(small, sizeof(small), "service") == 7u);
+  EXPECT(std::string(small) == prefix.substr(0, 7));
+}
@@ -0,0 +1,129 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <util/tar_view.hpp>
+#include <zlib.h>
+#include <string>
+#include <vector>
+
+// a ustar member, padded to whole blocks
+static std::string member(const std::string& name, const std::string& content)
+{
+  Tar_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  strncpy(hdr.name, name.c_str(), LENGTH_NAME);
+  snprintf(hdr.mode, LENGTH_MODE, "%07o", 0644);
+  snprintf(hdr.size, LENGTH_SIZE, "%011lo", (unsigned long) content.size());
+  snprintf(hdr.mod_time, LENGTH_MTIME, "%011o", 1234567);
+  hdr.typeflag = REGTYPE;
+  memcpy(hdr.magic, TMAGIC, TMAGLEN);
+  memcpy(hdr.version, TVERSION, TVERSLEN);
+  memset(hdr.checksum, ' ', LENGTH_CHECKSUM);
+  unsigned sum = 0;
+  for (size_t i = 0; i < sizeof(hdr); i++)
+    sum += ((uint8_t*) &hdr)[i];
+  snprintf(hdr.checksum, LENGTH_CHECKSUM, "%06o", sum);
+
+  std::string block((const char*) &hdr, sizeof(hdr));
+  block += content;
+  block.resize((block.size() + 511) / 512 * 512, '\0');
+  return block;
+}
+
+// content larger than the DEFLATE window, which does not repeat too soon
+static std::string content(size_t len)
+{
+  std::string data(len, '\0');
+  uint32_t x = 12345;
+  for (auto& c : data) {
+    x = x * 1103515245 + 12345;
+    c = 'a' + (x >> 16) % 16;
+  }
+  return data;
+}
+
+static std::string gzip(const std::string& data)
+{
+  z_stream zs {};
+  // 16 + window bits for a gzip header and trailer
+  deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&zs, data.size()), '\0');
+  zs.next_in   = (Bytef*) data.data();
+  zs.avail_in  = data.size();
+  zs.next_out  = (Bytef*) out.data();
+  zs.avail_out = out.size();
+  deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+CASE("tar::Gunzip decompresses a piece at a time")
+{
+  const std::string data = content(100 * 1024);
+  const std::string gz = gzip(data);
+
+  tar::Gunzip gunzip {gz};
+  std::string out;
+  uint8_t chunk[3000];
+  size_t len;
+  while ((len = gunzip.read(chunk, sizeof(chunk))) > 0) {
+    EXPECT(len <= sizeof(chunk));
+    out.append((const char*) chunk, len);
+  }
+  EXPECT(gunzip.done());
+  EXPECT(out == data);
+  EXPECT(gunzip.read(chunk, sizeof(chunk)) == 0u);
+}
+
+CASE("tar::Gunzip throws on corrupt data")
+{
+  EXPECT_THROWS_AS(tar::Gunzip{std::string(64, 'x')}, tar::Tar_exception);
+
+  std::string gz = gzip(content(100 * 1024));
+  // keep the header, break the compressed data
+  for (size_t i = 20; i < gz.size(); i += 7) gz[i] = ~gz[i];
+  tar::Gunzip gunzip {gz};
+  uint8_t chunk[4096];
+  auto drain = [&] { while (gunzip.read(chunk, sizeof(chunk)) > 0); };
+  EXPECT_THROWS_AS(drain(), tar::Tar_exception);
+}
+
+CASE("tar::Stream reads a .tar.gz in memory")
+{
+  const std::string big = content(80 * 1024);
+  const std::string data = member("config/app.json", "{\"port\": 80}")
+                         + member("assets/big.bin", big)
+                         + std::string(1024, '\0');
+  const std::string gz = gzip(data);
+
+  std::vector<std::string> names;
+  std::string got;
+  tar::Stream stream {
+    [&] (const tar::Header_view& hdr) {
+      names.emplace_back(hdr.name());
+    },
+    [&] (const tar::Header_view& hdr, std::string_view chunk) {
+      if (hdr.name() == "assets/big.bin") got += chunk;
+    }
+  };
+  stream.feed_gz(gz);
+  EXPECT(stream.done());
+  EXPECT(names.size() == 2u);
+  EXPECT(names.at(0) == "config/app.json");
+  EXPECT(got == big);
+}
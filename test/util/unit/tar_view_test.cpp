@@ -0,0 +1,223 @@
+// This file is a part of the IncludeOS unikernel - www.includeos.org
+//
+// Copyright 2018 IncludeOS AS, Oslo, Norway
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <common.cxx>
+#include <util/tar_view.hpp>
+#include <fs/memdisk.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+// a ustar member, padded to whole blocks
+static std::string member(const std::string& name, const std::string& content,
+                          char type = REGTYPE)
+{
+  Tar_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  strncpy(hdr.name, name.c_str(), LENGTH_NAME);
+  snprintf(hdr.mode, LENGTH_MODE, "%07o", 0644);
+  snprintf(hdr.size, LENGTH_SIZE, "%011lo", (unsigned long) content.size());
+  snprintf(hdr.mod_time, LENGTH_MTIME, "%011o", 1234567);
+  hdr.typeflag = type;
+  memcpy(hdr.magic, TMAGIC, TMAGLEN);
+  memcpy(hdr.version, TVERSION, TVERSLEN);
+  memset(hdr.checksum, ' ', LENGTH_CHECKSUM);
+  unsigned sum = 0;
+  for (size_t i = 0; i < sizeof(hdr); i++)
+    sum += ((uint8_t*) &hdr)[i];
+  snprintf(hdr.checksum, LENGTH_CHECKSUM, "%06o", sum);
+
+  std::string block((const char*) &hdr, sizeof(hdr));
+  block += content;
+  block.resize((block.size() + 511) / 512 * 512, '\0');
+  return block;
+}
+
+static std::string archive()
+{
+  return member("config/", "", DIRTYPE)
+       + member("config/app.json", "{\"port\": 80}")
+       + member("assets/big.bin", std::string(1300, 'x'))
+       + member("empty.txt", "")
+       + std::string(1024, '\0');
+}
+
+CASE("tar::View reads members in place")
+{
+  const std::string data = archive();
+  tar::View view {data};
+  std::vector<std::string_view> names;
+  for (const auto& entry : view)
+    names.push_back(entry.name());
+  EXPECT(names.size() == 4u);
+  EXPECT(names.at(0) == "config/");
+  EXPECT(names.at(3) == "empty.txt");
+
+  auto dir = view.find("config/");
+  EXPECT(dir.header.is_dir());
+
+  auto app = view.find("config/app.json");
+  EXPECT(app.is_valid());
+  EXPECT(app.header.is_file());
+  EXPECT(app.header.is_ustar());
+  EXPECT(app.header.mode() == 0644u);
+  EXPECT(app.header.mod_time() == 1234567u);
+  EXPECT(app.content == "{\"port\": 80}");
+  // nothing copied
+  EXPECT(app.content.data() == data.data() + 2 * 512);
+  EXPECT(app.name().data() == data.data() + 512);
+
+  auto big = view.find("assets/big.bin");
+  EXPECT(big.header.size() == 1300u);
+  EXPECT(big.header.padded_size() == 1536u);
+  EXPECT(big.content == std::string(1300, 'x'));
+
+  EXPECT(not view.find("missing").is_valid());
+  EXPECT(view.find("empty.txt").content.empty());
+}
+
+CASE("tar::View looks names up through the index")
+{
+  const std::string data = archive();
+  tar::View view {data};
+  EXPECT(not view.has_index());
+  view.build_index();
+  EXPECT(view.has_index());
+  EXPECT(view.find("assets/big.bin").content.size() == 1300u);
+  EXPECT(view.find("config/app.json").content == "{\"port\": 80}");
+  EXPECT(not view.find("config").is_valid());
+}
+
+CASE("tar::View throws on corrupt archives")
+{
+  std::string data = archive();
+  // damage the name of the second member
+  data[512] = 'C';
+  tar::View bad {data};
+  EXPECT_THROWS_AS(for (auto& e : bad) (void) e, tar::Tar_exception);
+
+  // content running past the end
+  data = member("cut.bin", std::string(2000, 'y')).substr(0, 1024);
+  EXPECT_THROWS_AS(tar::View{data}.begin(), tar::Tar_exception);
+
+  // no end blocks is fine
+  data = member("a", "1");
+  EXPECT(tar::View{data}.find("a").content == "1");
+  EXPECT(tar::View{""}.begin() == tar::View{""}.end());
+}
+
+CASE("tar::Stream reads archives arriving in pieces")
+{
+  const std::string data = archive();
+  std::vector<std::string> names;
+  std::string content;
+  tar::Stream stream {
+    [&] (const tar::Header_view& hdr) {
+      names.emplace_back(hdr.name());
+    },
+    [&] (const tar::Header_view& hdr, std::string_view chunk) {
+      if (hdr.name() == "assets/big.bin") content += chunk;
+    }
+  };
+  // in odd sized pieces
+  bool more = true;
+  for (size_t i = 0; i < data.size() and more; i += 77)
+    more = stream.feed(std::string_view{data}.substr(i, 77));
+  EXPECT(not more);
+  EXPECT(stream.done());
+  EXPECT(names.size() == 4u);
+  EXPECT(names.at(1) == "config/app.json");
+  EXPECT(content == std::string(1300, 'x'));
+}
+
+CASE("tar::Stream reads archives from a block device")
+{
+  static std::string data = archive();
+  fs::MemDisk disk {data.data(), data.data() + data.size()};
+  int count = 0;
+  size_t bytes = 0;
+  tar::Stream stream {
+    [&count] (const tar::Header_view&) { count++; },
+    [&bytes] (const tar::Header_view&, std::string_view chunk) {
+      bytes += chunk.size();
+    }
+  };
+  int done = 0;
+  bool failed = true;
+  stream.feed(disk, [&] (bool error) { done++; failed = error; }, 0, 2);
+  EXPECT(done == 1);
+  EXPECT(not failed);
+  EXPECT(stream.done());
+  EXPECT(count == 4);
+  EXPECT(bytes == 12u + 1300u);
+}
+
+// completes reads later, like drivers that wait for the device
+struct Deferred_disk : public fs::MemDisk
+{
+  using fs::MemDisk::MemDisk;
+  std::vector<std::function<void()>> pending;
+  bool fail = false;
+
+  void read(block_t blk, size_t count, on_read_func reader) override {
+    pending.push_back([this, blk, count, reader] {
+      reader(fail ? nullptr : read_sync(blk, count));
+    });
+  }
+  // complete the reads issued so far, returns how many there were
+  size_t complete() {
+    auto reads = std::move(pending);
+    pending.clear();
+    for (auto& read : reads) read();
+    return reads.size();
+  }
+};
+
+CASE("tar::Stream reads archives from a device that completes reads later")
+{
+  static std::string data = archive();
+  Deferred_disk disk {data.data(), data.data() + data.size()};
+  std::vector<std::string> names;
+  tar::Stream stream {
+    [&names] (const tar::Header_view& hdr) { names.emplace_back(hdr.name()); }
+  };
+  int done = 0;
+  bool failed = true;
+  stream.feed(disk, [&] (bool error) { done++; failed = error; }, 0, 1);
+  // one read at a time, each issued when the last completed
+  size_t reads = 0;
+  while (size_t n = disk.complete()) {
+    EXPECT(n == 1u);
+    reads += n;
+  }
+  EXPECT(done == 1);
+  EXPECT(not failed);
+  EXPECT(stream.done());
+  EXPECT(names.size() == 4u);
+  // 8 blocks of members, then the zero block at the end stops the reading
+  EXPECT(reads == 9u);
+
+  // a failed read ends it with an error
+  Deferred_disk broken {data.data(), data.data() + data.size()};
+  tar::Stream other {[] (const tar::Header_view&) {}};
+  done = 0;
+  other.feed(broken, [&] (bool error) { done++; failed = error; });
+  broken.fail = true;
+  broken.complete();
+  EXPECT(done == 1);
+  EXPECT(failed);
+  EXPECT(not other.done());
+}
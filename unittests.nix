@@ -63,6 +63,7 @@ stdenv.mkDerivation rec {
     pkgs.rapidjson
     pkgs.http-parser
     pkgs.openssl
+    pkgs.zlib
     lest
     uzlib
   ];